@@ -46,6 +46,41 @@ struct lttng_ust_tracepoint {
 	const char *signature;
 
 	/* End of base ABI. Fields below should be used after checking struct_size. */
+
+	/*
+	 * Called with the tracepoint registry lock held whenever the
+	 * tracepoint is armed (@state 1) or disarmed (@state 0). Used by
+	 * tracepoints registered at run time for dynamic instrumentation.
+	 */
+	void (*state_notify)(struct lttng_ust_tracepoint *tp, int state);
+};
+
+/*
+ * Tracepoint call site location
+ *
+ * Emitted for each lttng_ust_tracepoint() expansion when
+ * LTTNG_UST_TRACEPOINT_SITES is defined. A call site is only traced
+ * when both its tracepoint and its own state are enabled.
+ *
+ * IMPORTANT: this structure is part of the ABI between instrumented
+ * applications and UST. Fields need to be only added at the end, never
+ * reordered, never removed.
+ *
+ * The field @struct_size should be used to determine the size of the
+ * structure. It should be queried before using additional fields added
+ * at the end of the structure.
+ */
+
+struct lttng_ust_tracepoint_site {
+	uint32_t struct_size;
+
+	struct lttng_ust_tracepoint *tp;
+	const char *file;
+	const char *func;
+	uint32_t line;
+	int state;
+
+	/* End of base ABI. Fields below should be used after checking struct_size. */
 };
 
 #endif /* _LTTNG_UST_TRACEPOINT_TYPES_H */
@@ -7,6 +7,7 @@
 #ifndef _LTTNG_UST_TRACEPOINT_H
 #define _LTTNG_UST_TRACEPOINT_H
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <lttng/tracepoint-types.h>
@@ -15,6 +16,7 @@
 #include <urcu/system.h>
 #include <dlfcn.h>	/* for dlopen */
 #include <string.h>	/* for memset */
+#include <stddef.h>	/* for offsetof */
 
 #include <lttng/ust-config.h>	/* for sdt */
 #include <lttng/ust-compiler.h>
@@ -56,12 +58,47 @@ extern "C" {
 #define lttng_ust_do_tracepoint(provider, name, ...)				\
 	lttng_ust_tracepoint_cb_##provider##___##name(__VA_ARGS__)
 
+/*
+ * LTTNG_UST_TRACEPOINT_SITES: Define this before including a tracepoint
+ * instrumentation header to record the location of each
+ * lttng_ust_tracepoint() call site. Each call site then has its own
+ * enablement state, which is checked only once the tracepoint itself
+ * is enabled. Call sites can be selected with the
+ * LTTNG_UST_TRACEPOINT_SITES environment variable (see lttng-ust(3)),
+ * and at runtime with lttng_ust_tracepoint_select_sites().
+ *
+ * This declares a static variable at each call site, so it cannot be
+ * used within non-static inline functions.
+ */
+#ifdef LTTNG_UST_TRACEPOINT_SITES
+#define lttng_ust_tracepoint(provider, name, ...)				\
+	do {									\
+		static struct lttng_ust_tracepoint_site lttng_ust__tp_site = {	\
+			sizeof(struct lttng_ust_tracepoint_site),		\
+			&lttng_ust_tracepoint_##provider##___##name,		\
+			__FILE__,						\
+			__func__,						\
+			__LINE__,						\
+			1,							\
+		};								\
+		static struct lttng_ust_tracepoint_site *lttng_ust__tp_site_ptr	\
+			__attribute__((section("lttng_ust_tracepoint_sites_ptrs"), used)) \
+			__lttng_ust_variable_attribute_no_sanitize_address =	\
+				&lttng_ust__tp_site;				\
+		(void) lttng_ust__tp_site_ptr;					\
+		LTTNG_UST_STAP_PROBEV(provider, name, ## __VA_ARGS__);		\
+		if (lttng_ust_tracepoint_enabled(provider, name)		\
+				&& caa_likely(CMM_LOAD_SHARED(lttng_ust__tp_site.state))) \
+			lttng_ust_do_tracepoint(provider, name, __VA_ARGS__);	\
+	} while (0)
+#else
 #define lttng_ust_tracepoint(provider, name, ...)				\
 	do {									\
 		LTTNG_UST_STAP_PROBEV(provider, name, ## __VA_ARGS__);		\
 		if (lttng_ust_tracepoint_enabled(provider, name))		\
 			lttng_ust_do_tracepoint(provider, name, __VA_ARGS__);	\
 	} while (0)
+#endif
 
 #define LTTNG_UST_TP_ARGS(...)       __VA_ARGS__
 
@@ -177,16 +214,35 @@ extern "C" {
 		Tracepoint_name_length_is_too_long)
 
 /*
- * The tracepoint cb is marked always inline so we can distinguish
- * between caller's ip addresses within the probe using the return
- * address.
+ * The tracepoint cb holds the whole call path, including the probe
+ * iteration. By default, it is a cold function, kept out of line in
+ * the .text.unlikely section: a disabled tracepoint only costs a load
+ * and a branch on the tracepoint state, and an enabled one a call to
+ * its cb. The ip context then identifies the cb of the tracepoint
+ * within its compile unit rather than each call site.
+ *
+ * Define LTTNG_UST_TRACEPOINT_NO_COLD_PATH before including a
+ * tracepoint instrumentation header to have the cb always inlined
+ * instead, so that the probe can distinguish between caller's ip
+ * addresses using the return address, at the cost of the call path
+ * being expanded at each call site.
  */
+#ifndef LTTNG_UST_TRACEPOINT_NO_COLD_PATH
+#define LTTNG_UST__TRACEPOINT_CB_INLINE
+#define LTTNG_UST__TRACEPOINT_CB_ATTR						\
+	__attribute__((cold, noinline, section(".text.unlikely"), unused))
+#else
+#define LTTNG_UST__TRACEPOINT_CB_INLINE	inline
+#define LTTNG_UST__TRACEPOINT_CB_ATTR						\
+	__attribute__((always_inline, unused))
+#endif
+
 #define LTTNG_UST__DECLARE_TRACEPOINT(_provider, _name, ...)			 		\
 extern struct lttng_ust_tracepoint lttng_ust_tracepoint_##_provider##___##_name		\
 		LTTNG_UST__TRACEPOINT_DEFINITION_VISIBILITY;				\
-static inline										\
+static LTTNG_UST__TRACEPOINT_CB_INLINE							\
 void lttng_ust_tracepoint_cb_##_provider##___##_name(LTTNG_UST__TP_ARGS_PROTO(__VA_ARGS__))		\
-	__attribute__((always_inline, unused)) lttng_ust_notrace;			\
+	LTTNG_UST__TRACEPOINT_CB_ATTR lttng_ust_notrace;				\
 static											\
 void lttng_ust_tracepoint_cb_##_provider##___##_name(LTTNG_UST__TP_ARGS_PROTO(__VA_ARGS__))		\
 {											\
@@ -273,8 +329,20 @@ struct lttng_ust_tracepoint_dlopen {
 	void *(*rcu_dereference_sym)(void *p);
 
 	/* End of base ABI. Fields below should be used after checking struct_size. */
+
+	int (*lttng_ust_tracepoint_module_register_sites)(struct lttng_ust_tracepoint_site * const *sites_start,
+		int sites_count);
+	int (*lttng_ust_tracepoint_module_unregister_sites)(struct lttng_ust_tracepoint_site * const *sites_start);
 };
 
+/*
+ * Test whether a field added after the base ABI of a structure holding
+ * a @struct_size field is present.
+ */
+#define lttng_ust_struct_field_present(ptr, field)				\
+	((ptr)->struct_size >= offsetof(__typeof__(*(ptr)), field)		\
+		+ sizeof((ptr)->field))
+
 extern struct lttng_ust_tracepoint_dlopen lttng_ust_tracepoint_dlopen;
 extern struct lttng_ust_tracepoint_dlopen *lttng_ust_tracepoint_dlopen_ptr;
 
@@ -347,6 +415,30 @@ static inline void tracepoint_disable_destructors(void)
 		lttng_ust_tracepoint_destructors_syms_ptr->tracepoint_disable_destructors();
 }
 
+/*
+ * Replace the call site selectors of the LTTNG_UST_TRACEPOINT_SITES
+ * environment variable at runtime, with the same syntax (see
+ * lttng-ust(3)). NULL or an empty string selects all the call sites.
+ * Returns 0, a negative error value if the selectors are invalid, in
+ * which case the selection is unchanged, or -ENOSYS if
+ * liblttng-ust-tracepoint is not loaded.
+ */
+static inline int lttng_ust_tracepoint_select_sites(const char *selectors)
+{
+	int (*select_sites)(const char *);
+
+	if (!lttng_ust_tracepoint_dlopen_ptr)
+		lttng_ust_tracepoint_dlopen_ptr = &lttng_ust_tracepoint_dlopen;
+	if (!lttng_ust_tracepoint_dlopen_ptr->liblttngust_handle)
+		return -ENOSYS;
+	select_sites = URCU_FORCE_CAST(int (*)(const char *),
+			dlsym(lttng_ust_tracepoint_dlopen_ptr->liblttngust_handle,
+				"lttng_ust_tp_select_sites"));
+	if (!select_sites)
+		return -ENOSYS;
+	return select_sites(selectors);
+}
+
 #ifndef _LGPL_SOURCE
 static inline void
 lttng_ust_tracepoint__init_urcu_sym(void)
@@ -464,6 +556,10 @@ extern struct lttng_ust_tracepoint * const __start_lttng_ust_tracepoints_ptrs[]
 	__attribute__((weak, visibility("hidden")));
 extern struct lttng_ust_tracepoint * const __stop_lttng_ust_tracepoints_ptrs[]
 	__attribute__((weak, visibility("hidden")));
+extern struct lttng_ust_tracepoint_site * const __start_lttng_ust_tracepoint_sites_ptrs[]
+	__attribute__((weak, visibility("hidden")));
+extern struct lttng_ust_tracepoint_site * const __stop_lttng_ust_tracepoint_sites_ptrs[]
+	__attribute__((weak, visibility("hidden")));
 
 /*
  * When LTTNG_UST_TRACEPOINT_PROBE_DYNAMIC_LINKAGE is defined, we do not emit a
@@ -560,6 +656,24 @@ lttng_ust__tracepoints__ptrs_init(void)
 				__stop_lttng_ust_tracepoints_ptrs -
 				__start_lttng_ust_tracepoints_ptrs);
 	}
+	if (!lttng_ust_struct_field_present(lttng_ust_tracepoint_dlopen_ptr,
+			lttng_ust_tracepoint_module_unregister_sites))
+		return;
+	lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_register_sites =
+		URCU_FORCE_CAST(int (*)(struct lttng_ust_tracepoint_site * const *, int),
+				dlsym(lttng_ust_tracepoint_dlopen_ptr->liblttngust_handle,
+					"lttng_ust_tracepoint_module_register_sites"));
+	lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_unregister_sites =
+		URCU_FORCE_CAST(int (*)(struct lttng_ust_tracepoint_site * const *),
+				dlsym(lttng_ust_tracepoint_dlopen_ptr->liblttngust_handle,
+					"lttng_ust_tracepoint_module_unregister_sites"));
+	if (lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_register_sites
+			&& __stop_lttng_ust_tracepoint_sites_ptrs -
+				__start_lttng_ust_tracepoint_sites_ptrs > 0) {
+		lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_register_sites(__start_lttng_ust_tracepoint_sites_ptrs,
+				__stop_lttng_ust_tracepoint_sites_ptrs -
+				__start_lttng_ust_tracepoint_sites_ptrs);
+	}
 }
 
 static void
@@ -576,6 +690,12 @@ lttng_ust__tracepoints__ptrs_destroy(void)
 		lttng_ust_tracepoint_dlopen_ptr = &lttng_ust_tracepoint_dlopen;
 	if (!lttng_ust_tracepoint_destructors_syms_ptr)
 		lttng_ust_tracepoint_destructors_syms_ptr = &lttng_ust_tracepoint_destructors_syms;
+	if (lttng_ust_struct_field_present(lttng_ust_tracepoint_dlopen_ptr,
+				lttng_ust_tracepoint_module_unregister_sites)
+			&& lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_unregister_sites
+			&& __stop_lttng_ust_tracepoint_sites_ptrs -
+				__start_lttng_ust_tracepoint_sites_ptrs > 0)
+		lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_unregister_sites(__start_lttng_ust_tracepoint_sites_ptrs);
 	if (lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_unregister)
 		lttng_ust_tracepoint_dlopen_ptr->lttng_ust_tracepoint_module_unregister(__start_lttng_ust_tracepoints_ptrs);
 	if (lttng_ust_tracepoint_dlopen_ptr->liblttngust_handle
@@ -21,7 +21,7 @@
 /* Version for ABI between liblttng-ust, sessiond, consumerd */
 #define LTTNG_UST_ABI_MAJOR_VERSION			9
 #define LTTNG_UST_ABI_MAJOR_VERSION_OLDEST_COMPATIBLE	8
-#define LTTNG_UST_ABI_MINOR_VERSION		0
+#define LTTNG_UST_ABI_MINOR_VERSION		1
 
 enum lttng_ust_abi_instrumentation {
 	LTTNG_UST_ABI_TRACEPOINT	= 0,
@@ -42,6 +42,16 @@ enum lttng_ust_abi_output {
 enum lttng_ust_abi_chan_type {
 	LTTNG_UST_ABI_CHAN_PER_CPU = 0,
 	LTTNG_UST_ABI_CHAN_METADATA = 1,
+	LTTNG_UST_ABI_CHAN_PER_CHANNEL = 2,	/* Global buffer, one lane per stream. */
+};
+
+/* Clock source timestamping the events of a channel. */
+enum lttng_ust_abi_clock_source {
+	LTTNG_UST_ABI_CLOCK_DEFAULT = 0,		/* Trace clock, or clock plugin override. */
+	LTTNG_UST_ABI_CLOCK_MONOTONIC = 1,
+	LTTNG_UST_ABI_CLOCK_MONOTONIC_COARSE = 2,
+	LTTNG_UST_ABI_CLOCK_MONOTONIC_RAW = 3,
+	NR_LTTNG_UST_ABI_CLOCK_SOURCE,
 };
 
 struct lttng_ust_abi_tracer_version {
@@ -88,6 +98,26 @@ enum lttng_ust_abi_counter_bitness {
 	LTTNG_UST_ABI_COUNTER_BITNESS_64 = 1,
 };
 
+enum lttng_ust_abi_counter_sketch {
+	LTTNG_UST_ABI_COUNTER_SKETCH_NONE = 0,
+	LTTNG_UST_ABI_COUNTER_SKETCH_COUNT_MIN = 1,
+	LTTNG_UST_ABI_COUNTER_SKETCH_HYPERLOGLOG = 2,
+};
+
+/*
+ * Probe stages accounted by a session profile counter. Its dimensions
+ * are the channel id, the event id, the stage, and the base 2 logarithm
+ * of the stage duration in cycles.
+ */
+enum lttng_ust_abi_profile_stage {
+	LTTNG_UST_ABI_PROFILE_STAGE_FILTER = 0,
+	LTTNG_UST_ABI_PROFILE_STAGE_CONTEXT = 1,	/* Sizes, and context fields. */
+	LTTNG_UST_ABI_PROFILE_STAGE_RESERVE = 2,
+	LTTNG_UST_ABI_PROFILE_STAGE_SERIALIZE = 3,
+	LTTNG_UST_ABI_PROFILE_STAGE_COMMIT = 4,
+	NR_LTTNG_UST_ABI_PROFILE_STAGE,
+};
+
 struct lttng_ust_abi_counter_dimension {
 	uint64_t size;
 	uint64_t underflow_index;
@@ -96,7 +126,7 @@ struct lttng_ust_abi_counter_dimension {
 	uint8_t has_overflow;
 } __attribute__((packed));
 
-#define LTTNG_UST_ABI_COUNTER_CONF_PADDING1 67
+#define LTTNG_UST_ABI_COUNTER_CONF_PADDING1 47
 struct lttng_ust_abi_counter_conf {
 	uint32_t arithmetic;	/* enum lttng_ust_abi_counter_arithmetic */
 	uint32_t bitness;	/* enum lttng_ust_abi_counter_bitness */
@@ -104,6 +134,19 @@ struct lttng_ust_abi_counter_conf {
 	int64_t global_sum_step;
 	struct lttng_ust_abi_counter_dimension dimensions[LTTNG_UST_ABI_COUNTER_DIMENSION_MAX];
 	uint8_t coalesce_hits;
+	/*
+	 * Sketch counters have two dimensions: the sketch index, and
+	 * the sketch cells.
+	 */
+	uint32_t sketch;	/* enum lttng_ust_abi_counter_sketch */
+	uint32_t sketch_depth;	/* Count-min rows. */
+	uint32_t sketch_width;	/* Count-min columns, or HyperLogLog registers. */
+	uint32_t sketch_top_k;	/* Count-min heavy hitters tracked. */
+	/*
+	 * Non-zero for a session profile counter: each thread profiles
+	 * one probe hit out of profile_period.
+	 */
+	uint32_t profile_period;
 	char padding[LTTNG_UST_ABI_COUNTER_CONF_PADDING1];
 } __attribute__((packed));
 
@@ -113,7 +156,7 @@ struct lttng_ust_abi_counter_value {
 	int64_t value;
 } __attribute__((packed));
 
-#define LTTNG_UST_ABI_EVENT_PADDING1	8
+#define LTTNG_UST_ABI_EVENT_PADDING1	4
 #define LTTNG_UST_ABI_EVENT_PADDING2	(LTTNG_UST_ABI_SYM_NAME_LEN + 32)
 struct lttng_ust_abi_event {
 	int32_t instrumentation; 		/* enum lttng_ust_abi_instrumentation */
@@ -122,6 +165,12 @@ struct lttng_ust_abi_event {
 	int32_t loglevel_type;			/* enum lttng_ust_abi_loglevel_type */
 	int32_t loglevel;			/* value, -1: all */
 	uint64_t token;				/* User-provided token */
+	/*
+	 * Maximum number of bytes recorded for each string and sequence
+	 * field of the matching events, terminating '\0' of strings
+	 * included, 0: no limit.
+	 */
+	uint32_t max_payload_len;
 	char padding[LTTNG_UST_ABI_EVENT_PADDING1];
 
 	/* Per instrumentation type configuration */
@@ -130,17 +179,37 @@ struct lttng_ust_abi_event {
 	} u;
 } __attribute__((packed));
 
-#define LTTNG_UST_ABI_EVENT_NOTIFIER_PADDING	32
+#define LTTNG_UST_ABI_EVENT_NOTIFIER_PADDING	12
 struct lttng_ust_abi_event_notifier {
 	struct lttng_ust_abi_event event;
 	uint64_t error_counter_index;
+	/* Sketch updated for each hit, keyed on the first capture, if any. */
+	uint32_t sketch;	/* enum lttng_ust_abi_counter_sketch */
+	uint64_t sketch_index;
+	/*
+	 * Window within which the notifications of this event notifier
+	 * are coalesced (microseconds), at most LONG_MAX. 0: disabled.
+	 */
+	uint64_t coalesce_window_us;
 	char padding[LTTNG_UST_ABI_EVENT_NOTIFIER_PADDING];
 } __attribute__((packed));
 
-#define LTTNG_UST_ABI_EVENT_NOTIFIER_NOTIFICATION_PADDING 32
+#define LTTNG_UST_ABI_EVENT_NOTIFIER_NOTIFICATION_PADDING 24
 struct lttng_ust_abi_event_notifier_notification {
 	uint64_t token;
 	uint16_t capture_buf_size;
+	/*
+	 * Notifications coalesced since the previous one was sent.
+	 *
+	 * Only the first hit of an event notifier within its coalescing
+	 * window is notified with its captures: the following hits are
+	 * counted without evaluating their captures. Hits still counted
+	 * when the window expires are sent shortly after in a
+	 * notification standing for the last of them, whose captures
+	 * are all empty (msgpack nil), and whose nr_coalesced excludes
+	 * that last hit.
+	 */
+	uint64_t nr_coalesced;
 	char padding[LTTNG_UST_ABI_EVENT_NOTIFIER_NOTIFICATION_PADDING];
 } __attribute__((packed));
 
@@ -206,6 +275,8 @@ enum lttng_ust_abi_context_type {
 	LTTNG_UST_ABI_CONTEXT_VEGID			= 19,
 	LTTNG_UST_ABI_CONTEXT_VSGID			= 20,
 	LTTNG_UST_ABI_CONTEXT_TIME_NS			= 21,
+	LTTNG_UST_ABI_CONTEXT_REPEAT			= 22,	/* Fold identical consecutive events. */
+	LTTNG_UST_ABI_CONTEXT_TRUNCATED			= 23,	/* Fields cut by max_payload_len. */
 };
 
 struct lttng_ust_abi_perf_counter_ctx {
@@ -364,6 +435,8 @@ struct lttng_ust_abi_event_exclusion {
 #define LTTNG_UST_ABI_TRACEPOINT_FIELD_LIST	LTTNG_UST_ABI_CMD(0x45)
 #define LTTNG_UST_ABI_EVENT_NOTIFIER_GROUP_CREATE \
 	LTTNG_UST_ABI_CMD(0x46)
+#define LTTNG_UST_ABI_BATCH_BEGIN		LTTNG_UST_ABI_CMD(0x47)
+#define LTTNG_UST_ABI_BATCH_END			LTTNG_UST_ABI_CMD(0x48)
 
 /* Session commands */
 #define LTTNG_UST_ABI_CHANNEL			\
@@ -50,6 +50,7 @@ struct lttng_ust_ctl_consumer_channel_attr {
 	uint32_t chan_id;			/* channel ID */
 	unsigned char uuid[LTTNG_UST_UUID_LEN]; /* Trace session unique ID */
 	int64_t blocking_timeout;			/* Blocking timeout (usec) */
+	int32_t clock_source;			/* enum lttng_ust_abi_clock_source */
 } __attribute__((packed));
 
 /*
@@ -87,6 +88,38 @@ int lttng_ust_ctl_set_capture(int sock, struct lttng_ust_abi_capture_bytecode *b
 int lttng_ust_ctl_set_exclusion(int sock, struct lttng_ust_abi_event_exclusion *exclusion,
 		struct lttng_ust_abi_object_data *obj_data);
 
+/*
+ * Command batches: between lttng_ust_ctl_batch_begin() and
+ * lttng_ust_ctl_batch_end(), the commands issued by the calling thread
+ * on sock are sent without waiting for their replies, and report
+ * success. Handles returned within the batch refer to the objects the
+ * batched commands will create, and can be passed to later commands of
+ * the same batch. The application applies the enabler changes once, at
+ * batch end.
+ *
+ * lttng_ust_ctl_batch_end() returns the per-command replies, in command
+ * order, in an array to be freed by the caller. Object data handles
+ * created within the batch are updated, or set to -1 if their command
+ * failed. Handles returned by value (e.g. lttng_ust_ctl_create_session())
+ * are resolved with lttng_ust_ctl_batch_resolve_handle(). Object data
+ * created within a batch must not be released before its end.
+ * Commands returning data in their reply (tracer version, tracepoint
+ * list iteration) are refused within a batch.
+ */
+struct lttng_ust_ctl_batch_reply {
+	uint32_t tag;		/* Position of the command in the batch, from 1 */
+	uint32_t handle;	/* Handle the command was sent to */
+	uint32_t cmd;
+	int32_t ret_code;	/* LTTNG_UST_OK or -LTTNG_UST_ERR_* */
+	uint32_t ret_val;
+};
+
+int lttng_ust_ctl_batch_begin(int sock);
+int lttng_ust_ctl_batch_end(int sock, struct lttng_ust_ctl_batch_reply **replies,
+		size_t *nr_replies);
+int lttng_ust_ctl_batch_resolve_handle(const struct lttng_ust_ctl_batch_reply *replies,
+		size_t nr_replies, int handle);
+
 int lttng_ust_ctl_enable(int sock, struct lttng_ust_abi_object_data *object);
 int lttng_ust_ctl_disable(int sock, struct lttng_ust_abi_object_data *object);
 int lttng_ust_ctl_start_session(int sock, int handle);
@@ -107,7 +140,8 @@ int lttng_ust_ctl_create_event_notifier_group(int sock, int pipe_fd,
  * group giving a event notifier description and a event notifier group handle.
  * It returns a event notifier handle to be used when enabling the event
  * notifier, attaching filter, attaching exclusion, and disabling the event
- * notifier.
+ * notifier. The notifications of the event notifier are coalesced within
+ * the coalesce_window_us of its description, if set.
  */
 int lttng_ust_ctl_create_event_notifier(int sock,
 		struct lttng_ust_abi_event_notifier *event_notifier,
@@ -182,6 +216,22 @@ struct lttng_ust_ctl_consumer_channel_attr;
 
 int lttng_ust_ctl_get_nr_stream_per_channel(void);
 
+/*
+ * Per-channel (LTTNG_UST_ABI_CHAN_PER_CHANNEL) buffers have one lane per
+ * stream fd, up to lttng_ust_ctl_get_nr_stream_per_channel(). Each lane
+ * is an independent ring buffer, exposed as the stream of the same
+ * number, and application threads are spread over the lanes by hash.
+ *
+ * Per-cpu channels take either one stream fd per stream, or a single
+ * stream fd packing all per-cpu buffers within one shm object. Packed
+ * channels share a single wait/wakeup fd pair across their streams:
+ * only the stream of cpu 0 is sent to the session daemon, and it
+ * carries the whole shm object. Writers flag their cpu in a ready-cpu
+ * bitmap and only write into the wakeup pipe when their bit was clear,
+ * so the consumer must empty the pipe, fetch the bitmap with
+ * lttng_ust_ctl_channel_get_ready_cpus(), service the flagged streams,
+ * and then wait on the pipe.
+ */
 struct lttng_ust_ctl_consumer_channel *
 	lttng_ust_ctl_create_channel(struct lttng_ust_ctl_consumer_channel_attr *attr,
 		const int *stream_fds, int nr_stream_fds);
@@ -197,6 +247,13 @@ int lttng_ust_ctl_channel_close_wait_fd(struct lttng_ust_ctl_consumer_channel *c
 int lttng_ust_ctl_channel_close_wakeup_fd(struct lttng_ust_ctl_consumer_channel *consumer_chan);
 int lttng_ust_ctl_channel_get_wait_fd(struct lttng_ust_ctl_consumer_channel *consumer_chan);
 int lttng_ust_ctl_channel_get_wakeup_fd(struct lttng_ust_ctl_consumer_channel *consumer_chan);
+/*
+ * Fetch and clear the ready-cpu bitmap of a packed channel into @bitmap,
+ * which holds @nr_longs longs. Returns the number of ready cpus, or
+ * -ENOSYS if the channel is not packed.
+ */
+int lttng_ust_ctl_channel_get_ready_cpus(struct lttng_ust_ctl_consumer_channel *consumer_chan,
+		unsigned long *bitmap, size_t nr_longs);
 
 int lttng_ust_ctl_write_metadata_to_channel(
 		struct lttng_ust_ctl_consumer_channel *channel,
@@ -290,6 +347,18 @@ int lttng_ust_ctl_get_stream_id(struct lttng_ust_ctl_consumer_stream *stream,
 int lttng_ust_ctl_get_instance_id(struct lttng_ust_ctl_consumer_stream *stream,
 		uint64_t *id);
 
+/*
+ * NUMA placement of the sub-buffers of a per-channel stream: number of
+ * sub-buffers started from the node holding their pages, started from
+ * another node, and whose pages were moved to their writer node. The
+ * remote ratio is remote / (local + remote). The sub-buffers are
+ * accounted, and moved, as the consumer puts them, which requires
+ * CAP_SYS_NICE for the pages already mapped by the application. Zero
+ * unless the host has several NUMA nodes.
+ */
+int lttng_ust_ctl_get_numa_subbuf(struct lttng_ust_ctl_consumer_stream *stream,
+		uint64_t *local, uint64_t *remote, uint64_t *moved);
+
 /*
  * Getter returning the current timestamp as perceived from the
  * tracer.
@@ -297,6 +366,20 @@ int lttng_ust_ctl_get_instance_id(struct lttng_ust_ctl_consumer_stream *stream,
 int lttng_ust_ctl_get_current_timestamp(struct lttng_ust_ctl_consumer_stream *stream,
 		uint64_t *ts);
 
+/*
+ * Describe the clock of a channel clock source, for the clock block of
+ * its stream class in the trace metadata. @uuid must hold
+ * LTTNG_UST_UUID_STR_LEN bytes. The default clock source describes the
+ * trace clock, which honours the clock plugin override. Clocks which do
+ * not share a time base have distinct uuids.
+ */
+int lttng_ust_ctl_get_clock_description(int32_t clock_source,
+		const char **name, const char **description,
+		uint64_t *freq, char *uuid);
+
+/* Read a channel clock source, e.g. to compute its offset. */
+int lttng_ust_ctl_clock_read(int32_t clock_source, uint64_t *ts);
+
 /* returns whether UST has perf counters support. */
 int lttng_ust_ctl_has_perf_counters(void);
 
@@ -658,6 +741,74 @@ int lttng_ust_ctl_counter_aggregate(struct lttng_ust_ctl_daemon_counter *counter
 int lttng_ust_ctl_counter_clear(struct lttng_ust_ctl_daemon_counter *counter,
 		const size_t *dimension_indexes);
 
+/*
+ * Sketch counter API.
+ *
+ * A sketch counter holds nr_sketches probabilistic sketches. It is sent
+ * to an event notifier group like the error counter, with one cpu
+ * counter data per cpu. Each hit of an event notifier created with a
+ * matching sketch type updates the sketch at its sketch index, keyed on
+ * the value of its first capture, or on an empty key if it has none.
+ */
+
+enum lttng_ust_ctl_counter_sketch {
+	LTTNG_UST_CTL_COUNTER_SKETCH_COUNT_MIN = 1,
+	LTTNG_UST_CTL_COUNTER_SKETCH_HYPERLOGLOG = 2,
+};
+
+/* Length of the key prefix kept for each heavy hitter. */
+#define LTTNG_UST_CTL_SKETCH_KEY_LEN	48
+
+struct lttng_ust_ctl_sketch_entry {
+	uint64_t count;
+	size_t key_len;		/* Full key length, may exceed LTTNG_UST_CTL_SKETCH_KEY_LEN. */
+	char key[LTTNG_UST_CTL_SKETCH_KEY_LEN];
+};
+
+/*
+ * Count-min sketches use depth rows of width counters, and track the
+ * top_k heavy hitters. HyperLogLog sketches use width registers, a
+ * power of two between 16 and 262144: the standard error of their
+ * cardinality estimate is 1.04 / sqrt(width).
+ */
+struct lttng_ust_ctl_daemon_counter *
+	lttng_ust_ctl_create_sketch_counter(size_t nr_sketches,
+		enum lttng_ust_ctl_counter_sketch sketch,
+		uint32_t depth, uint32_t width, uint32_t top_k,
+		int nr_counter_cpu_fds,
+		const int *counter_cpu_fds);
+
+int lttng_ust_ctl_sketch_estimate(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index, const void *key, size_t key_len,
+		uint64_t *count);
+/*
+ * Heavy hitters by decreasing count. On input, *nr_entries is the
+ * number of entries available, on output the number of entries filled.
+ */
+int lttng_ust_ctl_sketch_top_k(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index, struct lttng_ust_ctl_sketch_entry *entries,
+		size_t *nr_entries);
+int lttng_ust_ctl_sketch_cardinality(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index, uint64_t *value);
+int lttng_ust_ctl_sketch_clear(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index);
+
+/*
+ * Profile counter API.
+ *
+ * A profile counter is sent to a session. When the application is built
+ * with probe profiling, one hit out of period of each event recorder of
+ * the session is timed, and the cycles spent in each stage (enum
+ * lttng_ust_abi_profile_stage) are accounted in a log2 histogram of
+ * nr_buckets buckets, indexed by channel id, event id, stage and
+ * bucket. Read it with lttng_ust_ctl_counter_aggregate().
+ */
+struct lttng_ust_ctl_daemon_counter *
+	lttng_ust_ctl_create_profile_counter(size_t nr_channels,
+		size_t nr_events, size_t nr_buckets, uint32_t period,
+		int nr_counter_cpu_fds,
+		const int *counter_cpu_fds);
+
 void lttng_ust_ctl_sigbus_handle(void *addr);
 
 #ifdef __cplusplus
@@ -12,6 +12,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <lttng/ust-abi.h>
+#include <lttng/ust-config.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ust-endian.h>
 #include <float.h>
@@ -62,6 +63,7 @@ enum lttng_ust_type {
 	lttng_ust_type_array,
 	lttng_ust_type_sequence,
 	lttng_ust_type_struct,
+	lttng_ust_type_struct_native,
 	NR_LTTNG_UST_TYPE,
 };
 
@@ -212,6 +214,39 @@ struct lttng_ust_type_struct {
 	unsigned int alignment;					/* Minimum alignment for this type. */
 };
 
+/*
+ * C structure recorded in its native memory layout with a single copy.
+ * Members are described with their offset within the structure, in
+ * increasing offset order. Bytes not covered by a member description
+ * (padding, omitted members) are described as padding when the type is
+ * serialized for the session daemon.
+ *
+ * IMPORTANT: these structures are part of the ABI between the probe and
+ * UST. Fields need to be only added at the end, never reordered, never
+ * removed.
+ *
+ * The field @struct_size should be used to determine the size of the
+ * structure. It should be queried before using additional fields added
+ * at the end of the structure.
+ */
+struct lttng_ust_struct_native_member {
+	uint32_t struct_size;
+
+	const char *name;
+	const struct lttng_ust_type_common *type;	/* Integer, float or array of integers. */
+	size_t offset;					/* Offset within the structure, in bytes. */
+
+	/* End of base ABI. Fields below should be used after checking struct_size. */
+};
+
+struct lttng_ust_type_struct_native {
+	struct lttng_ust_type_common parent;
+	uint32_t struct_size;
+	size_t size;					/* Size of the structure, in bytes. */
+	unsigned int alignment;				/* Alignment in the ring buffer, in bits. */
+	const struct lttng_ust_struct_native_member * const *members;	/* NULL-terminated. */
+};
+
 /*
  * Enumeration description
  *
@@ -344,6 +379,8 @@ struct lttng_ust_probe_ctx {
 	void *ip;				/* caller ip address */
 
 	/* End of base ABI. Fields below should be used after checking struct_size. */
+
+	uint32_t nr_truncated;			/* String and sequence fields cut to the event max_payload_len. */
 };
 
 /*
@@ -428,6 +465,8 @@ struct lttng_ust_event_recorder {
 	struct lttng_ust_channel_buffer *chan;
 
 	/* End of base ABI. Fields below should be used after checking struct_size. */
+
+	uint32_t max_payload_len;			/* Bytes recorded per string and sequence field, 0: no limit. */
 };
 
 /*
@@ -476,6 +515,16 @@ struct lttng_ust_event_notifier {
 	/* End of base ABI. Fields below should be used after checking struct_size. */
 };
 
+/*
+ * Kind of record of the value of a delta-encoded integer field. The
+ * values are recorded before the field, they must not change.
+ */
+enum lttng_ust_delta_kind {
+	LTTNG_UST_DELTA_KIND_VALUE = 0,		/* Value */
+	LTTNG_UST_DELTA_KIND_REFERENCE = 1,	/* Value, reference of the packet */
+	LTTNG_UST_DELTA_KIND_DELTA = 2,		/* Value minus the reference */
+};
+
 struct lttng_ust_ring_buffer_channel;
 struct lttng_ust_channel_buffer_ops_private;
 
@@ -503,6 +552,20 @@ struct lttng_ust_channel_buffer_ops {
 			const char *src, size_t len);
 
 	/* End of base ABI. Fields below should be used after checking struct_size. */
+
+	/*
+	 * Delta encoding of integer fields, between event_reserve and
+	 * event_commit. event_delta_reference returns the kind of
+	 * record of the value of a field, and the reference to
+	 * subtract from the value for LTTNG_UST_DELTA_KIND_DELTA.
+	 * event_shrink ends the record at the current write position,
+	 * or fails and rewinds the write position to the start of the
+	 * payload, to write the whole reserved payload.
+	 */
+	int (*event_delta_reference)(struct lttng_ust_ring_buffer_ctx *ctx,
+			unsigned int field, uint64_t value,
+			uint64_t *reference);
+	int (*event_shrink)(struct lttng_ust_ring_buffer_ctx *ctx);
 };
 
 enum lttng_ust_channel_type {
@@ -612,6 +675,22 @@ void lttng_ust_probe_unregister(struct lttng_ust_registered_probe *reg_probe);
  */
 void lttng_ust_context_procname_reset(void);
 
+#ifdef LTTNG_UST_HAVE_PROBE_PROFILING
+/*
+ * Per-stage cycle accounting of sampled probe hits, into the profile
+ * counter of the session. lttng_ust_profile_begin() returns 1 when the
+ * current probe hit is sampled, -1 when it is nested in a sampled one,
+ * and 0 otherwise. For a sampled hit, lttng_ust_profile_stage() then
+ * accounts the cycles elapsed since the previous stage to a stage
+ * (enum lttng_ust_abi_profile_stage). lttng_ust_profile_end() ends a
+ * probe hit for which lttng_ust_profile_begin() returned non-zero, and
+ * records the stages of a sampled one.
+ */
+int lttng_ust_profile_begin(struct lttng_ust_event_common *event);
+void lttng_ust_profile_stage(int stage);
+void lttng_ust_profile_end(struct lttng_ust_event_common *event);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -51,6 +51,15 @@
 #undef lttng_ust__field_enum
 #define lttng_ust__field_enum(_provider, _name, _type, _item, _src, _nowrite)
 
+#undef lttng_ust__field_struct_native
+#define lttng_ust__field_struct_native(_struct_type, _item, _src, _nowrite, ...)
+
+#undef lttng_ust__field_integer_varint
+#define lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)
+
+#undef lttng_ust__field_integer_delta
+#define lttng_ust__field_integer_delta(_type, _item, _src, _nowrite)
+
 /* "write" */
 #undef lttng_ust_field_integer
 #define lttng_ust_field_integer(_type, _item, _src)
@@ -106,6 +115,15 @@
 #undef lttng_ust_field_enum
 #define lttng_ust_field_enum(_provider, _name, _type, _item, _src)
 
+#undef lttng_ust_field_struct
+#define lttng_ust_field_struct(_struct_type, _item, _src, ...)
+
+#undef lttng_ust_field_integer_varint
+#define lttng_ust_field_integer_varint(_type, _item, _src)
+
+#undef lttng_ust_field_integer_delta
+#define lttng_ust_field_integer_delta(_type, _item, _src)
+
 /* "nowrite" */
 #undef lttng_ust_field_integer_nowrite
 #define lttng_ust_field_integer_nowrite(_type, _item, _src)
@@ -85,3 +85,15 @@
 #undef lttng_ust_field_enum
 #define lttng_ust_field_enum(_provider, _name, _type, _item, _src)			\
 	lttng_ust__field_enum(_provider, _name, _type, _item, _src, 0)
+
+#undef lttng_ust_field_struct
+#define lttng_ust_field_struct(_struct_type, _item, _src, ...)		\
+	lttng_ust__field_struct_native(_struct_type, _item, _src, 0, __VA_ARGS__)
+
+#undef lttng_ust_field_integer_varint
+#define lttng_ust_field_integer_varint(_type, _item, _src)			\
+	lttng_ust__field_integer_varint(_type, _item, _src, 0)
+
+#undef lttng_ust_field_integer_delta
+#define lttng_ust_field_integer_delta(_type, _item, _src)			\
+	lttng_ust__field_integer_delta(_type, _item, _src, 0)
@@ -105,6 +105,233 @@
 		lttng_ust__max1 > lttng_ust__max2 ? lttng_ust__max1: lttng_ust__max2;	\
 	})
 
+/*
+ * Variable-length integers are recorded as the smallest of 1, 2, 4 or 8
+ * bytes which holds the value, preceded by a one byte tag selecting the
+ * width. The tag values are the "_int8" to "_uint64" entries of the
+ * dynamic type enumeration, which describes the field to the session
+ * daemon as a tagged variant.
+ */
+#define LTTNG_UST__TP_VARINT_TAG_S8	1
+#define LTTNG_UST__TP_VARINT_TAG_U8	5
+
+#define lttng_ust__tp_varint_align(_order)				\
+	((1UL << (_order)) < lttng_ust_rb_alignof(uint64_t) ?		\
+		(1UL << (_order)) : lttng_ust_rb_alignof(uint64_t))
+
+/*
+ * Length of a string field, in bytes, excluding the terminating '\0',
+ * and number of elements of a sequence field, bounded so that at most
+ * max_payload_len bytes of the field are recorded, terminating '\0'
+ * included. The probe context counts the fields which are cut.
+ */
+#define lttng_ust__tp_max_payload_len(_event_recorder)			\
+	((_event_recorder)->struct_size >= offsetof(struct lttng_ust_event_recorder, max_payload_len) \
+			+ sizeof(uint32_t) ?				\
+		CMM_ACCESS_ONCE((_event_recorder)->max_payload_len) : 0)
+
+#define lttng_ust__tp_capped_strlen(_src, _max_len, _probe_ctx)		\
+	({								\
+		const char *__cap_str = (_src);				\
+		size_t __cap_len;					\
+									\
+		if (caa_likely(!(_max_len))) {				\
+			__cap_len = strlen(__cap_str);			\
+		} else {						\
+			const char *__cap_end = (const char *)		\
+				memchr(__cap_str, '\0', (_max_len));	\
+									\
+			if (__cap_end) {				\
+				__cap_len = __cap_end - __cap_str;	\
+			} else {					\
+				/* Leave room for the '\0'. */		\
+				__cap_len = (_max_len) - 1;		\
+				(_probe_ctx)->nr_truncated++;		\
+			}						\
+		}							\
+		__cap_len;						\
+	})
+
+#define lttng_ust__tp_capped_seq_len(_type, _src_length, _max_len, _probe_ctx) \
+	({								\
+		size_t __cap_len = (_src_length);			\
+									\
+		if (caa_unlikely((_max_len) &&				\
+				__cap_len > (_max_len) / sizeof(_type))) { \
+			__cap_len = (_max_len) / sizeof(_type);		\
+			(_probe_ctx)->nr_truncated++;			\
+		}							\
+		__cap_len;						\
+	})
+
+/* Base 2 logarithm of the number of bytes recording the value. */
+#define lttng_ust__tp_varint_order(_type, _src)				\
+	({								\
+		_type __varint_v = (_src);				\
+		unsigned int __varint_order;				\
+									\
+		if (lttng_ust_is_signed_type(_type)) {			\
+			int64_t __s = (int64_t) __varint_v;		\
+									\
+			if (__s == (int8_t) __s)			\
+				__varint_order = 0;			\
+			else if (__s == (int16_t) __s)			\
+				__varint_order = 1;			\
+			else if (__s == (int32_t) __s)			\
+				__varint_order = 2;			\
+			else						\
+				__varint_order = 3;			\
+		} else {						\
+			uint64_t __u = (uint64_t) __varint_v;		\
+									\
+			if (__u == (uint8_t) __u)			\
+				__varint_order = 0;			\
+			else if (__u == (uint16_t) __u)			\
+				__varint_order = 1;			\
+			else if (__u == (uint32_t) __u)			\
+				__varint_order = 2;			\
+			else						\
+				__varint_order = 3;			\
+		}							\
+		__varint_order;						\
+	})
+
+/* Record a tag selecting the width, and the (1 << _order) low bytes of _v. */
+#define lttng_ust__tp_varint_write(_chan, _ctx, _is_signed, _order, _v)	\
+	{								\
+		uint64_t __tmp64 = (_v);				\
+		char __tag = ((_is_signed) ?				\
+			LTTNG_UST__TP_VARINT_TAG_S8 :			\
+			LTTNG_UST__TP_VARINT_TAG_U8) + (_order);	\
+									\
+		(_chan)->ops->event_write(_ctx, &__tag, sizeof(__tag), lttng_ust_rb_alignof(__tag));\
+		switch (_order) {					\
+		case 0:							\
+		{							\
+			uint8_t __tmp8 = (uint8_t) __tmp64;		\
+			(_chan)->ops->event_write(_ctx, &__tmp8, sizeof(__tmp8), lttng_ust_rb_alignof(__tmp8));\
+			break;						\
+		}							\
+		case 1:							\
+		{							\
+			uint16_t __tmp16 = (uint16_t) __tmp64;		\
+			(_chan)->ops->event_write(_ctx, &__tmp16, sizeof(__tmp16), lttng_ust_rb_alignof(__tmp16));\
+			break;						\
+		}							\
+		case 2:							\
+		{							\
+			uint32_t __tmp32 = (uint32_t) __tmp64;		\
+			(_chan)->ops->event_write(_ctx, &__tmp32, sizeof(__tmp32), lttng_ust_rb_alignof(__tmp32));\
+			break;						\
+		}							\
+		default:						\
+			(_chan)->ops->event_write(_ctx, &__tmp64, sizeof(__tmp64), lttng_ust_rb_alignof(__tmp64));\
+			break;						\
+		}							\
+	}
+
+/*
+ * Delta-encoded integers are variable-length integers preceded by the
+ * kind of their record (enum lttng_ust_delta_kind). Their room is
+ * reserved for the value, and a delta against the reference of the
+ * field in the packet is only known once the room is reserved. The
+ * probe writes the deltas smaller than their value with fewer bytes,
+ * and then ends the record at the last byte written. If a record was
+ * reserved after it, the probe writes the fields again, with values.
+ */
+#define LTTNG_UST__TP_DELTA_NONE	0	/* No smaller delta written */
+#define LTTNG_UST__TP_DELTA_SHRINK	1	/* Record to shrink */
+#define LTTNG_UST__TP_DELTA_FULL	2	/* Writing the values */
+
+#define lttng_ust__tp_delta_reference(_chan, _ctx, _field, _value, _reference) \
+	(lttng_ust_struct_field_present((_chan)->ops, event_shrink) ?	\
+		(_chan)->ops->event_delta_reference(_ctx, _field, _value, _reference) : \
+		LTTNG_UST_DELTA_KIND_VALUE)
+
+/*
+ * Native structure members, listed in increasing offset order after
+ * the source expression of lttng_ust_field_struct(). Members are
+ * byte-aligned: the structure layout is described by the member
+ * offsets, and the bytes between members are described as padding.
+ */
+#define lttng_ust__tp_struct_member_type(_struct_type, _member)		\
+	__typeof__(((_struct_type *) 0)->_member)
+
+#define lttng_ust__tp_struct_member_integer_type(_type, _base)		\
+	((const struct lttng_ust_type_common *) LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_type_integer, { \
+		.parent = {						\
+			.type = lttng_ust_type_integer,			\
+		},							\
+		.struct_size = sizeof(struct lttng_ust_type_integer),	\
+		.size = sizeof(_type) * CHAR_BIT,			\
+		.alignment = CHAR_BIT,					\
+		.signedness = lttng_ust_is_signed_type(_type),		\
+		.reverse_byte_order = 0,				\
+		.base = _base,						\
+	}))
+
+#define lttng_ust__tp_struct_member_float_type(_type)			\
+	((const struct lttng_ust_type_common *) LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_type_float, { \
+		.parent = {						\
+			.type = lttng_ust_type_float,			\
+		},							\
+		.struct_size = sizeof(struct lttng_ust_type_float),	\
+		.exp_dig = sizeof(_type) * CHAR_BIT			\
+			- lttng_ust_float_mant_dig(_type),		\
+		.mant_dig = lttng_ust_float_mant_dig(_type),		\
+		.alignment = CHAR_BIT,					\
+		.reverse_byte_order = LTTNG_UST_BYTE_ORDER != LTTNG_UST_FLOAT_WORD_ORDER, \
+	}))
+
+#define lttng_ust__tp_struct_member_array_type(_struct_type, _member, _encoding, _base) \
+	((const struct lttng_ust_type_common *) LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_type_array, { \
+		.parent = {						\
+			.type = lttng_ust_type_array,			\
+		},							\
+		.struct_size = sizeof(struct lttng_ust_type_array),	\
+		.elem_type = lttng_ust__tp_struct_member_integer_type(	\
+			lttng_ust__tp_struct_member_type(_struct_type, _member[0]), _base), \
+		.length = sizeof(((_struct_type *) 0)->_member)		\
+			/ sizeof(((_struct_type *) 0)->_member[0]),	\
+		.alignment = 0,						\
+		.encoding = lttng_ust_string_encoding_##_encoding,	\
+	}))
+
+#define lttng_ust__tp_struct_member(_struct_type, _member, _member_type) \
+	LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_struct_native_member, { \
+		.struct_size = sizeof(struct lttng_ust_struct_native_member), \
+		.name = #_member,					\
+		.type = _member_type,					\
+		.offset = offsetof(_struct_type, _member),		\
+	}),
+
+#define lttng_ust_field_struct_member_integer(_struct_type, _member)	\
+	lttng_ust__tp_struct_member(_struct_type, _member,		\
+		lttng_ust__tp_struct_member_integer_type(		\
+			lttng_ust__tp_struct_member_type(_struct_type, _member), 10))
+
+#define lttng_ust_field_struct_member_integer_hex(_struct_type, _member) \
+	lttng_ust__tp_struct_member(_struct_type, _member,		\
+		lttng_ust__tp_struct_member_integer_type(		\
+			lttng_ust__tp_struct_member_type(_struct_type, _member), 16))
+
+#define lttng_ust_field_struct_member_float(_struct_type, _member)	\
+	lttng_ust__tp_struct_member(_struct_type, _member,		\
+		lttng_ust__tp_struct_member_float_type(			\
+			lttng_ust__tp_struct_member_type(_struct_type, _member)))
+
+#define lttng_ust_field_struct_member_array(_struct_type, _member)	\
+	lttng_ust__tp_struct_member(_struct_type, _member,		\
+		lttng_ust__tp_struct_member_array_type(_struct_type, _member, none, 10))
+
+#define lttng_ust_field_struct_member_array_hex(_struct_type, _member)	\
+	lttng_ust__tp_struct_member(_struct_type, _member,		\
+		lttng_ust__tp_struct_member_array_type(_struct_type, _member, none, 16))
+
+#define lttng_ust_field_struct_member_array_text(_struct_type, _member)	\
+	lttng_ust__tp_struct_member(_struct_type, _member,		\
+		lttng_ust__tp_struct_member_array_type(_struct_type, _member, UTF8, 10))
+
 /*
  * Stage 0 of tracepoint event generation.
  *
@@ -342,6 +569,22 @@ static void lttng_ust__event_probe__##_provider##___##_name(LTTNG_UST__TP_ARGS_D
 extern const struct lttng_ust_probe_desc LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust__probe_desc___, LTTNG_UST_TRACEPOINT_PROVIDER)
 	__attribute__((visibility("hidden")));
 
+/* Kinds of records of the delta-encoded integer fields of the probe. */
+static const struct lttng_ust_enum_entry * const LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust__delta_kind_values___, LTTNG_UST_TRACEPOINT_PROVIDER)[] = {
+	lttng_ust_field_enum_value("value", (uint8_t) LTTNG_UST_DELTA_KIND_VALUE)
+	lttng_ust_field_enum_value("reference", (uint8_t) LTTNG_UST_DELTA_KIND_REFERENCE)
+	lttng_ust_field_enum_value("delta", (uint8_t) LTTNG_UST_DELTA_KIND_DELTA)
+};
+
+static const struct lttng_ust_enum_desc LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust__delta_kind___, LTTNG_UST_TRACEPOINT_PROVIDER)
+	__attribute__((unused)) = {
+	.struct_size = sizeof(struct lttng_ust_enum_desc),
+	.name = "lttng_ust_delta_kind",
+	.entries = LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust__delta_kind_values___, LTTNG_UST_TRACEPOINT_PROVIDER),
+	.nr_entries = LTTNG_UST__TP_ARRAY_SIZE(LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust__delta_kind_values___, LTTNG_UST_TRACEPOINT_PROVIDER)),
+	.probe_desc = &LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust__probe_desc___, LTTNG_UST_TRACEPOINT_PROVIDER),
+};
+
 /*
  * Stage 2 of tracepoint event generation.
  *
@@ -459,6 +702,57 @@ extern const struct lttng_ust_probe_desc LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust_
 		.nofilter = 0,					\
 	}),
 
+#undef lttng_ust__field_struct_native
+#define lttng_ust__field_struct_native(_struct_type, _item, _src, _nowrite, ...) \
+	LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_event_field, { \
+		.struct_size = sizeof(struct lttng_ust_event_field), \
+		.name = #_item,					\
+		.type = (const struct lttng_ust_type_common *) LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_type_struct_native, { \
+			.parent = {				\
+				.type = lttng_ust_type_struct_native, \
+			},					\
+			.struct_size = sizeof(struct lttng_ust_type_struct_native), \
+			.size = sizeof(_struct_type),		\
+			.alignment = lttng_ust_rb_alignof(_struct_type) * CHAR_BIT, \
+			.members = (const struct lttng_ust_struct_native_member * const []) { \
+				__VA_ARGS__			\
+				NULL,				\
+			},					\
+		}),						\
+		.nowrite = _nowrite,				\
+		.nofilter = 1,					\
+	}),
+
+#undef lttng_ust__field_integer_varint
+#define lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)	\
+	LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_event_field, { \
+		.struct_size = sizeof(struct lttng_ust_event_field), \
+		.name = #_item,					\
+		.type = LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_type_common, { \
+			.type = lttng_ust_type_dynamic,		\
+		}),						\
+		.nowrite = _nowrite,				\
+		.nofilter = 1,					\
+	}),
+
+#undef lttng_ust__field_integer_delta
+#define lttng_ust__field_integer_delta(_type, _item, _src, _nowrite)	\
+	LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_event_field, { \
+		.struct_size = sizeof(struct lttng_ust_event_field), \
+		.name = #_item "_kind",				\
+		.type = (const struct lttng_ust_type_common *) LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_type_enum, { \
+			.parent = {				\
+				.type = lttng_ust_type_enum,	\
+			},					\
+			.struct_size = sizeof(struct lttng_ust_type_enum), \
+			.desc = &LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust__delta_kind___, LTTNG_UST_TRACEPOINT_PROVIDER), \
+			.container_type = lttng_ust_type_integer_define(uint8_t, LTTNG_UST_BYTE_ORDER, 10), \
+		}),						\
+		.nowrite = _nowrite,				\
+		.nofilter = 1,					\
+	}),							\
+	lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)
+
 #undef LTTNG_UST_TP_FIELDS
 #define LTTNG_UST_TP_FIELDS(...) __VA_ARGS__	/* Only one used in this phase */
 
@@ -529,14 +823,16 @@ extern const struct lttng_ust_probe_desc LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust_
 	__event_len += lttng_ust_ring_buffer_align(__event_len, lttng_ust_rb_alignof(_length_type));   \
 	__event_len += sizeof(_length_type);				       \
 	__event_len += lttng_ust_ring_buffer_align(__event_len, lttng_ust_rb_alignof(_type)); \
-	__dynamic_len[__dynamic_len_idx] = (_src_length);		       \
+	__dynamic_len[__dynamic_len_idx] = lttng_ust__tp_capped_seq_len(_type, \
+			_src_length, __max_len, __probe_ctx);		       \
 	__event_len += sizeof(_type) * __dynamic_len[__dynamic_len_idx];       \
 	__dynamic_len_idx++;
 
 #undef lttng_ust__field_string
 #define lttng_ust__field_string(_item, _src, _nowrite)				       \
 	__event_len += __dynamic_len[__dynamic_len_idx++] =		       \
-		strlen((_src) ? (_src) : LTTNG_UST__NULL_STRING) + 1;
+		lttng_ust__tp_capped_strlen((_src) ? (_src) : LTTNG_UST__NULL_STRING, \
+			__max_len, __probe_ctx) + 1;
 
 #undef lttng_ust__field_unused
 #define lttng_ust__field_unused(_src)							\
@@ -547,6 +843,35 @@ extern const struct lttng_ust_probe_desc LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust_
 #define lttng_ust__field_enum(_provider, _name, _type, _item, _src, _nowrite)		\
 	lttng_ust__field_integer_ext(_type, _item, _src, LTTNG_UST_BYTE_ORDER, 10, _nowrite)
 
+#undef lttng_ust__field_struct_native
+#define lttng_ust__field_struct_native(_struct_type, _item, _src, _nowrite, ...) \
+	if (0)									 \
+		(void) (_src);	/* Unused */					 \
+	__event_len += lttng_ust_ring_buffer_align(__event_len, lttng_ust_rb_alignof(_struct_type)); \
+	__event_len += sizeof(_struct_type);
+
+#undef lttng_ust__field_integer_varint
+#define lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)	       \
+	{								       \
+		unsigned int __order = lttng_ust__tp_varint_order(_type, _src); \
+									       \
+		__dynamic_len[__dynamic_len_idx++] = __order;		       \
+		__event_len += sizeof(char);				       \
+		__event_len += lttng_ust_ring_buffer_align(__event_len,       \
+			lttng_ust__tp_varint_align(__order));		       \
+		__event_len += 1U << __order;				       \
+	}
+
+/*
+ * Room for the value, and a dynamic length slot holding the kind of
+ * record, set when writing it.
+ */
+#undef lttng_ust__field_integer_delta
+#define lttng_ust__field_integer_delta(_type, _item, _src, _nowrite)	       \
+	__event_len += sizeof(uint8_t);					       \
+	lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)	       \
+	__dynamic_len[__dynamic_len_idx++] = LTTNG_UST_DELTA_KIND_VALUE;
+
 #undef LTTNG_UST_TP_ARGS
 #define LTTNG_UST_TP_ARGS(...) __VA_ARGS__
 
@@ -556,11 +881,15 @@ extern const struct lttng_ust_probe_desc LTTNG_UST__TP_COMBINE_TOKENS(lttng_ust_
 #undef LTTNG_UST__TRACEPOINT_EVENT_CLASS
 #define LTTNG_UST__TRACEPOINT_EVENT_CLASS(_provider, _name, _args, _fields)	      \
 static inline								      \
-size_t lttng_ust__event_get_size__##_provider##___##_name(size_t *__dynamic_len, LTTNG_UST__TP_ARGS_DATA_PROTO(_args)) \
+size_t lttng_ust__event_get_size__##_provider##___##_name(size_t *__dynamic_len, \
+		size_t __max_len, struct lttng_ust_probe_ctx *__probe_ctx,    \
+		LTTNG_UST__TP_ARGS_DATA_PROTO(_args))			      \
 	lttng_ust_notrace;						      \
 static inline								      \
 size_t lttng_ust__event_get_size__##_provider##___##_name(			      \
 		size_t *__dynamic_len __attribute__((__unused__)),	      \
+		size_t __max_len __attribute__((__unused__)),		      \
+		struct lttng_ust_probe_ctx *__probe_ctx __attribute__((__unused__)), \
 		LTTNG_UST__TP_ARGS_DATA_PROTO(_args))				      \
 {									      \
 	size_t __event_len = 0;						      \
@@ -716,6 +1045,33 @@ size_t lttng_ust__event_get_size__##_provider##___##_name(			      \
 #define lttng_ust__field_enum(_provider, _name, _type, _item, _src, _nowrite)		\
 	lttng_ust__field_integer_ext(_type, _item, _src, LTTNG_UST_BYTE_ORDER, 10, _nowrite)
 
+/*
+ * Native structures are not available to the filter, and take no room
+ * on the stack. Clear the next slot so the stack is initialized even
+ * when no other field follows.
+ */
+#undef lttng_ust__field_struct_native
+#define lttng_ust__field_struct_native(_struct_type, _item, _src, _nowrite, ...) \
+	{								       \
+		unsigned long __ctf_tmp_ulong = 0;			       \
+		if (0)							       \
+			(void) (_src);					       \
+		memcpy(__stack_data, &__ctf_tmp_ulong, sizeof(unsigned long)); \
+	}
+
+#undef lttng_ust__field_integer_varint
+#define lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)	       \
+	{								       \
+		unsigned long __ctf_tmp_ulong = 0;			       \
+		if (0)							       \
+			(void) (_src);					       \
+		memcpy(__stack_data, &__ctf_tmp_ulong, sizeof(unsigned long)); \
+	}
+
+#undef lttng_ust__field_integer_delta
+#define lttng_ust__field_integer_delta(_type, _item, _src, _nowrite)	       \
+	lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)
+
 #undef LTTNG_UST_TP_ARGS
 #define LTTNG_UST_TP_ARGS(...) __VA_ARGS__
 
@@ -791,6 +1147,22 @@ void lttng_ust__event_prepare_interpreter_stack__##_provider##___##_name(char *_
 #define lttng_ust__field_enum(_provider, _name, _type, _item, _src, _nowrite)		\
 	lttng_ust__field_integer_ext(_type, _item, _src, LTTNG_UST_BYTE_ORDER, 10, _nowrite)
 
+#undef lttng_ust__field_struct_native
+#define lttng_ust__field_struct_native(_struct_type, _item, _src, _nowrite, ...) \
+	if (0)								       \
+		(void) (_src);	/* Unused */				       \
+	__event_align = lttng_ust__tp_max_t(size_t, __event_align, lttng_ust_rb_alignof(_struct_type));
+
+#undef lttng_ust__field_integer_varint
+#define lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)	       \
+	if (0)								       \
+		(void) (_src);	/* Unused */				       \
+	__event_align = lttng_ust__tp_max_t(size_t, __event_align, lttng_ust_rb_alignof(_type));
+
+#undef lttng_ust__field_integer_delta
+#define lttng_ust__field_integer_delta(_type, _item, _src, _nowrite)	       \
+	lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)
+
 #undef LTTNG_UST_TP_ARGS
 #define LTTNG_UST_TP_ARGS(...) __VA_ARGS__
 
@@ -875,6 +1247,65 @@ size_t lttng_ust__event_get_align__##_provider##___##_name(LTTNG_UST__TP_ARGS_PR
 #define lttng_ust__field_enum(_provider, _name, _type, _item, _src, _nowrite)	\
 	lttng_ust__field_integer_ext(_type, _item, _src, LTTNG_UST_BYTE_ORDER, 10, _nowrite)
 
+#undef lttng_ust__field_struct_native
+#define lttng_ust__field_struct_native(_struct_type, _item, _src, _nowrite, ...) \
+	{								\
+		const _struct_type *__tmp_struct = (_src);		\
+		__chan->ops->event_write(&__ctx, __tmp_struct, sizeof(_struct_type), \
+			lttng_ust_rb_alignof(_struct_type));		\
+	}
+
+#undef lttng_ust__field_integer_varint
+#define lttng_ust__field_integer_varint(_type, _item, _src, _nowrite)	\
+	{								\
+		unsigned int __order = lttng_ust__get_dynamic_len(dest); \
+		_type __tmp = (_src);					\
+									\
+		lttng_ust__tp_varint_write(__chan, &__ctx,		\
+			lttng_ust_is_signed_type(_type), __order, (uint64_t) __tmp); \
+	}
+
+/*
+ * The first pass records a delta if it takes fewer bytes than the value,
+ * the full pass records the value in place of the delta.
+ */
+#undef lttng_ust__field_integer_delta
+#define lttng_ust__field_integer_delta(_type, _item, _src, _nowrite)	\
+	{								\
+		unsigned int __field = __dynamic_len_idx;		\
+		unsigned int __order = lttng_ust__get_dynamic_len(dest); \
+		size_t *__kind = &lttng_ust__get_dynamic_len(dest);	\
+		_type __tmp = (_src);					\
+		uint64_t __v = (uint64_t) __tmp;			\
+		bool __is_signed = lttng_ust_is_signed_type(_type);	\
+		uint8_t __kind8;					\
+									\
+		if (__delta != LTTNG_UST__TP_DELTA_FULL) {		\
+			uint64_t __reference = 0;			\
+									\
+			*__kind = lttng_ust__tp_delta_reference(__chan, &__ctx, \
+					__field, __v, &__reference);	\
+			if (*__kind == LTTNG_UST_DELTA_KIND_DELTA) {	\
+				unsigned int __delta_order =		\
+					lttng_ust__tp_varint_order(int64_t, (int64_t) (__v - __reference)); \
+									\
+				if (__delta_order < __order) {		\
+					__order = __delta_order;	\
+					__v -= __reference;		\
+					__is_signed = true;		\
+					__delta = LTTNG_UST__TP_DELTA_SHRINK; \
+				} else {				\
+					*__kind = LTTNG_UST_DELTA_KIND_VALUE; \
+				}					\
+			}						\
+		} else if (*__kind == LTTNG_UST_DELTA_KIND_DELTA) {	\
+			*__kind = LTTNG_UST_DELTA_KIND_VALUE;		\
+		}							\
+		__kind8 = (uint8_t) *__kind;				\
+		__chan->ops->event_write(&__ctx, &__kind8, sizeof(__kind8), lttng_ust_rb_alignof(__kind8));\
+		lttng_ust__tp_varint_write(__chan, &__ctx, __is_signed, __order, __v); \
+	}
+
 /* Beware: this get len actually consumes the len value */
 #undef lttng_ust__get_dynamic_len
 #define lttng_ust__get_dynamic_len(field)	__stackvar.__dynamic_len[__dynamic_len_idx++]
@@ -917,6 +1348,30 @@ size_t lttng_ust__event_get_align__##_provider##___##_name(LTTNG_UST__TP_ARGS_PR
 
 #endif /* TP_IP_PARAM */
 
+/*
+ * Per-stage cycle accounting of sampled probe hits, compiled out unless
+ * LTTng-UST is configured with --enable-probe-profiling.
+ */
+#ifdef LTTNG_UST_HAVE_PROBE_PROFILING
+#define LTTNG_UST__PROFILE_DECL		int __profile = 0;
+#define LTTNG_UST__PROFILE_BEGIN(_event)	__profile = lttng_ust_profile_begin(_event)
+#define LTTNG_UST__PROFILE_STAGE(_stage)					\
+	do {								\
+		if (caa_unlikely(__profile > 0))			\
+			lttng_ust_profile_stage(LTTNG_UST_ABI_PROFILE_STAGE_##_stage); \
+	} while (0)
+#define LTTNG_UST__PROFILE_END(_event)					\
+	do {								\
+		if (caa_unlikely(__profile))				\
+			lttng_ust_profile_end(_event);			\
+	} while (0)
+#else
+#define LTTNG_UST__PROFILE_DECL
+#define LTTNG_UST__PROFILE_BEGIN(_event)
+#define LTTNG_UST__PROFILE_STAGE(_stage)
+#define LTTNG_UST__PROFILE_END(_event)
+#endif
+
 /*
  * Using twice size for filter stack data to hold size and pointer for
  * each field (worse case). For integers, max size required is 64-bit.
@@ -942,6 +1397,7 @@ void lttng_ust__event_probe__##_provider##___##_name(LTTNG_UST__TP_ARGS_DATA_PRO
 	} __stackvar;							      \
 	int __ret;							      \
 	bool __interpreter_stack_prepared = false;			      \
+	LTTNG_UST__PROFILE_DECL						      \
 									      \
 	if (0)								      \
 		(void) __dynamic_len_idx;	/* don't warn if unused */    \
@@ -969,13 +1425,19 @@ void lttng_ust__event_probe__##_provider##___##_name(LTTNG_UST__TP_ARGS_DATA_PRO
 		return;							      \
 	__probe_ctx.struct_size = sizeof(struct lttng_ust_probe_ctx);	      \
 	__probe_ctx.ip = LTTNG_UST__TP_IP_PARAM(LTTNG_UST_TP_IP_PARAM);	      \
+	__probe_ctx.nr_truncated = 0;					      \
+	LTTNG_UST__PROFILE_BEGIN(__event);				      \
 	if (caa_unlikely(CMM_ACCESS_ONCE(__event->eval_filter))) {	      \
 		lttng_ust__event_prepare_interpreter_stack__##_provider##___##_name(__stackvar.__interpreter_stack_data, \
 			LTTNG_UST__TP_ARGS_DATA_VAR(_args));		      \
 		__interpreter_stack_prepared = true;			      \
 		if (caa_likely(__event->run_filter(__event,		      \
-				__stackvar.__interpreter_stack_data, &__probe_ctx, NULL) != LTTNG_UST_EVENT_FILTER_ACCEPT)) \
+				__stackvar.__interpreter_stack_data, &__probe_ctx, NULL) != LTTNG_UST_EVENT_FILTER_ACCEPT)) { \
+			LTTNG_UST__PROFILE_STAGE(FILTER);		      \
+			LTTNG_UST__PROFILE_END(__event);		      \
 			return;						      \
+		}							      \
+		LTTNG_UST__PROFILE_STAGE(FILTER);			      \
 	}								      \
 	switch (__event->type) {					      \
 	case LTTNG_UST_EVENT_TYPE_RECORDER:				      \
@@ -984,17 +1446,31 @@ void lttng_ust__event_probe__##_provider##___##_name(LTTNG_UST__TP_ARGS_DATA_PRO
 		struct lttng_ust_event_recorder *__event_recorder = (struct lttng_ust_event_recorder *) __event->child; \
 		struct lttng_ust_channel_buffer *__chan = __event_recorder->chan; \
 		struct lttng_ust_ring_buffer_ctx __ctx;			      \
+		int __delta = LTTNG_UST__TP_DELTA_NONE;			      \
 									      \
 		__event_len = lttng_ust__event_get_size__##_provider##___##_name(__stackvar.__dynamic_len, \
+			 lttng_ust__tp_max_payload_len(__event_recorder), &__probe_ctx, \
 			 LTTNG_UST__TP_ARGS_DATA_VAR(_args));			      \
 		__event_align = lttng_ust__event_get_align__##_provider##___##_name(LTTNG_UST__TP_ARGS_VAR(_args)); \
 		lttng_ust_ring_buffer_ctx_init(&__ctx, __event_recorder, __event_len, __event_align, \
 				&__probe_ctx);				      \
+		LTTNG_UST__PROFILE_STAGE(CONTEXT);			      \
 		__ret = __chan->ops->event_reserve(&__ctx);		      \
-		if (__ret < 0)						      \
+		if (__ret < 0) {					      \
+			LTTNG_UST__PROFILE_END(__event);		      \
 			return;						      \
-		_fields							      \
+		}							      \
+		for (;;) {						      \
+			_fields						      \
+			if (caa_likely(__delta != LTTNG_UST__TP_DELTA_SHRINK) \
+					|| !__chan->ops->event_shrink(&__ctx)) \
+				break;					      \
+			__delta = LTTNG_UST__TP_DELTA_FULL;		      \
+			__dynamic_len_idx = 0;				      \
+		}							      \
+		LTTNG_UST__PROFILE_STAGE(SERIALIZE);			      \
 		__chan->ops->event_commit(&__ctx);			      \
+		LTTNG_UST__PROFILE_STAGE(COMMIT);			      \
 		break;							      \
 	}								      \
 	case LTTNG_UST_EVENT_TYPE_NOTIFIER:				      \
@@ -1016,6 +1492,7 @@ void lttng_ust__event_probe__##_provider##___##_name(LTTNG_UST__TP_ARGS_DATA_PRO
 		break;							      \
 	}								      \
 	}								      \
+	LTTNG_UST__PROFILE_END(__event);				      \
 }
 
 #include LTTNG_UST_TRACEPOINT_INCLUDE
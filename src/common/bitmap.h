@@ -13,6 +13,7 @@
 #include <urcu/system.h>
 #include <urcu/uatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 static inline void lttng_bitmap_index(unsigned int index, unsigned int *word,
 		unsigned int *bit)
@@ -21,6 +22,12 @@ static inline void lttng_bitmap_index(unsigned int index, unsigned int *word,
 	*bit = index % CAA_BITS_PER_LONG;
 }
 
+/* Number of longs holding a bitmap of @nr_bits bits. */
+static inline size_t lttng_bitmap_nr_longs(unsigned int nr_bits)
+{
+	return (nr_bits + CAA_BITS_PER_LONG - 1) / CAA_BITS_PER_LONG;
+}
+
 static inline void lttng_bitmap_set_bit(unsigned int index, unsigned long *p)
 {
 	unsigned int word, bit;
@@ -49,4 +56,21 @@ static inline bool lttng_bitmap_test_bit(unsigned int index, unsigned long *p)
 	return (CMM_LOAD_SHARED(p[word]) >> bit) & 0x1;
 }
 
+/* Set a bit, returning whether it was already set. */
+static inline bool lttng_bitmap_test_and_set_bit(unsigned int index, unsigned long *p)
+{
+	unsigned int word, bit;
+	unsigned long old, mask;
+
+	lttng_bitmap_index(index, &word, &bit);
+	mask = 1UL << bit;
+	for (;;) {
+		old = CMM_LOAD_SHARED(p[word]);
+		if (old & mask)
+			return true;
+		if (uatomic_cmpxchg(p + word, old, old | mask) == old)
+			return false;
+	}
+}
+
 #endif /* _UST_COMMON_BITMAP_H */
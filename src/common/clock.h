@@ -16,6 +16,7 @@
 #include <urcu/system.h>
 #include <urcu/arch.h>
 #include <lttng/ust-clock.h>
+#include <lttng/ust-abi.h>
 
 struct lttng_ust_trace_clock {
 	uint64_t (*read64)(void);
@@ -59,4 +60,48 @@ uint64_t trace_clock_read64(void)
 	}
 }
 
+/*
+ * Read a POSIX clock in nanoseconds. Clocks missing from the C library
+ * headers fall back on the kernel MONOTONIC clock.
+ */
+static __inline__
+uint64_t trace_clock_read64_posix(clockid_t clock_id)
+{
+	struct timespec ts;
+
+	if (caa_unlikely(clock_gettime(clock_id, &ts))) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 0;
+	}
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+ * Read the clock source selected for a channel. Only the default source
+ * goes through the trace clock override, the others are direct calls.
+ */
+static __inline__
+uint64_t trace_clock_read64_source(int clock_source)
+{
+	switch (clock_source) {
+	case LTTNG_UST_ABI_CLOCK_MONOTONIC:
+		return trace_clock_read64_monotonic();
+	case LTTNG_UST_ABI_CLOCK_MONOTONIC_COARSE:
+#ifdef CLOCK_MONOTONIC_COARSE
+		return trace_clock_read64_posix(CLOCK_MONOTONIC_COARSE);
+#else
+		return trace_clock_read64_monotonic();
+#endif
+	case LTTNG_UST_ABI_CLOCK_MONOTONIC_RAW:
+#ifdef CLOCK_MONOTONIC_RAW
+		return trace_clock_read64_posix(CLOCK_MONOTONIC_RAW);
+#else
+		return trace_clock_read64_monotonic();
+#endif
+	case LTTNG_UST_ABI_CLOCK_DEFAULT:
+	default:
+		return trace_clock_read64();
+	}
+}
+
 #endif	/* _UST_COMMON_CLOCK_H */
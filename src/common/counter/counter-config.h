@@ -34,6 +34,10 @@ struct lib_counter_config {
 		COUNTER_SIZE_32_BIT	= 4,
 		COUNTER_SIZE_64_BIT	= 8,
 	} counter_size;
+	enum {
+		COUNTER_MEM_SHM,	/* Shared memory, from file descriptors. */
+		COUNTER_MEM_PRIVATE,	/* Process memory, populated on use. */
+	} mem;
 };
 
 #endif /* _LTTNG_COUNTER_CONFIG_H */
@@ -56,7 +56,7 @@ static int lttng_counter_layout_init(struct lib_counter *counter, int cpu, int s
 	size_t shm_length = 0, counters_offset, overflow_offset, underflow_offset;
 	struct lttng_counter_shm_object *shm_object;
 
-	if (shm_fd < 0)
+	if (shm_fd < 0 && counter->config.mem != COUNTER_MEM_PRIVATE)
 		return 0;	/* Skip, will be populated later. */
 
 	if (cpu == -1)
@@ -81,7 +81,13 @@ static int lttng_counter_layout_init(struct lib_counter *counter, int cpu, int s
 	underflow_offset = shm_length;
 	shm_length += LTTNG_UST_ALIGN(nr_elem, 8) / 8;
 	layout->shm_len = shm_length;
-	if (counter->is_daemon) {
+	if (counter->config.mem == COUNTER_MEM_PRIVATE) {
+		/* Only populated where the counters get updated. */
+		shm_object = lttng_counter_shm_object_table_alloc(counter->object_table,
+			shm_length, LTTNG_COUNTER_SHM_OBJECT_MEM, -1, cpu);
+		if (!shm_object)
+			return -ENOMEM;
+	} else if (counter->is_daemon) {
 		/* Allocate and clear shared memory. */
 		shm_object = lttng_counter_shm_object_table_alloc(counter->object_table,
 			shm_length, LTTNG_COUNTER_SHM_OBJECT_SHM, shm_fd, cpu);
@@ -105,7 +111,8 @@ int lttng_counter_set_global_shm(struct lib_counter *counter, int fd)
 	struct lib_counter_config *config = &counter->config;
 	struct lib_counter_layout *layout;
 
-	if (!(config->alloc & COUNTER_ALLOC_GLOBAL))
+	if (!(config->alloc & COUNTER_ALLOC_GLOBAL) ||
+			config->mem == COUNTER_MEM_PRIVATE)
 		return -EINVAL;
 	layout = &counter->global_counters;
 	if (layout->shm_fd >= 0)
@@ -121,7 +128,8 @@ int lttng_counter_set_cpu_shm(struct lib_counter *counter, int cpu, int fd)
 	if (cpu < 0 || cpu >= num_possible_cpus())
 		return -EINVAL;
 
-	if (!(config->alloc & COUNTER_ALLOC_PER_CPU))
+	if (!(config->alloc & COUNTER_ALLOC_PER_CPU) ||
+			config->mem == COUNTER_MEM_PRIVATE)
 		return -EINVAL;
 	layout = &counter->percpu_counters[cpu];
 	if (layout->shm_fd >= 0)
@@ -192,6 +200,10 @@ int validate_args(const struct lib_counter_config *config,
 		return -1;
 	if (!(config->alloc & COUNTER_ALLOC_PER_CPU) && nr_counter_cpu_fds >= 0)
 		return -1;
+	/* Private counters are not shared. */
+	if (config->mem == COUNTER_MEM_PRIVATE &&
+			(global_counter_fd >= 0 || counter_cpu_fds))
+		return -1;
 	if (counter_cpu_fds && nr_cpus != nr_counter_cpu_fds)
 		return -1;
 	return 0;
@@ -259,9 +271,11 @@ struct lib_counter *lttng_counter_create(const struct lib_counter_config *config
 		if (ret)
 			goto layout_init_error;
 	}
-	if ((config->alloc & COUNTER_ALLOC_PER_CPU) && counter_cpu_fds) {
+	if ((config->alloc & COUNTER_ALLOC_PER_CPU) &&
+			(counter_cpu_fds || config->mem == COUNTER_MEM_PRIVATE)) {
 		for_each_possible_cpu(cpu) {
-			ret = lttng_counter_layout_init(counter, cpu, counter_cpu_fds[cpu]);
+			ret = lttng_counter_layout_init(counter, cpu,
+					counter_cpu_fds ? counter_cpu_fds[cpu] : -1);
 			if (ret)
 				goto layout_init_error;
 		}
@@ -154,8 +154,10 @@ struct lttng_counter_shm_object *_lttng_counter_shm_object_table_alloc_mem(struc
 		return NULL;
 	obj = &table->objects[table->allocated_len];
 
-	memory_map = zmalloc(memory_map_size);
-	if (!memory_map)
+	/* Anonymous memory is only populated where it gets written. */
+	memory_map = mmap(NULL, memory_map_size, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory_map == MAP_FAILED)
 		goto alloc_error;
 
 	/* no shm_fd */
@@ -276,7 +278,7 @@ error_mmap:
 }
 
 /*
- * Passing ownership of mem to object.
+ * Passing ownership of mem, an anonymous mapping, to object.
  */
 struct lttng_counter_shm_object *lttng_counter_shm_object_table_append_mem(struct lttng_counter_shm_object_table *table,
 			void *mem, size_t memory_map_size)
@@ -339,7 +341,13 @@ void lttng_counter_shmp_object_destroy(struct lttng_counter_shm_object *obj, int
 	}
 	case LTTNG_COUNTER_SHM_OBJECT_MEM:
 	{
-		free(obj->memory_map);
+		int ret;
+
+		ret = munmap(obj->memory_map, obj->memory_map_size);
+		if (ret) {
+			PERROR("munmap");
+			assert(0);
+		}
 		break;
 	}
 	default:
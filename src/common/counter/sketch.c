@@ -0,0 +1,530 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR LGPL-2.1-only)
+ *
+ * sketch.c
+ *
+ * Count-min sketch with heavy hitters, and HyperLogLog, laid out over
+ * per-cpu 64-bit counters.
+ *
+ * Count-min sketch cells: depth rows of width counters, followed by
+ * top_k heavy hitter slots. Each slot holds the key hash (its tag),
+ * the count estimated when it was last updated, the key length and a
+ * prefix of the key. A key replaces the heavy hitter with the lowest
+ * count once its own estimate exceeds it.
+ *
+ * HyperLogLog cells: width 8-bit registers, packed 8 per cell.
+ *
+ * Updates only touch the current cpu cells, with atomic operations.
+ * Reads merge the cpu cells: count-min counters are summed, heavy
+ * hitter candidates of all cpus are re-estimated against the summed
+ * counters, and HyperLogLog registers are merged with their maximum.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#include "common/macros.h"
+#include "common/getcpu.h"
+#include "common/smp.h"
+#include "counter-internal.h"
+#include "sketch.h"
+
+#define COUNT_MIN_MAX_DEPTH	16
+#define COUNT_MIN_MAX_CELLS	(1U << 24)
+#define COUNT_MIN_MAX_TOP_K	1024
+
+#define HLL_MIN_REGISTERS	16
+#define HLL_MAX_REGISTERS	(1U << 18)
+#define HLL_REGISTERS_PER_CELL	8
+
+/* Heavy hitter slot cells. */
+enum sketch_slot_cell {
+	SLOT_TAG,		/* Key hash, SLOT_TAG_EMPTY or SLOT_TAG_BUSY. */
+	SLOT_COUNT,
+	SLOT_KEY_LEN,
+	SLOT_KEY,
+};
+
+#define SLOT_TAG_EMPTY		0
+#define SLOT_TAG_BUSY		1	/* Slot being written. */
+#define SLOT_TAG_RESERVED	2	/* Hashes are never below. */
+#define SLOT_NR_CELLS		(SLOT_KEY + LTTNG_SKETCH_KEY_LEN / sizeof(int64_t))
+
+int lttng_sketch_validate_config(const struct lib_sketch_config *config)
+{
+	if (CAA_BITS_PER_LONG != 64)
+		return -EINVAL;
+	switch (config->type) {
+	case LIB_SKETCH_COUNT_MIN:
+		if (!config->depth || config->depth > COUNT_MIN_MAX_DEPTH)
+			return -EINVAL;
+		if (!config->width || config->width > COUNT_MIN_MAX_CELLS / config->depth)
+			return -EINVAL;
+		if (config->top_k > COUNT_MIN_MAX_TOP_K)
+			return -EINVAL;
+		break;
+	case LIB_SKETCH_HYPERLOGLOG:
+		if (config->width < HLL_MIN_REGISTERS || config->width > HLL_MAX_REGISTERS)
+			return -EINVAL;
+		if (config->width & (config->width - 1))
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+size_t lttng_sketch_get_nr_elem(const struct lib_sketch_config *config)
+{
+	switch (config->type) {
+	case LIB_SKETCH_COUNT_MIN:
+		return (size_t) config->depth * config->width +
+			(size_t) config->top_k * SLOT_NR_CELLS;
+	case LIB_SKETCH_HYPERLOGLOG:
+		return config->width / HLL_REGISTERS_PER_CELL;
+	default:
+		return 0;
+	}
+}
+
+static
+int sketch_validate_counter(const struct lib_sketch_config *config,
+		struct lib_counter *counter, size_t sketch_index)
+{
+	if (counter->config.alloc != COUNTER_ALLOC_PER_CPU ||
+			counter->config.counter_size != COUNTER_SIZE_64_BIT ||
+			counter->nr_dimensions != 2)
+		return -EINVAL;
+	if (counter->dimensions[1].max_nr_elem != lttng_sketch_get_nr_elem(config))
+		return -EINVAL;
+	if (sketch_index >= counter->dimensions[0].max_nr_elem)
+		return -EOVERFLOW;
+	return 0;
+}
+
+/* Cells of a sketch for a cpu, NULL if its counters are not mapped yet. */
+static
+int64_t *sketch_cells(struct lib_counter *counter, int cpu, size_t sketch_index)
+{
+	struct lib_counter_layout *layout = &counter->percpu_counters[cpu];
+
+	if (caa_unlikely(!layout->counters))
+		return NULL;
+	return (int64_t *) layout->counters + sketch_index * counter->dimensions[0].stride;
+}
+
+/*
+ * FNV-1a, followed by a finalizer mixing all bits of the key into both
+ * halves of the hash.
+ */
+static
+uint64_t sketch_hash(const void *key, size_t key_len)
+{
+	const unsigned char *p = key;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < key_len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	/* Keep the heavy hitter slot tags free. */
+	if (caa_unlikely(hash < SLOT_TAG_RESERVED))
+		hash += SLOT_TAG_RESERVED;
+	return hash;
+}
+
+/* Column of a row, derived from the two halves of the hash. */
+static inline
+size_t count_min_column(const struct lib_sketch_config *config, uint64_t hash,
+		uint32_t row)
+{
+	uint32_t h1 = (uint32_t) hash, h2 = (uint32_t) (hash >> 32) | 1;
+
+	return (size_t) ((uint32_t) (h1 + row * h2) % config->width);
+}
+
+#if CAA_BITS_PER_LONG == 64
+static
+void top_k_update(const struct lib_sketch_config *config, int64_t *slots,
+		uint64_t hash, const void *key, size_t key_len, uint64_t count)
+{
+	int64_t tag = (int64_t) hash, min_tag = SLOT_TAG_EMPTY;
+	uint64_t min_count = UINT64_MAX;
+	int64_t *min_slot = NULL;
+	uint32_t i;
+
+	for (i = 0; i < config->top_k; i++) {
+		int64_t *slot = &slots[i * SLOT_NR_CELLS];
+		int64_t slot_tag = uatomic_read(&slot[SLOT_TAG]);
+		uint64_t slot_count;
+
+		if (slot_tag == tag) {
+			int64_t old = uatomic_read(&slot[SLOT_COUNT]), res;
+
+			/* Only ever raise the count. */
+			while ((uint64_t) old < count) {
+				res = uatomic_cmpxchg(&slot[SLOT_COUNT], old, (int64_t) count);
+				if (res == old)
+					break;
+				old = res;
+			}
+			return;
+		}
+		if (slot_tag == SLOT_TAG_BUSY)
+			continue;
+		if (slot_tag == SLOT_TAG_EMPTY)
+			slot_count = 0;
+		else
+			slot_count = (uint64_t) uatomic_read(&slot[SLOT_COUNT]);
+		if (slot_count < min_count) {
+			min_count = slot_count;
+			min_slot = slot;
+			min_tag = slot_tag;
+		}
+	}
+	if (!min_slot || count <= min_count)
+		return;
+	/*
+	 * Evict the smallest heavy hitter, unless a concurrent update
+	 * claimed its slot first. Readers discard a slot whose tag
+	 * changed while they copied its key.
+	 */
+	if (uatomic_cmpxchg(&min_slot[SLOT_TAG], min_tag, SLOT_TAG_BUSY) != min_tag)
+		return;
+	memcpy(&min_slot[SLOT_KEY], key, min_t(size_t, key_len, LTTNG_SKETCH_KEY_LEN));
+	CMM_STORE_SHARED(min_slot[SLOT_KEY_LEN], (int64_t) key_len);
+	CMM_STORE_SHARED(min_slot[SLOT_COUNT], (int64_t) count);
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(min_slot[SLOT_TAG], tag);
+}
+
+static
+void count_min_update(const struct lib_sketch_config *config, int64_t *cells,
+		uint64_t hash, const void *key, size_t key_len)
+{
+	uint64_t count = UINT64_MAX, v;
+	uint32_t row;
+
+	for (row = 0; row < config->depth; row++) {
+		int64_t *cell = &cells[(size_t) row * config->width +
+				count_min_column(config, hash, row)];
+
+		v = (uint64_t) uatomic_add_return(cell, 1);
+		if (v < count)
+			count = v;
+	}
+	if (config->top_k)
+		top_k_update(config, &cells[(size_t) config->depth * config->width],
+			hash, key, key_len, count);
+}
+
+static
+void hyperloglog_update(const struct lib_sketch_config *config, int64_t *cells,
+		uint64_t hash)
+{
+	unsigned int precision = __builtin_ctz(config->width), shift;
+	size_t reg = (size_t) (hash >> (64 - precision));
+	uint64_t w = hash << precision, rank;
+	int64_t *cell = &cells[reg / HLL_REGISTERS_PER_CELL];
+	int64_t old, n, res;
+
+	/* Position of the first set bit of the remaining hash bits. */
+	rank = w ? (uint64_t) __builtin_clzll(w) + 1 : 64 - precision + 1;
+	shift = (reg % HLL_REGISTERS_PER_CELL) * 8;
+	old = uatomic_read(cell);
+	for (;;) {
+		if ((((uint64_t) old >> shift) & 0xFF) >= rank)
+			return;
+		n = (int64_t) (((uint64_t) old & ~(0xFFULL << shift)) | (rank << shift));
+		res = uatomic_cmpxchg(cell, old, n);
+		if (res == old)
+			return;
+		old = res;
+	}
+}
+
+int lttng_sketch_update(const struct lib_sketch_config *config,
+			struct lib_counter *counter, size_t sketch_index,
+			const void *key, size_t key_len)
+{
+	int64_t *cells;
+	uint64_t hash;
+	int ret;
+
+	ret = sketch_validate_counter(config, counter, sketch_index);
+	if (caa_unlikely(ret))
+		return ret;
+	cells = sketch_cells(counter, lttng_ust_get_cpu(), sketch_index);
+	if (caa_unlikely(!cells))
+		return -ENODEV;
+	hash = sketch_hash(key, key_len);
+	switch (config->type) {
+	case LIB_SKETCH_COUNT_MIN:
+		count_min_update(config, cells, hash, key, key_len);
+		break;
+	case LIB_SKETCH_HYPERLOGLOG:
+		hyperloglog_update(config, cells, hash);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+#else
+int lttng_sketch_update(const struct lib_sketch_config *config __attribute__((unused)),
+			struct lib_counter *counter __attribute__((unused)),
+			size_t sketch_index __attribute__((unused)),
+			const void *key __attribute__((unused)),
+			size_t key_len __attribute__((unused)))
+{
+	/* 64-bit counters are not available. */
+	return -EINVAL;
+}
+#endif
+
+static
+uint64_t count_min_query(const struct lib_sketch_config *config,
+		struct lib_counter *counter, size_t sketch_index, uint64_t hash)
+{
+	uint64_t count = UINT64_MAX;
+	uint32_t row;
+
+	for (row = 0; row < config->depth; row++) {
+		size_t index = (size_t) row * config->width +
+			count_min_column(config, hash, row);
+		uint64_t sum = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			int64_t *cells = sketch_cells(counter, cpu, sketch_index);
+
+			if (cells)
+				sum += (uint64_t) CMM_LOAD_SHARED(cells[index]);
+		}
+		if (sum < count)
+			count = sum;
+	}
+	return count;
+}
+
+int lttng_sketch_estimate(const struct lib_sketch_config *config,
+			  struct lib_counter *counter, size_t sketch_index,
+			  const void *key, size_t key_len, uint64_t *count)
+{
+	int ret;
+
+	if (config->type != LIB_SKETCH_COUNT_MIN)
+		return -EINVAL;
+	ret = sketch_validate_counter(config, counter, sketch_index);
+	if (ret)
+		return ret;
+	*count = count_min_query(config, counter, sketch_index,
+			sketch_hash(key, key_len));
+	return 0;
+}
+
+struct top_k_candidate {
+	int64_t tag;
+	struct lib_sketch_entry entry;
+};
+
+/* Copy a heavy hitter slot, false if empty or changed while copied. */
+static
+bool top_k_read_slot(const int64_t *slot, struct top_k_candidate *candidate)
+{
+	int64_t tag;
+
+	tag = CMM_LOAD_SHARED(slot[SLOT_TAG]);
+	if (tag == SLOT_TAG_EMPTY || tag == SLOT_TAG_BUSY)
+		return false;
+	cmm_smp_rmb();
+	candidate->entry.key_len = (size_t) CMM_LOAD_SHARED(slot[SLOT_KEY_LEN]);
+	memcpy(candidate->entry.key, &slot[SLOT_KEY],
+		min_t(size_t, candidate->entry.key_len, LTTNG_SKETCH_KEY_LEN));
+	cmm_smp_rmb();
+	if (CMM_LOAD_SHARED(slot[SLOT_TAG]) != tag)
+		return false;
+	candidate->tag = tag;
+	return true;
+}
+
+static
+int top_k_candidate_compare(const void *a, const void *b)
+{
+	const struct top_k_candidate *ca = a, *cb = b;
+
+	if (ca->entry.count != cb->entry.count)
+		return ca->entry.count > cb->entry.count ? -1 : 1;
+	return 0;
+}
+
+int lttng_sketch_top_k(const struct lib_sketch_config *config,
+		       struct lib_counter *counter, size_t sketch_index,
+		       struct lib_sketch_entry *entries, size_t *nr_entries)
+{
+	struct top_k_candidate *candidates;
+	size_t nr_candidates = 0, i, j;
+	int cpu, ret;
+
+	if (config->type != LIB_SKETCH_COUNT_MIN)
+		return -EINVAL;
+	ret = sketch_validate_counter(config, counter, sketch_index);
+	if (ret)
+		return ret;
+	if (!config->top_k) {
+		*nr_entries = 0;
+		return 0;
+	}
+	candidates = zmalloc(sizeof(*candidates) * config->top_k * num_possible_cpus());
+	if (!candidates)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		int64_t *cells = sketch_cells(counter, cpu, sketch_index);
+
+		if (!cells)
+			continue;
+		cells += (size_t) config->depth * config->width;
+		for (i = 0; i < config->top_k; i++) {
+			struct top_k_candidate *candidate = &candidates[nr_candidates];
+
+			if (!top_k_read_slot(&cells[i * SLOT_NR_CELLS], candidate))
+				continue;
+			/* The same key may be a heavy hitter on many cpus. */
+			for (j = 0; j < nr_candidates; j++) {
+				if (candidates[j].tag == candidate->tag)
+					break;
+			}
+			if (j == nr_candidates)
+				nr_candidates++;
+		}
+	}
+	for (i = 0; i < nr_candidates; i++)
+		candidates[i].entry.count = count_min_query(config, counter,
+				sketch_index, (uint64_t) candidates[i].tag);
+	qsort(candidates, nr_candidates, sizeof(*candidates), top_k_candidate_compare);
+	nr_candidates = min_t(size_t, nr_candidates, config->top_k);
+	nr_candidates = min_t(size_t, nr_candidates, *nr_entries);
+	for (i = 0; i < nr_candidates; i++)
+		entries[i] = candidates[i].entry;
+	*nr_entries = nr_candidates;
+	free(candidates);
+	return 0;
+}
+
+/* Natural logarithm of x >= 1, without depending on libm. */
+static
+double sketch_log(double x)
+{
+	double y, y2, term, sum = 0;
+	int k = 0, i;
+
+	while (x >= 2) {
+		x /= 2;
+		k++;
+	}
+	/* ln(x) = 2 atanh((x - 1) / (x + 1)), with x in [1, 2). */
+	y = (x - 1) / (x + 1);
+	y2 = y * y;
+	term = y;
+	for (i = 1; i < 40; i += 2) {
+		sum += term / i;
+		term *= y2;
+	}
+	return k * 0.69314718055994530942 + 2 * sum;
+}
+
+int lttng_sketch_cardinality(const struct lib_sketch_config *config,
+			     struct lib_counter *counter, size_t sketch_index,
+			     uint64_t *value)
+{
+	size_t nr_cells = lttng_sketch_get_nr_elem(config), i;
+	double m = config->width, alpha, sum = 0, estimate;
+	uint8_t *registers;
+	size_t nr_zeros = 0;
+	int cpu, ret;
+
+	if (config->type != LIB_SKETCH_HYPERLOGLOG)
+		return -EINVAL;
+	ret = sketch_validate_counter(config, counter, sketch_index);
+	if (ret)
+		return ret;
+	registers = zmalloc(config->width);
+	if (!registers)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		int64_t *cells = sketch_cells(counter, cpu, sketch_index);
+
+		if (!cells)
+			continue;
+		for (i = 0; i < nr_cells; i++) {
+			uint64_t cell = (uint64_t) CMM_LOAD_SHARED(cells[i]);
+			unsigned int j;
+
+			for (j = 0; j < HLL_REGISTERS_PER_CELL; j++) {
+				uint8_t *reg = &registers[i * HLL_REGISTERS_PER_CELL + j];
+				uint8_t rank = (uint8_t) (cell >> (j * 8));
+
+				if (rank > *reg)
+					*reg = rank;
+			}
+		}
+	}
+	for (i = 0; i < config->width; i++) {
+		sum += 1.0 / (double) (1ULL << registers[i]);
+		if (!registers[i])
+			nr_zeros++;
+	}
+	free(registers);
+
+	switch (config->width) {
+	case 16:
+		alpha = 0.673;
+		break;
+	case 32:
+		alpha = 0.697;
+		break;
+	case 64:
+		alpha = 0.709;
+		break;
+	default:
+		alpha = 0.7213 / (1 + 1.079 / m);
+		break;
+	}
+	estimate = alpha * m * m / sum;
+	/* Linear counting is more accurate for small cardinalities. */
+	if (estimate <= 2.5 * m && nr_zeros)
+		estimate = m * sketch_log(m / nr_zeros);
+	*value = (uint64_t) (estimate + 0.5);
+	return 0;
+}
+
+int lttng_sketch_clear(const struct lib_sketch_config *config,
+		       struct lib_counter *counter, size_t sketch_index)
+{
+	size_t nr_cells = lttng_sketch_get_nr_elem(config), i;
+	int cpu, ret;
+
+	ret = sketch_validate_counter(config, counter, sketch_index);
+	if (ret)
+		return ret;
+	for_each_possible_cpu(cpu) {
+		int64_t *cells = sketch_cells(counter, cpu, sketch_index);
+
+		if (!cells)
+			continue;
+		for (i = 0; i < nr_cells; i++)
+			CMM_STORE_SHARED(cells[i], 0);
+	}
+	return 0;
+}
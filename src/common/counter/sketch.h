@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * LTTng Sketch Counters API
+ *
+ * Probabilistic sketches laid out over per-cpu 64-bit counters of two
+ * dimensions: the sketch index, and the sketch cells. Updates are
+ * lock-free and only touch the current cpu counters, which are merged
+ * on read.
+ */
+
+#ifndef _LTTNG_COUNTER_SKETCH_H
+#define _LTTNG_COUNTER_SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "counter-types.h"
+
+/* Length of the key prefix kept for each heavy hitter. */
+#define LTTNG_SKETCH_KEY_LEN	48
+
+enum lib_sketch_type {
+	LIB_SKETCH_COUNT_MIN,
+	LIB_SKETCH_HYPERLOGLOG,
+};
+
+struct lib_sketch_config {
+	enum lib_sketch_type type;
+	uint32_t depth;		/* Count-min rows. */
+	uint32_t width;		/* Count-min columns, or HyperLogLog registers. */
+	uint32_t top_k;		/* Count-min heavy hitters tracked. */
+};
+
+struct lib_sketch_entry {
+	uint64_t count;		/* Estimated number of occurrences. */
+	size_t key_len;		/* Full key length, may exceed LTTNG_SKETCH_KEY_LEN. */
+	char key[LTTNG_SKETCH_KEY_LEN];
+};
+
+int lttng_sketch_validate_config(const struct lib_sketch_config *config)
+	__attribute__((visibility("hidden")));
+
+/* Number of 64-bit counter elements used by each sketch. */
+size_t lttng_sketch_get_nr_elem(const struct lib_sketch_config *config)
+	__attribute__((visibility("hidden")));
+
+int lttng_sketch_update(const struct lib_sketch_config *config,
+			struct lib_counter *counter, size_t sketch_index,
+			const void *key, size_t key_len)
+	__attribute__((visibility("hidden")));
+
+int lttng_sketch_estimate(const struct lib_sketch_config *config,
+			  struct lib_counter *counter, size_t sketch_index,
+			  const void *key, size_t key_len, uint64_t *count)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Heavy hitters of a count-min sketch, by decreasing count. On input,
+ * *nr_entries is the number of entries available, on output the number
+ * of entries filled.
+ */
+int lttng_sketch_top_k(const struct lib_sketch_config *config,
+		       struct lib_counter *counter, size_t sketch_index,
+		       struct lib_sketch_entry *entries, size_t *nr_entries)
+	__attribute__((visibility("hidden")));
+
+int lttng_sketch_cardinality(const struct lib_sketch_config *config,
+			     struct lib_counter *counter, size_t sketch_index,
+			     uint64_t *value)
+	__attribute__((visibility("hidden")));
+
+int lttng_sketch_clear(const struct lib_sketch_config *config,
+		       struct lib_counter *counter, size_t sketch_index)
+	__attribute__((visibility("hidden")));
+
+#endif /* _LTTNG_COUNTER_SKETCH_H */
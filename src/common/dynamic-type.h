@@ -9,6 +9,11 @@
 
 #include <lttng/ust-events.h>
 
+/*
+ * The values of the integer entries are recorded as tags by the probes
+ * of variable-length integer fields (see LTTNG_UST__TP_VARINT_TAG_S8
+ * and LTTNG_UST__TP_VARINT_TAG_U8), they must not change.
+ */
 enum lttng_ust_dynamic_type {
 	LTTNG_UST_DYNAMIC_TYPE_NONE,
 	LTTNG_UST_DYNAMIC_TYPE_S8,
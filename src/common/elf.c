@@ -703,3 +703,200 @@ error:
 	free(_filename);
 	return -1;
 }
+
+/*
+ * Retrieve the link-time address and the size of the section named
+ * `name`, if any.
+ *
+ * If the function returns successfully, the out parameter `found`
+ * indicates whether the section was present in the ELF file or not.
+ * If `found` is not 0, the out parameters `addr` and `size` will both
+ * have been set with the retrieved information.
+ *
+ * Returns 0 on success, -1 if an error occurred.
+ */
+int lttng_ust_elf_get_section(struct lttng_ust_elf *elf, const char *name,
+			uint64_t *addr, uint64_t *size, int *found)
+{
+	uint16_t i;
+
+	if (!elf || !name || !addr || !size || !found) {
+		goto error;
+	}
+
+	*found = 0;
+	for (i = 0; i < elf->ehdr->e_shnum; ++i) {
+		struct lttng_ust_elf_shdr *shdr;
+		char *section_name;
+
+		shdr = lttng_ust_elf_get_shdr(elf, i);
+		if (!shdr) {
+			goto error;
+		}
+		section_name = lttng_ust_elf_get_section_name(elf,
+						shdr->sh_name);
+		if (section_name && !strcmp(section_name, name)) {
+			*addr = shdr->sh_addr;
+			*size = shdr->sh_size;
+			*found = 1;
+		}
+		free(section_name);
+		free(shdr);
+		if (*found) {
+			break;
+		}
+	}
+
+	return 0;
+error:
+	return -1;
+}
+
+/*
+ * Read `size` bytes at `offset` of the ELF file in a newly allocated,
+ * zero-terminated buffer.
+ *
+ * Returns the buffer on success, NULL on failure.
+ */
+static
+char *lttng_ust_elf_read_range(struct lttng_ust_elf *elf, uint64_t offset,
+			uint64_t size)
+{
+	char *buf;
+
+	if (size >= SIZE_MAX) {
+		return NULL;
+	}
+	buf = zmalloc(size + 1);
+	if (!buf) {
+		return NULL;
+	}
+	if (lseek(elf->fd, offset, SEEK_SET) < 0) {
+		goto error;
+	}
+	if (lttng_ust_read(elf->fd, buf, size) < size) {
+		goto error;
+	}
+	return buf;
+
+error:
+	free(buf);
+	return NULL;
+}
+
+/*
+ * Call `cb` for each defined function symbol of the ELF file, taken
+ * from its static symbol table or, when it is stripped, from its
+ * dynamic symbol table. Symbol values are link-time addresses. The
+ * iteration stops at the first non-zero value returned by `cb`.
+ *
+ * Returns 0 on success, -1 if an error occurred or if `cb` stopped the
+ * iteration.
+ */
+int lttng_ust_elf_for_each_func_symbol(struct lttng_ust_elf *elf,
+			lttng_ust_elf_func_symbol_cb cb, void *priv)
+{
+	struct lttng_ust_elf_shdr *symtab = NULL, *strtab = NULL;
+	char *syms = NULL, *strs = NULL;
+	uint64_t sym_size, nr_syms, i;
+	uint16_t j;
+	int ret = -1;
+
+	if (!elf || !cb) {
+		goto end;
+	}
+
+	for (j = 0; j < elf->ehdr->e_shnum; ++j) {
+		struct lttng_ust_elf_shdr *shdr;
+
+		shdr = lttng_ust_elf_get_shdr(elf, j);
+		if (!shdr) {
+			goto end;
+		}
+		if (shdr->sh_type == SHT_SYMTAB
+				|| (shdr->sh_type == SHT_DYNSYM && !symtab)) {
+			free(symtab);
+			symtab = shdr;
+		} else {
+			free(shdr);
+		}
+		if (symtab && symtab->sh_type == SHT_SYMTAB) {
+			break;
+		}
+	}
+	if (!symtab) {
+		/* No symbols. */
+		ret = 0;
+		goto end;
+	}
+
+	sym_size = is_elf_32_bit(elf) ? sizeof(Elf32_Sym) : sizeof(Elf64_Sym);
+	if (symtab->sh_entsize && symtab->sh_entsize != sym_size) {
+		goto end;
+	}
+	strtab = lttng_ust_elf_get_shdr(elf, symtab->sh_link);
+	if (!strtab) {
+		goto end;
+	}
+	syms = lttng_ust_elf_read_range(elf, symtab->sh_offset, symtab->sh_size);
+	strs = lttng_ust_elf_read_range(elf, strtab->sh_offset, strtab->sh_size);
+	if (!syms || !strs) {
+		goto end;
+	}
+
+	nr_syms = symtab->sh_size / sym_size;
+	for (i = 0; i < nr_syms; i++) {
+		uint64_t name, value, size;
+		uint16_t shndx;
+		uint8_t info;
+
+		if (is_elf_32_bit(elf)) {
+			Elf32_Sym sym;
+
+			memcpy(&sym, syms + i * sym_size, sizeof(sym));
+			if (!is_elf_native_endian(elf)) {
+				bswap(sym.st_name);
+				bswap(sym.st_value);
+				bswap(sym.st_size);
+				bswap(sym.st_shndx);
+			}
+			name = sym.st_name;
+			value = sym.st_value;
+			size = sym.st_size;
+			shndx = sym.st_shndx;
+			info = sym.st_info;
+		} else {
+			Elf64_Sym sym;
+
+			memcpy(&sym, syms + i * sym_size, sizeof(sym));
+			if (!is_elf_native_endian(elf)) {
+				bswap(sym.st_name);
+				bswap(sym.st_value);
+				bswap(sym.st_size);
+				bswap(sym.st_shndx);
+			}
+			name = sym.st_name;
+			value = sym.st_value;
+			size = sym.st_size;
+			shndx = sym.st_shndx;
+			info = sym.st_info;
+		}
+		if (ELF64_ST_TYPE(info) != STT_FUNC || shndx == SHN_UNDEF) {
+			continue;
+		}
+		if (name >= strtab->sh_size || !strs[name]) {
+			continue;
+		}
+		if (cb(strs + name, value, size, priv)) {
+			goto end;
+		}
+	}
+	ret = 0;
+
+end:
+	free(strs);
+	free(syms);
+	free(strtab);
+	free(symtab);
+	return ret;
+}
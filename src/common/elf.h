@@ -229,4 +229,15 @@ int lttng_ust_elf_get_debug_link(struct lttng_ust_elf *elf, char **filename,
 			uint32_t *crc, int *found)
 	__attribute__((visibility("hidden")));
 
+int lttng_ust_elf_get_section(struct lttng_ust_elf *elf, const char *name,
+			uint64_t *addr, uint64_t *size, int *found)
+	__attribute__((visibility("hidden")));
+
+typedef int (*lttng_ust_elf_func_symbol_cb)(const char *name, uint64_t value,
+			uint64_t size, void *priv);
+
+int lttng_ust_elf_for_each_func_symbol(struct lttng_ust_elf *elf,
+			lttng_ust_elf_func_symbol_cb cb, void *priv)
+	__attribute__((visibility("hidden")));
+
 #endif	/* _UST_COMMON_ELF_H */
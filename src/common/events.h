@@ -17,6 +17,7 @@
 
 #include "common/macros.h"
 #include "common/ust-context-provider.h"
+#include "common/counter/sketch.h"
 
 /*
  * The context procname length is part of the LTTng-UST ABI.
@@ -27,6 +28,7 @@
 
 struct lttng_ust_abi_obj;
 struct lttng_event_notifier_group;
+struct lttng_event_notifier_dispatch;
 
 union lttng_ust_abi_args {
 	struct {
@@ -95,6 +97,9 @@ struct lttng_event_enabler {
 struct lttng_event_notifier_enabler {
 	struct lttng_enabler base;
 	uint64_t error_counter_index;
+	uint32_t sketch;		/* enum lttng_ust_abi_counter_sketch */
+	uint64_t sketch_index;
+	unsigned long coalesce_window_us;
 	struct cds_list_head node;	/* per-app list of event_notifier enablers */
 	struct cds_list_head capture_bytecode_head;
 	struct lttng_event_notifier_group *group; /* weak ref */
@@ -217,6 +222,7 @@ struct lttng_counter_ops {
 struct lttng_counter {
 	int objd;
 	struct lttng_event_notifier_group *event_notifier_group;    /* owner */
+	struct lttng_ust_session *session;	/* owner of a profile counter */
 	struct lttng_counter_transport *transport;
 	struct lib_counter *counter;
 	struct lttng_counter_ops *ops;
@@ -242,6 +248,15 @@ struct lttng_ust_enum_ht {
 	struct cds_hlist_head table[LTTNG_UST_ENUM_HT_SIZE];
 };
 
+/* Indexed by enum lttng_ust_abi_counter_sketch. */
+#define LTTNG_EVENT_NOTIFIER_SKETCH_NR	3
+
+struct lttng_event_notifier_sketch {
+	struct lttng_counter *counter;		/* NULL if not created. */
+	struct lib_sketch_config config;
+	size_t len;				/* Number of sketches. */
+};
+
 struct lttng_event_notifier_group {
 	int objd;
 	void *owner;
@@ -254,6 +269,10 @@ struct lttng_event_notifier_group {
 
 	struct lttng_counter *error_counter;
 	size_t error_counter_len;
+
+	struct lttng_event_notifier_sketch sketches[LTTNG_EVENT_NOTIFIER_SKETCH_NR];
+
+	int sync_pending;			/* Enabler sync deferred */
 };
 
 struct lttng_transport {
@@ -301,9 +320,27 @@ struct lttng_ust_event_notifier_private {
 	struct lttng_event_notifier_group *group; /* weak ref */
 	size_t num_captures;			/* Needed to allocate the msgpack array. */
 	uint64_t error_counter_index;
+	uint32_t sketch;			/* enum lttng_ust_abi_counter_sketch */
+	uint64_t sketch_index;
 	struct cds_list_head node;		/* Event notifier list */
 	struct cds_hlist_node hlist;		/* Hash table of event notifiers */
 	struct cds_list_head capture_bytecode_runtime_head;
+
+	/* Dispatch index of the event notifiers reached through this one (RCU). */
+	struct lttng_event_notifier_dispatch *dispatch;
+	struct lttng_event_notifier_dispatch *dispatch_pending;
+	/*
+	 * Holder of the dispatch index notifying this event notifier:
+	 * itself for a holder, NULL when notified by its own probe.
+	 */
+	struct lttng_ust_event_notifier *dispatcher;
+	struct lttng_ust_event_notifier *dispatcher_pending;
+	int dispatch_disabled;			/* Disabled holder, enabled until handed over. */
+
+	/* Notification coalescing, see event-notifier-notification.c. */
+	unsigned long coalesce_window_us;	/* Coalescing window (us), 0 if disabled. */
+	unsigned long coalesce_start;		/* Last notification sent (us), 0 if none. */
+	unsigned long nr_coalesced;		/* Notifications coalesced since. */
 };
 
 struct lttng_ust_bytecode_runtime {
@@ -338,6 +375,7 @@ struct lttng_ust_session_private {
 	int tstate:1;				/* Transient enable state */
 
 	int statedump_pending:1;
+	int sync_pending:1;			/* Enabler sync deferred */
 
 	struct lttng_ust_enum_ht enums_ht;	/* ht of enumerations */
 	struct cds_list_head enums_head;
@@ -345,6 +383,10 @@ struct lttng_ust_session_private {
 
 	unsigned char uuid[LTTNG_UST_UUID_LEN];	/* Trace session unique ID */
 	bool uuid_set;				/* Is uuid set ? */
+
+	struct lttng_counter *profile_counter;	/* Probe stage cycles. */
+	uint32_t profile_period;		/* Probe hits per profiled hit. */
+	size_t profile_nr_buckets;		/* Cycles histogram buckets. */
 };
 
 struct lttng_enum {
@@ -368,7 +410,8 @@ struct lttng_ust_channel_buffer_ops_private {
 			unsigned char *uuid,
 			uint32_t chan_id,
 			const int *stream_fds, int nr_stream_fds,
-			int64_t blocking_timeout);
+			int64_t blocking_timeout,
+			int clock_source);
 	void (*channel_destroy)(struct lttng_ust_channel_buffer *chan);
 	/*
 	 * packet_avail_size returns the available size in the current
@@ -411,7 +454,7 @@ struct lttng_ust_channel_buffer_private {
  */
 struct lttng_ust_abi_channel_config {
 	void *unused1;
-	int unused2;
+	int clock_source;	/* enum lttng_ust_abi_clock_source */
 	void *unused3;
 	void *unused4;
 	int unused5;
@@ -519,6 +562,14 @@ const struct lttng_ust_type_struct *lttng_ust_get_type_struct(const struct lttng
 	return caa_container_of(type, const struct lttng_ust_type_struct, parent);
 }
 
+static inline
+const struct lttng_ust_type_struct_native *lttng_ust_get_type_struct_native(const struct lttng_ust_type_common *type)
+{
+	if (type->type != lttng_ust_type_struct_native)
+		return NULL;
+	return caa_container_of(type, const struct lttng_ust_type_struct_native, parent);
+}
+
 #define lttng_ust_static_type_integer(_size, _alignment, _signedness, _byte_order, _base)		\
 	((const struct lttng_ust_type_common *) LTTNG_UST_COMPOUND_LITERAL(const struct lttng_ust_type_integer, { \
 		.parent = {										\
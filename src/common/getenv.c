@@ -42,11 +42,16 @@ static struct lttng_env lttng_env[] = {
 	/* Env. var. which can be used in setuid/setgid executables. */
 	{ "LTTNG_UST_WITHOUT_BADDR_STATEDUMP", LTTNG_ENV_NOT_SECURE, NULL, },
 	{ "LTTNG_UST_REGISTER_TIMEOUT", LTTNG_ENV_NOT_SECURE, NULL, },
+	{ "LTTNG_UST_REGISTER_WAVE", LTTNG_ENV_NOT_SECURE, NULL, },
+	{ "LTTNG_UST_TRACEPOINT_SITES", LTTNG_ENV_NOT_SECURE, NULL, },
 
 	/* Env. var. which are not fetched in setuid/setgid executables. */
 	{ "LTTNG_UST_CLOCK_PLUGIN", LTTNG_ENV_SECURE, NULL, },
 	{ "LTTNG_UST_GETCPU_PLUGIN", LTTNG_ENV_SECURE, NULL, },
 	{ "LTTNG_UST_ALLOW_BLOCKING", LTTNG_ENV_SECURE, NULL, },
+	{ "LTTNG_UST_IO_AGGREGATE", LTTNG_ENV_SECURE, NULL, },
+	{ "LTTNG_UST_IO_FLUSH_PERIOD", LTTNG_ENV_SECURE, NULL, },
+	{ "LTTNG_UST_IO_MAX_FD", LTTNG_ENV_SECURE, NULL, },
 	{ "HOME", LTTNG_ENV_SECURE, NULL, },
 	{ "LTTNG_HOME", LTTNG_ENV_SECURE, NULL, },
 };
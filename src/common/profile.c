@@ -0,0 +1,11 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Thread-local state of the probe hit profiling, shared by the probes
+ * and the ring buffer clients.
+ */
+
+#define _LGPL_SOURCE
+#include "common/profile.h"
+
+DEFINE_URCU_TLS(struct lttng_ust_profile_state, lttng_ust_profile_state);
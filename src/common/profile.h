@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Per-stage cycle accounting of sampled probe hits, compiled out unless
+ * LTTng-UST is configured with --enable-probe-profiling.
+ */
+
+#ifndef _UST_COMMON_PROFILE_H
+#define _UST_COMMON_PROFILE_H
+
+#include <stdint.h>
+
+#include <lttng/ust-abi.h>
+#include <lttng/ust-arch.h>
+#include <lttng/ust-config.h>
+#include <urcu/compiler.h>
+#include <urcu/tls-compat.h>
+
+#include "common/clock.h"
+
+#ifdef LTTNG_UST_HAVE_PROBE_PROFILING
+
+struct lttng_ust_profile_state {
+	int active;		/* Profiling the current probe hit. */
+	unsigned int nesting;	/* Probe hits nested in the profiled one. */
+	uint32_t countdown;	/* Probe hits before the next profiled one. */
+	uint32_t stages;	/* Mask of the stages reached. */
+	uint64_t last;		/* Cycles at the end of the previous stage. */
+	uint64_t cycles[NR_LTTNG_UST_ABI_PROFILE_STAGE];
+};
+
+extern DECLARE_URCU_TLS(struct lttng_ust_profile_state, lttng_ust_profile_state)
+	__attribute__((visibility("hidden")));
+
+static inline
+uint64_t lttng_ust_profile_cycles(void)
+{
+#ifdef LTTNG_UST_ARCH_X86
+	return __builtin_ia32_rdtsc();
+#else
+	return trace_clock_read64_monotonic();
+#endif
+}
+
+/* Account the cycles since the end of the previous stage to a stage. */
+static inline
+void lttng_ust_profile_account(int stage)
+{
+	struct lttng_ust_profile_state *state = &URCU_TLS(lttng_ust_profile_state);
+	uint64_t now = lttng_ust_profile_cycles();
+
+	state->cycles[stage] += now - state->last;
+	state->stages |= 1U << stage;
+	state->last = now;
+}
+
+/*
+ * Account a stage of the probe hit from within the tracer, unless the
+ * tracer records a probe hit nested in the profiled one.
+ */
+static inline
+void lttng_ust_profile_tracer_stage(int stage)
+{
+	struct lttng_ust_profile_state *state = &URCU_TLS(lttng_ust_profile_state);
+
+	if (caa_unlikely(state->active) && !state->nesting)
+		lttng_ust_profile_account(stage);
+}
+
+#else
+
+static inline
+void lttng_ust_profile_tracer_stage(int stage __attribute__((unused)))
+{
+}
+
+#endif
+
+#endif /* _UST_COMMON_PROFILE_H */
@@ -13,10 +13,18 @@ void lttng_ust_ring_buffer_clients_init(void)
 	lttng_ring_buffer_client_overwrite_rt_init();
 	lttng_ring_buffer_client_discard_init();
 	lttng_ring_buffer_client_discard_rt_init();
+	lttng_ring_buffer_client_overwrite_per_channel_init();
+	lttng_ring_buffer_client_overwrite_per_channel_rt_init();
+	lttng_ring_buffer_client_discard_per_channel_init();
+	lttng_ring_buffer_client_discard_per_channel_rt_init();
 }
 
 void lttng_ust_ring_buffer_clients_exit(void)
 {
+	lttng_ring_buffer_client_discard_per_channel_rt_exit();
+	lttng_ring_buffer_client_discard_per_channel_exit();
+	lttng_ring_buffer_client_overwrite_per_channel_rt_exit();
+	lttng_ring_buffer_client_overwrite_per_channel_exit();
 	lttng_ring_buffer_client_discard_rt_exit();
 	lttng_ring_buffer_client_discard_exit();
 	lttng_ring_buffer_client_overwrite_rt_exit();
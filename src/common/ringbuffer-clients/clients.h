@@ -60,6 +60,18 @@ void lttng_ring_buffer_client_discard_init(void)
 void lttng_ring_buffer_client_discard_rt_init(void)
 	__attribute__((visibility("hidden")));
 
+void lttng_ring_buffer_client_overwrite_per_channel_init(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ring_buffer_client_overwrite_per_channel_rt_init(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ring_buffer_client_discard_per_channel_init(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ring_buffer_client_discard_per_channel_rt_init(void)
+	__attribute__((visibility("hidden")));
+
 void lttng_ring_buffer_metadata_client_init(void)
 	__attribute__((visibility("hidden")));
 
@@ -76,6 +88,18 @@ void lttng_ring_buffer_client_discard_exit(void)
 void lttng_ring_buffer_client_discard_rt_exit(void)
 	__attribute__((visibility("hidden")));
 
+void lttng_ring_buffer_client_overwrite_per_channel_exit(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ring_buffer_client_overwrite_per_channel_rt_exit(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ring_buffer_client_discard_per_channel_exit(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ring_buffer_client_discard_per_channel_rt_exit(void)
+	__attribute__((visibility("hidden")));
+
 void lttng_ring_buffer_metadata_client_exit(void)
 	__attribute__((visibility("hidden")));
 
@@ -92,4 +116,16 @@ void lttng_ust_ring_buffer_client_discard_alloc_tls(void)
 void lttng_ust_ring_buffer_client_discard_rt_alloc_tls(void)
 	__attribute__((visibility("hidden")));
 
+void lttng_ust_ring_buffer_client_overwrite_per_channel_alloc_tls(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ust_ring_buffer_client_overwrite_per_channel_rt_alloc_tls(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ust_ring_buffer_client_discard_per_channel_alloc_tls(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ust_ring_buffer_client_discard_per_channel_rt_alloc_tls(void)
+	__attribute__((visibility("hidden")));
+
 #endif /* _UST_COMMON_RINGBUFFER_CLIENTS_CLIENTS_H */
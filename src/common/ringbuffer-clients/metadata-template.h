@@ -215,7 +215,8 @@ struct lttng_ust_channel_buffer *_channel_create(const char *name,
 				unsigned char *uuid,
 				uint32_t chan_id,
 				const int *stream_fds, int nr_stream_fds,
-				int64_t blocking_timeout)
+				int64_t blocking_timeout,
+				int clock_source __attribute__((unused)))
 {
 	struct lttng_ust_abi_channel_config chan_priv_init;
 	struct lttng_ust_shm_handle *handle;
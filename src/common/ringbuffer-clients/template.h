@@ -7,8 +7,10 @@
  */
 
 #include <limits.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <lttng/urcu/pointer.h>
 #include <urcu/tls-compat.h>
@@ -17,8 +19,13 @@
 #include "common/bitfield.h"
 #include "common/align.h"
 #include "common/clock.h"
+#include "common/profile.h"
 #include "common/ringbuffer/frontend_types.h"
 
+#ifndef LTTNG_CLIENT_ALLOC
+#define LTTNG_CLIENT_ALLOC		RING_BUFFER_ALLOC_PER_CPU
+#endif
+
 #define LTTNG_COMPACT_EVENT_BITS       5
 #define LTTNG_COMPACT_TSC_BITS         27
 
@@ -78,9 +85,12 @@ void RING_BUFFER_MODE_TEMPLATE_ALLOC_TLS(void)
 }
 
 static inline uint64_t lib_ring_buffer_clock_read(
-		struct lttng_ust_ring_buffer_channel *chan __attribute__((unused)))
+		struct lttng_ust_ring_buffer_channel *chan)
 {
-	return trace_clock_read64();
+	struct lttng_ust_abi_channel_config *chan_config =
+			channel_get_private_config(chan);
+
+	return trace_clock_read64_source(chan_config->clock_source);
 }
 
 static inline
@@ -614,7 +624,7 @@ static const struct lttng_ust_ring_buffer_config client_config = {
 	.cb.packet_size_field = client_packet_size_field,
 
 	.tsc_bits = LTTNG_COMPACT_TSC_BITS,
-	.alloc = RING_BUFFER_ALLOC_PER_CPU,
+	.alloc = LTTNG_CLIENT_ALLOC,
 	.sync = RING_BUFFER_SYNC_GLOBAL,
 	.mode = RING_BUFFER_MODE_TEMPLATE,
 	.backend = RING_BUFFER_PAGE,
@@ -636,7 +646,8 @@ struct lttng_ust_channel_buffer *_channel_create(const char *name,
 				unsigned char *uuid,
 				uint32_t chan_id,
 				const int *stream_fds, int nr_stream_fds,
-				int64_t blocking_timeout)
+				int64_t blocking_timeout,
+				int clock_source)
 {
 	struct lttng_ust_abi_channel_config chan_priv_init;
 	struct lttng_ust_shm_handle *handle;
@@ -651,6 +662,7 @@ struct lttng_ust_channel_buffer *_channel_create(const char *name,
 	memset(&chan_priv_init, 0, sizeof(chan_priv_init));
 	memcpy(chan_priv_init.uuid, uuid, LTTNG_UST_UUID_LEN);
 	chan_priv_init.id = chan_id;
+	chan_priv_init.clock_source = clock_source;
 
 	handle = channel_create(&client_config, name,
 			__alignof__(struct lttng_ust_abi_channel_config),
@@ -692,6 +704,7 @@ int lttng_event_reserve(struct lttng_ust_ring_buffer_ctx *ctx)
 	/* Compute internal size of context structures. */
 	ctx_get_struct_size(ctx, client_ctx.chan_ctx, &client_ctx.packet_context_len);
 	ctx_get_struct_size(ctx, client_ctx.event_ctx, &client_ctx.event_context_len);
+	lttng_ust_profile_tracer_stage(LTTNG_UST_ABI_PROFILE_STAGE_CONTEXT);
 
 	nesting = lib_ring_buffer_nesting_inc(&client_config);
 	if (nesting < 0)
@@ -725,20 +738,136 @@ int lttng_event_reserve(struct lttng_ust_ring_buffer_ctx *ctx)
 		ret = -EPERM;
 		goto put;
 	}
+	lttng_ust_profile_tracer_stage(LTTNG_UST_ABI_PROFILE_STAGE_RESERVE);
 	lttng_write_event_header(&client_config, ctx, &client_ctx, event_id);
+	lttng_ust_profile_tracer_stage(LTTNG_UST_ABI_PROFILE_STAGE_CONTEXT);
 	return 0;
 put:
 	lib_ring_buffer_nesting_dec(&client_config);
+	lttng_ust_profile_tracer_stage(LTTNG_UST_ABI_PROFILE_STAGE_RESERVE);
 	return ret;
 }
 
+/*
+ * With the repeat context, a record identical to the previous record of
+ * its buffer is folded into it: same event id, and same bytes from the
+ * repeat context fields, recorded first, to the end of the record. The
+ * previous record must end where this one starts, within the same
+ * sub-buffer, which cannot be delivered until this record is committed
+ * or discarded, so the previous record can still be updated.
+ *
+ * The last record of the buffer is tracked in the buffer, under a
+ * sequence count made odd by the writer updating it. Writers finding it
+ * odd neither fold nor update it, so this never waits. With per-UID
+ * buffers, a process dying while the count is odd leaves it odd: the
+ * records of the buffer are no longer folded, only recorded, until the
+ * buffer is destroyed. The count is not reset on sub-buffer switch: a
+ * writer preempted while updating the tracked record would then update
+ * it along with the next one.
+ *
+ * Returns true if the record was folded and must not be committed.
+ */
+static
+bool lttng_event_fold(struct lttng_ust_ring_buffer_ctx *ctx)
+{
+	struct lttng_ust_ring_buffer_ctx_private *ctx_private = ctx->priv;
+	struct lttng_ust_event_recorder *event_recorder = ctx->client_priv;
+	struct lttng_ust_ring_buffer_channel *chan = ctx_private->chan;
+	struct lttng_ust_ring_buffer *buf = ctx_private->buf;
+	unsigned long begin = ctx_private->fold_offset;
+	unsigned long end = ctx_private->pre_offset + ctx_private->slot_size;
+	uint32_t id = event_recorder->priv->id;
+	uint64_t repeat[2], prev_repeat[2];
+	unsigned long prev_begin;
+	bool folded = false;
+	char *prev, *cur;
+	uint32_t seq;
+
+	seq = CMM_LOAD_SHARED(buf->fold_seq);
+	if (seq & 1)
+		return false;
+	if (uatomic_cmpxchg(&buf->fold_seq, seq, seq + 1) != seq)
+		return false;
+	prev_begin = buf->fold_end - buf->fold_len;
+	if (buf->fold_end != ctx_private->pre_offset
+			|| buf->fold_len != end - begin
+			|| buf->fold_id != id
+			|| subbuf_trunc(prev_begin, chan) != subbuf_trunc(end - 1, chan))
+		goto update;
+	prev = lib_ring_buffer_offset_address(&buf->backend, prev_begin, chan->handle);
+	cur = lib_ring_buffer_offset_address(&buf->backend, begin, chan->handle);
+	if (!prev || !cur || memcmp(prev + sizeof(repeat), cur + sizeof(repeat),
+			end - begin - sizeof(repeat)))
+		goto update;
+	memcpy(prev_repeat, prev, sizeof(prev_repeat));
+	repeat[0] = prev_repeat[0] + 1;
+	repeat[1] = ctx_private->tsc;
+	memcpy(prev, repeat, sizeof(repeat));
+	if (!lib_ring_buffer_try_discard_reserve(&client_config, ctx)) {
+		folded = true;
+		goto end;
+	}
+	/* A record was reserved after this one: keep both. */
+	memcpy(prev, prev_repeat, sizeof(prev_repeat));
+update:
+	buf->fold_end = end;
+	buf->fold_len = end - begin;
+	buf->fold_id = id;
+end:
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(buf->fold_seq, seq + 2);
+	return folded;
+}
+
 static
 void lttng_event_commit(struct lttng_ust_ring_buffer_ctx *ctx)
 {
+	if (caa_unlikely(ctx->priv->fold_offset) && lttng_event_fold(ctx)) {
+		lib_ring_buffer_nesting_dec(&client_config);
+		return;
+	}
 	lib_ring_buffer_commit(&client_config, ctx);
 	lib_ring_buffer_nesting_dec(&client_config);
 }
 
+/*
+ * The reference of a delta-encoded field is shared by the records of a
+ * sub-buffer with the same event id and field. Fields beyond the key
+ * space are recorded as values.
+ */
+static
+int lttng_event_delta_reference(struct lttng_ust_ring_buffer_ctx *ctx,
+		unsigned int field, uint64_t value, uint64_t *reference)
+{
+	struct lttng_ust_event_recorder *event_recorder = ctx->client_priv;
+	uint32_t id = event_recorder->priv->id;
+
+	if (id > (UINT32_MAX >> 8) || field >= UINT8_MAX)
+		return LTTNG_UST_DELTA_KIND_VALUE;
+	switch (lib_ring_buffer_delta_reference(&client_config, ctx,
+			(id << 8) | (field + 1), value, reference)) {
+	case 0:
+		return LTTNG_UST_DELTA_KIND_REFERENCE;
+	case 1:
+		return LTTNG_UST_DELTA_KIND_DELTA;
+	default:
+		return LTTNG_UST_DELTA_KIND_VALUE;
+	}
+}
+
+static
+int lttng_event_shrink(struct lttng_ust_ring_buffer_ctx *ctx)
+{
+	struct lttng_ust_ring_buffer_ctx_private *ctx_private = ctx->priv;
+
+	if (!lib_ring_buffer_try_shrink_reserve(&client_config, ctx))
+		return 0;
+	/* A record was reserved after this one: rewind to its payload. */
+	ctx_private->buf_offset = ctx_private->pre_offset
+		+ ctx_private->slot_size - ctx->data_size;
+	return -EPERM;
+}
+
 static
 void lttng_event_write(struct lttng_ust_ring_buffer_ctx *ctx,
 		const void *src, size_t len, size_t alignment)
@@ -784,7 +913,7 @@ int lttng_flush_buffer(struct lttng_ust_channel_buffer *chan)
 	struct lttng_ust_ring_buffer *buf;
 	int cpu;
 
-	for_each_channel_cpu(cpu, rb_chan) {
+	for_each_channel_stream(cpu, &client_config, rb_chan) {
 		int shm_fd, wait_fd, wakeup_fd;
 		uint64_t memory_map_size;
 		void *memory_map_addr;
@@ -816,6 +945,8 @@ static struct lttng_transport lttng_relay_transport = {
 		.event_write = lttng_event_write,
 		.event_strcpy = lttng_event_strcpy,
 		.event_pstrcpy_pad = lttng_event_pstrcpy_pad,
+		.event_delta_reference = lttng_event_delta_reference,
+		.event_shrink = lttng_event_shrink,
 	},
 	.client_config = &client_config,
 };
@@ -14,13 +14,15 @@
 #include "shm_internal.h"
 #include "vatomic.h"
 
-#define RB_BACKEND_PAGES_PADDING	16
+#define RB_BACKEND_PAGES_PADDING	8
 struct lttng_ust_ring_buffer_backend_pages {
 	unsigned long mmap_offset;	/* offset of the subbuffer in mmap */
 	union v_atomic records_commit;	/* current records committed count */
 	union v_atomic records_unread;	/* records to read */
 	unsigned long data_size;	/* Amount of data to read from subbuf */
 	DECLARE_SHMP(char, p);		/* Backing memory map */
+	int numa_node;			/* Node of the memory, plus one */
+	int writer_cpu;			/* CPU which started it, plus one */
 	char padding[RB_BACKEND_PAGES_PADDING];
 };
 
@@ -13,6 +13,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include <urcu/compiler.h>
 #include <urcu/uatomic.h>
@@ -75,6 +76,39 @@ void channel_destroy(struct lttng_ust_ring_buffer_channel *chan,
 #define for_each_channel_cpu(cpu, chan)					\
 	for_each_possible_cpu(cpu)
 
+/*
+ * Iteration on the lanes of a global buffer channel, one per stream.
+ */
+#define for_each_channel_lane(lane, chan)				\
+	for ((lane) = 0; (lane) < (int) (chan)->nr_streams; (lane)++)
+
+/*
+ * Iteration on all the streams of a channel, either per-cpu or per-lane.
+ */
+#define for_each_channel_stream(stream, config, chan)			\
+	for ((stream) = 0;						\
+	     (stream) < ((config)->alloc == RING_BUFFER_ALLOC_PER_CPU ?	\
+			num_possible_cpus() : (int) (chan)->nr_streams);	\
+	     (stream)++)
+
+/**
+ * lib_ring_buffer_get_lane - Get the lane of the current thread.
+ *
+ * Threads are spread over the lanes of a global buffer channel by hashing
+ * their thread handle, so a given thread always writes into the same lane.
+ */
+static inline
+int lib_ring_buffer_get_lane(struct lttng_ust_ring_buffer_channel *chan)
+{
+	unsigned int nr_lanes = chan->nr_streams;
+	uint64_t hash;
+
+	if (caa_likely(nr_lanes <= 1))
+		return 0;
+	hash = (uint64_t) (uintptr_t) pthread_self() * 0x9E3779B97F4A7C15ULL;
+	return (int) ((hash >> 32) % nr_lanes);
+}
+
 extern struct lttng_ust_ring_buffer *channel_get_ring_buffer(
 				const struct lttng_ust_ring_buffer_config *config,
 				struct lttng_ust_ring_buffer_channel *chan, int cpu,
@@ -295,4 +329,28 @@ unsigned long lib_ring_buffer_get_records_read(
 	return v_read(config, &buf->backend.records_read);
 }
 
+static inline
+unsigned long lib_ring_buffer_get_numa_subbuf_local(
+				const struct lttng_ust_ring_buffer_config *config,
+				struct lttng_ust_ring_buffer *buf)
+{
+	return v_read(config, &buf->numa_subbuf_local);
+}
+
+static inline
+unsigned long lib_ring_buffer_get_numa_subbuf_remote(
+				const struct lttng_ust_ring_buffer_config *config,
+				struct lttng_ust_ring_buffer *buf)
+{
+	return v_read(config, &buf->numa_subbuf_remote);
+}
+
+static inline
+unsigned long lib_ring_buffer_get_numa_subbuf_moved(
+				const struct lttng_ust_ring_buffer_config *config,
+				struct lttng_ust_ring_buffer *buf)
+{
+	return v_read(config, &buf->numa_subbuf_moved);
+}
+
 #endif /* _LTTNG_RING_BUFFER_FRONTEND_H */
@@ -155,12 +155,11 @@ int lib_ring_buffer_reserve(const struct lttng_ust_ring_buffer_config *config,
 	if (caa_unlikely(uatomic_read(&chan->record_disabled)))
 		return -EAGAIN;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
 		ctx_private->reserve_cpu = lttng_ust_get_cpu();
-		buf = shmp(handle, chan->backend.buf[ctx_private->reserve_cpu].shmp);
-	} else {
-		buf = shmp(handle, chan->backend.buf[0].shmp);
-	}
+	else
+		ctx_private->reserve_cpu = lib_ring_buffer_get_lane(chan);
+	buf = shmp(handle, chan->backend.buf[ctx_private->reserve_cpu].shmp);
 	if (caa_unlikely(!buf))
 		return -EIO;
 	if (caa_unlikely(uatomic_read(&buf->record_disabled)))
@@ -336,6 +335,110 @@ int lib_ring_buffer_try_discard_reserve(const struct lttng_ust_ring_buffer_confi
 		return 0;
 }
 
+/**
+ * lib_ring_buffer_try_shrink_reserve - Try ending a record before its
+ *                                      reserved end.
+ * @config: ring buffer instance configuration.
+ * @ctx: ring buffer context, whose write position is the new end of the
+ *       record.
+ *
+ * Only succeeds if no other record has been reserved after the record to
+ * shrink, and if the record does not end its sub-buffer: the reserve then
+ * already set the data size of the sub-buffer. If shrink fails, the whole
+ * reserved slot must be written.
+ *
+ * Returns 0 upon success, -EPERM if the record cannot be shrunk.
+ */
+static inline
+int lib_ring_buffer_try_shrink_reserve(const struct lttng_ust_ring_buffer_config *config,
+				       const struct lttng_ust_ring_buffer_ctx *ctx)
+{
+	struct lttng_ust_ring_buffer_ctx_private *ctx_private = ctx->priv;
+	struct lttng_ust_ring_buffer_channel *chan = ctx_private->chan;
+	struct lttng_ust_ring_buffer *buf = ctx_private->buf;
+	unsigned long end_offset = ctx_private->pre_offset + ctx_private->slot_size;
+
+	if (caa_unlikely(subbuf_offset(end_offset, chan) == 0))
+		return -EPERM;
+	if (caa_unlikely(v_cmpxchg(config, &buf->offset, end_offset, ctx_private->buf_offset)
+		   != end_offset))
+		return -EPERM;
+	ctx_private->slot_size = ctx_private->buf_offset - ctx_private->pre_offset;
+	return 0;
+}
+
+/**
+ * lib_ring_buffer_delta_reference - Get the delta reference of a field.
+ * @config: ring buffer instance configuration.
+ * @ctx: ring buffer context of a reserved record. (input arguments only)
+ * @key: field of the reference, nonzero.
+ * @value: value of the field in the record.
+ * @reference: reference of the field. (output)
+ *
+ * The reference of a field in a sub-buffer is its value in the first
+ * record which claims it, among the records of the sub-buffer. Fields
+ * share the references of a sub-buffer by their key, and a reference
+ * is never replaced within the sub-buffer, so a record following it
+ * can be recorded as a delta against it. The references of the previous
+ * packet of a sub-buffer are cleared when a packet begins in it. As
+ * writers may already have reserved records in the new packet by then,
+ * references are also tied to their packet by the offset of their
+ * record: a reference left by the previous packet is free to claim.
+ *
+ * References are updated under a sequence count made odd by the writer
+ * updating them. Writers finding it odd neither use nor claim the
+ * reference, so this never waits.
+ *
+ * Returns 1 if @reference was set to a reference recorded before the
+ * record, 0 if the record claimed the reference with @value, -EBUSY if
+ * neither.
+ */
+static inline
+int lib_ring_buffer_delta_reference(const struct lttng_ust_ring_buffer_config *config __attribute__((unused)),
+				    const struct lttng_ust_ring_buffer_ctx *ctx,
+				    uint32_t key, uint64_t value,
+				    uint64_t *reference)
+{
+	struct lttng_ust_ring_buffer_ctx_private *ctx_private = ctx->priv;
+	struct lttng_ust_ring_buffer_channel *chan = ctx_private->chan;
+	struct lttng_ust_ring_buffer *buf = ctx_private->buf;
+	unsigned long offset = ctx_private->pre_offset;
+	struct commit_counters_hot *cc_hot;
+	struct delta_reference *ref;
+	unsigned long ref_offset;
+	uint64_t ref_value;
+	uint32_t seq, ref_key;
+
+	cc_hot = shmp_index(chan->handle, buf->commit_hot, subbuf_index(offset, chan));
+	if (caa_unlikely(!cc_hot))
+		return -EBUSY;
+	ref = &cc_hot->delta_ref[key % RB_DELTA_REFERENCES];
+	seq = CMM_LOAD_SHARED(ref->seq);
+	if (seq & 1)
+		return -EBUSY;
+	cmm_smp_rmb();
+	ref_key = ref->key;
+	ref_offset = ref->offset;
+	ref_value = ref->value;
+	cmm_smp_rmb();
+	if (CMM_LOAD_SHARED(ref->seq) != seq)
+		return -EBUSY;
+	if (ref_key && subbuf_trunc(ref_offset, chan) == subbuf_trunc(offset, chan)) {
+		if (ref_key != key || ref_offset >= offset)
+			return -EBUSY;
+		*reference = ref_value;
+		return 1;
+	}
+	if (uatomic_cmpxchg(&ref->seq, seq, seq + 1) != seq)
+		return -EBUSY;
+	ref->key = key;
+	ref->offset = offset;
+	ref->value = value;
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(ref->seq, seq + 2);
+	return 0;
+}
+
 static inline
 void channel_record_disable(
 		const struct lttng_ust_ring_buffer_config *config __attribute__((unused)),
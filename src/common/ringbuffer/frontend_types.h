@@ -62,6 +62,14 @@ struct lttng_ust_ring_buffer_channel {
 		struct {
 			int32_t blocking_timeout_ms;
 			void *priv;		/* Private data pointer. */
+			/*
+			 * Packed per-cpu buffers layout: stride between
+			 * buffers and offset of the first buffer within
+			 * the single shm object. Zero stride if each
+			 * buffer has its own shm object.
+			 */
+			uint64_t packed_stride;
+			uint32_t packed_header;
 		} s;
 		char padding[RB_CHANNEL_PADDING];
 	} u;
@@ -72,12 +80,26 @@ struct lttng_ust_ring_buffer_channel {
 	struct channel_backend backend;		/* Associated backend */
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
-/* Per-subbuffer commit counters used on the hot path */
-#define RB_COMMIT_COUNT_HOT_PADDING	16
+/*
+ * Delta encoding reference of a field in a sub-buffer, updated under a
+ * sequence count made odd by the writer updating it.
+ */
+struct delta_reference {
+	uint32_t seq;			/* Odd while updated */
+	uint32_t key;			/* Field, 0 if none */
+	unsigned long offset;		/* Start of the record holding it */
+	uint64_t value;			/* Value of the field in the record */
+};
+
+/*
+ * Per-subbuffer commit counters used on the hot path. The delta
+ * references take the room left in the cache line.
+ */
+#define RB_DELTA_REFERENCES		2
 struct commit_counters_hot {
 	union v_atomic cc;		/* Commit counter */
 	union v_atomic seq;		/* Consecutive commits */
-	char padding[RB_COMMIT_COUNT_HOT_PADDING];
+	struct delta_reference delta_ref[RB_DELTA_REFERENCES];
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
 /* Per-subbuffer commit counters used only on cold paths */
@@ -89,7 +111,7 @@ struct commit_counters_cold {
 
 /* ring buffer state */
 #define RB_CRASH_DUMP_ABI_LEN		256
-#define RB_RING_BUFFER_PADDING		60
+#define RB_RING_BUFFER_PADDING		8
 
 #define RB_CRASH_DUMP_ABI_MAGIC_LEN	16
 
@@ -222,6 +244,17 @@ struct lttng_ust_ring_buffer {
 	unsigned int get_subbuf:1;	/* Sub-buffer being held by reader */
 	/* shmp pointer to self */
 	DECLARE_SHMP(struct lttng_ust_ring_buffer, self);
+					/* NUMA placement of sub-buffers */
+	union v_atomic numa_subbuf_local;	/* Started from their node */
+	union v_atomic numa_subbuf_remote;	/* Started from another node */
+	union v_atomic numa_subbuf_moved;	/* Moved to their writer node */
+	int numa_writer_node;		/* Node starting sub-buffers, plus one (consumer) */
+	unsigned int numa_writer_stable;	/* Sub-buffers it started in a row (consumer) */
+					/* Last record, to fold repeats */
+	unsigned long fold_end;		/* End offset of the record */
+	uint32_t fold_seq;		/* Odd while updated */
+	uint32_t fold_len;		/* Length of its compared part */
+	uint32_t fold_id;		/* Event id of the record */
 	char padding[RB_RING_BUFFER_PADDING];
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
@@ -259,6 +292,11 @@ struct lttng_ust_ring_buffer_ctx_private {
 						 * for this channel
 						 */
 	struct lttng_ust_ring_buffer_backend_pages *backend_pages;
+	unsigned long fold_offset;		/*
+						 * Start of the part compared
+						 * to fold identical records,
+						 * 0 if not folding.
+						 */
 };
 
 static inline
@@ -247,6 +247,9 @@ void channel_backend_reset(struct channel_backend *chanb)
  * @num_subbuf: number of sub-buffers (power of 2)
  * @lttng_ust_shm_handle: shared memory handle
  * @stream_fds: stream file descriptors.
+ * @nr_stream_fds: number of stream file descriptors. A single stream
+ *                 file descriptor for a per-cpu channel packs all
+ *                 buffers within one shm object.
  *
  * Returns channel pointer if successful, %NULL otherwise.
  *
@@ -261,7 +264,7 @@ int channel_backend_init(struct channel_backend *chanb,
 			 const struct lttng_ust_ring_buffer_config *config,
 			 size_t subbuf_size, size_t num_subbuf,
 			 struct lttng_ust_shm_handle *handle,
-			 const int *stream_fds)
+			 const int *stream_fds, int nr_stream_fds)
 {
 	struct lttng_ust_ring_buffer_channel *chan = caa_container_of(chanb,
 			struct lttng_ust_ring_buffer_channel, backend);
@@ -339,16 +342,35 @@ int channel_backend_init(struct channel_backend *chanb,
 
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
 		struct lttng_ust_ring_buffer *buf;
+		struct shm_object *first;
+
+		if (nr_stream_fds == 1 && num_possible_cpus() > 1) {
+			size_t header_size, stride;
+
+			first = shm_object_table_alloc_packed(handle->table,
+					shmsize, num_possible_cpus(),
+					stream_fds[0], &header_size, &stride);
+			if (!first)
+				goto end;
+			chan->u.s.packed_header = header_size;
+			chan->u.s.packed_stride = stride;
+		} else {
+			/*
+			 * Allocating and zeroing the buffers dominates
+			 * channel creation: do it in parallel, on each cpu.
+			 */
+			first = shm_object_table_alloc_per_cpu(handle->table,
+					shmsize, stream_fds, num_possible_cpus());
+			if (!first)
+				goto end;
+		}
 		/*
 		 * We need to allocate for all possible cpus.
 		 */
 		for_each_possible_cpu(i) {
 			struct shm_object *shmobj;
 
-			shmobj = shm_object_table_alloc(handle->table, shmsize,
-					SHM_OBJECT_SHM, stream_fds[i], i);
-			if (!shmobj)
-				goto end;
+			shmobj = &handle->table->objects[first->index + i];
 			align_shm(shmobj, __alignof__(struct lttng_ust_ring_buffer));
 			set_shmp(chanb->buf[i].shmp, zalloc_shm(shmobj, sizeof(struct lttng_ust_ring_buffer)));
 			buf = shmp(handle, chanb->buf[i].shmp);
@@ -361,23 +383,31 @@ int channel_backend_init(struct channel_backend *chanb,
 				goto free_bufs;	/* cpu hotplug locked */
 		}
 	} else {
-		struct shm_object *shmobj;
 		struct lttng_ust_ring_buffer *buf;
 
-		shmobj = shm_object_table_alloc(handle->table, shmsize,
-					SHM_OBJECT_SHM, stream_fds[0], -1);
-		if (!shmobj)
-			goto end;
-		align_shm(shmobj, __alignof__(struct lttng_ust_ring_buffer));
-		set_shmp(chanb->buf[0].shmp, zalloc_shm(shmobj, sizeof(struct lttng_ust_ring_buffer)));
-		buf = shmp(handle, chanb->buf[0].shmp);
-		if (!buf)
-			goto end;
-		set_shmp(buf->self, chanb->buf[0].shmp._ref);
-		ret = lib_ring_buffer_create(buf, chanb, -1,
+		/*
+		 * One buffer per lane. Buffers of a single lane channel
+		 * are not tied to any cpu.
+		 */
+		for (i = 0; i < chan->nr_streams; i++) {
+			struct shm_object *shmobj;
+
+			shmobj = shm_object_table_alloc(handle->table, shmsize,
+					SHM_OBJECT_SHM, stream_fds[i], -1);
+			if (!shmobj)
+				goto end;
+			align_shm(shmobj, __alignof__(struct lttng_ust_ring_buffer));
+			set_shmp(chanb->buf[i].shmp, zalloc_shm(shmobj, sizeof(struct lttng_ust_ring_buffer)));
+			buf = shmp(handle, chanb->buf[i].shmp);
+			if (!buf)
+				goto end;
+			set_shmp(buf->self, chanb->buf[i].shmp._ref);
+			ret = lib_ring_buffer_create(buf, chanb,
+					chan->nr_streams > 1 ? (int) i : -1,
 					handle, shmobj);
-		if (ret)
-			goto free_bufs;
+			if (ret)
+				goto free_bufs;
+		}
 	}
 	chanb->start_tsc = config->cb.ring_buffer_clock_read(chan);
 
@@ -56,6 +56,7 @@
 #include <lttng/ust-ringbuffer-context.h>
 
 #include "common/smp.h"
+#include "common/bitmap.h"
 #include "ringbuffer-config.h"
 #include "vatomic.h"
 #include "backend.h"
@@ -64,6 +65,12 @@
 #include "rb-init.h"
 #include "common/compat/errno.h"	/* For ENODATA */
 
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#include <numaif.h>
+#include "common/getcpu.h"
+#endif
+
 /* Print DBG() messages about events lost only every 1048576 hits */
 #define DBG_PRINT_NR_LOST	(1UL << 20)
 
@@ -197,6 +204,7 @@ void lib_ring_buffer_reset(struct lttng_ust_ring_buffer *buf,
 			return;
 		v_set(config, &cc_hot->cc, 0);
 		v_set(config, &cc_hot->seq, 0);
+		memset(cc_hot->delta_ref, 0, sizeof(cc_hot->delta_ref));
 		v_set(config, &cc_cold->cc_sb, 0);
 		*ts_end = 0;
 	}
@@ -462,14 +470,16 @@ void lib_ring_buffer_channel_switch_timer(int sig __attribute__((unused)),
 					chan->handle);
 		}
 	} else {
-		struct lttng_ust_ring_buffer *buf =
-			shmp(handle, chan->backend.buf[0].shmp);
-
-		if (!buf)
-			goto end;
-		if (uatomic_read(&buf->active_readers))
-			lib_ring_buffer_switch_slow(buf, SWITCH_ACTIVE,
-				chan->handle);
+		for_each_channel_lane(cpu, chan) {
+			struct lttng_ust_ring_buffer *buf =
+				shmp(handle, chan->backend.buf[cpu].shmp);
+
+			if (!buf)
+				goto end;
+			if (uatomic_read(&buf->active_readers))
+				lib_ring_buffer_switch_slow(buf, SWITCH_ACTIVE,
+					chan->handle);
+		}
 	}
 end:
 	pthread_mutex_unlock(&wakeup_fd_mutex);
@@ -529,10 +539,24 @@ void lib_ring_buffer_wakeup(struct lttng_ust_ring_buffer *buf,
 	int wakeup_fd = shm_get_wakeup_fd(handle, &buf->self._ref);
 	sigset_t sigpipe_set, pending_set, old_set;
 	int ret, sigpipe_was_pending = 0;
+	unsigned long *ready;
+	unsigned int nr_ready;
 
 	if (wakeup_fd < 0)
 		return;
 
+	/*
+	 * Packed channels share a single wakeup fd: flag this buffer in
+	 * the ready-cpu bitmap, and only write into the pipe if the
+	 * consumer has not been woken up since it last fetched the
+	 * bitmap.
+	 */
+	ready = shm_get_ready_bitmap(handle, &buf->self._ref, &nr_ready);
+	if (ready && buf->backend.cpu >= 0
+			&& (unsigned int) buf->backend.cpu < nr_ready
+			&& lttng_bitmap_test_and_set_bit(buf->backend.cpu, ready))
+		return;
+
 	/*
 	 * Wake-up the other end by writing a null byte in the pipe
 	 * (non-blocking).  Important note: Because writing into the
@@ -615,15 +639,17 @@ void lib_ring_buffer_channel_do_read(struct lttng_ust_ring_buffer_channel *chan)
 			}
 		}
 	} else {
-		struct lttng_ust_ring_buffer *buf =
-			shmp(handle, chan->backend.buf[0].shmp);
-
-		if (!buf)
-			goto end;
-		if (uatomic_read(&buf->active_readers)
-		    && lib_ring_buffer_poll_deliver(config, buf,
-				chan, handle)) {
-			lib_ring_buffer_wakeup(buf, handle);
+		for_each_channel_lane(cpu, chan) {
+			struct lttng_ust_ring_buffer *buf =
+				shmp(handle, chan->backend.buf[cpu].shmp);
+
+			if (!buf)
+				goto end;
+			if (uatomic_read(&buf->active_readers)
+			    && lib_ring_buffer_poll_deliver(config, buf,
+					chan, handle)) {
+				lib_ring_buffer_wakeup(buf, handle);
+			}
 		}
 	}
 end:
@@ -920,11 +946,14 @@ static void channel_print_errors(struct lttng_ust_ring_buffer_channel *chan,
 				lib_ring_buffer_print_errors(chan, buf, cpu, handle);
 		}
 	} else {
-		struct lttng_ust_ring_buffer *buf =
-			shmp(handle, chan->backend.buf[0].shmp);
+		for_each_channel_lane(cpu, chan) {
+			struct lttng_ust_ring_buffer *buf =
+				shmp(handle, chan->backend.buf[cpu].shmp);
 
-		if (buf)
-			lib_ring_buffer_print_errors(chan, buf, -1, handle);
+			if (buf)
+				lib_ring_buffer_print_errors(chan, buf,
+					chan->nr_streams > 1 ? cpu : -1, handle);
+		}
 	}
 }
 
@@ -956,7 +985,9 @@ static void channel_free(struct lttng_ust_ring_buffer_channel *chan,
  *                         Used for live streaming.
  * @read_timer_interval: Time interval (in us) to wake up pending readers.
  * @stream_fds: array of stream file descriptors.
- * @nr_stream_fds: number of file descriptors in array.
+ * @nr_stream_fds: number of file descriptors in array. Either one per
+ *                 stream, or a single one to pack all per-cpu buffers
+ *                 within one shm object sharing one wakeup fd.
  *
  * Holds cpu hotplug.
  * Returns NULL on failure.
@@ -981,13 +1012,23 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_ring_buffer_c
 	unsigned int nr_streams;
 	int64_t blocking_timeout_ms;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
 		nr_streams = num_possible_cpus();
-	else
-		nr_streams = 1;
-
-	if (nr_stream_fds != nr_streams)
-		return NULL;
+		/*
+		 * A single stream fd for a per-cpu channel packs all
+		 * per-cpu buffers within one shm object.
+		 */
+		if (nr_stream_fds != nr_streams && nr_stream_fds != 1)
+			return NULL;
+	} else {
+		/*
+		 * Global buffers have one lane per stream fd, at most
+		 * one per possible cpu.
+		 */
+		if (nr_stream_fds < 1 || nr_stream_fds > num_possible_cpus())
+			return NULL;
+		nr_streams = nr_stream_fds;
+	}
 
 	if (blocking_timeout < -1) {
 		return NULL;
@@ -1061,7 +1102,7 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_ring_buffer_c
 
 	ret = channel_backend_init(&chan->backend, name, config,
 				   subbuf_size, num_subbuf, handle,
-				   stream_fds);
+				   stream_fds, nr_stream_fds);
 	if (ret)
 		goto error_backend_init;
 
@@ -1119,8 +1160,24 @@ int channel_handle_add_stream(struct lttng_ust_shm_handle *handle,
 		int shm_fd, int wakeup_fd, uint32_t stream_nr,
 		uint64_t memory_map_size)
 {
+	struct lttng_ust_ring_buffer_channel *chan;
 	struct shm_object *object;
 
+	chan = shmp(handle, handle->chan);
+	if (!chan)
+		return -EINVAL;
+	if (chan->u.s.packed_stride) {
+		/* Single stream holding all per-cpu buffers. */
+		if (stream_nr != 0)
+			return -EINVAL;
+		object = shm_object_table_append_packed(handle->table,
+				shm_fd, wakeup_fd, chan->nr_streams,
+				chan->u.s.packed_header,
+				chan->u.s.packed_stride, memory_map_size);
+		if (!object)
+			return -EINVAL;
+		return 0;
+	}
 	/* Add stream object */
 	object = shm_object_table_append_shm(handle->table,
 			shm_fd, wakeup_fd, stream_nr,
@@ -1176,6 +1233,27 @@ void channel_destroy(struct lttng_ust_ring_buffer_channel *chan, struct lttng_us
 	return;
 }
 
+/*
+ * Buffer index of the stream of @cpu: the cpu itself for per-cpu
+ * channels, or the lane of global channels. Any cpu maps to the single
+ * buffer of global channels without lanes.
+ */
+static
+int channel_stream_index(const struct lttng_ust_ring_buffer_config *config,
+		struct lttng_ust_ring_buffer_channel *chan, int cpu)
+{
+	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
+		if (chan->nr_streams <= 1)
+			return 0;
+		if (cpu < 0 || cpu >= (int) chan->nr_streams)
+			return -1;
+	} else {
+		if (cpu < 0 || cpu >= num_possible_cpus())
+			return -1;
+	}
+	return cpu;
+}
+
 struct lttng_ust_ring_buffer *channel_get_ring_buffer(
 					const struct lttng_ust_ring_buffer_config *config,
 					struct lttng_ust_ring_buffer_channel *chan, int cpu,
@@ -1187,12 +1265,9 @@ struct lttng_ust_ring_buffer *channel_get_ring_buffer(
 {
 	struct shm_ref *ref;
 
-	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
-		cpu = 0;
-	} else {
-		if (cpu >= num_possible_cpus())
-			return NULL;
-	}
+	cpu = channel_stream_index(config, chan, cpu);
+	if (cpu < 0)
+		return NULL;
 	ref = &chan->backend.buf[cpu].shmp._ref;
 	*shm_fd = shm_get_shm_fd(handle, ref);
 	*wait_fd = shm_get_wait_fd(handle, ref);
@@ -1232,12 +1307,9 @@ int ring_buffer_stream_close_wait_fd(const struct lttng_ust_ring_buffer_config *
 {
 	struct shm_ref *ref;
 
-	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
-		cpu = 0;
-	} else {
-		if (cpu >= num_possible_cpus())
-			return -EINVAL;
-	}
+	cpu = channel_stream_index(config, chan, cpu);
+	if (cpu < 0)
+		return -EINVAL;
 	ref = &chan->backend.buf[cpu].shmp._ref;
 	return shm_close_wait_fd(handle, ref);
 }
@@ -1250,12 +1322,9 @@ int ring_buffer_stream_close_wakeup_fd(const struct lttng_ust_ring_buffer_config
 	struct shm_ref *ref;
 	int ret;
 
-	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
-		cpu = 0;
-	} else {
-		if (cpu >= num_possible_cpus())
-			return -EINVAL;
-	}
+	cpu = channel_stream_index(config, chan, cpu);
+	if (cpu < 0)
+		return -EINVAL;
 	ref = &chan->backend.buf[cpu].shmp._ref;
 	pthread_mutex_lock(&wakeup_fd_mutex);
 	ret = shm_close_wakeup_fd(handle, ref);
@@ -1581,6 +1650,106 @@ nodata:
 		return -EAGAIN;
 }
 
+#ifdef HAVE_LIBNUMA
+/* Sub-buffers started in a row from a node before moving them to it. */
+#define RB_NUMA_STABLE_SWITCHES		4
+#define RB_NUMA_MAX_NODES		1024
+
+static
+int lib_ring_buffer_numa_nr_nodes(void)
+{
+	static int nr_nodes = -1;
+
+	if (caa_unlikely(nr_nodes < 0))
+		nr_nodes = lttng_is_numa_available() ? numa_max_node() + 1 : 0;
+	return nr_nodes;
+}
+
+/*
+ * Per-channel buffers are written by threads running on any node, so
+ * their sub-buffers follow the writer. This is done by the consumer,
+ * out of the writer path, as it releases each sub-buffer: the node of
+ * the cpu which started it is compared to the node of its pages, and
+ * once sub-buffers were started from the same node
+ * RB_NUMA_STABLE_SWITCHES times in a row, the pages of the remote ones
+ * are bound and moved to it. Those pages are also mapped by the
+ * application: moving them requires CAP_SYS_NICE, otherwise only the
+ * pages allocated afterwards follow the binding.
+ */
+static
+void lib_ring_buffer_numa_follow_writer(const struct lttng_ust_ring_buffer_config *config,
+		struct lttng_ust_ring_buffer *buf,
+		struct lttng_ust_ring_buffer_channel *chan,
+		struct lttng_ust_ring_buffer_backend_pages *backend_pages,
+		struct lttng_ust_shm_handle *handle)
+{
+	unsigned long nodemask[RB_NUMA_MAX_NODES / CAA_BITS_PER_LONG];
+	int cpu, node, pages_node;
+	char *p;
+
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL
+			|| lib_ring_buffer_numa_nr_nodes() < 2)
+		return;
+	cpu = CMM_LOAD_SHARED(backend_pages->writer_cpu) - 1;
+	if (cpu < 0)
+		return;
+	node = numa_node_of_cpu(cpu);
+	if (node < 0 || node >= RB_NUMA_MAX_NODES)
+		return;
+	p = shmp_index(handle, backend_pages->p, 0);
+	if (!p)
+		return;
+
+	if (buf->numa_writer_node == node + 1) {
+		buf->numa_writer_stable++;
+	} else {
+		buf->numa_writer_node = node + 1;
+		buf->numa_writer_stable = 1;
+	}
+
+	pages_node = backend_pages->numa_node - 1;
+	if (pages_node < 0) {
+		if (get_mempolicy(&pages_node, NULL, 0, p,
+				MPOL_F_NODE | MPOL_F_ADDR))
+			return;
+		backend_pages->numa_node = pages_node + 1;
+	}
+	if (pages_node == node) {
+		v_inc(config, &buf->numa_subbuf_local);
+		return;
+	}
+	v_inc(config, &buf->numa_subbuf_remote);
+	if (buf->numa_writer_stable < RB_NUMA_STABLE_SWITCHES)
+		return;
+	memset(nodemask, 0, sizeof(nodemask));
+	nodemask[node / CAA_BITS_PER_LONG] |= 1UL << (node % CAA_BITS_PER_LONG);
+	if (mbind(p, chan->backend.subbuf_size, MPOL_PREFERRED, nodemask,
+			RB_NUMA_MAX_NODES, MPOL_MF_MOVE_ALL)) {
+		if (errno != EPERM || mbind(p, chan->backend.subbuf_size,
+				MPOL_PREFERRED, nodemask, RB_NUMA_MAX_NODES,
+				MPOL_MF_MOVE))
+			return;
+	}
+	/* Shared pages may not have moved. */
+	backend_pages->numa_node = 0;
+	if (get_mempolicy(&pages_node, NULL, 0, p, MPOL_F_NODE | MPOL_F_ADDR)
+			|| pages_node != node)
+		return;
+	backend_pages->numa_node = node + 1;
+	v_inc(config, &buf->numa_subbuf_moved);
+}
+#else
+static
+void lib_ring_buffer_numa_follow_writer(
+		const struct lttng_ust_ring_buffer_config *config __attribute__((unused)),
+		struct lttng_ust_ring_buffer *buf __attribute__((unused)),
+		struct lttng_ust_ring_buffer_channel *chan __attribute__((unused)),
+		struct lttng_ust_ring_buffer_backend_pages *backend_pages __attribute__((unused)),
+		struct lttng_ust_shm_handle *handle __attribute__((unused)))
+{
+}
+#endif /* HAVE_LIBNUMA */
+
 /**
  * lib_ring_buffer_put_subbuf - release exclusive subbuffer access
  * @buf: ring buffer
@@ -1628,6 +1797,8 @@ void lib_ring_buffer_put_subbuf(struct lttng_ust_ring_buffer *buf,
 	v_add(config, v_read(config, &backend_pages->records_unread),
 			&bufb->records_read);
 	v_set(config, &backend_pages->records_unread, 0);
+	lib_ring_buffer_numa_follow_writer(config, buf, chan, backend_pages,
+			handle);
 	CHAN_WARN_ON(chan, config->mode == RING_BUFFER_OVERWRITE
 		     && subbuffer_id_is_noref(config, bufb->buf_rsb.id));
 	subbuffer_id_set_noref(config, &bufb->buf_rsb.id);
@@ -1753,6 +1924,32 @@ void lib_ring_buffer_print_errors(struct lttng_ust_ring_buffer_channel *chan,
 	lib_ring_buffer_print_buffer_errors(buf, chan, cpu, handle);
 }
 
+/*
+ * Clear the delta references left in a sub-buffer by its previous packet,
+ * when a packet begins at offset. References already claimed by records
+ * of the new packet are kept, and a reference being updated is left to
+ * its writer: see lib_ring_buffer_delta_reference().
+ */
+static
+void lib_ring_buffer_reset_delta_references(struct lttng_ust_ring_buffer_channel *chan,
+					    struct commit_counters_hot *cc_hot,
+					    unsigned long offset)
+{
+	unsigned int i;
+
+	for (i = 0; i < RB_DELTA_REFERENCES; i++) {
+		struct delta_reference *ref = &cc_hot->delta_ref[i];
+		uint32_t seq = CMM_LOAD_SHARED(ref->seq);
+
+		if ((seq & 1) || uatomic_cmpxchg(&ref->seq, seq, seq + 1) != seq)
+			continue;
+		if (subbuf_trunc(ref->offset, chan) != subbuf_trunc(offset, chan))
+			ref->key = 0;
+		cmm_smp_wmb();
+		CMM_STORE_SHARED(ref->seq, seq + 2);
+	}
+}
+
 /*
  * lib_ring_buffer_switch_old_start: Populate old subbuffer header.
  *
@@ -1781,6 +1978,7 @@ void lib_ring_buffer_switch_old_start(struct lttng_ust_ring_buffer *buf,
 	cc_hot = shmp_index(handle, buf->commit_hot, oldidx);
 	if (!cc_hot)
 		return;
+	lib_ring_buffer_reset_delta_references(chan, cc_hot, offsets->old);
 	v_add(config, config->cb.subbuffer_header_size(),
 	      &cc_hot->cc);
 	commit_count = v_read(config, &cc_hot->cc);
@@ -1848,6 +2046,49 @@ void lib_ring_buffer_switch_old_end(struct lttng_ust_ring_buffer *buf,
 			cc_hot);
 }
 
+#ifdef HAVE_LIBNUMA
+/*
+ * Record the cpu starting a sub-buffer written from any node, for the
+ * consumer to move it to the node of its writer. Only a store, as the
+ * writer may run in a signal handler.
+ */
+static
+void lib_ring_buffer_numa_record_writer(const struct lttng_ust_ring_buffer_config *config,
+		struct lttng_ust_ring_buffer *buf,
+		unsigned long beginidx,
+		struct lttng_ust_shm_handle *handle)
+{
+	struct lttng_ust_ring_buffer_backend_subbuffer *wsb;
+	struct lttng_ust_ring_buffer_backend_pages_shmp *rpages;
+	struct lttng_ust_ring_buffer_backend_pages *backend_pages;
+	int cpu;
+
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL)
+		return;
+	wsb = shmp_index(handle, buf->backend.buf_wsb, beginidx);
+	if (!wsb)
+		return;
+	rpages = shmp_index(handle, buf->backend.array,
+			subbuffer_id_get_index(config, wsb->id));
+	if (!rpages)
+		return;
+	backend_pages = shmp(handle, rpages->shmp);
+	if (!backend_pages)
+		return;
+	cpu = lttng_ust_get_cpu();
+	CMM_STORE_SHARED(backend_pages->writer_cpu, cpu < 0 ? 0 : cpu + 1);
+}
+#else
+static
+void lib_ring_buffer_numa_record_writer(
+		const struct lttng_ust_ring_buffer_config *config __attribute__((unused)),
+		struct lttng_ust_ring_buffer *buf __attribute__((unused)),
+		unsigned long beginidx __attribute__((unused)),
+		struct lttng_ust_shm_handle *handle __attribute__((unused)))
+{
+}
+#endif /* HAVE_LIBNUMA */
+
 /*
  * lib_ring_buffer_switch_new_start: Populate new subbuffer.
  *
@@ -1877,6 +2118,7 @@ void lib_ring_buffer_switch_new_start(struct lttng_ust_ring_buffer *buf,
 	cc_hot = shmp_index(handle, buf->commit_hot, beginidx);
 	if (!cc_hot)
 		return;
+	lib_ring_buffer_reset_delta_references(chan, cc_hot, offsets->begin);
 	v_add(config, config->cb.subbuffer_header_size(), &cc_hot->cc);
 	commit_count = v_read(config, &cc_hot->cc);
 	/* Check if the written buffer has to be delivered */
@@ -2330,10 +2572,7 @@ int lib_ring_buffer_reserve_slow(struct lttng_ust_ring_buffer_ctx *ctx,
 	struct switch_offsets offsets;
 	int ret;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		buf = shmp(handle, chan->backend.buf[ctx_private->reserve_cpu].shmp);
-	else
-		buf = shmp(handle, chan->backend.buf[0].shmp);
+	buf = shmp(handle, chan->backend.buf[ctx_private->reserve_cpu].shmp);
 	if (!buf)
 		return -EIO;
 	ctx_private->buf = buf;
@@ -2382,8 +2621,11 @@ int lib_ring_buffer_reserve_slow(struct lttng_ust_ring_buffer_ctx *ctx,
 	/*
 	 * Populate new subbuffer.
 	 */
-	if (caa_unlikely(offsets.switch_new_start))
+	if (caa_unlikely(offsets.switch_new_start)) {
+		lib_ring_buffer_numa_record_writer(config, buf,
+				subbuf_index(offsets.begin, chan), handle);
 		lib_ring_buffer_switch_new_start(buf, chan, &offsets, ctx_private->tsc, handle);
+	}
 
 	if (caa_unlikely(offsets.switch_new_end))
 		lib_ring_buffer_switch_new_end(buf, chan, &offsets, ctx_private->tsc, handle);
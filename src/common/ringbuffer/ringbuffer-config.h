@@ -108,7 +108,9 @@ struct lttng_ust_ring_buffer_client_cb {
  *   should be disabled in this kind of configuration.
  *
  * RING_BUFFER_ALLOC_GLOBAL and RING_BUFFER_SYNC_GLOBAL :
- *   Global shared buffer with global synchronization.
+ *   Global shared buffer with global synchronization. The buffer can be
+ *   split in lanes, one per stream, with threads spread over the lanes to
+ *   reduce contention on the buffer offset.
  *
  * wakeup:
  *
@@ -19,6 +19,9 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <urcu/uatomic.h>
 
 #ifdef HAVE_LIBNUMA
 #include <numa.h>
@@ -27,6 +30,8 @@
 
 #include <lttng/ust-utils.h>
 
+#include "common/align.h"
+#include "common/bitmap.h"
 #include "common/macros.h"
 #include "common/ust-fd.h"
 #include "common/compat/mmap.h"
@@ -81,21 +86,17 @@ struct shm_object_table *shm_object_table_create(size_t max_nb_obj)
 	return table;
 }
 
+/*
+ * Create the wait pipe of @obj and map @memory_map_size bytes of
+ * @stream_fd, fully allocated. Does not assign the object index.
+ */
 static
-struct shm_object *_shm_object_table_alloc_shm(struct shm_object_table *table,
-					   size_t memory_map_size,
-					   int stream_fd)
+int _shm_object_init_shm(struct shm_object *obj, size_t memory_map_size,
+			int stream_fd)
 {
 	int shmfd, waitfd[2], ret, i;
-	struct shm_object *obj;
 	char *memory_map;
 
-	if (stream_fd < 0)
-		return NULL;
-	if (table->allocated_len >= table->size)
-		return NULL;
-	obj = &table->objects[table->allocated_len];
-
 	/* wait_fd: create pipe */
 	ret = pipe(waitfd);
 	if (ret < 0) {
@@ -163,9 +164,8 @@ struct shm_object *_shm_object_table_alloc_shm(struct shm_object_table *table,
 	obj->memory_map = memory_map;
 	obj->memory_map_size = memory_map_size;
 	obj->allocated_len = 0;
-	obj->index = table->allocated_len++;
 
-	return obj;
+	return 0;
 
 error_mmap:
 error_fsync:
@@ -180,7 +180,46 @@ error_fcntl:
 		}
 	}
 error_pipe:
-	return NULL;
+	return -1;
+}
+
+/* Undo _shm_object_init_shm(). */
+static
+void _shm_object_fini_shm(struct shm_object *obj)
+{
+	int ret, i;
+
+	ret = munmap(obj->memory_map, obj->memory_map_size);
+	if (ret) {
+		PERROR("umnmap");
+		assert(0);
+	}
+	for (i = 0; i < 2; i++) {
+		ret = close(obj->wait_fd[i]);
+		if (ret) {
+			PERROR("close");
+			assert(0);
+		}
+	}
+}
+
+static
+struct shm_object *_shm_object_table_alloc_shm(struct shm_object_table *table,
+					   size_t memory_map_size,
+					   int stream_fd)
+{
+	struct shm_object *obj;
+
+	if (stream_fd < 0)
+		return NULL;
+	if (table->allocated_len >= table->size)
+		return NULL;
+	obj = &table->objects[table->allocated_len];
+	if (_shm_object_init_shm(obj, memory_map_size, stream_fd))
+		return NULL;
+	obj->index = table->allocated_len++;
+
+	return obj;
 }
 
 static
@@ -252,7 +291,7 @@ alloc_error:
  * check whether the kernel supports mempolicy.
  */
 #ifdef HAVE_LIBNUMA
-static bool lttng_is_numa_available(void)
+bool lttng_is_numa_available(void)
 {
 	int ret;
 
@@ -313,6 +352,138 @@ struct shm_object *shm_object_table_alloc(struct shm_object_table *table,
 	return shm_object;
 }
 
+/*
+ * Parallel allocation of per-cpu shm objects. Zeroing the shm file is
+ * what allocates its pages, so each worker moves to the cpu it
+ * allocates for (and prefers its NUMA node) to get first-touch locality.
+ */
+struct shm_alloc_work {
+	struct shm_object *objs;	/* Reserved table slots, one per cpu */
+	size_t memory_map_size;
+	const int *stream_fds;
+	unsigned int nr;
+	unsigned int next;		/* Next cpu to allocate */
+	int nr_errors;
+};
+
+static
+void shm_alloc_move_to_cpu(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t cpuset;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	/* Offline or disallowed cpu: allocate from wherever we run. */
+	(void) pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+#ifdef HAVE_LIBNUMA
+	if (lttng_is_numa_available()) {
+		int node = numa_node_of_cpu(cpu);
+
+		if (node >= 0)
+			numa_set_preferred(node);
+		else
+			numa_set_localalloc();
+	}
+#endif
+}
+
+static
+void *shm_alloc_worker(void *arg)
+{
+	struct shm_alloc_work *work = arg;
+	unsigned int cpu;
+
+	for (;;) {
+		cpu = uatomic_add_return(&work->next, 1) - 1;
+		if (cpu >= work->nr)
+			break;
+		shm_alloc_move_to_cpu(cpu);
+		if (_shm_object_init_shm(&work->objs[cpu],
+				work->memory_map_size, work->stream_fds[cpu]))
+			uatomic_inc(&work->nr_errors);
+	}
+	return NULL;
+}
+
+struct shm_object *shm_object_table_alloc_per_cpu(struct shm_object_table *table,
+			size_t memory_map_size, const int *stream_fds,
+			unsigned int nr)
+{
+	struct shm_alloc_work work = {
+		.memory_map_size = memory_map_size,
+		.stream_fds = stream_fds,
+		.nr = nr,
+	};
+	unsigned int i, nr_workers, nr_started = 0;
+	pthread_t *workers;
+	sigset_t all_set, old_set;
+	long nr_online;
+	int ret;
+
+	if (!nr || table->size - table->allocated_len < nr)
+		return NULL;
+	for (i = 0; i < nr; i++) {
+		if (stream_fds[i] < 0)
+			return NULL;
+	}
+	/* Unused slots are zeroed: memory_map is only set on success. */
+	work.objs = &table->objects[table->allocated_len];
+
+	nr_online = sysconf(_SC_NPROCESSORS_ONLN);
+	nr_workers = min_t(unsigned int, nr, nr_online > 0 ? nr_online : 1);
+	workers = zmalloc(nr_workers * sizeof(*workers));
+	if (workers) {
+		/* Workers must not handle the application signals. */
+		ret = sigfillset(&all_set);
+		assert(!ret);
+		ret = pthread_sigmask(SIG_BLOCK, &all_set, &old_set);
+		assert(!ret);
+		for (i = 0; i < nr_workers; i++) {
+			ret = pthread_create(&workers[nr_started], NULL,
+					shm_alloc_worker, &work);
+			if (ret) {
+				errno = ret;
+				PERROR("pthread_create");
+				break;
+			}
+			nr_started++;
+		}
+		ret = pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+		assert(!ret);
+	}
+	if (!nr_started) {
+		/* Allocate from the current thread, without moving it. */
+		for (i = 0; i < nr; i++) {
+			if (_shm_object_init_shm(&work.objs[i],
+					memory_map_size, stream_fds[i]))
+				work.nr_errors++;
+		}
+	}
+	for (i = 0; i < nr_started; i++) {
+		ret = pthread_join(workers[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join");
+			assert(0);
+		}
+	}
+	free(workers);
+
+	if (work.nr_errors) {
+		for (i = 0; i < nr; i++) {
+			if (work.objs[i].memory_map)
+				_shm_object_fini_shm(&work.objs[i]);
+			memset(&work.objs[i], 0, sizeof(work.objs[i]));
+		}
+		return NULL;
+	}
+	for (i = 0; i < nr; i++)
+		work.objs[i].index = table->allocated_len++;
+	return work.objs;
+}
+
 struct shm_object *shm_object_table_append_shm(struct shm_object_table *table,
 			int shm_fd, int wakeup_fd, uint32_t stream_nr,
 			size_t memory_map_size)
@@ -362,6 +533,109 @@ error_mmap:
 	return NULL;
 }
 
+/*
+ * Split the mapping of @owner into @nr_views views of @stride bytes
+ * following a @header_size header. The first view is the owner itself.
+ */
+static
+int _shm_object_table_pack(struct shm_object_table *table,
+			struct shm_object *owner, unsigned int nr_views,
+			size_t header_size, size_t stride)
+{
+	uint64_t allocated_len;
+	unsigned int i;
+
+	if (table->size - table->allocated_len < nr_views - 1)
+		return -ENOMEM;
+	allocated_len = owner->allocated_len ? stride : 0;
+	owner->packed_map = owner->memory_map;
+	owner->packed_map_size = owner->memory_map_size;
+	owner->packed_nr = nr_views;
+	for (i = 0; i < nr_views; i++) {
+		struct shm_object *obj = owner;
+
+		if (i) {
+			obj = &table->objects[table->allocated_len];
+			obj->type = SHM_OBJECT_VIEW;
+			obj->shm_fd = -1;
+			obj->wait_fd[0] = -1;
+			obj->wait_fd[1] = -1;
+			obj->shm_fd_ownership = 0;
+			obj->owner = owner->index;
+			obj->index = table->allocated_len++;
+		}
+		obj->memory_map = owner->packed_map + header_size + i * stride;
+		obj->memory_map_size = stride;
+		obj->allocated_len = allocated_len;
+	}
+	return 0;
+}
+
+static
+int _shm_packed_layout_check(unsigned int nr_views, size_t header_size,
+			size_t stride, size_t memory_map_size)
+{
+	long page_size = LTTNG_UST_PAGE_SIZE;
+
+	if (page_size <= 0 || !nr_views || !stride)
+		return -EINVAL;
+	if ((header_size | stride) & (page_size - 1))
+		return -EINVAL;
+	if (header_size < lttng_bitmap_nr_longs(nr_views) * sizeof(unsigned long))
+		return -EINVAL;
+	if (header_size > memory_map_size
+			|| stride > (memory_map_size - header_size) / nr_views)
+		return -EINVAL;
+	return 0;
+}
+
+struct shm_object *shm_object_table_alloc_packed(struct shm_object_table *table,
+			size_t view_size, unsigned int nr_views,
+			int stream_fd, size_t *header_size, size_t *stride)
+{
+	struct shm_object *owner;
+	size_t header, view_stride;
+
+	if (!nr_views || table->size - table->allocated_len < nr_views)
+		return NULL;
+	header = LTTNG_UST_PAGE_ALIGN(lttng_bitmap_nr_longs(nr_views)
+			* sizeof(unsigned long));
+	view_stride = LTTNG_UST_PAGE_ALIGN(view_size);
+	if (view_stride > (SIZE_MAX - header) / nr_views)
+		return NULL;
+	owner = _shm_object_table_alloc_shm(table,
+			header + nr_views * view_stride, stream_fd);
+	if (!owner)
+		return NULL;
+	if (_shm_object_table_pack(table, owner, nr_views, header, view_stride))
+		return NULL;	/* Owner released with the table. */
+	*header_size = header;
+	*stride = view_stride;
+	return owner;
+}
+
+struct shm_object *shm_object_table_append_packed(struct shm_object_table *table,
+			int shm_fd, int wakeup_fd, unsigned int nr_views,
+			size_t header_size, size_t stride,
+			size_t memory_map_size)
+{
+	struct shm_object *owner;
+
+	if (_shm_packed_layout_check(nr_views, header_size, stride,
+			memory_map_size))
+		return NULL;
+	if (!table->allocated_len
+			|| table->size - table->allocated_len < nr_views)
+		return NULL;
+	owner = shm_object_table_append_shm(table, shm_fd, wakeup_fd,
+			table->allocated_len - 1, memory_map_size);
+	if (!owner)
+		return NULL;
+	if (_shm_object_table_pack(table, owner, nr_views, header_size, stride))
+		return NULL;
+	return owner;
+}
+
 /*
  * Passing ownership of mem to object.
  */
@@ -412,7 +686,10 @@ void shmp_object_destroy(struct shm_object *obj, int consumer)
 	{
 		int ret, i;
 
-		ret = munmap(obj->memory_map, obj->memory_map_size);
+		if (obj->packed_map)
+			ret = munmap(obj->packed_map, obj->packed_map_size);
+		else
+			ret = munmap(obj->memory_map, obj->memory_map_size);
 		if (ret) {
 			PERROR("umnmap");
 			assert(0);
@@ -489,6 +766,9 @@ void shmp_object_destroy(struct shm_object *obj, int consumer)
 		free(obj->memory_map);
 		break;
 	}
+	case SHM_OBJECT_VIEW:
+		/* Mapping and fds are released by the owner. */
+		break;
 	default:
 		assert(0);
 	}
@@ -7,6 +7,7 @@
 #ifndef _LIBRINGBUFFER_SHM_H
 #define _LIBRINGBUFFER_SHM_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <unistd.h>
@@ -74,6 +75,11 @@ void _set_shmp(struct shm_ref *ref, struct shm_ref src)
 struct shm_object_table *shm_object_table_create(size_t max_nb_obj)
 	__attribute__((visibility("hidden")));
 
+#ifdef HAVE_LIBNUMA
+bool lttng_is_numa_available(void)
+	__attribute__((visibility("hidden")));
+#endif
+
 struct shm_object *shm_object_table_alloc(struct shm_object_table *table,
 			size_t memory_map_size,
 			enum shm_object_type type,
@@ -81,11 +87,39 @@ struct shm_object *shm_object_table_alloc(struct shm_object_table *table,
 			int cpu)
 	__attribute__((visibility("hidden")));
 
+/*
+ * Allocate one shm object per cpu, for cpus 0 to @nr - 1, in parallel.
+ * Returns the object of cpu 0, the others follow it in the table. On
+ * error, NULL is returned and no object is allocated.
+ */
+struct shm_object *shm_object_table_alloc_per_cpu(struct shm_object_table *table,
+			size_t memory_map_size, const int *stream_fds,
+			unsigned int nr)
+	__attribute__((visibility("hidden")));
+
 struct shm_object *shm_object_table_append_shm(struct shm_object_table *table,
 			int shm_fd, int wakeup_fd, uint32_t stream_nr,
 			size_t memory_map_size)
 	__attribute__((visibility("hidden")));
 
+/*
+ * Packed layout: @nr_views buffers of @view_size bytes each within a
+ * single shm object, following a header holding the ready-cpu bitmap.
+ * Returns the object of the first buffer, which owns the mapping. The
+ * header size and the stride between buffers are returned in
+ * @header_size and @stride.
+ */
+struct shm_object *shm_object_table_alloc_packed(struct shm_object_table *table,
+			size_t view_size, unsigned int nr_views,
+			int stream_fd, size_t *header_size, size_t *stride)
+	__attribute__((visibility("hidden")));
+
+struct shm_object *shm_object_table_append_packed(struct shm_object_table *table,
+			int shm_fd, int wakeup_fd, unsigned int nr_views,
+			size_t header_size, size_t stride,
+			size_t memory_map_size)
+	__attribute__((visibility("hidden")));
+
 /* mem ownership is passed to shm_object_table_append_mem(). */
 struct shm_object *shm_object_table_append_mem(struct shm_object_table *table,
 			void *mem, size_t memory_map_size, int wakeup_fd)
@@ -107,6 +141,20 @@ struct shm_ref zalloc_shm(struct shm_object *obj, size_t len)
 void align_shm(struct shm_object *obj, size_t align)
 	__attribute__((visibility("hidden")));
 
+/*
+ * Object holding the file descriptors of the object at @index: views
+ * of a packed object share the fds of their owner.
+ */
+static inline
+struct shm_object *shm_fd_object(struct shm_object_table *table, size_t index)
+{
+	struct shm_object *obj = &table->objects[index];
+
+	if (caa_unlikely(obj->type == SHM_OBJECT_VIEW))
+		obj = &table->objects[obj->owner];
+	return obj;
+}
+
 static inline
 int shm_get_wait_fd(struct lttng_ust_shm_handle *handle, struct shm_ref *ref)
 {
@@ -117,7 +165,7 @@ int shm_get_wait_fd(struct lttng_ust_shm_handle *handle, struct shm_ref *ref)
 	index = (size_t) ref->index;
 	if (caa_unlikely(index >= table->allocated_len))
 		return -EPERM;
-	obj = &table->objects[index];
+	obj = shm_fd_object(table, index);
 	return obj->wait_fd[0];
 }
 
@@ -131,7 +179,7 @@ int shm_get_wakeup_fd(struct lttng_ust_shm_handle *handle, struct shm_ref *ref)
 	index = (size_t) ref->index;
 	if (caa_unlikely(index >= table->allocated_len))
 		return -EPERM;
-	obj = &table->objects[index];
+	obj = shm_fd_object(table, index);
 	return obj->wait_fd[1];
 }
 
@@ -149,6 +197,9 @@ int shm_close_wait_fd(struct lttng_ust_shm_handle *handle,
 	if (caa_unlikely(index >= table->allocated_len))
 		return -EPERM;
 	obj = &table->objects[index];
+	/* Shared fds are closed through the owner. */
+	if (obj->type == SHM_OBJECT_VIEW)
+		return -ENOENT;
 	wait_fd = obj->wait_fd[0];
 	if (wait_fd < 0)
 		return -ENOENT;
@@ -175,6 +226,9 @@ int shm_close_wakeup_fd(struct lttng_ust_shm_handle *handle,
 	if (caa_unlikely(index >= table->allocated_len))
 		return -EPERM;
 	obj = &table->objects[index];
+	/* Shared fds are closed through the owner. */
+	if (obj->type == SHM_OBJECT_VIEW)
+		return -ENOENT;
 	wakeup_fd = obj->wait_fd[1];
 	if (wakeup_fd < 0)
 		return -ENOENT;
@@ -197,7 +251,7 @@ int shm_get_shm_fd(struct lttng_ust_shm_handle *handle, struct shm_ref *ref)
 	index = (size_t) ref->index;
 	if (caa_unlikely(index >= table->allocated_len))
 		return -EPERM;
-	obj = &table->objects[index];
+	obj = shm_fd_object(table, index);
 	return obj->shm_fd;
 }
 
@@ -218,4 +272,48 @@ int shm_get_shm_size(struct lttng_ust_shm_handle *handle, struct shm_ref *ref,
 	return 0;
 }
 
+/*
+ * Size of the whole mapping of a packed object, which covers all its
+ * buffers. Returns -ENOENT if @ref is not within a packed object.
+ */
+static inline
+int shm_get_packed_size(struct lttng_ust_shm_handle *handle, struct shm_ref *ref,
+		uint64_t *size)
+{
+	struct shm_object_table *table = handle->table;
+	struct shm_object *obj;
+	size_t index;
+
+	index = (size_t) ref->index;
+	if (caa_unlikely(index >= table->allocated_len))
+		return -EPERM;
+	obj = shm_fd_object(table, index);
+	if (!obj->packed_map)
+		return -ENOENT;
+	*size = obj->packed_map_size;
+	return 0;
+}
+
+/*
+ * Ready-cpu bitmap at the start of a packed object, one bit per
+ * buffer. Returns NULL if @ref is not within a packed object.
+ */
+static inline
+unsigned long *shm_get_ready_bitmap(struct lttng_ust_shm_handle *handle,
+		struct shm_ref *ref, unsigned int *nr_bits)
+{
+	struct shm_object_table *table = handle->table;
+	struct shm_object *obj;
+	size_t index;
+
+	index = (size_t) ref->index;
+	if (caa_unlikely(index >= table->allocated_len))
+		return NULL;
+	obj = shm_fd_object(table, index);
+	if (!obj->packed_map)
+		return NULL;
+	*nr_bits = obj->packed_nr;
+	return (unsigned long *) obj->packed_map;
+}
+
 #endif /* _LIBRINGBUFFER_SHM_H */
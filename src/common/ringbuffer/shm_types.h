@@ -17,6 +17,7 @@ struct lttng_ust_ring_buffer_channel;
 enum shm_object_type {
 	SHM_OBJECT_SHM,
 	SHM_OBJECT_MEM,
+	SHM_OBJECT_VIEW,	/* Range of a packed object mapping. */
 };
 
 struct shm_object {
@@ -28,6 +29,16 @@ struct shm_object {
 	size_t memory_map_size;
 	uint64_t allocated_len;
 	int shm_fd_ownership;
+	/*
+	 * Packed channels keep all their per-cpu buffers within a single
+	 * mapping. The object of the first buffer owns the shm fd, the
+	 * wait fds and the whole mapping, which starts with the ready-cpu
+	 * bitmap. The other buffers are views referring to their owner.
+	 */
+	size_t owner;		/* Owner object index (views only) */
+	char *packed_map;	/* Whole packed mapping (owner only) */
+	size_t packed_map_size;
+	unsigned int packed_nr;	/* Number of packed buffers (owner only) */
 };
 
 struct shm_object_table {
@@ -36,6 +36,10 @@ enum lttng_client_types {
 	LTTNG_CLIENT_OVERWRITE = 2,
 	LTTNG_CLIENT_DISCARD_RT = 3,
 	LTTNG_CLIENT_OVERWRITE_RT = 4,
+	LTTNG_CLIENT_DISCARD_PER_CHANNEL = 5,
+	LTTNG_CLIENT_OVERWRITE_PER_CHANNEL = 6,
+	LTTNG_CLIENT_DISCARD_PER_CHANNEL_RT = 7,
+	LTTNG_CLIENT_OVERWRITE_PER_CHANNEL_RT = 8,
 	LTTNG_NR_CLIENT_TYPES,
 };
 
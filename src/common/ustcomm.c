@@ -44,6 +44,12 @@ int serialize_fields(struct lttng_ust_session *session,
 		struct lttng_ust_ctl_field *lttng_ust_ctl_fields,
 		size_t *iter_output, size_t nr_lttng_fields,
 		const struct lttng_ust_event_field * const *lttng_fields);
+static
+int serialize_one_type(struct lttng_ust_session *session,
+		struct lttng_ust_ctl_field *fields, size_t *iter_output,
+		const char *field_name, const struct lttng_ust_type_common *lt,
+		enum lttng_ust_string_encoding parent_encoding,
+		const char *prev_field_name);
 
 /*
  * ustcomm_connect_unix_sock
@@ -548,6 +554,24 @@ int ustcomm_recv_app_reply(int sock, struct ustcomm_ust_reply *lur,
 	}
 }
 
+/*
+ * Commands whose reply carries more than a return value, or which send
+ * data after their reply, cannot be part of a command batch.
+ */
+bool ustcomm_batch_cmd_allowed(uint32_t cmd)
+{
+	switch (cmd) {
+	case LTTNG_UST_ABI_TRACER_VERSION:
+	case LTTNG_UST_ABI_TRACEPOINT_LIST_GET:
+	case LTTNG_UST_ABI_TRACEPOINT_FIELD_LIST_GET:
+	case LTTNG_UST_ABI_BATCH_BEGIN:
+	case LTTNG_UST_ABI_BATCH_END:
+		return false;
+	default:
+		return true;
+	}
+}
+
 int ustcomm_send_app_cmd(int sock,
 			struct ustcomm_ust_msg *lum,
 			struct ustcomm_ust_reply *lur)
@@ -835,6 +859,67 @@ int ustcomm_send_reg_msg(int sock,
 	return 0;
 }
 
+/*
+ * Size in bytes of a native structure member type.
+ */
+static
+ssize_t struct_native_member_size(const struct lttng_ust_type_common *lt)
+{
+	switch (lt->type) {
+	case lttng_ust_type_integer:
+		return lttng_ust_get_type_integer(lt)->size / CHAR_BIT;
+	case lttng_ust_type_float:
+	{
+		const struct lttng_ust_type_float *lft = lttng_ust_get_type_float(lt);
+
+		return (lft->exp_dig + lft->mant_dig) / CHAR_BIT;
+	}
+	case lttng_ust_type_array:
+	{
+		const struct lttng_ust_type_array *lat = lttng_ust_get_type_array(lt);
+		ssize_t elem_size;
+
+		elem_size = struct_native_member_size(lat->elem_type);
+		if (elem_size < 0)
+			return elem_size;
+		return elem_size * lat->length;
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Count the areas of a native structure not covered by a member:
+ * padding, omitted members and trailing bytes. Members must be in
+ * increasing offset order, and must not overlap.
+ */
+static
+ssize_t count_struct_native_padding(const struct lttng_ust_type_struct_native *lst)
+{
+	const struct lttng_ust_struct_native_member * const *member;
+	ssize_t nr_padding = 0;
+	size_t cursor = 0;
+
+	for (member = lst->members; *member; member++) {
+		ssize_t size;
+
+		size = struct_native_member_size((*member)->type);
+		if (size < 0)
+			return size;
+		if ((*member)->offset < cursor)
+			return -EINVAL;
+		if ((*member)->offset > cursor)
+			nr_padding++;
+		cursor = (*member)->offset + size;
+	}
+	if (cursor > lst->size)
+		return -EINVAL;
+	if (cursor < lst->size)
+		nr_padding++;
+	return nr_padding;
+}
+
 static
 ssize_t count_one_type(const struct lttng_ust_type_common *lt)
 {
@@ -852,6 +937,24 @@ ssize_t count_one_type(const struct lttng_ust_type_common *lt)
 	case lttng_ust_type_struct:
 		return count_fields_recursive(lttng_ust_get_type_struct(lt)->nr_fields,
 				lttng_ust_get_type_struct(lt)->fields) + 1;
+	case lttng_ust_type_struct_native:
+	{
+		const struct lttng_ust_struct_native_member * const *member;
+		ssize_t ret, count;
+
+		/* Two fields (array and element type) per padding area. */
+		count = count_struct_native_padding(lttng_ust_get_type_struct_native(lt));
+		if (count < 0)
+			return count;
+		count *= 2;
+		for (member = lttng_ust_get_type_struct_native(lt)->members; *member; member++) {
+			ret = count_one_type((*member)->type);
+			if (ret < 0)
+				return ret;
+			count += ret;
+		}
+		return count + 1;
+	}
 
 	case lttng_ust_type_dynamic:
 	{
@@ -1017,6 +1120,100 @@ int serialize_dynamic_type(struct lttng_ust_session *session,
 	return 0;
 }
 
+/*
+ * Describe a padding area of a native structure as an array of bytes.
+ */
+static
+int serialize_struct_native_padding(struct lttng_ust_session *session,
+		struct lttng_ust_ctl_field *fields, size_t *iter_output,
+		size_t offset, size_t len)
+{
+	const struct lttng_ust_type_integer byte_type = {
+		.parent = {
+			.type = lttng_ust_type_integer,
+		},
+		.struct_size = sizeof(struct lttng_ust_type_integer),
+		.size = CHAR_BIT,
+		.alignment = CHAR_BIT,
+		.signedness = 0,
+		.reverse_byte_order = 0,
+		.base = 16,
+	};
+	const struct lttng_ust_type_array padding_type = {
+		.parent = {
+			.type = lttng_ust_type_array,
+		},
+		.struct_size = sizeof(struct lttng_ust_type_array),
+		.elem_type = &byte_type.parent,
+		.length = len,
+		.alignment = 0,
+		.encoding = lttng_ust_string_encoding_none,
+	};
+	char name[LTTNG_UST_ABI_SYM_NAME_LEN];
+
+	snprintf(name, sizeof(name), "_padding_%zu", offset);
+	return serialize_one_type(session, fields, iter_output, name,
+			&padding_type.parent, lttng_ust_string_encoding_none, NULL);
+}
+
+/*
+ * A native structure is described as a structure whose members are
+ * byte-aligned, with explicit padding areas, so the reader finds each
+ * member at its offset within the copied C structure.
+ */
+static
+int serialize_struct_native_type(struct lttng_ust_session *session,
+		struct lttng_ust_ctl_field *fields, size_t *iter_output,
+		const char *field_name,
+		const struct lttng_ust_type_struct_native *lst)
+{
+	const struct lttng_ust_struct_native_member * const *member;
+	struct lttng_ust_ctl_field *uf = &fields[*iter_output];
+	ssize_t nr_padding;
+	size_t nr_members = 0, cursor = 0;
+	int ret;
+
+	nr_padding = count_struct_native_padding(lst);
+	if (nr_padding < 0)
+		return nr_padding;
+	for (member = lst->members; *member; member++)
+		nr_members++;
+
+	if (field_name) {
+		strncpy(uf->name, field_name, LTTNG_UST_ABI_SYM_NAME_LEN);
+		uf->name[LTTNG_UST_ABI_SYM_NAME_LEN - 1] = '\0';
+	} else {
+		uf->name[0] = '\0';
+	}
+	uf->type.atype = lttng_ust_ctl_atype_struct_nestable;
+	uf->type.u.struct_nestable.nr_fields = nr_members + nr_padding;
+	uf->type.u.struct_nestable.alignment = lst->alignment;
+	(*iter_output)++;
+
+	for (member = lst->members; *member; member++) {
+		if ((*member)->offset > cursor) {
+			ret = serialize_struct_native_padding(session, fields,
+					iter_output, cursor,
+					(*member)->offset - cursor);
+			if (ret)
+				return ret;
+		}
+		ret = serialize_one_type(session, fields, iter_output,
+				(*member)->name, (*member)->type,
+				lttng_ust_string_encoding_none, NULL);
+		if (ret)
+			return ret;
+		cursor = (*member)->offset + struct_native_member_size((*member)->type);
+	}
+	if (lst->size > cursor) {
+		ret = serialize_struct_native_padding(session, fields,
+				iter_output, cursor, lst->size - cursor);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
 static
 int serialize_one_type(struct lttng_ust_session *session,
 		struct lttng_ust_ctl_field *fields, size_t *iter_output,
@@ -1181,6 +1378,14 @@ int serialize_one_type(struct lttng_ust_session *session,
 			return -EINVAL;
 		break;
 	}
+	case lttng_ust_type_struct_native:
+	{
+		ret = serialize_struct_native_type(session, fields, iter_output,
+				field_name, lttng_ust_get_type_struct_native(lt));
+		if (ret)
+			return -EINVAL;
+		break;
+	}
 	case lttng_ust_type_enum:
 	{
 		struct lttng_ust_ctl_field *uf = &fields[*iter_output];
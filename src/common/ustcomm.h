@@ -14,6 +14,7 @@
 #ifndef _UST_COMMON_UST_COMM_H
 #define _UST_COMMON_UST_COMM_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <limits.h>
 #include <unistd.h>
@@ -62,14 +63,31 @@ struct lttng_ust_ctl_reg_msg {
 	char padding[LTTNG_UST_COMM_REG_MSG_PADDING];
 } __attribute__((packed));
 
+/*
+ * Command batches (LTTNG_UST_ABI_BATCH_BEGIN/END on the root handle):
+ * the commands in between are tagged 1, 2, 3... in the order they are
+ * sent, and the session daemon does not wait for any reply until
+ * LTTNG_UST_ABI_BATCH_END. The application replies to
+ * LTTNG_UST_ABI_BATCH_END with the number of replies (ret_val),
+ * followed by one struct ustcomm_ust_reply per batched command, in tag
+ * order. Commands which otherwise reply before receiving their payload
+ * do not within a batch.
+ *
+ * Within a batch, a handle with USTCOMM_BATCH_HANDLE_REF set refers to
+ * the object returned by the batched command whose tag is in the low
+ * bits. A command referring to a failed command fails with it.
+ */
+#define USTCOMM_BATCH_HANDLE_REF	(1U << 30)
+
 /*
  * Data structure for the commands sent from sessiond to UST.
  */
-#define USTCOMM_MSG_PADDING1		32
+#define USTCOMM_MSG_PADDING1		28
 #define USTCOMM_MSG_PADDING2		32
 struct ustcomm_ust_msg {
 	uint32_t handle;
 	uint32_t cmd;
+	uint32_t tag;		/* Position within a command batch, 0 otherwise */
 	char padding[USTCOMM_MSG_PADDING1];
 	union {
 		struct lttng_ust_abi_channel channel;
@@ -111,13 +129,14 @@ struct ustcomm_ust_msg {
  * Data structure for the response from UST to the session daemon.
  * cmd_type is sent back in the reply for validation.
  */
-#define USTCOMM_REPLY_PADDING1		32
+#define USTCOMM_REPLY_PADDING1		28
 #define USTCOMM_REPLY_PADDING2		32
 struct ustcomm_ust_reply {
 	uint32_t handle;
 	uint32_t cmd;
 	int32_t ret_code;	/* enum ustcomm_return_code */
 	uint32_t ret_val;	/* return value */
+	uint32_t tag;		/* Tag of the command replied to */
 	char padding[USTCOMM_REPLY_PADDING1];
 	union {
 		struct {
@@ -235,6 +254,9 @@ int ustcomm_recv_app_reply(int sock, struct ustcomm_ust_reply *lur,
 	uint32_t expected_handle, uint32_t expected_cmd)
 	__attribute__((visibility("hidden")));
 
+bool ustcomm_batch_cmd_allowed(uint32_t cmd)
+	__attribute__((visibility("hidden")));
+
 int ustcomm_send_app_cmd(int sock,
 		struct ustcomm_ust_msg *lum,
 		struct ustcomm_ust_reply *lur)
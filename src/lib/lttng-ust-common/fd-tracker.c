@@ -21,9 +21,12 @@
 #include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <poll.h>
+#include <urcu/arch.h>
 #include <urcu/compiler.h>
 #include <urcu/tls-compat.h>
 #include <urcu/system.h>
+#include <urcu/uatomic.h>
 
 #include "common/ust-fd.h"
 #include "common/macros.h"
@@ -70,6 +73,25 @@ static int ust_safe_guard_saved_cancelstate;
  */
 static DEFINE_URCU_TLS(int, ust_fd_mutex_nest);
 
+/*
+ * Lock-free close() fast path. Application threads closing an fd which
+ * is not tracked count themselves in ust_fd_closers for the duration of
+ * the close, and take the ust_safe_guard_fd_mutex only if the fd is
+ * tracked or if ust_fd_tracker_locked is set. The outermost lock of the
+ * tracker sets ust_fd_tracker_locked, then waits for the closers in
+ * flight, so lttng-ust never allocates an fd while an application
+ * thread may close it without seeing it tracked.
+ *
+ * ust_fd_close_nest counts the closers of the current thread, which may
+ * be interrupted by a signal handler taking the tracker lock.
+ */
+static int ust_fd_tracker_locked;
+static unsigned long ust_fd_closers;
+static DEFINE_URCU_TLS(unsigned long, ust_fd_close_nest);
+
+/* Iterations before sleeping while waiting for the closers. */
+#define FD_CLOSERS_SPIN		1000
+
 /* fd_set used to book keep fd being used by lttng-ust. */
 static fd_set *lttng_fd_set;
 static int lttng_ust_max_fd;
@@ -82,6 +104,7 @@ static int init_done;
 void lttng_ust_fd_tracker_alloc_tls(void)
 {
 	asm volatile ("" : : "m" (URCU_TLS(ust_fd_mutex_nest)));
+	asm volatile ("" : : "m" (URCU_TLS(ust_fd_close_nest)));
 }
 
 /*
@@ -123,6 +146,59 @@ void lttng_ust_fd_tracker_init(void)
 	CMM_STORE_SHARED(init_done, 1);
 }
 
+/*
+ * Called with ust_safe_guard_fd_mutex held, signals blocked.
+ */
+static
+void wait_fd_closers(void)
+{
+	unsigned int i = 0;
+
+	CMM_STORE_SHARED(ust_fd_tracker_locked, 1);
+	/* Store ust_fd_tracker_locked before loading ust_fd_closers. */
+	cmm_smp_mb();
+	while (uatomic_read(&ust_fd_closers) != URCU_TLS(ust_fd_close_nest)) {
+		if (++i < FD_CLOSERS_SPIN) {
+			caa_cpu_relax();
+		} else {
+			/* A close() may block, e.g. lingering sockets. */
+			(void) poll(NULL, 0, 1);
+		}
+	}
+}
+
+/*
+ * Enter the close() fast path if @fd is not tracked and the tracker is
+ * not locked. Returns false if the tracker lock is needed instead.
+ * Async-signal-safe.
+ */
+static
+bool fd_close_fast_enter(int fd)
+{
+	URCU_TLS(ust_fd_close_nest)++;
+	/* Implies a full memory barrier, pairs with wait_fd_closers(). */
+	(void) uatomic_add_return(&ust_fd_closers, 1);
+	if (caa_likely(!CMM_LOAD_SHARED(ust_fd_tracker_locked))
+			&& !(IS_FD_VALID(fd) && IS_FD_SET(fd, lttng_fd_set)))
+		return true;
+	(void) uatomic_sub_return(&ust_fd_closers, 1);
+	URCU_TLS(ust_fd_close_nest)--;
+	return false;
+}
+
+/*
+ * Leave the close() fast path. Also runs as cleanup handler when the
+ * thread is cancelled within close(), which is a cancellation point:
+ * wait_fd_closers() would otherwise wait for it forever.
+ */
+static
+void fd_close_fast_exit(void *arg __attribute__((unused)))
+{
+	/* Implies a full memory barrier: the close completes before. */
+	(void) uatomic_sub_return(&ust_fd_closers, 1);
+	URCU_TLS(ust_fd_close_nest)--;
+}
+
 void lttng_ust_lock_fd_tracker(void)
 {
 	sigset_t sig_all_blocked, orig_mask;
@@ -145,6 +221,7 @@ void lttng_ust_lock_fd_tracker(void)
 		cmm_barrier();
 		pthread_mutex_lock(&ust_safe_guard_fd_mutex);
 		ust_safe_guard_saved_cancelstate = oldstate;
+		wait_fd_closers();
 	}
 	ret = pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
 	if (ret) {
@@ -171,6 +248,9 @@ void lttng_ust_unlock_fd_tracker(void)
 	if (!--URCU_TLS(ust_fd_mutex_nest)) {
 		newstate = ust_safe_guard_saved_cancelstate;
 		restore_cancel = true;
+		/* Publish the fd set updates before the fast path resumes. */
+		cmm_smp_mb();
+		CMM_STORE_SHARED(ust_fd_tracker_locked, 0);
 		pthread_mutex_unlock(&ust_safe_guard_fd_mutex);
 	}
 	ret = pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
@@ -338,6 +418,17 @@ int lttng_ust_safe_close_fd(int fd, int (*close_cb)(int fd))
 	if (URCU_TLS(ust_fd_mutex_nest))
 		return close_cb(fd);
 
+	/*
+	 * Closing an fd which is not tracked needs neither the tracker
+	 * lock nor blocking signals.
+	 */
+	if (caa_likely(fd_close_fast_enter(fd))) {
+		pthread_cleanup_push(fd_close_fast_exit, NULL);
+		ret = close_cb(fd);
+		pthread_cleanup_pop(1);
+		return ret;
+	}
+
 	lttng_ust_lock_fd_tracker();
 	if (IS_FD_VALID(fd) && IS_FD_SET(fd, lttng_fd_set)) {
 		ret = -1;
@@ -376,6 +467,13 @@ int lttng_ust_safe_fclose_stream(FILE *stream, int (*fclose_cb)(FILE *stream))
 
 	fd = fileno(stream);
 
+	if (caa_likely(fd_close_fast_enter(fd))) {
+		pthread_cleanup_push(fd_close_fast_exit, NULL);
+		ret = fclose_cb(stream);
+		pthread_cleanup_pop(1);
+		return ret;
+	}
+
 	lttng_ust_lock_fd_tracker();
 	if (IS_FD_VALID(fd) && IS_FD_SET(fd, lttng_fd_set)) {
 		ret = -1;
@@ -35,40 +35,25 @@
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 
-#ifdef __linux__
-static
-void *mremap_wrapper(void *old_address, size_t old_size,
-		size_t new_size, int flags)
-{
-	return mremap(old_address, old_size, new_size, flags);
-}
-#else
-
-#define MREMAP_MAYMOVE	1
-#define MREMAP_FIXED	2
+/* Sleep delay in ms */
+#define RCU_SLEEP_DELAY_MS	10
+#define INIT_NR_THREADS_ORDER	3
+#define INIT_NR_THREADS		(1UL << INIT_NR_THREADS_ORDER)
 
 /*
- * mremap wrapper for non-Linux systems not allowing MAYMOVE.
- * This is not generic.
-*/
-static
-void *mremap_wrapper(void *old_address __attribute__((unused)),
-		size_t old_size __attribute__((unused)),
-		size_t new_size __attribute__((unused)),
-		int flags)
-{
-	assert(!(flags & MREMAP_MAYMOVE));
-
-	return MAP_FAILED;
-}
-#endif
+ * The registry free list head packs a slot index (plus one, 0 meaning
+ * empty) in its low-order bits and an ABA generation counter in its
+ * high-order bits, so it can be updated with a single-word cmpxchg.
+ */
+#define FREE_LIST_INDEX_BITS	(CAA_BITS_PER_LONG >> 1)
+#define FREE_LIST_INDEX_MASK	((1UL << FREE_LIST_INDEX_BITS) - 1)
+#define FREE_LIST_GEN_INC	(1UL << FREE_LIST_INDEX_BITS)
 
-/* Sleep delay in ms */
-#define RCU_SLEEP_DELAY_MS	10
-#define INIT_NR_THREADS		8
-#define ARENA_INIT_ALLOC		\
-	sizeof(struct registry_chunk)	\
-	+ INIT_NR_THREADS * sizeof(struct lttng_ust_urcu_reader)
+/*
+ * Chunk i holds INIT_NR_THREADS << i reader slots, so the total number
+ * of slots stays representable within FREE_LIST_INDEX_BITS.
+ */
+#define ARENA_MAX_CHUNKS	(FREE_LIST_INDEX_BITS - INIT_NR_THREADS_ORDER)
 
 /*
  * Active attempts to check for reader Q.S. before calling sleep().
@@ -111,15 +96,12 @@ int lttng_ust_urcu_has_sys_membarrier;
  */
 static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
 /*
- * rcu_registry_lock ensures mutual exclusion between threads
- * registering and unregistering themselves to/from the registry, and
- * with threads reading that registry from synchronize_rcu(). However,
- * this lock is not held all the way through the completion of awaiting
- * for the grace period. It is sporadically released between iterations
- * on the registry.
- * rcu_registry_lock may nest inside rcu_gp_lock.
+ * Reader registration and unregistration are lock-free. The
+ * registry_arena_lock only serializes the rare arena expansion, and is
+ * held across fork to keep the chunk table coherent in the child.
+ * registry_arena_lock may nest inside rcu_gp_lock.
  */
-static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t registry_arena_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
 static int initialized;
@@ -134,22 +116,19 @@ struct lttng_ust_urcu_gp lttng_ust_urcu_gp = { .ctr = LTTNG_UST_URCU_GP_COUNT };
  */
 DEFINE_URCU_TLS(struct lttng_ust_urcu_reader *, lttng_ust_urcu_reader);
 
-static CDS_LIST_HEAD(registry);
-
-struct registry_chunk {
-	size_t data_len;		/* data length */
-	size_t used;			/* amount of data used */
-	struct cds_list_head node;	/* chunk_list node */
-	char data[];
-};
-
+/*
+ * Reader slots live in chunks which are never moved nor freed while the
+ * library is in use, so readers and synchronize_rcu() can access them
+ * without holding any lock. Chunks are published in order: nr_chunks
+ * is only incremented once the chunk pointer is visible.
+ */
 struct registry_arena {
-	struct cds_list_head chunk_list;
+	struct lttng_ust_urcu_reader *chunks[ARENA_MAX_CHUNKS];
+	unsigned long nr_chunks;
+	unsigned long free_list;	/* Generation | (slot index + 1) */
 };
 
-static struct registry_arena registry_arena = {
-	.chunk_list = CDS_LIST_HEAD_INIT(registry_arena.chunk_list),
-};
+static struct registry_arena registry_arena;
 
 /* Saved fork signal mask, protected by rcu_gp_lock */
 static sigset_t saved_fork_signal_mask;
@@ -190,68 +169,66 @@ static void smp_mb_master(void)
 	}
 }
 
+static
+size_t chunk_nr_slots(unsigned long chunk_index)
+{
+	return INIT_NR_THREADS << chunk_index;
+}
+
+/*
+ * Return whether any registered reader is still within a read-side
+ * critical section which began before the last grace period phase
+ * flip. Slots which are not allocated have a zero ctr and are seen as
+ * inactive.
+ */
+static
+bool registry_has_old_readers(void)
+{
+	unsigned long nr_chunks, i;
+
+	nr_chunks = CMM_LOAD_SHARED(registry_arena.nr_chunks);
+	for (i = 0; i < nr_chunks; i++) {
+		struct lttng_ust_urcu_reader *chunk;
+		size_t j, nr_slots;
+
+		chunk = CMM_LOAD_SHARED(registry_arena.chunks[i]);
+		nr_slots = chunk_nr_slots(i);
+		for (j = 0; j < nr_slots; j++) {
+			if (lttng_ust_urcu_reader_state(&chunk[j].ctr)
+					== LTTNG_UST_URCU_READER_ACTIVE_OLD)
+				return true;
+		}
+	}
+	return false;
+}
+
 /*
- * Always called with rcu_registry lock held. Releases this lock between
- * iterations and grabs it again. Holds the lock when it returns.
+ * Wait for each thread URCU_TLS(lttng_ust_urcu_reader).ctr to either
+ * indicate quiescence (not nested), or observe the current rcu_gp.ctr
+ * value. Readers registering concurrently observe the current rcu_gp.ctr
+ * value on their first read-side critical section.
  */
-static void wait_for_readers(struct cds_list_head *input_readers,
-			struct cds_list_head *cur_snap_readers,
-			struct cds_list_head *qsreaders)
+static
+void wait_for_readers(void)
 {
 	unsigned int wait_loops = 0;
-	struct lttng_ust_urcu_reader *index, *tmp;
 
-	/*
-	 * Wait for each thread URCU_TLS(lttng_ust_urcu_reader).ctr to either
-	 * indicate quiescence (not nested), or observe the current
-	 * rcu_gp.ctr value.
-	 */
 	for (;;) {
 		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
 			wait_loops++;
 
-		cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
-			switch (lttng_ust_urcu_reader_state(&index->ctr)) {
-			case LTTNG_UST_URCU_READER_ACTIVE_CURRENT:
-				if (cur_snap_readers) {
-					cds_list_move(&index->node,
-						cur_snap_readers);
-					break;
-				}
-				/* Fall-through */
-			case LTTNG_UST_URCU_READER_INACTIVE:
-				cds_list_move(&index->node, qsreaders);
-				break;
-			case LTTNG_UST_URCU_READER_ACTIVE_OLD:
-				/*
-				 * Old snapshot. Leaving node in
-				 * input_readers will make us busy-loop
-				 * until the snapshot becomes current or
-				 * the reader becomes inactive.
-				 */
-				break;
-			}
-		}
-
-		if (cds_list_empty(input_readers)) {
+		if (!registry_has_old_readers())
 			break;
-		} else {
-			/* Temporarily unlock the registry lock. */
-			mutex_unlock(&rcu_registry_lock);
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS)
-				(void) poll(NULL, 0, RCU_SLEEP_DELAY_MS);
-			else
-				caa_cpu_relax();
-			/* Re-lock the registry lock before the next loop. */
-			mutex_lock(&rcu_registry_lock);
-		}
+
+		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS)
+			(void) poll(NULL, 0, RCU_SLEEP_DELAY_MS);
+		else
+			caa_cpu_relax();
 	}
 }
 
 void lttng_ust_urcu_synchronize_rcu(void)
 {
-	CDS_LIST_HEAD(cur_snap_readers);
-	CDS_LIST_HEAD(qsreaders);
 	sigset_t newmask, oldmask;
 	int ret;
 
@@ -262,9 +239,7 @@ void lttng_ust_urcu_synchronize_rcu(void)
 
 	mutex_lock(&rcu_gp_lock);
 
-	mutex_lock(&rcu_registry_lock);
-
-	if (cds_list_empty(&registry))
+	if (!CMM_LOAD_SHARED(registry_arena.nr_chunks))
 		goto out;
 
 	/* All threads should read qparity before accessing data structure
@@ -274,10 +249,8 @@ void lttng_ust_urcu_synchronize_rcu(void)
 
 	/*
 	 * Wait for readers to observe original parity or be quiescent.
-	 * wait_for_readers() can release and grab again rcu_registry_lock
-	 * internally.
 	 */
-	wait_for_readers(&registry, &cur_snap_readers, &qsreaders);
+	wait_for_readers();
 
 	/*
 	 * Adding a cmm_smp_mb() which is _not_ formally required, but makes the
@@ -305,15 +278,8 @@ void lttng_ust_urcu_synchronize_rcu(void)
 
 	/*
 	 * Wait for readers to observe new parity or be quiescent.
-	 * wait_for_readers() can release and grab again rcu_registry_lock
-	 * internally.
-	 */
-	wait_for_readers(&cur_snap_readers, NULL, &qsreaders);
-
-	/*
-	 * Put quiescent reader list back into registry.
 	 */
-	cds_list_splice(&qsreaders, &registry);
+	wait_for_readers();
 
 	/*
 	 * Finish waiting for reader threads before letting the old ptr being
@@ -321,7 +287,6 @@ void lttng_ust_urcu_synchronize_rcu(void)
 	 */
 	smp_mb_master();
 out:
-	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 	assert(!ret);
@@ -346,169 +311,229 @@ int lttng_ust_urcu_read_ongoing(void)
 	return _lttng_ust_urcu_read_ongoing();
 }
 
+static
+struct lttng_ust_urcu_reader *slot_from_index(unsigned long index)
+{
+	unsigned long chunk_index, first;
+
+	/*
+	 * Chunk i covers slot indexes starting at
+	 * INIT_NR_THREADS * ((1 << i) - 1).
+	 */
+	chunk_index = (CAA_BITS_PER_LONG - 1)
+		- __builtin_clzl((index >> INIT_NR_THREADS_ORDER) + 1);
+	first = INIT_NR_THREADS * ((1UL << chunk_index) - 1);
+	return &CMM_LOAD_SHARED(registry_arena.chunks[chunk_index])[index - first];
+}
+
 /*
- * Only grow for now. If empty, allocate a ARENA_INIT_ALLOC sized chunk.
- * Else, try expanding the last chunk. If this fails, allocate a new
- * chunk twice as big as the last chunk.
- * Memory used by chunks _never_ moves. A chunk could theoretically be
- * freed when all "used" slots are released, but we don't do it at this
- * point.
+ * Push a chain of slots, linked through their next_free field from
+ * first to last, onto the free list.
  */
 static
-void expand_arena(struct registry_arena *arena)
+void free_list_push(struct lttng_ust_urcu_reader *last,
+		unsigned long first_index)
 {
-	struct registry_chunk *new_chunk, *last_chunk;
-	size_t old_chunk_len, new_chunk_len;
-
-	/* No chunk. */
-	if (cds_list_empty(&arena->chunk_list)) {
-		assert(ARENA_INIT_ALLOC >=
-			sizeof(struct registry_chunk)
-			+ sizeof(struct lttng_ust_urcu_reader));
-		new_chunk_len = ARENA_INIT_ALLOC;
-		new_chunk = (struct registry_chunk *) mmap(NULL,
-			new_chunk_len,
-			PROT_READ | PROT_WRITE,
-			MAP_ANONYMOUS | MAP_PRIVATE,
-			-1, 0);
-		if (new_chunk == MAP_FAILED)
-			abort();
-		memset(new_chunk, 0, new_chunk_len);
-		new_chunk->data_len =
-			new_chunk_len - sizeof(struct registry_chunk);
-		cds_list_add_tail(&new_chunk->node, &arena->chunk_list);
-		return;		/* We're done. */
-	}
+	unsigned long old_head, head;
+
+	head = uatomic_read(&registry_arena.free_list);
+	do {
+		old_head = head;
+		CMM_STORE_SHARED(last->next_free,
+			old_head & FREE_LIST_INDEX_MASK);
+		head = uatomic_cmpxchg(&registry_arena.free_list, old_head,
+			((old_head & ~FREE_LIST_INDEX_MASK) + FREE_LIST_GEN_INC)
+				| (first_index + 1));
+	} while (head != old_head);
+}
 
-	/* Try expanding last chunk. */
-	last_chunk = cds_list_entry(arena->chunk_list.prev,
-		struct registry_chunk, node);
-	old_chunk_len =
-		last_chunk->data_len + sizeof(struct registry_chunk);
-	new_chunk_len = old_chunk_len << 1;
-
-	/* Don't allow memory mapping to move, just expand. */
-	new_chunk = mremap_wrapper(last_chunk, old_chunk_len,
-		new_chunk_len, 0);
-	if (new_chunk != MAP_FAILED) {
-		/* Should not have moved. */
-		assert(new_chunk == last_chunk);
-		memset((char *) last_chunk + old_chunk_len, 0,
-			new_chunk_len - old_chunk_len);
-		last_chunk->data_len =
-			new_chunk_len - sizeof(struct registry_chunk);
-		return;		/* We're done. */
-	}
+/*
+ * Pop a slot from the free list. Slots are never unmapped while the
+ * library is in use, so reading next_free from a slot concurrently
+ * popped by another thread is harmless: the generation counter makes
+ * the cmpxchg fail in that case.
+ */
+static
+struct lttng_ust_urcu_reader *free_list_pop(void)
+{
+	unsigned long old_head, head;
+	struct lttng_ust_urcu_reader *rcu_reader_reg;
+
+	head = uatomic_read(&registry_arena.free_list);
+	do {
+		unsigned long next;
+
+		old_head = head;
+		if (!(old_head & FREE_LIST_INDEX_MASK))
+			return NULL;
+		rcu_reader_reg = slot_from_index((old_head & FREE_LIST_INDEX_MASK) - 1);
+		next = CMM_LOAD_SHARED(rcu_reader_reg->next_free);
+		head = uatomic_cmpxchg(&registry_arena.free_list, old_head,
+			((old_head & ~FREE_LIST_INDEX_MASK) + FREE_LIST_GEN_INC)
+				| next);
+	} while (head != old_head);
+	return rcu_reader_reg;
+}
+
+/*
+ * Only grow. Add a new chunk twice as big as the last chunk and push
+ * all its slots onto the free list. Memory used by chunks _never_
+ * moves, and is only released when the library is unloaded.
+ * Called with signals off and registry_arena_lock held.
+ */
+static
+void expand_arena(struct registry_arena *arena)
+{
+	struct lttng_ust_urcu_reader *new_chunk;
+	unsigned long chunk_index, first;
+	size_t nr_slots, i;
 
-	/* Remap did not succeed, we need to add a new chunk. */
-	new_chunk = (struct registry_chunk *) mmap(NULL,
-		new_chunk_len,
+	chunk_index = arena->nr_chunks;
+	if (chunk_index >= ARENA_MAX_CHUNKS)
+		abort();
+	nr_slots = chunk_nr_slots(chunk_index);
+	new_chunk = (struct lttng_ust_urcu_reader *) mmap(NULL,
+		nr_slots * sizeof(struct lttng_ust_urcu_reader),
 		PROT_READ | PROT_WRITE,
 		MAP_ANONYMOUS | MAP_PRIVATE,
 		-1, 0);
 	if (new_chunk == MAP_FAILED)
 		abort();
-	memset(new_chunk, 0, new_chunk_len);
-	new_chunk->data_len =
-		new_chunk_len - sizeof(struct registry_chunk);
-	cds_list_add_tail(&new_chunk->node, &arena->chunk_list);
+	memset(new_chunk, 0, nr_slots * sizeof(struct lttng_ust_urcu_reader));
+
+	/* Chain the new slots together in index order. */
+	first = INIT_NR_THREADS * ((1UL << chunk_index) - 1);
+	for (i = 0; i < nr_slots - 1; i++)
+		new_chunk[i].next_free = first + i + 2;
+
+	/* Publish the chunk before its slots can be reached. */
+	CMM_STORE_SHARED(arena->chunks[chunk_index], new_chunk);
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(arena->nr_chunks, chunk_index + 1);
+	free_list_push(&new_chunk[nr_slots - 1], first);
 }
 
+/*
+ * Slow path, taken only when the free list is empty. Signals are
+ * blocked so a signal handler nesting a registration cannot deadlock
+ * on registry_arena_lock.
+ */
 static
-struct lttng_ust_urcu_reader *arena_alloc(struct registry_arena *arena)
+struct lttng_ust_urcu_reader *arena_alloc_slow(struct registry_arena *arena)
 {
-	struct registry_chunk *chunk;
 	struct lttng_ust_urcu_reader *rcu_reader_reg;
-	int expand_done = 0;	/* Only allow to expand once per alloc */
-	size_t len = sizeof(struct lttng_ust_urcu_reader);
+	sigset_t newmask, oldmask;
+	int ret;
 
-retry:
-	cds_list_for_each_entry(chunk, &arena->chunk_list, node) {
-		if (chunk->data_len - chunk->used < len)
-			continue;
-		/* Find spot */
-		for (rcu_reader_reg = (struct lttng_ust_urcu_reader *) &chunk->data[0];
-				rcu_reader_reg < (struct lttng_ust_urcu_reader *) &chunk->data[chunk->data_len];
-				rcu_reader_reg++) {
-			if (!rcu_reader_reg->alloc) {
-				rcu_reader_reg->alloc = 1;
-				chunk->used += len;
-				return rcu_reader_reg;
-			}
-		}
-	}
+	ret = sigfillset(&newmask);
+	if (ret)
+		abort();
+	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
+	if (ret)
+		abort();
 
-	if (!expand_done) {
+	mutex_lock(&registry_arena_lock);
+	while (!(rcu_reader_reg = free_list_pop()))
 		expand_arena(arena);
-		expand_done = 1;
-		goto retry;
-	}
+	mutex_unlock(&registry_arena_lock);
 
-	return NULL;
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	if (ret)
+		abort();
+	return rcu_reader_reg;
 }
 
-/* Called with signals off and mutex locked */
 static
-void add_thread(void)
+struct lttng_ust_urcu_reader *arena_alloc(struct registry_arena *arena)
 {
 	struct lttng_ust_urcu_reader *rcu_reader_reg;
-	int ret;
 
-	rcu_reader_reg = arena_alloc(&registry_arena);
-	if (!rcu_reader_reg)
-		abort();
-	ret = pthread_setspecific(lttng_ust_urcu_key, rcu_reader_reg);
-	if (ret)
-		abort();
+	rcu_reader_reg = free_list_pop();
+	if (caa_unlikely(!rcu_reader_reg))
+		rcu_reader_reg = arena_alloc_slow(arena);
+	return rcu_reader_reg;
+}
 
-	/* Add to registry */
-	rcu_reader_reg->tid = pthread_self();
-	assert(rcu_reader_reg->ctr == 0);
-	cds_list_add(&rcu_reader_reg->node, &registry);
-	/*
-	 * Reader threads are pointing to the reader registry. This is
-	 * why its memory should never be relocated.
-	 */
-	URCU_TLS(lttng_ust_urcu_reader) = rcu_reader_reg;
+static
+unsigned long slot_index(unsigned long chunk_index, size_t offset)
+{
+	return INIT_NR_THREADS * ((1UL << chunk_index) - 1) + offset;
 }
 
-/* Called with mutex locked */
 static
-void cleanup_thread(struct registry_chunk *chunk,
+void cleanup_thread(unsigned long index,
 		struct lttng_ust_urcu_reader *rcu_reader_reg)
 {
 	rcu_reader_reg->ctr = 0;
-	cds_list_del(&rcu_reader_reg->node);
 	rcu_reader_reg->tid = 0;
 	rcu_reader_reg->alloc = 0;
-	chunk->used -= sizeof(struct lttng_ust_urcu_reader);
+	free_list_push(rcu_reader_reg, index);
 }
 
 static
-struct registry_chunk *find_chunk(struct lttng_ust_urcu_reader *rcu_reader_reg)
+unsigned long find_slot_index(struct lttng_ust_urcu_reader *rcu_reader_reg)
 {
-	struct registry_chunk *chunk;
+	unsigned long nr_chunks, i;
 
-	cds_list_for_each_entry(chunk, &registry_arena.chunk_list, node) {
-		if (rcu_reader_reg < (struct lttng_ust_urcu_reader *) &chunk->data[0])
+	nr_chunks = CMM_LOAD_SHARED(registry_arena.nr_chunks);
+	for (i = 0; i < nr_chunks; i++) {
+		struct lttng_ust_urcu_reader *chunk;
+
+		chunk = CMM_LOAD_SHARED(registry_arena.chunks[i]);
+		if (rcu_reader_reg < chunk)
 			continue;
-		if (rcu_reader_reg >= (struct lttng_ust_urcu_reader *) &chunk->data[chunk->data_len])
+		if (rcu_reader_reg >= chunk + chunk_nr_slots(i))
 			continue;
-		return chunk;
+		return slot_index(i, rcu_reader_reg - chunk);
 	}
-	return NULL;
+	abort();
 }
 
-/* Called with signals off and mutex locked */
+/*
+ * Take a reference on the library state without init_lock when it is
+ * already initialized.
+ */
 static
-void remove_thread(struct lttng_ust_urcu_reader *rcu_reader_reg)
+bool lttng_ust_urcu_get_fast(void)
 {
-	cleanup_thread(find_chunk(rcu_reader_reg), rcu_reader_reg);
-	URCU_TLS(lttng_ust_urcu_reader) = NULL;
+	int old, ref;
+
+	ref = uatomic_read(&lttng_ust_urcu_refcount);
+	while (ref > 0) {
+		old = ref;
+		ref = uatomic_cmpxchg(&lttng_ust_urcu_refcount, old, old + 1);
+		if (ref == old)
+			return true;
+	}
+	return false;
 }
 
-/* Disable signals, take mutex, add to registry */
-void lttng_ust_urcu_register(void)
+/*
+ * Drop a reference on the library state without init_lock unless it is
+ * the last one.
+ */
+static
+bool lttng_ust_urcu_put_fast(void)
+{
+	int old, ref;
+
+	ref = uatomic_read(&lttng_ust_urcu_refcount);
+	while (ref > 1) {
+		old = ref;
+		ref = uatomic_cmpxchg(&lttng_ust_urcu_refcount, old, old - 1);
+		if (ref == old)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Take the first reference on the library state. Signals are blocked
+ * so a signal handler nesting a registration cannot deadlock on
+ * init_lock.
+ */
+static
+void lttng_ust_urcu_get_slow(void)
 {
 	sigset_t newmask, oldmask;
 	int ret;
@@ -520,23 +545,55 @@ void lttng_ust_urcu_register(void)
 	if (ret)
 		abort();
 
+	_lttng_ust_urcu_init();
+
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	if (ret)
+		abort();
+}
+
+/*
+ * Lock-free: pop a slot from the registry free list and publish it in
+ * TLS. A signal handler may register this thread concurrently, in which
+ * case the slot we popped is given back.
+ */
+void lttng_ust_urcu_register(void)
+{
+	struct lttng_ust_urcu_reader *rcu_reader_reg;
+	int ret;
+
 	/*
 	 * Check if a signal concurrently registered our thread since
 	 * the check in rcu_read_lock().
 	 */
 	if (URCU_TLS(lttng_ust_urcu_reader))
-		goto end;
+		return;
 
 	/*
 	 * Take care of early registration before lttng_ust_urcu constructor.
 	 */
-	_lttng_ust_urcu_init();
+	if (!lttng_ust_urcu_get_fast())
+		lttng_ust_urcu_get_slow();
 
-	mutex_lock(&rcu_registry_lock);
-	add_thread();
-	mutex_unlock(&rcu_registry_lock);
-end:
-	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	rcu_reader_reg = arena_alloc(&registry_arena);
+	if (!rcu_reader_reg)
+		abort();
+	assert(rcu_reader_reg->ctr == 0);
+	rcu_reader_reg->tid = pthread_self();
+	rcu_reader_reg->alloc = 1;
+
+	/*
+	 * Reader threads are pointing to the reader registry. This is
+	 * why its memory should never be relocated.
+	 */
+	if (uatomic_cmpxchg(&URCU_TLS(lttng_ust_urcu_reader), NULL,
+			rcu_reader_reg) != NULL) {
+		/* Registered by a nested signal handler. */
+		cleanup_thread(find_slot_index(rcu_reader_reg), rcu_reader_reg);
+		lttng_ust_urcu_exit();
+		return;
+	}
+	ret = pthread_setspecific(lttng_ust_urcu_key, rcu_reader_reg);
 	if (ret)
 		abort();
 }
@@ -547,26 +604,17 @@ void lttng_ust_urcu_register_thread(void)
 		lttng_ust_urcu_register(); /* If not yet registered. */
 }
 
-/* Disable signals, take mutex, remove from registry */
+/* Lock-free: clear TLS, give the slot back to the free list */
 static
 void lttng_ust_urcu_unregister(struct lttng_ust_urcu_reader *rcu_reader_reg)
 {
-	sigset_t newmask, oldmask;
-	int ret;
-
-	ret = sigfillset(&newmask);
-	if (ret)
-		abort();
-	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
-	if (ret)
-		abort();
-
-	mutex_lock(&rcu_registry_lock);
-	remove_thread(rcu_reader_reg);
-	mutex_unlock(&rcu_registry_lock);
-	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
-	if (ret)
-		abort();
+	/*
+	 * Clear TLS first: a signal handler nested after this point
+	 * registers a new slot rather than using the one being freed.
+	 */
+	URCU_TLS(lttng_ust_urcu_reader) = NULL;
+	cmm_barrier();
+	cleanup_thread(find_slot_index(rcu_reader_reg), rcu_reader_reg);
 	lttng_ust_urcu_exit();
 }
 
@@ -618,7 +666,7 @@ static
 void _lttng_ust_urcu_init(void)
 {
 	mutex_lock(&init_lock);
-	if (!lttng_ust_urcu_refcount++) {
+	if (!uatomic_read(&lttng_ust_urcu_refcount)) {
 		int ret;
 
 		ret = pthread_key_create(&lttng_ust_urcu_key,
@@ -628,34 +676,53 @@ void _lttng_ust_urcu_init(void)
 		lttng_ust_urcu_sys_membarrier_init();
 		initialized = 1;
 	}
+	/* Make initialization visible before lttng_ust_urcu_get_fast(). */
+	cmm_smp_mb();
+	uatomic_inc(&lttng_ust_urcu_refcount);
 	mutex_unlock(&init_lock);
 }
 
 static
 void lttng_ust_urcu_exit(void)
 {
+	sigset_t newmask, oldmask;
+	int ret;
+
+	if (lttng_ust_urcu_put_fast())
+		return;
+
+	/* Same as lttng_ust_urcu_get_slow(), for the last reference. */
+	ret = sigfillset(&newmask);
+	if (ret)
+		abort();
+	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
+	if (ret)
+		abort();
 	mutex_lock(&init_lock);
-	if (!--lttng_ust_urcu_refcount) {
-		struct registry_chunk *chunk, *tmp;
-		int ret;
+	if (!uatomic_sub_return(&lttng_ust_urcu_refcount, 1)) {
+		unsigned long i;
 
-		cds_list_for_each_entry_safe(chunk, tmp,
-				&registry_arena.chunk_list, node) {
-			munmap((void *) chunk, chunk->data_len
-					+ sizeof(struct registry_chunk));
+		for (i = 0; i < registry_arena.nr_chunks; i++) {
+			munmap((void *) registry_arena.chunks[i],
+				chunk_nr_slots(i) * sizeof(struct lttng_ust_urcu_reader));
+			registry_arena.chunks[i] = NULL;
 		}
-		CDS_INIT_LIST_HEAD(&registry_arena.chunk_list);
+		registry_arena.nr_chunks = 0;
+		registry_arena.free_list = 0;
 		ret = pthread_key_delete(lttng_ust_urcu_key);
 		if (ret)
 			abort();
 	}
 	mutex_unlock(&init_lock);
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	if (ret)
+		abort();
 }
 
 /*
- * Holding the rcu_gp_lock and rcu_registry_lock across fork will make
+ * Holding the rcu_gp_lock and registry_arena_lock across fork will make
  * sure we fork() don't race with a concurrent thread executing with
- * any of those locks held. This ensures that the registry and data
+ * any of those locks held. This ensures that the registry arena and data
  * protected by rcu_gp_lock are in a coherent state in the child.
  */
 void lttng_ust_urcu_before_fork(void)
@@ -668,7 +735,7 @@ void lttng_ust_urcu_before_fork(void)
 	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
 	assert(!ret);
 	mutex_lock(&rcu_gp_lock);
-	mutex_lock(&rcu_registry_lock);
+	mutex_lock(&registry_arena_lock);
 	saved_fork_signal_mask = oldmask;
 }
 
@@ -678,7 +745,7 @@ void lttng_ust_urcu_after_fork_parent(void)
 	int ret;
 
 	oldmask = saved_fork_signal_mask;
-	mutex_unlock(&rcu_registry_lock);
+	mutex_unlock(&registry_arena_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 	assert(!ret);
@@ -686,23 +753,26 @@ void lttng_ust_urcu_after_fork_parent(void)
 
 /*
  * Prune all entries from registry except our own thread. Fits the Linux
- * fork behavior. Called with rcu_gp_lock and rcu_registry_lock held.
+ * fork behavior. The free list is rebuilt from scratch, which also
+ * reclaims slots that other threads were pushing or popping when the
+ * fork happened. Called with rcu_gp_lock and registry_arena_lock held.
  */
 static
 void lttng_ust_urcu_prune_registry(void)
 {
-	struct registry_chunk *chunk;
-	struct lttng_ust_urcu_reader *rcu_reader_reg;
+	unsigned long i;
 
-	cds_list_for_each_entry(chunk, &registry_arena.chunk_list, node) {
-		for (rcu_reader_reg = (struct lttng_ust_urcu_reader *) &chunk->data[0];
-				rcu_reader_reg < (struct lttng_ust_urcu_reader *) &chunk->data[chunk->data_len];
-				rcu_reader_reg++) {
-			if (!rcu_reader_reg->alloc)
-				continue;
-			if (rcu_reader_reg->tid == pthread_self())
+	registry_arena.free_list = 0;
+	for (i = registry_arena.nr_chunks; i > 0; i--) {
+		struct lttng_ust_urcu_reader *chunk = registry_arena.chunks[i - 1];
+		size_t j;
+
+		for (j = chunk_nr_slots(i - 1); j > 0; j--) {
+			struct lttng_ust_urcu_reader *rcu_reader_reg = &chunk[j - 1];
+
+			if (rcu_reader_reg == URCU_TLS(lttng_ust_urcu_reader))
 				continue;
-			cleanup_thread(chunk, rcu_reader_reg);
+			cleanup_thread(slot_index(i - 1, j - 1), rcu_reader_reg);
 		}
 	}
 }
@@ -714,7 +784,7 @@ void lttng_ust_urcu_after_fork_child(void)
 
 	lttng_ust_urcu_prune_registry();
 	oldmask = saved_fork_signal_mask;
-	mutex_unlock(&rcu_registry_lock);
+	mutex_unlock(&registry_arena_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 	assert(!ret);
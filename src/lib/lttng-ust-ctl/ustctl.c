@@ -5,6 +5,7 @@
  * Copyright (C) 2011-2013 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
  */
 
+#include <ctype.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -24,6 +25,7 @@
 #include "common/ustcomm.h"
 #include "common/macros.h"
 #include "common/align.h"
+#include "common/bitmap.h"
 
 #include "common/ringbuffer/backend.h"
 #include "common/ringbuffer/frontend.h"
@@ -31,11 +33,13 @@
 #include "common/wait.h"
 #include "common/ringbuffer-clients/clients.h"
 #include "common/getenv.h"
+#include "common/clock.h"
 #include "common/tracer.h"
 #include "common/counter-clients/clients.h"
 
 #include "common/smp.h"
 #include "common/counter/counter.h"
+#include "common/counter/sketch.h"
 
 /*
  * Number of milliseconds to retry before failing metadata writes on
@@ -75,6 +79,9 @@ struct lttng_ust_ctl_counter_attr {
 	int64_t global_sum_step;
 	struct lttng_ust_ctl_counter_dimension dimensions[LTTNG_UST_CTL_COUNTER_ATTR_DIMENSION_MAX];
 	bool coalesce_hits;
+	uint32_t sketch;	/* enum lttng_ust_abi_counter_sketch */
+	struct lib_sketch_config sketch_config;
+	uint32_t profile_period;
 };
 
 /*
@@ -86,6 +93,243 @@ struct lttng_ust_ctl_daemon_counter {
 	struct lttng_ust_ctl_counter_attr *attr;	/* initial attributes */
 };
 
+/*
+ * Command batch opened by the current thread on a socket, see
+ * lttng_ust_ctl_batch_begin().
+ */
+struct ustctl_batch {
+	int sock;
+	uint32_t nr_cmds;		/* Tag of the last batched command */
+	/* Objects whose handle is resolved at batch end */
+	struct lttng_ust_abi_object_data **objects;
+	size_t nr_objects;
+	size_t alloc_objects;
+};
+
+static __thread struct ustctl_batch *ustctl_batch;
+
+static
+struct ustctl_batch *ustctl_get_batch(int sock)
+{
+	if (ustctl_batch && ustctl_batch->sock == sock)
+		return ustctl_batch;
+	return NULL;
+}
+
+static
+int ustctl_send_app_msg(int sock, struct ustcomm_ust_msg *lum)
+{
+	struct ustctl_batch *batch = ustctl_get_batch(sock);
+
+	if (batch) {
+		if (!ustcomm_batch_cmd_allowed(lum->cmd))
+			return -EINVAL;
+		/* Room for the object the command may create. */
+		if (batch->nr_objects == batch->alloc_objects) {
+			size_t new_alloc = max_t(size_t, 2 * batch->alloc_objects, 16);
+			struct lttng_ust_abi_object_data **new_objects;
+
+			new_objects = realloc(batch->objects,
+					new_alloc * sizeof(*new_objects));
+			if (!new_objects)
+				return -ENOMEM;
+			batch->objects = new_objects;
+			batch->alloc_objects = new_alloc;
+		}
+		lum->tag = ++batch->nr_cmds;
+	}
+	return ustcomm_send_app_msg(sock, lum);
+}
+
+/*
+ * Within a batch, the reply is only received by
+ * lttng_ust_ctl_batch_end(): report success, with a reference to the
+ * object the command will return as return value.
+ */
+static
+int ustctl_recv_app_reply(int sock, struct ustcomm_ust_reply *lur,
+		uint32_t expected_handle, uint32_t expected_cmd)
+{
+	struct ustctl_batch *batch = ustctl_get_batch(sock);
+
+	if (!batch)
+		return ustcomm_recv_app_reply(sock, lur, expected_handle,
+				expected_cmd);
+	memset(lur, 0, sizeof(*lur));
+	lur->handle = expected_handle;
+	lur->cmd = expected_cmd;
+	lur->ret_code = LTTNG_UST_OK;
+	lur->ret_val = USTCOMM_BATCH_HANDLE_REF | batch->nr_cmds;
+	lur->tag = batch->nr_cmds;
+	return 0;
+}
+
+static
+int ustctl_send_app_cmd(int sock, struct ustcomm_ust_msg *lum,
+		struct ustcomm_ust_reply *lur)
+{
+	int ret;
+
+	ret = ustctl_send_app_msg(sock, lum);
+	if (ret)
+		return ret;
+	ret = ustctl_recv_app_reply(sock, lur, lum->handle, lum->cmd);
+	if (ret > 0)
+		return -EIO;
+	return ret;
+}
+
+/*
+ * Record an object created within a batch, so that its handle can be
+ * replaced by the actual handle at batch end. Room was reserved when
+ * sending the command.
+ */
+static
+void ustctl_batch_track_object(int sock, struct lttng_ust_abi_object_data *obj)
+{
+	struct ustctl_batch *batch = ustctl_get_batch(sock);
+
+	if (!batch)
+		return;
+	assert(batch->nr_objects < batch->alloc_objects);
+	batch->objects[batch->nr_objects++] = obj;
+}
+
+int lttng_ust_ctl_batch_begin(int sock)
+{
+	struct ustcomm_ust_msg lum;
+	struct ustctl_batch *batch;
+	int ret;
+
+	if (sock < 0)
+		return -EINVAL;
+	if (ustctl_batch)
+		return -EBUSY;
+	batch = zmalloc(sizeof(*batch));
+	if (!batch)
+		return -ENOMEM;
+	batch->sock = sock;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
+	lum.cmd = LTTNG_UST_ABI_BATCH_BEGIN;
+	ret = ustcomm_send_app_msg(sock, &lum);
+	if (ret) {
+		free(batch);
+		return ret;
+	}
+	ustctl_batch = batch;
+	return 0;
+}
+
+static
+const struct lttng_ust_ctl_batch_reply *ustctl_batch_find_reply(
+		const struct lttng_ust_ctl_batch_reply *replies,
+		size_t nr_replies, uint32_t tag)
+{
+	size_t i;
+
+	/* Replies are in tag order, usually one per tag. */
+	i = min_t(size_t, tag, nr_replies);
+	while (i > 0) {
+		const struct lttng_ust_ctl_batch_reply *reply = &replies[--i];
+
+		if (reply->tag > tag)
+			continue;
+		if (reply->tag < tag)
+			break;
+		return reply;
+	}
+	return NULL;
+}
+
+int lttng_ust_ctl_batch_resolve_handle(const struct lttng_ust_ctl_batch_reply *replies,
+		size_t nr_replies, int handle)
+{
+	const struct lttng_ust_ctl_batch_reply *reply;
+
+	if (handle < 0 || !(handle & USTCOMM_BATCH_HANDLE_REF))
+		return handle;
+	reply = ustctl_batch_find_reply(replies, nr_replies,
+			handle & ~USTCOMM_BATCH_HANDLE_REF);
+	if (!reply)
+		return -LTTNG_UST_ERR_NOENT;
+	if (reply->ret_code != LTTNG_UST_OK)
+		return reply->ret_code;
+	return reply->ret_val;
+}
+
+int lttng_ust_ctl_batch_end(int sock, struct lttng_ust_ctl_batch_reply **_replies,
+		size_t *_nr_replies)
+{
+	struct ustctl_batch *batch = ustctl_get_batch(sock);
+	struct lttng_ust_ctl_batch_reply *replies = NULL;
+	struct ustcomm_ust_reply *lurs = NULL;
+	struct ustcomm_ust_msg lum;
+	struct ustcomm_ust_reply lur;
+	size_t nr_replies = 0, i;
+	ssize_t len;
+	int ret;
+
+	if (!batch)
+		return -EINVAL;
+	/* The batch is over even if its replies cannot be received. */
+	ustctl_batch = NULL;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
+	lum.cmd = LTTNG_UST_ABI_BATCH_END;
+	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	if (ret)
+		goto end;
+	nr_replies = lur.ret_val;
+	if (nr_replies > batch->nr_cmds) {
+		ret = -EINVAL;
+		goto end;
+	}
+	if (nr_replies) {
+		lurs = zmalloc(nr_replies * sizeof(*lurs));
+		replies = zmalloc(nr_replies * sizeof(*replies));
+		if (!lurs || !replies) {
+			ret = -ENOMEM;
+			goto end;
+		}
+		len = ustcomm_recv_unix_sock(sock, lurs,
+				nr_replies * sizeof(*lurs));
+		if (len != nr_replies * sizeof(*lurs)) {
+			ret = len < 0 ? len : -EPIPE;
+			goto end;
+		}
+	}
+	for (i = 0; i < nr_replies; i++) {
+		replies[i].tag = lurs[i].tag;
+		replies[i].handle = lurs[i].handle;
+		replies[i].cmd = lurs[i].cmd;
+		replies[i].ret_code = lurs[i].ret_code;
+		replies[i].ret_val = lurs[i].ret_val;
+	}
+end:
+	/* Objects created by failed or unanswered commands get no handle. */
+	for (i = 0; i < batch->nr_objects; i++) {
+		struct lttng_ust_abi_object_data *obj = batch->objects[i];
+		int handle;
+
+		handle = lttng_ust_ctl_batch_resolve_handle(replies,
+				ret ? 0 : nr_replies, obj->handle);
+		obj->handle = handle < 0 ? -1 : handle;
+	}
+	free(batch->objects);
+	free(batch);
+	free(lurs);
+	if (ret) {
+		free(replies);
+		return ret;
+	}
+	*_replies = replies;
+	*_nr_replies = nr_replies;
+	return 0;
+}
+
 /*
  * Evaluates to false if transaction begins, true if it has failed due to SIGBUS.
  * The entire transaction must complete before the current function returns.
@@ -157,7 +401,7 @@ int lttng_ust_ctl_release_handle(int sock, int handle)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = handle;
 	lum.cmd = LTTNG_UST_ABI_RELEASE;
-	return ustcomm_send_app_cmd(sock, &lum, &lur);
+	return ustctl_send_app_cmd(sock, &lum, &lur);
 }
 
 /*
@@ -250,7 +494,7 @@ int lttng_ust_ctl_register_done(int sock)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
 	lum.cmd = LTTNG_UST_ABI_REGISTER_DONE;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	return 0;
@@ -269,7 +513,7 @@ int lttng_ust_ctl_create_session(int sock)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
 	lum.cmd = LTTNG_UST_ABI_SESSION;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	session_handle = lur.ret_val;
@@ -301,12 +545,14 @@ int lttng_ust_ctl_create_event(int sock, struct lttng_ust_abi_event *ev,
 	lum.u.event.instrumentation = ev->instrumentation;
 	lum.u.event.loglevel_type = ev->loglevel_type;
 	lum.u.event.loglevel = ev->loglevel;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	lum.u.event.max_payload_len = ev->max_payload_len;
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret) {
 		free(event_data);
 		return ret;
 	}
 	event_data->handle = lur.ret_val;
+	ustctl_batch_track_object(sock, event_data);
 	DBG("received event handle %u", event_data->handle);
 	*_event_data = event_data;
 	return 0;
@@ -378,7 +624,7 @@ int lttng_ust_ctl_add_context(int sock, struct lttng_ust_context_attr *ctx,
 	default:
 		break;
 	}
-	ret = ustcomm_send_app_msg(sock, &lum);
+	ret = ustctl_send_app_msg(sock, &lum);
 	if (ret)
 		goto end;
 	if (buf) {
@@ -392,7 +638,7 @@ int lttng_ust_ctl_add_context(int sock, struct lttng_ust_context_attr *ctx,
 			goto end;
 		}
 	}
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (ret < 0) {
 		if (ret == -EINVAL) {
 			/*
@@ -441,7 +687,7 @@ int lttng_ust_ctl_set_filter(int sock, struct lttng_ust_abi_filter_bytecode *byt
 	lum.u.filter.reloc_offset = bytecode->reloc_offset;
 	lum.u.filter.seqnum = bytecode->seqnum;
 
-	ret = ustcomm_send_app_msg(sock, &lum);
+	ret = ustctl_send_app_msg(sock, &lum);
 	if (ret)
 		return ret;
 	/* send var len bytecode */
@@ -452,7 +698,7 @@ int lttng_ust_ctl_set_filter(int sock, struct lttng_ust_abi_filter_bytecode *byt
 	}
 	if (ret != bytecode->len)
 		return -EINVAL;
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (ret == -EINVAL) {
 		/*
 		 * Command unknown from remote end. The communication socket is
@@ -488,7 +734,7 @@ int lttng_ust_ctl_set_capture(int sock, struct lttng_ust_abi_capture_bytecode *b
 	lum.u.capture.reloc_offset = bytecode->reloc_offset;
 	lum.u.capture.seqnum = bytecode->seqnum;
 
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	/* send var len bytecode */
@@ -499,7 +745,7 @@ int lttng_ust_ctl_set_capture(int sock, struct lttng_ust_abi_capture_bytecode *b
 	}
 	if (ret != bytecode->len)
 		return -EINVAL;
-	return ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	return ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 }
 
 /*
@@ -529,7 +775,7 @@ int lttng_ust_ctl_set_exclusion(int sock, struct lttng_ust_abi_event_exclusion *
 	lum.cmd = LTTNG_UST_ABI_EXCLUSION;
 	lum.u.exclusion.count = exclusion->count;
 
-	ret = ustcomm_send_app_msg(sock, &lum);
+	ret = ustctl_send_app_msg(sock, &lum);
 	if (ret) {
 		return ret;
 	}
@@ -544,7 +790,7 @@ int lttng_ust_ctl_set_exclusion(int sock, struct lttng_ust_abi_event_exclusion *
 	if (ret != exclusion->count * LTTNG_UST_ABI_SYM_NAME_LEN) {
 		return -EINVAL;
 	}
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (ret == -EINVAL) {
 		/*
 		 * Command unknown from remote end. The communication socket is
@@ -568,7 +814,7 @@ int lttng_ust_ctl_enable(int sock, struct lttng_ust_abi_object_data *object)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = object->handle;
 	lum.cmd = LTTNG_UST_ABI_ENABLE;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	DBG("enabled handle %u", object->handle);
@@ -588,7 +834,7 @@ int lttng_ust_ctl_disable(int sock, struct lttng_ust_abi_object_data *object)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = object->handle;
 	lum.cmd = LTTNG_UST_ABI_DISABLE;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	DBG("disable handle %u", object->handle);
@@ -641,7 +887,7 @@ int lttng_ust_ctl_create_event_notifier_group(int sock, int pipe_fd,
 	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
 	lum.cmd = LTTNG_UST_ABI_EVENT_NOTIFIER_GROUP_CREATE;
 
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		goto error;
 
@@ -652,11 +898,12 @@ int lttng_ust_ctl_create_event_notifier_group(int sock, int pipe_fd,
 		goto error;
 	}
 
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (ret)
 		goto error;
 
 	event_notifier_group_data->handle = lur.ret_val;
+	ustctl_batch_track_object(sock, event_notifier_group_data);
 	DBG("received event_notifier group handle %d", event_notifier_group_data->handle);
 
 	*_event_notifier_group_data = event_notifier_group_data;
@@ -702,7 +949,7 @@ int lttng_ust_ctl_create_event_notifier(int sock, struct lttng_ust_abi_event_not
 	lum.cmd = LTTNG_UST_ABI_EVENT_NOTIFIER_CREATE;
 	lum.u.event_notifier.len = sizeof(*event_notifier);
 
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret) {
 		free(event_notifier_data);
 		return ret;
@@ -716,12 +963,13 @@ int lttng_ust_ctl_create_event_notifier(int sock, struct lttng_ust_abi_event_not
 		else
 			return -EIO;
 	}
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (ret) {
 		free(event_notifier_data);
 		return ret;
 	}
 	event_notifier_data->handle = lur.ret_val;
+	ustctl_batch_track_object(sock, event_notifier_data);
 	DBG("received event_notifier handle %u", event_notifier_data->handle);
 	*_event_notifier_data = event_notifier_data;
 
@@ -737,7 +985,7 @@ int lttng_ust_ctl_tracepoint_list(int sock)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
 	lum.cmd = LTTNG_UST_ABI_TRACEPOINT_LIST;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	tp_list_handle = lur.ret_val;
@@ -758,7 +1006,7 @@ int lttng_ust_ctl_tracepoint_list_get(int sock, int tp_list_handle,
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = tp_list_handle;
 	lum.cmd = LTTNG_UST_ABI_TRACEPOINT_LIST_GET;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	DBG("received tracepoint list entry name %s loglevel %d",
@@ -777,7 +1025,7 @@ int lttng_ust_ctl_tracepoint_field_list(int sock)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
 	lum.cmd = LTTNG_UST_ABI_TRACEPOINT_FIELD_LIST;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	tp_field_list_handle = lur.ret_val;
@@ -799,7 +1047,7 @@ int lttng_ust_ctl_tracepoint_field_list_get(int sock, int tp_field_list_handle,
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = tp_field_list_handle;
 	lum.cmd = LTTNG_UST_ABI_TRACEPOINT_FIELD_LIST_GET;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	len = ustcomm_recv_unix_sock(sock, iter, sizeof(*iter));
@@ -826,7 +1074,7 @@ int lttng_ust_ctl_tracer_version(int sock, struct lttng_ust_abi_tracer_version *
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
 	lum.cmd = LTTNG_UST_ABI_TRACER_VERSION;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	memcpy(v, &lur.u.version, sizeof(*v));
@@ -843,7 +1091,7 @@ int lttng_ust_ctl_wait_quiescent(int sock)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = LTTNG_UST_ABI_ROOT_HANDLE;
 	lum.cmd = LTTNG_UST_ABI_WAIT_QUIESCENT;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	DBG("waited for quiescent state");
@@ -871,7 +1119,7 @@ int lttng_ust_ctl_sock_flush_buffer(int sock, struct lttng_ust_abi_object_data *
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = object->handle;
 	lum.cmd = LTTNG_UST_ABI_FLUSH_BUFFER;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	DBG("flushed buffer handle %u", object->handle);
@@ -1154,7 +1402,7 @@ int lttng_ust_ctl_send_channel_to_ust(int sock, int session_handle,
 	lum.cmd = LTTNG_UST_ABI_CHANNEL;
 	lum.u.channel.len = channel_data->size;
 	lum.u.channel.type = channel_data->u.channel.type;
-	ret = ustcomm_send_app_msg(sock, &lum);
+	ret = ustctl_send_app_msg(sock, &lum);
 	if (ret)
 		return ret;
 
@@ -1166,9 +1414,10 @@ int lttng_ust_ctl_send_channel_to_ust(int sock, int session_handle,
 			1);
 	if (ret)
 		return ret;
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (!ret) {
 		channel_data->handle = lur.ret_val;
+		ustctl_batch_track_object(sock, channel_data);
 	} else if (ret == -EINVAL) {
 		/*
 		 * Command unknown from remote end. The communication socket is
@@ -1203,7 +1452,7 @@ int lttng_ust_ctl_send_stream_to_ust(int sock,
 	lum.cmd = LTTNG_UST_ABI_STREAM;
 	lum.u.stream.len = stream_data->size;
 	lum.u.stream.stream_nr = stream_data->u.stream.stream_nr;
-	ret = ustcomm_send_app_msg(sock, &lum);
+	ret = ustctl_send_app_msg(sock, &lum);
 	if (ret)
 		return ret;
 
@@ -1217,7 +1466,7 @@ int lttng_ust_ctl_send_stream_to_ust(int sock,
 			stream_data->u.stream.wakeup_fd, 1);
 	if (ret)
 		return ret;
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (ret == -EINVAL) {
 		/*
 		 * Command unknown from remote end. The communication socket is
@@ -1395,6 +1644,10 @@ struct lttng_ust_ctl_consumer_channel *
 	const char *transport_name;
 	struct lttng_transport *transport;
 
+	if (attr->clock_source < 0
+			|| attr->clock_source >= NR_LTTNG_UST_ABI_CLOCK_SOURCE)
+		return NULL;
+
 	switch (attr->type) {
 	case LTTNG_UST_ABI_CHAN_PER_CPU:
 		if (attr->output == LTTNG_UST_ABI_MMAP) {
@@ -1415,6 +1668,25 @@ struct lttng_ust_ctl_consumer_channel *
 			return NULL;
 		}
 		break;
+	case LTTNG_UST_ABI_CHAN_PER_CHANNEL:
+		if (attr->output == LTTNG_UST_ABI_MMAP) {
+			if (attr->overwrite) {
+				if (attr->read_timer_interval == 0) {
+					transport_name = "relay-overwrite-per-channel-mmap";
+				} else {
+					transport_name = "relay-overwrite-per-channel-rt-mmap";
+				}
+			} else {
+				if (attr->read_timer_interval == 0) {
+					transport_name = "relay-discard-per-channel-mmap";
+				} else {
+					transport_name = "relay-discard-per-channel-rt-mmap";
+				}
+			}
+		} else {
+			return NULL;
+		}
+		break;
 	case LTTNG_UST_ABI_CHAN_METADATA:
 		if (attr->output == LTTNG_UST_ABI_MMAP)
 			transport_name = "relay-metadata-mmap";
@@ -1443,7 +1715,8 @@ struct lttng_ust_ctl_consumer_channel *
 			attr->read_timer_interval,
 			attr->uuid, attr->chan_id,
 			stream_fds, nr_stream_fds,
-			attr->blocking_timeout);
+			attr->blocking_timeout,
+			attr->clock_source);
 	if (!chan->chan) {
 		goto chan_error;
 	}
@@ -1485,12 +1758,25 @@ int lttng_ust_ctl_send_channel_to_sessiond(int sock,
 int lttng_ust_ctl_send_stream_to_sessiond(int sock,
 		struct lttng_ust_ctl_consumer_stream *stream)
 {
+	struct lttng_ust_ring_buffer_channel *rb_chan;
+	uint64_t memory_map_size;
+
 	if (!stream)
 		return lttng_ust_ctl_send_stream(sock, -1U, -1U, -1, -1, 0);
 
+	memory_map_size = stream->memory_map_size;
+	rb_chan = stream->chan->chan->priv->rb_chan;
+	if (rb_chan->u.s.packed_stride) {
+		/* The first stream carries the whole packed object. */
+		if (stream->cpu != 0)
+			return -EINVAL;
+		if (shm_get_packed_size(rb_chan->handle, &stream->buf->self._ref,
+				&memory_map_size))
+			return -EINVAL;
+	}
 	return lttng_ust_ctl_send_stream(sock,
 			stream->cpu,
-			stream->memory_map_size,
+			memory_map_size,
 			stream->shm_fd, stream->wakeup_fd,
 			0);
 }
@@ -1693,6 +1979,54 @@ int lttng_ust_ctl_channel_get_wakeup_fd(struct lttng_ust_ctl_consumer_channel *c
 		&chan->chan->priv->rb_chan->handle->chan._ref);
 }
 
+static
+int fetch_ready_cpus(unsigned long *ready, unsigned long *bitmap, size_t len)
+{
+	struct lttng_ust_sigbus_range range;
+	size_t i;
+
+	if (sigbus_begin())
+		return -EIO;
+	lttng_ust_sigbus_add_range(&range, ready, len * sizeof(unsigned long));
+	for (i = 0; i < len; i++)
+		bitmap[i] = uatomic_xchg(&ready[i], 0);
+	lttng_ust_sigbus_del_range(&range);
+	sigbus_end();
+	return 0;
+}
+
+int lttng_ust_ctl_channel_get_ready_cpus(struct lttng_ust_ctl_consumer_channel *chan,
+		unsigned long *bitmap, size_t nr_longs)
+{
+	struct lttng_ust_ring_buffer_channel *rb_chan;
+	unsigned long *ready;
+	unsigned int nr_bits;
+	size_t i, len;
+	int ret, nr_ready = 0;
+
+	if (!chan || !bitmap)
+		return -EINVAL;
+	rb_chan = chan->chan->priv->rb_chan;
+	if (!rb_chan->u.s.packed_stride)
+		return -ENOSYS;
+	ready = shm_get_ready_bitmap(rb_chan->handle,
+			&rb_chan->backend.buf[0].shmp._ref, &nr_bits);
+	if (!ready)
+		return -EINVAL;
+	len = lttng_bitmap_nr_longs(nr_bits);
+	if (nr_longs < len)
+		return -EINVAL;
+	ret = fetch_ready_cpus(ready, bitmap, len);
+	if (ret)
+		return ret;
+	for (i = 0; i < nr_longs; i++) {
+		if (i >= len)
+			bitmap[i] = 0;
+		nr_ready += __builtin_popcountl(bitmap[i]);
+	}
+	return nr_ready;
+}
+
 int lttng_ust_ctl_stream_get_wait_fd(struct lttng_ust_ctl_consumer_stream *stream)
 {
 	struct lttng_ust_ring_buffer *buf;
@@ -2292,6 +2626,99 @@ int lttng_ust_ctl_get_current_timestamp(struct lttng_ust_ctl_consumer_stream *st
 	return ret;
 }
 
+static const struct {
+	const char *name;
+	const char *description;
+} clock_source_desc[NR_LTTNG_UST_ABI_CLOCK_SOURCE] = {
+	[LTTNG_UST_ABI_CLOCK_MONOTONIC] = { "monotonic", "Monotonic Clock" },
+	[LTTNG_UST_ABI_CLOCK_MONOTONIC_COARSE] = { "monotonic_coarse", "Coarse Monotonic Clock" },
+	[LTTNG_UST_ABI_CLOCK_MONOTONIC_RAW] = { "monotonic_raw", "Raw Monotonic Clock" },
+};
+
+static
+int clock_source_boot_id(char *uuid)
+{
+	int ret = 0;
+	size_t len;
+	FILE *fp;
+
+	fp = fopen("/proc/sys/kernel/random/boot_id", "r");
+	if (!fp)
+		return -ENOENT;
+	len = fread(uuid, 1, LTTNG_UST_UUID_STR_LEN - 1, fp);
+	if (len < LTTNG_UST_UUID_STR_LEN - 1)
+		ret = -EINVAL;
+	else
+		uuid[LTTNG_UST_UUID_STR_LEN - 1] = '\0';
+	fclose(fp);
+	return ret;
+}
+
+/*
+ * The monotonic clock has the boot id as uuid, as the default trace
+ * clock reading it. The coarse and raw monotonic clocks, which do not
+ * share its time base, derive distinct uuids from the boot id by
+ * flipping bits of its last digit with the clock source number.
+ */
+static
+int clock_source_uuid(int32_t clock_source, char *uuid)
+{
+	static const char digits[] = "0123456789abcdef";
+	char *last = &uuid[LTTNG_UST_UUID_STR_LEN - 2];
+	const char *digit;
+	int ret;
+
+	ret = clock_source_boot_id(uuid);
+	if (ret || clock_source == LTTNG_UST_ABI_CLOCK_MONOTONIC)
+		return ret;
+	digit = *last ? strchr(digits, tolower((unsigned char) *last)) : NULL;
+	if (!digit)
+		return -EINVAL;
+	*last = digits[(digit - digits) ^ clock_source];
+	return 0;
+}
+
+int lttng_ust_ctl_get_clock_description(int32_t clock_source,
+		const char **name, const char **description,
+		uint64_t *freq, char *uuid)
+{
+	if (!name || !description || !freq || !uuid)
+		return -EINVAL;
+	if (clock_source < 0 || clock_source >= NR_LTTNG_UST_ABI_CLOCK_SOURCE)
+		return -EINVAL;
+	if (clock_source == LTTNG_UST_ABI_CLOCK_DEFAULT) {
+		lttng_ust_clock_name_function name_cb;
+		lttng_ust_clock_description_function description_cb;
+		lttng_ust_clock_freq_function freq_cb;
+		lttng_ust_clock_uuid_function uuid_cb;
+
+		lttng_ust_trace_clock_get_name_cb(&name_cb);
+		lttng_ust_trace_clock_get_description_cb(&description_cb);
+		lttng_ust_trace_clock_get_freq_cb(&freq_cb);
+		lttng_ust_trace_clock_get_uuid_cb(&uuid_cb);
+		*name = name_cb();
+		*description = description_cb();
+		*freq = freq_cb();
+		if (!uuid_cb)
+			return clock_source_boot_id(uuid);
+		return uuid_cb(uuid);
+	}
+	*name = clock_source_desc[clock_source].name;
+	*description = clock_source_desc[clock_source].description;
+	*freq = 1000000000ULL;
+	return clock_source_uuid(clock_source, uuid);
+}
+
+int lttng_ust_ctl_clock_read(int32_t clock_source, uint64_t *ts)
+{
+	if (!ts)
+		return -EINVAL;
+	if (clock_source < 0 || clock_source >= NR_LTTNG_UST_ABI_CLOCK_SOURCE)
+		return -EINVAL;
+	*ts = trace_clock_read64_source(clock_source);
+	return 0;
+}
+
 int lttng_ust_ctl_get_sequence_number(struct lttng_ust_ctl_consumer_stream *stream,
 		uint64_t *seq)
 {
@@ -2344,6 +2771,29 @@ int lttng_ust_ctl_get_instance_id(struct lttng_ust_ctl_consumer_stream *stream,
 	return ret;
 }
 
+int lttng_ust_ctl_get_numa_subbuf(struct lttng_ust_ctl_consumer_stream *stream,
+		uint64_t *local, uint64_t *remote, uint64_t *moved)
+{
+	struct lttng_ust_ring_buffer_channel *chan;
+	struct lttng_ust_ring_buffer *buf;
+	struct lttng_ust_sigbus_range range;
+
+	if (!stream || !local || !remote || !moved)
+		return -EINVAL;
+	buf = stream->buf;
+	chan = stream->chan->chan->priv->rb_chan;
+	if (sigbus_begin())
+		return -EIO;
+	lttng_ust_sigbus_add_range(&range, stream->memory_map_addr,
+				stream->memory_map_size);
+	*local = lib_ring_buffer_get_numa_subbuf_local(&chan->backend.config, buf);
+	*remote = lib_ring_buffer_get_numa_subbuf_remote(&chan->backend.config, buf);
+	*moved = lib_ring_buffer_get_numa_subbuf_moved(&chan->backend.config, buf);
+	lttng_ust_sigbus_del_range(&range);
+	sigbus_end();
+	return 0;
+}
+
 #ifdef HAVE_LINUX_PERF_EVENT_H
 
 int lttng_ust_ctl_has_perf_counters(void)
@@ -2893,7 +3343,7 @@ int lttng_ust_ctl_regenerate_statedump(int sock, int handle)
 	memset(&lum, 0, sizeof(lum));
 	lum.handle = handle;
 	lum.cmd = LTTNG_UST_ABI_SESSION_STATEDUMP;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 	DBG("Regenerated statedump for handle %u", handle);
@@ -3009,6 +3459,80 @@ free_counter:
 	return NULL;
 }
 
+struct lttng_ust_ctl_daemon_counter *
+	lttng_ust_ctl_create_sketch_counter(size_t nr_sketches,
+		enum lttng_ust_ctl_counter_sketch sketch,
+		uint32_t depth, uint32_t width, uint32_t top_k,
+		int nr_counter_cpu_fds,
+		const int *counter_cpu_fds)
+{
+	struct lttng_ust_ctl_counter_dimension dimensions[2] = { 0 };
+	struct lttng_ust_ctl_daemon_counter *counter;
+	struct lib_sketch_config config;
+
+	switch (sketch) {
+	case LTTNG_UST_CTL_COUNTER_SKETCH_COUNT_MIN:
+		config.type = LIB_SKETCH_COUNT_MIN;
+		break;
+	case LTTNG_UST_CTL_COUNTER_SKETCH_HYPERLOGLOG:
+		config.type = LIB_SKETCH_HYPERLOGLOG;
+		break;
+	default:
+		return NULL;
+	}
+	config.depth = depth;
+	config.width = width;
+	config.top_k = top_k;
+	if (lttng_sketch_validate_config(&config))
+		return NULL;
+
+	dimensions[0].size = nr_sketches;
+	dimensions[1].size = lttng_sketch_get_nr_elem(&config);
+	counter = lttng_ust_ctl_create_counter(2, dimensions, 0, -1,
+		nr_counter_cpu_fds, counter_cpu_fds,
+		LTTNG_UST_CTL_COUNTER_BITNESS_64,
+		LTTNG_UST_CTL_COUNTER_ARITHMETIC_MODULAR,
+		LTTNG_UST_CTL_COUNTER_ALLOC_PER_CPU, false);
+	if (!counter)
+		return NULL;
+	switch (sketch) {
+	case LTTNG_UST_CTL_COUNTER_SKETCH_COUNT_MIN:
+		counter->attr->sketch = LTTNG_UST_ABI_COUNTER_SKETCH_COUNT_MIN;
+		break;
+	case LTTNG_UST_CTL_COUNTER_SKETCH_HYPERLOGLOG:
+		counter->attr->sketch = LTTNG_UST_ABI_COUNTER_SKETCH_HYPERLOGLOG;
+		break;
+	}
+	counter->attr->sketch_config = config;
+	return counter;
+}
+
+struct lttng_ust_ctl_daemon_counter *
+	lttng_ust_ctl_create_profile_counter(size_t nr_channels,
+		size_t nr_events, size_t nr_buckets, uint32_t period,
+		int nr_counter_cpu_fds,
+		const int *counter_cpu_fds)
+{
+	struct lttng_ust_ctl_counter_dimension dimensions[4] = { 0 };
+	struct lttng_ust_ctl_daemon_counter *counter;
+
+	if (!period || !nr_buckets)
+		return NULL;
+	dimensions[0].size = nr_channels;
+	dimensions[1].size = nr_events;
+	dimensions[2].size = NR_LTTNG_UST_ABI_PROFILE_STAGE;
+	dimensions[3].size = nr_buckets;
+	counter = lttng_ust_ctl_create_counter(4, dimensions, 0, -1,
+		nr_counter_cpu_fds, counter_cpu_fds,
+		LTTNG_UST_CTL_COUNTER_BITNESS_64,
+		LTTNG_UST_CTL_COUNTER_ARITHMETIC_MODULAR,
+		LTTNG_UST_CTL_COUNTER_ALLOC_PER_CPU, false);
+	if (!counter)
+		return NULL;
+	counter->attr->profile_period = period;
+	return counter;
+}
+
 int lttng_ust_ctl_create_counter_data(struct lttng_ust_ctl_daemon_counter *counter,
 		struct lttng_ust_abi_object_data **_counter_data)
 {
@@ -3040,6 +3564,13 @@ int lttng_ust_ctl_create_counter_data(struct lttng_ust_ctl_daemon_counter *count
 	counter_conf.number_dimensions = counter->attr->nr_dimensions;
 	counter_conf.global_sum_step = counter->attr->global_sum_step;
 	counter_conf.coalesce_hits = counter->attr->coalesce_hits;
+	if (counter->attr->sketch != LTTNG_UST_ABI_COUNTER_SKETCH_NONE) {
+		counter_conf.sketch = counter->attr->sketch;
+		counter_conf.sketch_depth = counter->attr->sketch_config.depth;
+		counter_conf.sketch_width = counter->attr->sketch_config.width;
+		counter_conf.sketch_top_k = counter->attr->sketch_config.top_k;
+	}
+	counter_conf.profile_period = counter->attr->profile_period;
 	for (i = 0; i < counter->attr->nr_dimensions; i++) {
 		counter_conf.dimensions[i].size = counter->attr->dimensions[i].size;
 		counter_conf.dimensions[i].underflow_index = counter->attr->dimensions[i].underflow_index;
@@ -3157,7 +3688,7 @@ int lttng_ust_ctl_send_counter_data_to_ust(int sock, int parent_handle,
 	lum.handle = parent_handle;
 	lum.cmd = LTTNG_UST_ABI_COUNTER;
 	lum.u.counter.len = size;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 
@@ -3170,9 +3701,10 @@ int lttng_ust_ctl_send_counter_data_to_ust(int sock, int parent_handle,
 			return -EIO;
 	}
 
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (!ret) {
 		counter_data->handle = lur.ret_val;
+		ustctl_batch_track_object(sock, counter_data);
 	}
 	return ret;
 }
@@ -3203,7 +3735,7 @@ int lttng_ust_ctl_send_counter_global_data_to_ust(int sock,
 	lum.handle = counter_data->handle;	/* parent handle */
 	lum.cmd = LTTNG_UST_ABI_COUNTER_GLOBAL;
 	lum.u.counter_global.len = size;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 
@@ -3216,9 +3748,10 @@ int lttng_ust_ctl_send_counter_global_data_to_ust(int sock,
 			return -EIO;
 	}
 
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (!ret) {
 		counter_global_data->handle = lur.ret_val;
+		ustctl_batch_track_object(sock, counter_global_data);
 	}
 	return ret;
 }
@@ -3250,7 +3783,7 @@ int lttng_ust_ctl_send_counter_cpu_data_to_ust(int sock,
 	lum.cmd = LTTNG_UST_ABI_COUNTER_CPU;
 	lum.u.counter_cpu.len = size;
 	lum.u.counter_cpu.cpu_nr = counter_cpu_data->u.counter_cpu.cpu_nr;
-	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	ret = ustctl_send_app_cmd(sock, &lum, &lur);
 	if (ret)
 		return ret;
 
@@ -3263,9 +3796,10 @@ int lttng_ust_ctl_send_counter_cpu_data_to_ust(int sock,
 			return -EIO;
 	}
 
-	ret = ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
+	ret = ustctl_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 	if (!ret) {
 		counter_cpu_data->handle = lur.ret_val;
+		ustctl_batch_track_object(sock, counter_cpu_data);
 	}
 	return ret;
 }
@@ -3294,6 +3828,64 @@ int lttng_ust_ctl_counter_clear(struct lttng_ust_ctl_daemon_counter *counter,
 	return counter->ops->counter_clear(counter->counter, dimension_indexes);
 }
 
+int lttng_ust_ctl_sketch_estimate(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index, const void *key, size_t key_len,
+		uint64_t *count)
+{
+	if (counter->attr->sketch == LTTNG_UST_ABI_COUNTER_SKETCH_NONE)
+		return -EINVAL;
+	return lttng_sketch_estimate(&counter->attr->sketch_config, counter->counter,
+			sketch_index, key, key_len, count);
+}
+
+int lttng_ust_ctl_sketch_top_k(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index, struct lttng_ust_ctl_sketch_entry *entries,
+		size_t *nr_entries)
+{
+	struct lib_sketch_entry *sketch_entries;
+	size_t i;
+	int ret;
+
+	if (counter->attr->sketch == LTTNG_UST_ABI_COUNTER_SKETCH_NONE)
+		return -EINVAL;
+	if (!*nr_entries)
+		return 0;
+	sketch_entries = zmalloc(sizeof(*sketch_entries) * *nr_entries);
+	if (!sketch_entries)
+		return -ENOMEM;
+	ret = lttng_sketch_top_k(&counter->attr->sketch_config, counter->counter,
+			sketch_index, sketch_entries, nr_entries);
+	if (ret)
+		goto end;
+	for (i = 0; i < *nr_entries; i++) {
+		entries[i].count = sketch_entries[i].count;
+		entries[i].key_len = sketch_entries[i].key_len;
+		memcpy(entries[i].key, sketch_entries[i].key,
+			min_t(size_t, sketch_entries[i].key_len, LTTNG_UST_CTL_SKETCH_KEY_LEN));
+	}
+end:
+	free(sketch_entries);
+	return ret;
+}
+
+int lttng_ust_ctl_sketch_cardinality(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index, uint64_t *value)
+{
+	if (counter->attr->sketch == LTTNG_UST_ABI_COUNTER_SKETCH_NONE)
+		return -EINVAL;
+	return lttng_sketch_cardinality(&counter->attr->sketch_config, counter->counter,
+			sketch_index, value);
+}
+
+int lttng_ust_ctl_sketch_clear(struct lttng_ust_ctl_daemon_counter *counter,
+		size_t sketch_index)
+{
+	if (counter->attr->sketch == LTTNG_UST_ABI_COUNTER_SKETCH_NONE)
+		return -EINVAL;
+	return lttng_sketch_clear(&counter->attr->sketch_config, counter->counter,
+			sketch_index);
+}
+
 static
 void lttng_ust_ctl_ctor(void)
 	__attribute__((constructor));
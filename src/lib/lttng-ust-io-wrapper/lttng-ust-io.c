@@ -0,0 +1,931 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ * I/O system call wrappers.
+ *
+ * Each wrapped call emits its lttng_ust_io event when it is enabled.
+ * When LTTNG_UST_IO_AGGREGATE is set, the latency of each call is also
+ * accounted in per-cpu histograms kept in private memory, indexed by
+ * file descriptor and system call, which a flush thread turns into
+ * lttng_ust_io:latency_summary events periodically and at exit.
+ */
+
+/*
+ * Do _not_ define _LGPL_SOURCE because we don't want to create a
+ * circular dependency loop between this wrapper, liburcu and libc.
+ */
+
+/* Has to be included first to override dlfcn.h */
+#include <common/compat/dlfcn.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/clock.h"
+#include "common/counter/counter.h"
+#include "common/counter/counter-api.h"
+#include "common/getenv.h"
+#include "common/logging.h"
+#include "common/macros.h"
+
+#define LTTNG_UST_TRACEPOINT_HIDDEN_DEFINITION
+#define LTTNG_UST_TRACEPOINT_PROVIDER_HIDDEN_DEFINITION
+
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#define LTTNG_UST_TP_IP_PARAM ip
+#include "ust_io.h"
+
+#define IO_DEFAULT_MAX_FD		64
+#define IO_MAX_MAX_FD			4096
+#define IO_DEFAULT_FLUSH_PERIOD		1000	/* ms */
+
+/* Histogram bucket n counts latencies below 2^(n + IO_BUCKET_SHIFT) ns. */
+#define IO_BUCKET_SHIFT			9
+
+enum io_syscall {
+	IO_SYSCALL_READ,
+	IO_SYSCALL_WRITE,
+	IO_SYSCALL_PREAD,
+	IO_SYSCALL_PWRITE,
+	IO_SYSCALL_READV,
+	IO_SYSCALL_WRITEV,
+	IO_SYSCALL_RECV,
+	IO_SYSCALL_SEND,
+	IO_SYSCALL_RECVFROM,
+	IO_SYSCALL_SENDTO,
+	IO_SYSCALL_RECVMSG,
+	IO_SYSCALL_SENDMSG,
+	IO_SYSCALL_FSYNC,
+	IO_SYSCALL_FDATASYNC,
+
+	NR_IO_SYSCALL,
+};
+
+static const char *io_syscall_names[NR_IO_SYSCALL] = {
+	[IO_SYSCALL_READ] = "read",
+	[IO_SYSCALL_WRITE] = "write",
+	[IO_SYSCALL_PREAD] = "pread",
+	[IO_SYSCALL_PWRITE] = "pwrite",
+	[IO_SYSCALL_READV] = "readv",
+	[IO_SYSCALL_WRITEV] = "writev",
+	[IO_SYSCALL_RECV] = "recv",
+	[IO_SYSCALL_SEND] = "send",
+	[IO_SYSCALL_RECVFROM] = "recvfrom",
+	[IO_SYSCALL_SENDTO] = "sendto",
+	[IO_SYSCALL_RECVMSG] = "recvmsg",
+	[IO_SYSCALL_SENDMSG] = "sendmsg",
+	[IO_SYSCALL_FSYNC] = "fsync",
+	[IO_SYSCALL_FDATASYNC] = "fdatasync",
+};
+
+/*
+ * Counter dimensions: file descriptor slot, system call, and column.
+ * The last file descriptor slot gathers all the file descriptors above
+ * the tracked ones.
+ */
+enum io_column {
+	IO_COLUMN_COUNT,
+	IO_COLUMN_TOTAL,
+	IO_COLUMN_HIST,
+
+	NR_IO_COLUMN = IO_COLUMN_HIST + LTTNG_UST_IO_NR_BUCKETS,
+};
+
+#define IO_NR_DIMENSIONS	3
+
+static const struct lib_counter_config io_counter_config = {
+	.alloc = COUNTER_ALLOC_PER_CPU,
+	.sync = COUNTER_SYNC_PER_CPU,
+	.arithmetic = COUNTER_ARITHMETIC_MODULAR,
+	.counter_size = COUNTER_SIZE_64_BIT,
+	.mem = COUNTER_MEM_PRIVATE,
+};
+
+static struct lib_counter *io_counter;
+static size_t io_nr_fd_slots;
+/* Aggregated values at the previous flush, by counter element. */
+static uint64_t *io_flushed;
+
+static pthread_t io_flush_thread;
+static bool io_flush_thread_started;
+static pthread_mutex_t io_flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t io_flush_cond;
+static bool io_flush_quit;
+static long io_flush_period;
+
+static __thread int thread_in_trace;
+
+struct io_call {
+	uint64_t start;
+	int saved_errno;
+};
+
+/* Declared by libc only when building with _FORTIFY_SOURCE. */
+ssize_t __read_chk(int fd, void *buf, size_t count, size_t buflen);
+ssize_t __pread_chk(int fd, void *buf, size_t count, off_t offset,
+		size_t buflen);
+ssize_t __pread64_chk(int fd, void *buf, size_t count, off64_t offset,
+		size_t buflen);
+ssize_t __recv_chk(int fd, void *buf, size_t len, size_t buflen, int flags);
+ssize_t __recvfrom_chk(int fd, void *buf, size_t len, size_t buflen,
+		int flags, struct sockaddr *src_addr, socklen_t *addrlen);
+
+static
+void *io_lookup(const char *name)
+{
+	void *func;
+
+	func = dlsym(RTLD_NEXT, name);
+	if (!func) {
+		if (thread_in_trace) {
+			abort();
+		}
+		fprintf(stderr, "unable to initialize I/O wrapper library.\n");
+	}
+	return func;
+}
+
+static
+size_t io_fd_slot(int fd)
+{
+	if (fd < 0 || (size_t) fd >= io_nr_fd_slots - 1)
+		return io_nr_fd_slots - 1;
+	return fd;
+}
+
+static
+size_t io_latency_bucket(uint64_t latency)
+{
+	uint64_t v = latency >> IO_BUCKET_SHIFT;
+	size_t bucket;
+
+	if (!v)
+		return 0;
+	bucket = 64 - __builtin_clzll(v);
+	return min_t(size_t, bucket, LTTNG_UST_IO_NR_BUCKETS - 1);
+}
+
+static
+void io_account(struct lib_counter *counter, enum io_syscall syscall,
+		int fd, uint64_t latency)
+{
+	size_t indexes[IO_NR_DIMENSIONS] = {
+		io_fd_slot(fd), syscall, IO_COLUMN_COUNT,
+	};
+
+	(void) lttng_counter_inc(&io_counter_config, counter, indexes);
+	indexes[2] = IO_COLUMN_TOTAL;
+	(void) lttng_counter_add(&io_counter_config, counter, indexes,
+			(int64_t) latency);
+	indexes[2] = IO_COLUMN_HIST + io_latency_bucket(latency);
+	(void) lttng_counter_inc(&io_counter_config, counter, indexes);
+}
+
+/*
+ * Start timing a call when its event is enabled or when latencies are
+ * aggregated, unless the call comes from the tracer itself.
+ */
+static inline
+bool io_begin(bool event_enabled, struct io_call *call)
+{
+	if (thread_in_trace)
+		return false;
+	if (!event_enabled && !CMM_LOAD_SHARED(io_counter))
+		return false;
+	thread_in_trace = 1;
+	call->start = trace_clock_read64_monotonic();
+	return true;
+}
+
+static inline
+uint64_t io_end(enum io_syscall syscall, int fd, struct io_call *call)
+{
+	struct lib_counter *counter;
+	uint64_t latency;
+
+	call->saved_errno = errno;
+	latency = trace_clock_read64_monotonic() - call->start;
+	counter = CMM_LOAD_SHARED(io_counter);
+	if (counter)
+		io_account(counter, syscall, fd, latency);
+	return latency;
+}
+
+static inline
+void io_exit(struct io_call *call)
+{
+	thread_in_trace = 0;
+	errno = call->saved_errno;
+}
+
+static
+size_t io_iov_len(const struct iovec *iov, int iovcnt)
+{
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+	return len;
+}
+
+static
+size_t io_msg_len(const struct msghdr *msg)
+{
+	if (!msg)
+		return 0;
+	return io_iov_len(msg->msg_iov, msg->msg_iovlen);
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("read"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, read), &call))
+		return plibc_func(fd, buf, count);
+	ret = plibc_func(fd, buf, count);
+	latency = io_end(IO_SYSCALL_READ, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, read, fd, count, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+	static ssize_t (*plibc_func)(int, const void *, size_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("write"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, write), &call))
+		return plibc_func(fd, buf, count);
+	ret = plibc_func(fd, buf, count);
+	latency = io_end(IO_SYSCALL_WRITE, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, write, fd, count, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, off_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("pread"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, pread), &call))
+		return plibc_func(fd, buf, count, offset);
+	ret = plibc_func(fd, buf, count, offset);
+	latency = io_end(IO_SYSCALL_PREAD, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, pread, fd, count, offset, ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off64_t offset)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, off64_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("pread64"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, pread), &call))
+		return plibc_func(fd, buf, count, offset);
+	ret = plibc_func(fd, buf, count, offset);
+	latency = io_end(IO_SYSCALL_PREAD, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, pread, fd, count, offset, ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+	static ssize_t (*plibc_func)(int, const void *, size_t, off_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("pwrite"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, pwrite), &call))
+		return plibc_func(fd, buf, count, offset);
+	ret = plibc_func(fd, buf, count, offset);
+	latency = io_end(IO_SYSCALL_PWRITE, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, pwrite, fd, count, offset, ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t pwrite64(int fd, const void *buf, size_t count, off64_t offset)
+{
+	static ssize_t (*plibc_func)(int, const void *, size_t, off64_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("pwrite64"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, pwrite), &call))
+		return plibc_func(fd, buf, count, offset);
+	ret = plibc_func(fd, buf, count, offset);
+	latency = io_end(IO_SYSCALL_PWRITE, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, pwrite, fd, count, offset, ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+	static ssize_t (*plibc_func)(int, const struct iovec *, int);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("readv"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, readv), &call))
+		return plibc_func(fd, iov, iovcnt);
+	ret = plibc_func(fd, iov, iovcnt);
+	latency = io_end(IO_SYSCALL_READV, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, readv, fd, io_iov_len(iov, iovcnt),
+		ret, latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	static ssize_t (*plibc_func)(int, const struct iovec *, int);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("writev"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, writev), &call))
+		return plibc_func(fd, iov, iovcnt);
+	ret = plibc_func(fd, iov, iovcnt);
+	latency = io_end(IO_SYSCALL_WRITEV, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, writev, fd, io_iov_len(iov, iovcnt),
+		ret, latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t recv(int fd, void *buf, size_t len, int flags)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, int);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("recv"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, recv), &call))
+		return plibc_func(fd, buf, len, flags);
+	ret = plibc_func(fd, buf, len, flags);
+	latency = io_end(IO_SYSCALL_RECV, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, recv, fd, len, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t send(int fd, const void *buf, size_t len, int flags)
+{
+	static ssize_t (*plibc_func)(int, const void *, size_t, int);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("send"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, send), &call))
+		return plibc_func(fd, buf, len, flags);
+	ret = plibc_func(fd, buf, len, flags);
+	latency = io_end(IO_SYSCALL_SEND, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, send, fd, len, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t recvfrom(int fd, void *buf, size_t len, int flags,
+		struct sockaddr *src_addr, socklen_t *addrlen)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, int,
+			struct sockaddr *, socklen_t *);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("recvfrom"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, recvfrom), &call))
+		return plibc_func(fd, buf, len, flags, src_addr, addrlen);
+	ret = plibc_func(fd, buf, len, flags, src_addr, addrlen);
+	latency = io_end(IO_SYSCALL_RECVFROM, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, recvfrom, fd, len, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t sendto(int fd, const void *buf, size_t len, int flags,
+		const struct sockaddr *dest_addr, socklen_t addrlen)
+{
+	static ssize_t (*plibc_func)(int, const void *, size_t, int,
+			const struct sockaddr *, socklen_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("sendto"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, sendto), &call))
+		return plibc_func(fd, buf, len, flags, dest_addr, addrlen);
+	ret = plibc_func(fd, buf, len, flags, dest_addr, addrlen);
+	latency = io_end(IO_SYSCALL_SENDTO, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, sendto, fd, len, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t recvmsg(int fd, struct msghdr *msg, int flags)
+{
+	static ssize_t (*plibc_func)(int, struct msghdr *, int);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("recvmsg"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, recvmsg), &call))
+		return plibc_func(fd, msg, flags);
+	ret = plibc_func(fd, msg, flags);
+	latency = io_end(IO_SYSCALL_RECVMSG, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, recvmsg, fd, io_msg_len(msg), ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t sendmsg(int fd, const struct msghdr *msg, int flags)
+{
+	static ssize_t (*plibc_func)(int, const struct msghdr *, int);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("sendmsg"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, sendmsg), &call))
+		return plibc_func(fd, msg, flags);
+	ret = plibc_func(fd, msg, flags);
+	latency = io_end(IO_SYSCALL_SENDMSG, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, sendmsg, fd, io_msg_len(msg), ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+int fsync(int fd)
+{
+	static int (*plibc_func)(int);
+	struct io_call call;
+	uint64_t latency;
+	int ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("fsync"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, fsync), &call))
+		return plibc_func(fd);
+	ret = plibc_func(fd);
+	latency = io_end(IO_SYSCALL_FSYNC, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, fsync, fd, 0, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+int fdatasync(int fd)
+{
+	static int (*plibc_func)(int);
+	struct io_call call;
+	uint64_t latency;
+	int ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("fdatasync"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, fdatasync), &call))
+		return plibc_func(fd);
+	ret = plibc_func(fd);
+	latency = io_end(IO_SYSCALL_FDATASYNC, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, fdatasync, fd, 0, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+/*
+ * Fortified variants, called in place of read, pread and recv(from) by
+ * applications built with _FORTIFY_SOURCE when the buffer size is known
+ * at compile time. The libc implementation checks the buffer size.
+ */
+ssize_t __read_chk(int fd, void *buf, size_t count, size_t buflen)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, size_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("__read_chk"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, read), &call))
+		return plibc_func(fd, buf, count, buflen);
+	ret = plibc_func(fd, buf, count, buflen);
+	latency = io_end(IO_SYSCALL_READ, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, read, fd, count, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t __pread_chk(int fd, void *buf, size_t count, off_t offset,
+		size_t buflen)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, off_t, size_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("__pread_chk"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, pread), &call))
+		return plibc_func(fd, buf, count, offset, buflen);
+	ret = plibc_func(fd, buf, count, offset, buflen);
+	latency = io_end(IO_SYSCALL_PREAD, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, pread, fd, count, offset, ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t __pread64_chk(int fd, void *buf, size_t count, off64_t offset,
+		size_t buflen)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, off64_t, size_t);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("__pread64_chk"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, pread), &call))
+		return plibc_func(fd, buf, count, offset, buflen);
+	ret = plibc_func(fd, buf, count, offset, buflen);
+	latency = io_end(IO_SYSCALL_PREAD, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, pread, fd, count, offset, ret,
+		latency, LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t __recv_chk(int fd, void *buf, size_t len, size_t buflen, int flags)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, size_t, int);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("__recv_chk"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, recv), &call))
+		return plibc_func(fd, buf, len, buflen, flags);
+	ret = plibc_func(fd, buf, len, buflen, flags);
+	latency = io_end(IO_SYSCALL_RECV, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, recv, fd, len, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+ssize_t __recvfrom_chk(int fd, void *buf, size_t len, size_t buflen,
+		int flags, struct sockaddr *src_addr, socklen_t *addrlen)
+{
+	static ssize_t (*plibc_func)(int, void *, size_t, size_t, int,
+			struct sockaddr *, socklen_t *);
+	struct io_call call;
+	uint64_t latency;
+	ssize_t ret;
+
+	if (!plibc_func && !(plibc_func = io_lookup("__recvfrom_chk"))) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if (!io_begin(lttng_ust_tracepoint_enabled(lttng_ust_io, recvfrom), &call))
+		return plibc_func(fd, buf, len, buflen, flags, src_addr, addrlen);
+	ret = plibc_func(fd, buf, len, buflen, flags, src_addr, addrlen);
+	latency = io_end(IO_SYSCALL_RECVFROM, fd, &call);
+	lttng_ust_tracepoint(lttng_ust_io, recvfrom, fd, len, ret, latency,
+		LTTNG_UST_CALLER_IP());
+	io_exit(&call);
+	return ret;
+}
+
+/*
+ * Emit the latencies accounted since the previous flush. The counters
+ * are never cleared, so updates racing with a flush are not lost: they
+ * show up in the next summary.
+ */
+static
+void io_flush(void)
+{
+	struct lib_counter *counter = io_counter;
+	uint64_t hist[LTTNG_UST_IO_NR_BUCKETS];
+	uint64_t delta[NR_IO_COLUMN];
+	size_t indexes[IO_NR_DIMENSIONS];
+	size_t fd_slot, syscall, column;
+
+	if (!counter)
+		return;
+	for (fd_slot = 0; fd_slot < io_nr_fd_slots; fd_slot++) {
+		for (syscall = 0; syscall < NR_IO_SYSCALL; syscall++) {
+			uint64_t *flushed = &io_flushed[(fd_slot * NR_IO_SYSCALL + syscall) * NR_IO_COLUMN];
+			int64_t value;
+			bool overflow, underflow;
+
+			indexes[0] = fd_slot;
+			indexes[1] = syscall;
+			indexes[2] = IO_COLUMN_COUNT;
+			if (lttng_counter_aggregate(&io_counter_config, counter,
+					indexes, &value, &overflow, &underflow))
+				continue;
+			if ((uint64_t) value == flushed[IO_COLUMN_COUNT])
+				continue;
+			for (column = 0; column < NR_IO_COLUMN; column++) {
+				indexes[2] = column;
+				if (lttng_counter_aggregate(&io_counter_config,
+						counter, indexes, &value,
+						&overflow, &underflow))
+					value = (int64_t) flushed[column];
+				delta[column] = (uint64_t) value - flushed[column];
+				flushed[column] = (uint64_t) value;
+			}
+			memcpy(hist, &delta[IO_COLUMN_HIST], sizeof(hist));
+			lttng_ust_tracepoint(lttng_ust_io, latency_summary,
+				fd_slot == io_nr_fd_slots - 1 ? -1 : (int) fd_slot,
+				io_syscall_names[syscall],
+				delta[IO_COLUMN_COUNT], delta[IO_COLUMN_TOTAL],
+				hist, NULL);
+		}
+	}
+}
+
+static
+void *io_flush_thread_func(void *arg __attribute__((unused)))
+{
+	struct timespec deadline;
+
+	thread_in_trace = 1;
+	(void) clock_gettime(CLOCK_MONOTONIC, &deadline);
+	pthread_mutex_lock(&io_flush_mutex);
+	while (!io_flush_quit) {
+		deadline.tv_sec += io_flush_period / 1000;
+		deadline.tv_nsec += (io_flush_period % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		while (!io_flush_quit && pthread_cond_timedwait(&io_flush_cond,
+				&io_flush_mutex, &deadline) != ETIMEDOUT)
+			;
+		if (io_flush_quit)
+			break;
+		io_flush();
+	}
+	pthread_mutex_unlock(&io_flush_mutex);
+	return NULL;
+}
+
+static
+long io_getenv_long(const char *name, long default_value, long max_value)
+{
+	const char *str;
+	char *endptr;
+	long value;
+
+	str = lttng_ust_getenv(name);
+	if (!str)
+		return default_value;
+	errno = 0;
+	value = strtol(str, &endptr, 10);
+	if (errno || endptr == str || *endptr != '\0' || value < 0
+			|| value > max_value) {
+		ERR("Invalid value \"%s\" for %s, using %ld", str, name,
+			default_value);
+		return default_value;
+	}
+	return value;
+}
+
+/*
+ * The per-cpu histograms are only read by this process: they are kept
+ * in private anonymous memory, which only gets populated for the file
+ * descriptors and system calls actually used.
+ */
+static
+struct lib_counter *io_counter_create(void)
+{
+	size_t max_nr_elem[IO_NR_DIMENSIONS] = {
+		io_nr_fd_slots, NR_IO_SYSCALL, NR_IO_COLUMN,
+	};
+
+	return lttng_counter_create(&io_counter_config, IO_NR_DIMENSIONS,
+			max_nr_elem, 0, -1, -1, NULL, false);
+}
+
+/*
+ * A forked child would account its latencies in the histograms of its
+ * parent, and has no flush thread: stop aggregating in the child.
+ */
+static
+void io_after_fork_child(void)
+{
+	CMM_STORE_SHARED(io_counter, NULL);
+	io_flush_thread_started = false;
+}
+
+static
+void io_start_flush_thread(void)
+{
+	sigset_t sig_all_blocked, orig_mask;
+	pthread_condattr_t attr;
+	int ret;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&io_flush_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	sigfillset(&sig_all_blocked);
+	ret = pthread_sigmask(SIG_SETMASK, &sig_all_blocked, &orig_mask);
+	if (ret) {
+		ERR("pthread_sigmask: %s", strerror(ret));
+	}
+	ret = pthread_create(&io_flush_thread, NULL, io_flush_thread_func, NULL);
+	if (ret) {
+		ERR("pthread_create: %s", strerror(ret));
+	} else {
+		io_flush_thread_started = true;
+	}
+	ret = pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
+	if (ret) {
+		ERR("pthread_sigmask: %s", strerror(ret));
+	}
+}
+
+static
+void lttng_ust_io_init(void)
+	__attribute__((constructor));
+static
+void lttng_ust_io_init(void)
+{
+	struct lib_counter *counter;
+	const char *aggregate;
+
+	aggregate = lttng_ust_getenv("LTTNG_UST_IO_AGGREGATE");
+	if (!aggregate || strcmp(aggregate, "1") != 0)
+		return;
+	io_nr_fd_slots = io_getenv_long("LTTNG_UST_IO_MAX_FD",
+			IO_DEFAULT_MAX_FD, IO_MAX_MAX_FD) + 1;
+	io_flush_period = io_getenv_long("LTTNG_UST_IO_FLUSH_PERIOD",
+			IO_DEFAULT_FLUSH_PERIOD, LONG_MAX);
+
+	/* The tracer logs through the wrapped write(). */
+	thread_in_trace = 1;
+	io_flushed = zmalloc(io_nr_fd_slots * NR_IO_SYSCALL * NR_IO_COLUMN
+			* sizeof(*io_flushed));
+	if (!io_flushed) {
+		ERR("Unable to allocate I/O latency histograms");
+		goto end;
+	}
+	counter = io_counter_create();
+	if (!counter) {
+		ERR("Unable to allocate I/O latency histograms");
+		free(io_flushed);
+		io_flushed = NULL;
+		goto end;
+	}
+	DBG("Aggregating I/O latencies of %zu file descriptors, flush period %ld ms",
+		io_nr_fd_slots - 1, io_flush_period);
+	(void) pthread_atfork(NULL, NULL, io_after_fork_child);
+	CMM_STORE_SHARED(io_counter, counter);
+	if (io_flush_period)
+		io_start_flush_thread();
+end:
+	thread_in_trace = 0;
+}
+
+static
+void lttng_ust_io_exit(void)
+	__attribute__((destructor));
+static
+void lttng_ust_io_exit(void)
+{
+	struct lib_counter *counter;
+	int ret;
+
+	if (io_flush_thread_started) {
+		pthread_mutex_lock(&io_flush_mutex);
+		io_flush_quit = true;
+		pthread_cond_signal(&io_flush_cond);
+		pthread_mutex_unlock(&io_flush_mutex);
+		ret = pthread_join(io_flush_thread, NULL);
+		if (ret) {
+			ERR("pthread_join: %s", strerror(ret));
+		}
+		io_flush_thread_started = false;
+	}
+	counter = io_counter;
+	if (!counter)
+		return;
+	thread_in_trace = 1;
+	io_flush();
+	CMM_STORE_SHARED(io_counter, NULL);
+	thread_in_trace = 0;
+	/*
+	 * Other threads may still be running at exit: leave the counter
+	 * mapped rather than racing with their accounting.
+	 */
+}
@@ -0,0 +1,153 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * I/O system call events, and the latency summaries aggregated by the
+ * I/O wrapper library.
+ */
+
+#undef LTTNG_UST_TRACEPOINT_PROVIDER
+#define LTTNG_UST_TRACEPOINT_PROVIDER lttng_ust_io
+
+#if !defined(_TRACEPOINT_UST_IO_H) || defined(LTTNG_UST_TRACEPOINT_HEADER_MULTI_READ)
+#define _TRACEPOINT_UST_IO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <lttng/tracepoint.h>
+
+/*
+ * Latency histogram buckets: bucket n counts the calls which lasted
+ * less than 2^(n + 9) ns, the last bucket counts all the longer calls.
+ */
+#define LTTNG_UST_IO_NR_BUCKETS		24
+
+LTTNG_UST_TRACEPOINT_EVENT_CLASS(lttng_ust_io, io_class,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer(int, fd, fd)
+		lttng_ust_field_integer(size_t, count, count)
+		lttng_ust_field_integer(ssize_t, ret, ret)
+		lttng_ust_field_integer(uint64_t, latency, latency)
+		lttng_ust_field_unused(ip)
+	)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_CLASS(lttng_ust_io, io_pos_class,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, int64_t, offset, ssize_t, ret,
+		uint64_t, latency, void *, ip),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer(int, fd, fd)
+		lttng_ust_field_integer(size_t, count, count)
+		lttng_ust_field_integer(int64_t, offset, offset)
+		lttng_ust_field_integer(ssize_t, ret, ret)
+		lttng_ust_field_integer(uint64_t, latency, latency)
+		lttng_ust_field_unused(ip)
+	)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, read,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, write,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_pos_class, lttng_ust_io, pread,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, int64_t, offset, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_pos_class, lttng_ust_io, pwrite,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, int64_t, offset, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, readv,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, writev,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, recv,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, send,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, recvfrom,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, sendto,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, recvmsg,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, sendmsg,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, fsync,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT_INSTANCE(lttng_ust_io, io_class, lttng_ust_io, fdatasync,
+	LTTNG_UST_TP_ARGS(int, fd, size_t, count, ssize_t, ret,
+		uint64_t, latency, void *, ip)
+)
+
+/*
+ * Latencies of the calls of one system call on one file descriptor
+ * since the previous summary. A fd of -1 stands for all the file
+ * descriptors beyond the tracked ones.
+ */
+LTTNG_UST_TRACEPOINT_EVENT(lttng_ust_io, latency_summary,
+	LTTNG_UST_TP_ARGS(int, fd, const char *, syscall, uint64_t, count,
+		uint64_t, total, const uint64_t *, hist, void *, ip),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer(int, fd, fd)
+		lttng_ust_field_string(syscall, syscall)
+		lttng_ust_field_integer(uint64_t, count, count)
+		lttng_ust_field_integer(uint64_t, total, total)
+		lttng_ust_field_array(uint64_t, hist, hist,
+			LTTNG_UST_IO_NR_BUCKETS)
+		lttng_ust_field_unused(ip)
+	)
+)
+
+#endif /* _TRACEPOINT_UST_IO_H */
+
+#undef LTTNG_UST_TRACEPOINT_INCLUDE
+#define LTTNG_UST_TRACEPOINT_INCLUDE "./ust_io.h"
+
+/* This part must be outside ifdef protection */
+#include <lttng/tracepoint-event.h>
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+package org.lttng.ust.agent.log4j2;
+
+import java.util.Collection;
+import java.util.Set;
+import java.util.TreeSet;
+
+import org.apache.logging.log4j.core.Appender;
+import org.apache.logging.log4j.core.LoggerContext;
+import org.apache.logging.log4j.core.config.LoggerConfig;
+import org.apache.logging.log4j.core.Logger;
+import org.lttng.ust.agent.AbstractLttngAgent;
+
+/**
+ * Agent implementation for using the Log4j 2 logger, connecting to a root
+ * session daemon.
+ *
+ * The session daemon has no Log4j 2 domain: the agent registers to the log4j
+ * one, so an application must not use the Log4j 1.x and Log4j 2 appenders at
+ * the same time.
+ */
+class LttngLog4j2Agent extends AbstractLttngAgent<LttngLogAppender> {
+
+	private static LttngLog4j2Agent instance = null;
+
+	private LttngLog4j2Agent() {
+		super(Domain.LOG4J);
+	}
+
+	public static synchronized LttngLog4j2Agent getInstance() {
+		if (instance == null) {
+			instance = new LttngLog4j2Agent();
+		}
+		return instance;
+	}
+
+	@Override
+	public Collection<String> listAvailableEvents() {
+		Set<String> ret = new TreeSet<String>();
+
+		LoggerContext context = LoggerContext.getContext(false);
+		for (Logger logger : context.getLoggers()) {
+			/*
+			 * Check if that logger has at least one LTTng log4j2 appender
+			 * attached.
+			 */
+			if (hasLttngAppenderAttached(logger.get())) {
+				ret.add(logger.getName());
+			}
+		}
+
+		return ret;
+	}
+
+	private static boolean hasLttngAppenderAttached(LoggerConfig config) {
+		for (Appender appender : config.getAppenders().values()) {
+			if (appender instanceof LttngLogAppender) {
+				return true;
+			}
+		}
+
+		/*
+		 * The events of the logger also reach the appenders of its parent,
+		 * unless it is not additive.
+		 */
+		LoggerConfig parent = config.getParent();
+		if (parent != null && config.isAdditive()) {
+			return hasLttngAppenderAttached(parent);
+		}
+
+		return false;
+	}
+
+}
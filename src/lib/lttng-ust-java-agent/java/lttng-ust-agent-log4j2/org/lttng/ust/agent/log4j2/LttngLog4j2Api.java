@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+package org.lttng.ust.agent.log4j2;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Virtual class containing the Java side of the LTTng-log4j2 JNI API methods.
+ *
+ * The strings of an event are passed as the offsets of their UTF-8 encoded,
+ * '\0'-terminated bytes in a direct buffer, which the native side records
+ * without copying them.
+ */
+final class LttngLog4j2Api {
+
+	private LttngLog4j2Api() {}
+
+	static native void tracepoint(ByteBuffer strings,
+			int msg,
+			int logger_name,
+			int class_name,
+			int method_name,
+			int file_name,
+			int line_number,
+			long timestamp,
+			int loglevel,
+			int thread_name);
+
+	static native void tracepointWithContext(ByteBuffer strings,
+			int msg,
+			int logger_name,
+			int class_name,
+			int method_name,
+			int file_name,
+			int line_number,
+			long timestamp,
+			int loglevel,
+			int thread_name,
+			byte[] contextEntries,
+			byte[] contextStrings);
+}
@@ -0,0 +1,240 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+package org.lttng.ust.agent.log4j2;
+
+import java.io.IOException;
+import java.util.Collection;
+import java.util.Map;
+import java.util.Map.Entry;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicLong;
+
+import org.apache.logging.log4j.Level;
+import org.apache.logging.log4j.core.Appender;
+import org.apache.logging.log4j.core.Filter;
+import org.apache.logging.log4j.core.LogEvent;
+import org.apache.logging.log4j.core.appender.AbstractAppender;
+import org.apache.logging.log4j.core.config.plugins.Plugin;
+import org.apache.logging.log4j.core.config.plugins.PluginAttribute;
+import org.apache.logging.log4j.core.config.plugins.PluginElement;
+import org.apache.logging.log4j.core.config.plugins.PluginFactory;
+import org.apache.logging.log4j.message.Message;
+import org.apache.logging.log4j.util.StringBuilderFormattable;
+import org.lttng.ust.agent.ILttngAgent;
+import org.lttng.ust.agent.ILttngHandler;
+import org.lttng.ust.agent.context.ContextInfoSerializer;
+
+/**
+ * LTTng-UST Log4j 2 appender.
+ *
+ * Applications can declare this appender, as "Lttng", in their Log4j 2
+ * configuration to have it generate UST events from the logging events of the
+ * loggers referencing it.
+ *
+ * The appender is garbage-free: the loggers not enabled by a session are
+ * rejected before the message is formatted, and the message and the strings
+ * of the event are built in buffers reused by each thread. Only the
+ * application contexts, when the session enables some, are serialized in new
+ * arrays.
+ *
+ * It sends its events to UST via the JNI library "liblttng-ust-log4j-jni.so".
+ * Make sure this library is available before using this appender.
+ */
+@Plugin(name = "Lttng", category = "Core", elementType = Appender.ELEMENT_TYPE, printObject = true)
+public final class LttngLogAppender extends AbstractAppender implements ILttngHandler {
+
+	private static final String SHARED_OBJECT_NAME = "lttng-ust-log4j-jni";
+
+	private static final ThreadLocal<LttngRecordBuffer> RECORD_BUFFER = new ThreadLocal<LttngRecordBuffer>() {
+		@Override
+		protected LttngRecordBuffer initialValue() {
+			return new LttngRecordBuffer();
+		}
+	};
+
+	private final AtomicLong eventCount = new AtomicLong(0);
+
+	private final ILttngAgent<LttngLogAppender> agent;
+
+
+	/**
+	 * Constructor
+	 *
+	 * @param name
+	 *            The name of the appender
+	 * @param filter
+	 *            The filter of the appender, or null
+	 * @throws IOException
+	 *             This appender requires the lttng-ust-log4j-jni.so native
+	 *             library, through which it will send the trace events. This
+	 *             exception is throw is this library cannot be found.
+	 * @throws SecurityException
+	 *             We will forward any SecurityExcepion that may be thrown when
+	 *             trying to load the JNI library.
+	 */
+	public LttngLogAppender(String name, Filter filter) throws IOException, SecurityException {
+		super(name, filter, null, true);
+		/* Initialize LTTng UST tracer. */
+		try {
+			System.loadLibrary(SHARED_OBJECT_NAME); // $NON-NLS-1$
+		} catch (UnsatisfiedLinkError e) {
+			throw new IOException(e);
+		}
+
+		agent = LttngLog4j2Agent.getInstance();
+	}
+
+	/**
+	 * Create the appender from a Log4j 2 configuration.
+	 *
+	 * @param name
+	 *            The name of the appender
+	 * @param filter
+	 *            The filter of the appender, or null
+	 * @return The appender, or null if it could not be created
+	 */
+	@PluginFactory
+	public static LttngLogAppender createAppender(@PluginAttribute("name") String name,
+			@PluginElement("Filter") Filter filter) {
+		if (name == null) {
+			LOGGER.error("No name provided for LttngLogAppender");
+			return null;
+		}
+
+		try {
+			return new LttngLogAppender(name, filter);
+		} catch (IOException e) {
+			LOGGER.error("Cannot load the " + SHARED_OBJECT_NAME + " library", e);
+			return null;
+		}
+	}
+
+	@Override
+	public void start() {
+		/** Register to the relevant agent */
+		agent.registerHandler(this);
+		super.start();
+	}
+
+	@Override
+	public boolean stop(long timeout, TimeUnit timeUnit) {
+		boolean stopped = super.stop(timeout, timeUnit);
+
+		close();
+		return stopped;
+	}
+
+	@Override
+	public synchronized void close() {
+		agent.unregisterHandler(this);
+	}
+
+	/**
+	 * Get the number of events logged by this appender so far. This means the
+	 * number of events actually sent through JNI to UST.
+	 *
+	 * @return The number of events logged so far
+	 */
+	@Override
+	public long getEventCount() {
+		return eventCount.get();
+	}
+
+	@Override
+	public void append(LogEvent event) {
+		/*
+		 * Check if the current message should be logged, according to the UST
+		 * session settings, before doing any formatting.
+		 */
+		if (!agent.isEventEnabled(event.getLoggerName())) {
+			return;
+		}
+
+		LttngRecordBuffer buffer = RECORD_BUFFER.get();
+		StringBuilder msg = buffer.begin();
+
+		Message message = event.getMessage();
+		if (message instanceof StringBuilderFormattable) {
+			((StringBuilderFormattable) message).formatTo(msg);
+		} else if (message != null) {
+			msg.append(message.getFormattedMessage());
+		}
+
+		/*
+		 * The source location is only available if the configuration asks
+		 * for it, since it is computed from a stack trace.
+		 */
+		StackTraceElement source = event.isIncludeLocation() ? event.getSource() : null;
+
+		int msgOffset = buffer.put(msg);
+		int loggerNameOffset = buffer.put(event.getLoggerName());
+		int classNameOffset = buffer.put(source == null ? null : source.getClassName());
+		int methodNameOffset = buffer.put(source == null ? null : source.getMethodName());
+		int fileNameOffset = buffer.put(source == null ? null : source.getFileName());
+		int threadNameOffset = buffer.put(event.getThreadName());
+		int line = (source == null) ? -1 : source.getLineNumber();
+
+		eventCount.incrementAndGet();
+
+		/* Retrieve all the requested context information we can find */
+		Collection<Entry<String, Map<String, Integer>>> enabledContexts = agent.getEnabledAppContexts();
+		if (enabledContexts.isEmpty()) {
+			LttngLog4j2Api.tracepoint(buffer.getStrings(),
+					msgOffset,
+					loggerNameOffset,
+					classNameOffset,
+					methodNameOffset,
+					fileNameOffset,
+					line,
+					event.getTimeMillis(),
+					toLog4jLevel(event.getLevel()),
+					threadNameOffset);
+		} else {
+			ContextInfoSerializer.SerializedContexts contextInfo = ContextInfoSerializer.queryAndSerializeRequestedContexts(enabledContexts);
+
+			LttngLog4j2Api.tracepointWithContext(buffer.getStrings(),
+					msgOffset,
+					loggerNameOffset,
+					classNameOffset,
+					methodNameOffset,
+					fileNameOffset,
+					line,
+					event.getTimeMillis(),
+					toLog4jLevel(event.getLevel()),
+					threadNameOffset,
+					contextInfo.getEntriesArray(),
+					contextInfo.getStringsArray());
+		}
+
+		buffer.end();
+	}
+
+	/**
+	 * Map a Log4j 2 level to the Log4j 1.x level recorded in the int_loglevel
+	 * field, so that the loglevel filters of the log4j domain apply. Custom
+	 * levels map to the next less severe standard level.
+	 */
+	private static int toLog4jLevel(Level level) {
+		int intLevel = level.intLevel();
+
+		if (intLevel <= Level.OFF.intLevel()) {
+			return Integer.MAX_VALUE;
+		} else if (intLevel <= Level.FATAL.intLevel()) {
+			return 50000;
+		} else if (intLevel <= Level.ERROR.intLevel()) {
+			return 40000;
+		} else if (intLevel <= Level.WARN.intLevel()) {
+			return 30000;
+		} else if (intLevel <= Level.INFO.intLevel()) {
+			return 20000;
+		} else if (intLevel <= Level.DEBUG.intLevel()) {
+			return 10000;
+		} else if (intLevel <= Level.TRACE.intLevel()) {
+			return 5000;
+		}
+		return Integer.MIN_VALUE;
+	}
+
+}
@@ -0,0 +1,117 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+package org.lttng.ust.agent.log4j2;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Buffers reused by a thread to record its logging events: the formatted
+ * message, and the native copy of the strings of the event.
+ *
+ * The strings are encoded in UTF-8 and '\0'-terminated, except that a '\0'
+ * character is encoded on two bytes like the JNI string functions do, so that
+ * it does not cut the string.
+ */
+final class LttngRecordBuffer {
+
+	private static final int INITIAL_MESSAGE_CAPACITY = 512;
+	private static final int INITIAL_STRINGS_CAPACITY = 2048;
+
+	/*
+	 * Messages longer than this are not kept by the thread after being
+	 * recorded, so that one large message does not pin its buffers.
+	 */
+	private static final int MAX_RETAINED_CAPACITY = 256 * 1024;
+
+	private StringBuilder message = new StringBuilder(INITIAL_MESSAGE_CAPACITY);
+	private ByteBuffer strings = ByteBuffer.allocateDirect(INITIAL_STRINGS_CAPACITY);
+
+	/**
+	 * Start a new event.
+	 *
+	 * @return The empty message builder of the thread
+	 */
+	StringBuilder begin() {
+		message.setLength(0);
+		strings.clear();
+		return message;
+	}
+
+	/**
+	 * @return The buffer the strings of the current event are encoded in
+	 */
+	ByteBuffer getStrings() {
+		return strings;
+	}
+
+	/**
+	 * Release the buffers of the thread if the current event made them grow
+	 * too large.
+	 */
+	void end() {
+		if (message.capacity() > MAX_RETAINED_CAPACITY) {
+			message = new StringBuilder(INITIAL_MESSAGE_CAPACITY);
+		}
+		if (strings.capacity() > MAX_RETAINED_CAPACITY) {
+			strings = ByteBuffer.allocateDirect(INITIAL_STRINGS_CAPACITY);
+		}
+	}
+
+	/**
+	 * Append a string of the current event.
+	 *
+	 * @param str
+	 *            The string, or null for an empty string
+	 * @return The offset of the string in the buffer of the strings
+	 */
+	int put(CharSequence str) {
+		int offset = strings.position();
+		int len = (str == null) ? 0 : str.length();
+
+		/* Each char takes at most 3 bytes, a surrogate pair 4 bytes. */
+		ensureRemaining(3 * len + 1);
+		for (int i = 0; i < len; i++) {
+			char c = str.charAt(i);
+
+			if (c != 0 && c < 0x80) {
+				strings.put((byte) c);
+			} else if (c < 0x800) {
+				strings.put((byte) (0xc0 | (c >> 6)));
+				strings.put((byte) (0x80 | (c & 0x3f)));
+			} else if (Character.isHighSurrogate(c) && i + 1 < len
+					&& Character.isLowSurrogate(str.charAt(i + 1))) {
+				int cp = Character.toCodePoint(c, str.charAt(++i));
+
+				strings.put((byte) (0xf0 | (cp >> 18)));
+				strings.put((byte) (0x80 | ((cp >> 12) & 0x3f)));
+				strings.put((byte) (0x80 | ((cp >> 6) & 0x3f)));
+				strings.put((byte) (0x80 | (cp & 0x3f)));
+			} else if (Character.isSurrogate(c)) {
+				strings.put((byte) '?');
+			} else {
+				strings.put((byte) (0xe0 | (c >> 12)));
+				strings.put((byte) (0x80 | ((c >> 6) & 0x3f)));
+				strings.put((byte) (0x80 | (c & 0x3f)));
+			}
+		}
+		strings.put((byte) 0);
+		return offset;
+	}
+
+	private void ensureRemaining(int size) {
+		if (strings.remaining() >= size) {
+			return;
+		}
+
+		int capacity = strings.capacity();
+		while (capacity - strings.position() < size) {
+			capacity *= 2;
+		}
+		ByteBuffer grown = ByteBuffer.allocateDirect(capacity);
+		strings.flip();
+		grown.put(strings);
+		strings = grown;
+	}
+}
@@ -12,8 +12,6 @@
 #define LTTNG_UST_TRACEPOINT_HIDDEN_DEFINITION
 #define LTTNG_UST_TRACEPOINT_PROVIDER_HIDDEN_DEFINITION
 
-#define LTTNG_UST_TRACEPOINT_DEFINE
-#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
 #include "lttng_ust_log4j.h"
 #include "../common/lttng_ust_context.h"
 
@@ -13,7 +13,8 @@
 #include <lttng/tracepoint.h>
 
 /*
- * Tracepoint used by Java applications using the log4j log appender.
+ * Tracepoint used by Java applications using the Log4j 1.x or Log4j 2
+ * log appenders.
  */
 LTTNG_UST_TRACEPOINT_EVENT(lttng_log4j, event,
 	LTTNG_UST_TP_ARGS(
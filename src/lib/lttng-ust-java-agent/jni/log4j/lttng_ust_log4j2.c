@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * JNI side of the Log4j 2 agent. The strings of an event are encoded by
+ * the appender, '\0'-terminated, in a direct buffer reused by its thread,
+ * and are recorded from there without any copy.
+ */
+
+#define _LGPL_SOURCE
+#include "org_lttng_ust_agent_log4j2_LttngLog4j2Api.h"
+
+#define LTTNG_UST_TRACEPOINT_HIDDEN_DEFINITION
+#define LTTNG_UST_TRACEPOINT_PROVIDER_HIDDEN_DEFINITION
+
+#include "lttng_ust_log4j.h"
+#include "../common/lttng_ust_context.h"
+
+/*
+ * Tracepoint used by Java applications using the Log4j 2 appender, when
+ * no application context is enabled.
+ */
+JNIEXPORT void JNICALL Java_org_lttng_ust_agent_log4j2_LttngLog4j2Api_tracepoint(JNIEnv *env,
+						jobject jobj __attribute__((unused)),
+						jobject buffer,
+						jint msg,
+						jint logger_name,
+						jint class_name,
+						jint method_name,
+						jint file_name,
+						jint line_number,
+						jlong timestamp,
+						jint loglevel,
+						jint thread_name)
+{
+	const char *strings = (*env)->GetDirectBufferAddress(env, buffer);
+
+	if (!strings)
+		return;
+
+	lttng_ust_tracepoint(lttng_log4j, event, strings + msg,
+		   strings + logger_name, strings + class_name,
+		   strings + method_name, strings + file_name,
+		   line_number, timestamp, loglevel, strings + thread_name);
+}
+
+/*
+ * Tracepoint used by Java applications using the Log4j 2 appender, with
+ * the serialized application contexts.
+ */
+JNIEXPORT void JNICALL Java_org_lttng_ust_agent_log4j2_LttngLog4j2Api_tracepointWithContext(JNIEnv *env,
+						jobject jobj __attribute__((unused)),
+						jobject buffer,
+						jint msg,
+						jint logger_name,
+						jint class_name,
+						jint method_name,
+						jint file_name,
+						jint line_number,
+						jlong timestamp,
+						jint loglevel,
+						jint thread_name,
+						jbyteArray context_info_entries,
+						jbyteArray context_info_strings)
+{
+	const char *strings = (*env)->GetDirectBufferAddress(env, buffer);
+	jboolean iscopy;
+	signed char *context_info_entries_array;
+	signed char *context_info_strings_array;
+
+	if (!strings)
+		return;
+
+	/*
+	 * Write these to the TLS variables, so that the UST callbacks in
+	 * lttng_ust_context.c can access them.
+	 */
+	context_info_entries_array = (*env)->GetByteArrayElements(env, context_info_entries, &iscopy);
+	lttng_ust_context_info_tls.ctx_entries = (struct lttng_ust_jni_ctx_entry *) context_info_entries_array;
+	lttng_ust_context_info_tls.ctx_entries_len = (*env)->GetArrayLength(env, context_info_entries);
+	context_info_strings_array = (*env)->GetByteArrayElements(env, context_info_strings, &iscopy);
+	lttng_ust_context_info_tls.ctx_strings = context_info_strings_array;
+	lttng_ust_context_info_tls.ctx_strings_len = (*env)->GetArrayLength(env, context_info_strings);
+
+	lttng_ust_tracepoint(lttng_log4j, event, strings + msg,
+		   strings + logger_name, strings + class_name,
+		   strings + method_name, strings + file_name,
+		   line_number, timestamp, loglevel, strings + thread_name);
+
+	lttng_ust_context_info_tls.ctx_entries = NULL;
+	lttng_ust_context_info_tls.ctx_entries_len = 0;
+	lttng_ust_context_info_tls.ctx_strings = NULL;
+	lttng_ust_context_info_tls.ctx_strings_len = 0;
+	(*env)->ReleaseByteArrayElements(env, context_info_entries, context_info_entries_array, JNI_ABORT);
+	(*env)->ReleaseByteArrayElements(env, context_info_strings, context_info_strings_array, JNI_ABORT);
+}
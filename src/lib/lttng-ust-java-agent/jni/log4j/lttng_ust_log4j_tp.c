@@ -0,0 +1,15 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Probe of the lttng_log4j provider, shared by the Log4j 1.x and Log4j 2
+ * agents so that both record the same event through one provider.
+ */
+
+#define _LGPL_SOURCE
+
+#define LTTNG_UST_TRACEPOINT_HIDDEN_DEFINITION
+#define LTTNG_UST_TRACEPOINT_PROVIDER_HIDDEN_DEFINITION
+
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#include "lttng_ust_log4j.h"
@@ -0,0 +1,789 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ * Function entry tracing through patchable function entries.
+ *
+ * Functions compiled with -fpatchable-function-entry=7,5 are preceded
+ * by 5 NOPs and start with 2 NOPs (after the endbr64 instruction when
+ * built with -fcf-protection). Each of them gets an event named
+ * "lttng_ust_func:<symbol>", selected through the usual enablers.
+ *
+ * While its event is armed, the NOPs preceding a function hold a call
+ * to the tracing trampoline, and its 2 entry NOPs are replaced by a
+ * short jump to that call. Disarmed functions only cost their NOPs.
+ *
+ * The entry is modified while other threads may execute it, which
+ * requires them to serialize before running the new bytes: its first
+ * byte is turned into an int3 while the other one is written, and all
+ * the threads of the process run a core serializing instruction
+ * (membarrier SYNC_CORE) between each step. A thread trapping on the
+ * int3 resumes past the entry, as if it was still disarmed. The
+ * displacement byte of the jump decodes as a single byte instruction
+ * (stc or cmc) which only clobbers the carry flag, so a thread which
+ * already went through the first entry NOP is not derailed either.
+ */
+
+#define _LGPL_SOURCE
+#include <errno.h>
+#include <link.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <urcu/hlist.h>
+#include <urcu/compiler.h>
+#include <lttng/ust-events.h>
+#include <lttng/urcu/urcu-ust.h>
+
+#include "common/elf.h"
+#include "common/logging.h"
+#include "common/macros.h"
+
+#define LTTNG_UST_TRACEPOINT_PROVIDER_HIDDEN_DEFINITION
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#define LTTNG_UST_TP_IP_PARAM func_addr
+#include "lttng-ust-patchable.h"
+
+#define PATCHABLE_SECTION	"__patchable_function_entries"
+#define PATCHABLE_PROVIDER	"lttng_ust_func"
+
+#define PATCH_PRE_LEN		5	/* NOPs before the function. */
+#define PATCH_ENTRY_LEN		2	/* NOPs at the function entry. */
+
+#define SITE_HASH_BITS		12
+#define SITE_TABLE_SIZE		(1 << SITE_HASH_BITS)
+
+struct patch_site;
+
+/* Patchable functions sharing a symbol name, and their event. */
+struct patch_func {
+	struct lttng_ust_tracepoint tp;
+	struct lttng_ust_event_desc desc;
+	struct patch_site *sites;
+};
+
+struct patch_site {
+	struct cds_hlist_node hlist;	/* Function address hash table node. */
+	struct patch_site *next;	/* Next site of the same function. */
+	struct patch_func *func;
+	char *name;
+	uint8_t *pre;			/* NOPs before the function. */
+	uint8_t *entry;			/* NOPs at the function entry. */
+	uint8_t *stub;			/* Trampoline jump near the module. */
+	bool pre_patched;
+};
+
+static struct patch_site *sites;
+static size_t nr_sites, alloc_sites;
+static struct patch_func *funcs;
+static size_t nr_funcs;
+static struct lttng_ust_tracepoint **tps;
+static const struct lttng_ust_event_desc **descs;
+
+/*
+ * The site table is filled before the events are registered, and
+ * never modified afterwards.
+ */
+static struct cds_hlist_head site_table[SITE_TABLE_SIZE];
+
+static struct lttng_ust_probe_desc patchable_probe_desc = {
+	.struct_size = sizeof(struct lttng_ust_probe_desc),
+	.provider_name = PATCHABLE_PROVIDER,
+	.major = LTTNG_UST_PROVIDER_MAJOR,
+	.minor = LTTNG_UST_PROVIDER_MINOR,
+};
+static struct lttng_ust_registered_probe *patchable_reg_probe;
+
+static const int func_loglevel = LTTNG_UST_TRACEPOINT_LOGLEVEL_DEBUG_FUNCTION;
+static const int *func_loglevel_ptr = &func_loglevel;
+static const char *func_model_emf_uri;
+
+static DEFINE_URCU_TLS(int, patchable_nesting);
+
+static
+unsigned long site_hash(const void *func_addr)
+{
+	return (unsigned long) (((uint64_t) (uintptr_t) func_addr
+			* 0x9E3779B97F4A7C15ULL) >> (64 - SITE_HASH_BITS));
+}
+
+static
+struct patch_site *lookup_site(const void *func_addr)
+{
+	struct cds_hlist_head *head;
+	struct patch_site *site;
+
+	head = &site_table[site_hash(func_addr)];
+	cds_hlist_for_each_entry_2(site, head, hlist) {
+		if (site->pre + PATCH_PRE_LEN == func_addr)
+			return site;
+	}
+	return NULL;
+}
+
+/*
+ * Called from the trampoline with the address of the patched function
+ * and its call site. Returns the address at which the function
+ * resumes, past its entry jump.
+ */
+void *lttng_ust_patchable_entry(void *func_addr, void *call_site)
+	__attribute__((visibility("hidden")));
+void *lttng_ust_patchable_entry(void *func_addr, void *call_site)
+{
+	struct lttng_ust_tracepoint_probe *probe;
+	struct patch_site *site;
+
+	site = lookup_site(func_addr);
+	if (caa_unlikely(!site))
+		abort();	/* Only patched functions call the trampoline. */
+	if (URCU_TLS(patchable_nesting)++)
+		goto end;
+	lttng_ust_urcu_read_lock();
+	probe = lttng_ust_rcu_dereference(site->func->tp.probes);
+	for (; probe && probe->func; probe++) {
+		((void (*)(void *, void *, void *)) probe->func)(probe->data,
+				func_addr, call_site);
+	}
+	lttng_ust_urcu_read_unlock();
+end:
+	URCU_TLS(patchable_nesting)--;
+	return site->entry + PATCH_ENTRY_LEN;
+}
+
+#if defined(__x86_64__)
+
+static const uint8_t endbr64[] = { 0xf3, 0x0f, 0x1e, 0xfa };
+
+/* If the headers do not support membarrier system call, patching is refused. */
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE		= (1 << 5),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE	= (1 << 6),
+};
+
+static struct sigaction prev_trap_action;
+static bool trap_handler_installed;
+
+/*
+ * Entered through the call preceding a patched function, with the
+ * function address as return address and the function call site
+ * above it. Saves the argument registers around the handler, and
+ * returns past the function entry jump. It is reached by the indirect
+ * jump of a stub, hence its endbr64 for indirect branch tracking.
+ */
+extern char lttng_ust_patchable_trampoline[]
+	__attribute__((visibility("hidden")));
+
+asm (
+	".text\n\t"
+	".p2align 4\n\t"
+	".type lttng_ust_patchable_trampoline, @function\n"
+	"lttng_ust_patchable_trampoline:\n\t"
+	"endbr64\n\t"
+	"pushq %rax\n\t"
+	"pushq %rdi\n\t"
+	"pushq %rsi\n\t"
+	"pushq %rdx\n\t"
+	"pushq %rcx\n\t"
+	"pushq %r8\n\t"
+	"pushq %r9\n\t"
+	"pushq %r10\n\t"
+	"pushq %r11\n\t"
+	"subq $136, %rsp\n\t"
+	"movdqu %xmm0, 0(%rsp)\n\t"
+	"movdqu %xmm1, 16(%rsp)\n\t"
+	"movdqu %xmm2, 32(%rsp)\n\t"
+	"movdqu %xmm3, 48(%rsp)\n\t"
+	"movdqu %xmm4, 64(%rsp)\n\t"
+	"movdqu %xmm5, 80(%rsp)\n\t"
+	"movdqu %xmm6, 96(%rsp)\n\t"
+	"movdqu %xmm7, 112(%rsp)\n\t"
+	"movq 208(%rsp), %rdi\n\t"
+	"movq 216(%rsp), %rsi\n\t"
+	"call lttng_ust_patchable_entry\n\t"
+	"movq %rax, 208(%rsp)\n\t"
+	"movdqu 0(%rsp), %xmm0\n\t"
+	"movdqu 16(%rsp), %xmm1\n\t"
+	"movdqu 32(%rsp), %xmm2\n\t"
+	"movdqu 48(%rsp), %xmm3\n\t"
+	"movdqu 64(%rsp), %xmm4\n\t"
+	"movdqu 80(%rsp), %xmm5\n\t"
+	"movdqu 96(%rsp), %xmm6\n\t"
+	"movdqu 112(%rsp), %xmm7\n\t"
+	"addq $136, %rsp\n\t"
+	"popq %r11\n\t"
+	"popq %r10\n\t"
+	"popq %r9\n\t"
+	"popq %r8\n\t"
+	"popq %rcx\n\t"
+	"popq %rdx\n\t"
+	"popq %rsi\n\t"
+	"popq %rdi\n\t"
+	"popq %rax\n\t"
+	"ret\n\t"
+	".size lttng_ust_patchable_trampoline, .-lttng_ust_patchable_trampoline\n\t"
+);
+
+static
+bool rel32_reachable(const uint8_t *from, const uint8_t *to)
+{
+	int64_t disp = (int64_t) (intptr_t) to - (int64_t) (intptr_t) from;
+
+	return disp >= INT32_MIN && disp <= INT32_MAX;
+}
+
+/*
+ * Map the absolute jump to the trampoline within reach of a rel32 call
+ * from the [lo, hi) text range of a module.
+ */
+static
+uint8_t *alloc_stub(uint8_t *lo, uint8_t *hi)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	uintptr_t hints[2];
+	int i;
+
+	hints[0] = ((uintptr_t) hi + page_size - 1) & ~((uintptr_t) page_size - 1);
+	hints[1] = ((uintptr_t) lo & ~((uintptr_t) page_size - 1)) - (16 * page_size);
+	for (i = 0; i < 2; i++) {
+		uint8_t *stub;
+		uint64_t target = (uint64_t) (uintptr_t) lttng_ust_patchable_trampoline;
+
+		stub = mmap((void *) hints[i], page_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (stub == MAP_FAILED)
+			continue;
+		if (!rel32_reachable(lo, stub) || !rel32_reachable(hi, stub)) {
+			munmap(stub, page_size);
+			continue;
+		}
+		/* jmp *0(%rip), followed by the trampoline address. */
+		stub[0] = 0xff;
+		stub[1] = 0x25;
+		memset(&stub[2], 0, 4);
+		memcpy(&stub[6], &target, sizeof(target));
+		if (mprotect(stub, page_size, PROT_READ | PROT_EXEC)) {
+			munmap(stub, page_size);
+			continue;
+		}
+		return stub;
+	}
+	return NULL;
+}
+
+/*
+ * Validate the NOPs of a patchable function entry recorded at @pre.
+ * Returns the address of its entry NOPs, or NULL.
+ */
+static
+uint8_t *site_entry(uint8_t *pre)
+{
+	uint8_t *entry = pre + PATCH_PRE_LEN;
+	int i;
+
+	for (i = 0; i < PATCH_PRE_LEN; i++) {
+		if (pre[i] != 0x90)
+			return NULL;
+	}
+	if (!memcmp(entry, endbr64, sizeof(endbr64)))
+		entry += sizeof(endbr64);
+	if (entry[0] != 0x90 || entry[1] != 0x90)
+		return NULL;
+	return entry;
+}
+
+static
+int text_write(uint8_t *addr, const uint8_t *bytes, size_t len)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t) addr & ~((uintptr_t) page_size - 1);
+	size_t size = (uintptr_t) addr + len - start;
+
+	if (mprotect((void *) start, size, PROT_READ | PROT_WRITE | PROT_EXEC))
+		return -errno;
+	memcpy(addr, bytes, len);
+	if (mprotect((void *) start, size, PROT_READ | PROT_EXEC))
+		return -errno;
+	return 0;
+}
+
+/* Have all the threads of the process run a serializing instruction. */
+static
+int sync_cores(void)
+{
+	if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE, 0))
+		return -errno;
+	return 0;
+}
+
+/*
+ * Whether the int3 which trapped before @ip is the one stored at the
+ * entry of a site while it is modified.
+ */
+static
+bool site_trap(const uint8_t *ip)
+{
+	const uint8_t *entry = ip - 1;
+	struct patch_site *site;
+
+	site = lookup_site(entry);
+	if (!site)
+		site = lookup_site(entry - sizeof(endbr64));
+	return site && site->entry == entry;
+}
+
+/*
+ * A thread trapping on the int3 of a site entry resumes past the entry.
+ * Other SIGTRAPs go to the handler which was installed before.
+ */
+static
+void trap_handler(int sig, siginfo_t *info, void *context)
+{
+	ucontext_t *uc = context;
+	uint8_t *ip = (uint8_t *) (uintptr_t) uc->uc_mcontext.gregs[REG_RIP];
+
+	if (info->si_code == SI_KERNEL && site_trap(ip)) {
+		uc->uc_mcontext.gregs[REG_RIP] =
+			(greg_t) (uintptr_t) (ip - 1 + PATCH_ENTRY_LEN);
+		return;
+	}
+	if (prev_trap_action.sa_flags & SA_SIGINFO) {
+		prev_trap_action.sa_sigaction(sig, info, context);
+	} else if (prev_trap_action.sa_handler == SIG_DFL) {
+		/* Delivered again on return, with its default action. */
+		(void) signal(sig, SIG_DFL);
+		(void) raise(sig);
+	} else if (prev_trap_action.sa_handler != SIG_IGN) {
+		prev_trap_action.sa_handler(sig);
+	}
+}
+
+/*
+ * Installed when a site is first patched, and kept: a thread may still
+ * be about to trap on an int3 of a site.
+ */
+static
+int install_trap_handler(void)
+{
+	struct sigaction act;
+
+	if (trap_handler_installed)
+		return 0;
+	memset(&act, 0, sizeof(act));
+	act.sa_sigaction = trap_handler;
+	act.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&act.sa_mask);
+	if (sigaction(SIGTRAP, &act, &prev_trap_action))
+		return -errno;
+	trap_handler_installed = true;
+	return 0;
+}
+
+/*
+ * Replace the entry bytes of a site, which other threads may be
+ * running: its first byte is an int3 while its second one is written,
+ * and the threads are serialized after each step.
+ */
+static
+int entry_write(struct patch_site *site, const uint8_t *bytes)
+{
+	static const uint8_t int3 = 0xcc;
+	int ret;
+
+	ret = install_trap_handler();
+	if (ret)
+		return ret;
+	ret = text_write(site->entry, &int3, 1);
+	if (ret)
+		return ret;
+	ret = sync_cores();
+	if (ret)
+		return ret;
+	ret = text_write(site->entry + 1, &bytes[1], 1);
+	if (ret)
+		return ret;
+	ret = sync_cores();
+	if (ret)
+		return ret;
+	ret = text_write(site->entry, &bytes[0], 1);
+	if (ret)
+		return ret;
+	return sync_cores();
+}
+
+static
+int arm_site(struct patch_site *site)
+{
+	uint8_t insn[PATCH_PRE_LEN];
+	int32_t disp;
+	int ret;
+
+	if (!site->pre_patched) {
+		/*
+		 * call rel32 to the stub, never executed while disarmed,
+		 * and serialized by the entry write.
+		 */
+		disp = (int32_t) (site->stub - (site->pre + PATCH_PRE_LEN));
+		insn[0] = 0xe8;
+		memcpy(&insn[1], &disp, sizeof(disp));
+		ret = text_write(site->pre, insn, PATCH_PRE_LEN);
+		if (ret)
+			return ret;
+		site->pre_patched = true;
+	}
+	/* jmp rel8 to the call. */
+	insn[0] = 0xeb;
+	insn[1] = (uint8_t) (int8_t) (site->pre - (site->entry + PATCH_ENTRY_LEN));
+	return entry_write(site, insn);
+}
+
+/*
+ * The call preceding the function is kept: a thread may be about to
+ * execute it.
+ */
+static
+int disarm_site(struct patch_site *site)
+{
+	static const uint8_t nops[PATCH_ENTRY_LEN] = { 0x90, 0x90 };
+
+	return entry_write(site, nops);
+}
+
+/*
+ * Modifying code which other threads may run requires them to
+ * serialize, through membarrier SYNC_CORE (Linux 4.16).
+ */
+static
+int patch_init(void)
+{
+	if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE, 0))
+		return -ENOSYS;
+	return 0;
+}
+
+#define PATCHABLE_ARCH_SUPPORTED	1
+
+#else	/* defined(__x86_64__) */
+
+static
+uint8_t *alloc_stub(uint8_t *lo __attribute__((unused)),
+		uint8_t *hi __attribute__((unused)))
+{
+	return NULL;
+}
+
+static
+uint8_t *site_entry(uint8_t *pre __attribute__((unused)))
+{
+	return NULL;
+}
+
+static
+int arm_site(struct patch_site *site __attribute__((unused)))
+{
+	return -ENOSYS;
+}
+
+static
+int disarm_site(struct patch_site *site __attribute__((unused)))
+{
+	return -ENOSYS;
+}
+
+static
+int patch_init(void)
+{
+	return -ENOSYS;
+}
+
+#define PATCHABLE_ARCH_SUPPORTED	0
+
+#endif	/* defined(__x86_64__) */
+
+/*
+ * Patch or unpatch the sites of a function when its tracepoint is
+ * armed or disarmed. Called with the tracepoint registry lock held.
+ */
+static
+void patch_func_state_notify(struct lttng_ust_tracepoint *tp, int state)
+{
+	struct patch_func *func = caa_container_of(tp, struct patch_func, tp);
+	struct patch_site *site;
+
+	for (site = func->sites; site; site = site->next) {
+		int ret;
+
+		ret = state ? arm_site(site) : disarm_site(site);
+		if (ret)
+			ERR("Unable to %s function %s at %p: %s",
+				state ? "patch" : "unpatch", site->name,
+				site->pre + PATCH_PRE_LEN, strerror(-ret));
+	}
+}
+
+static
+int add_site(uint8_t *pre, uint8_t *entry, uint8_t *stub)
+{
+	struct patch_site *site;
+
+	if (nr_sites == alloc_sites) {
+		size_t new_alloc = max_t(size_t, 2 * alloc_sites, 64);
+		struct patch_site *new_sites;
+
+		new_sites = realloc(sites, new_alloc * sizeof(*sites));
+		if (!new_sites)
+			return -ENOMEM;
+		sites = new_sites;
+		alloc_sites = new_alloc;
+	}
+	site = &sites[nr_sites++];
+	memset(site, 0, sizeof(*site));
+	site->pre = pre;
+	site->entry = entry;
+	site->stub = stub;
+	return 0;
+}
+
+static
+int compare_site_addr(const void *a, const void *b)
+{
+	const struct patch_site *sa = a, *sb = b;
+
+	if (sa->pre == sb->pre)
+		return 0;
+	return sa->pre < sb->pre ? -1 : 1;
+}
+
+static
+int compare_site_name(const void *a, const void *b)
+{
+	const struct patch_site *sa = a, *sb = b;
+
+	return strcmp(sa->name, sb->name);
+}
+
+struct module_scan {
+	uint64_t bias;
+	struct patch_site *first;	/* Module sites, sorted by address. */
+	size_t nr;
+};
+
+static
+int name_site(const char *name, uint64_t value,
+		uint64_t size __attribute__((unused)), void *priv)
+{
+	struct module_scan *scan = priv;
+	struct patch_site key, *site;
+
+	key.pre = (uint8_t *) (uintptr_t) (scan->bias + value) - PATCH_PRE_LEN;
+	site = bsearch(&key, scan->first, scan->nr, sizeof(*site),
+			compare_site_addr);
+	if (!site || site->name)
+		return 0;
+	site->name = strdup(name);
+	return site->name ? 0 : -1;
+}
+
+/*
+ * Record the patchable function entries of a loaded module, and name
+ * them from its symbol table.
+ */
+static
+int scan_module(struct dl_phdr_info *info, size_t size __attribute__((unused)),
+		void *data __attribute__((unused)))
+{
+	const char *path = info->dlpi_name;
+	uint8_t *lo = (uint8_t *) UINTPTR_MAX, *hi = NULL, *stub = NULL;
+	uint64_t addr, section_size;
+	struct lttng_ust_elf *elf;
+	struct module_scan scan;
+	size_t i, first;
+	int found;
+	void **entries;
+
+	if (!path || !*path)
+		path = "/proc/self/exe";
+	elf = lttng_ust_elf_create(path);
+	if (!elf)
+		return 0;
+	if (lttng_ust_elf_get_section(elf, PATCHABLE_SECTION, &addr,
+			&section_size, &found) || !found)
+		goto end;
+
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+		uint8_t *start;
+
+		if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_X))
+			continue;
+		start = (uint8_t *) (uintptr_t) (info->dlpi_addr + phdr->p_vaddr);
+		lo = min_t(uint8_t *, lo, start);
+		hi = max_t(uint8_t *, hi, start + phdr->p_memsz);
+	}
+	if (!hi)
+		goto end;
+	stub = alloc_stub(lo, hi);
+	if (!stub) {
+		DBG("Unable to map the trampoline jump near \"%s\"", path);
+		goto end;
+	}
+
+	/* The section is allocated and relocated at load. */
+	entries = (void **) (uintptr_t) (info->dlpi_addr + addr);
+	first = nr_sites;
+	for (i = 0; i < section_size / sizeof(void *); i++) {
+		uint8_t *pre = entries[i], *entry;
+
+		if (pre < lo || pre + PATCH_PRE_LEN + PATCH_ENTRY_LEN > hi)
+			continue;
+		entry = site_entry(pre);
+		if (!entry)
+			continue;
+		if (add_site(pre, entry, stub))
+			goto end;
+	}
+
+	scan.bias = info->dlpi_addr;
+	scan.first = &sites[first];
+	scan.nr = nr_sites - first;
+	qsort(scan.first, scan.nr, sizeof(*scan.first), compare_site_addr);
+	(void) lttng_ust_elf_for_each_func_symbol(elf, name_site, &scan);
+	DBG("Found %zu patchable function entries in \"%s\"", scan.nr, path);
+end:
+	lttng_ust_elf_destroy(elf);
+	return 0;
+}
+
+/*
+ * Keep the named sites, and gather those sharing a name into one
+ * function with its event and tracepoint.
+ */
+static
+int build_funcs(void)
+{
+	size_t i, j;
+
+	for (i = 0, j = 0; i < nr_sites; i++) {
+		if (!sites[i].name)
+			continue;
+		if (strlen(PATCHABLE_PROVIDER) + 1 + strlen(sites[i].name)
+				>= LTTNG_UST_ABI_SYM_NAME_LEN) {
+			free(sites[i].name);
+			continue;
+		}
+		sites[j++] = sites[i];
+	}
+	nr_sites = j;
+	if (!nr_sites)
+		return 0;
+	qsort(sites, nr_sites, sizeof(*sites), compare_site_name);
+
+	funcs = zmalloc(nr_sites * sizeof(*funcs));
+	tps = zmalloc(nr_sites * sizeof(*tps));
+	descs = zmalloc(nr_sites * sizeof(*descs));
+	if (!funcs || !tps || !descs)
+		return -ENOMEM;
+	for (i = 0; i < nr_sites; i++) {
+		struct patch_site *site = &sites[i];
+		struct patch_func *func;
+
+		if (!i || strcmp(site->name, sites[i - 1].name)) {
+			func = &funcs[nr_funcs];
+			func->tp.struct_size = sizeof(struct lttng_ust_tracepoint);
+			func->tp.provider_name = PATCHABLE_PROVIDER;
+			func->tp.event_name = site->name;
+			func->tp.signature = lttng_ust__event_class___lttng_ust_patchable___func_class.signature;
+			func->tp.state_notify = patch_func_state_notify;
+			func->desc.struct_size = sizeof(struct lttng_ust_event_desc);
+			func->desc.event_name = site->name;
+			func->desc.probe_desc = &patchable_probe_desc;
+			func->desc.tp_class = &lttng_ust__event_class___lttng_ust_patchable___func_class;
+			func->desc.loglevel = &func_loglevel_ptr;
+			func->desc.model_emf_uri = &func_model_emf_uri;
+			tps[nr_funcs] = &func->tp;
+			descs[nr_funcs] = &func->desc;
+			nr_funcs++;
+		} else {
+			func = &funcs[nr_funcs - 1];
+		}
+		site->func = func;
+		site->next = func->sites;
+		func->sites = site;
+		cds_hlist_add_head(&site->hlist,
+			&site_table[site_hash(site->pre + PATCH_PRE_LEN)]);
+	}
+	return 0;
+}
+
+static
+void lttng_ust_patchable_alloc_tls(void)
+{
+	asm volatile ("" : : "m" (URCU_TLS(patchable_nesting)));
+}
+
+static
+void lttng_ust_patchable_init(void)
+	__attribute__((constructor));
+static
+void lttng_ust_patchable_init(void)
+{
+	lttng_ust_patchable_alloc_tls();
+	if (!PATCHABLE_ARCH_SUPPORTED) {
+		DBG("Patchable function entries are not supported on this architecture");
+		return;
+	}
+	dl_iterate_phdr(scan_module, NULL);
+	if (build_funcs()) {
+		ERR("Unable to register patchable function entries");
+		return;
+	}
+	if (!nr_funcs)
+		return;
+	if (patch_init()) {
+		ERR("Unable to serialize the patching of function entries: membarrier SYNC_CORE is not supported");
+		return;
+	}
+	patchable_probe_desc.event_desc = descs;
+	patchable_probe_desc.nr_events = nr_funcs;
+	patchable_reg_probe = lttng_ust_probe_register(&patchable_probe_desc);
+	if (!patchable_reg_probe) {
+		ERR("Unable to register patchable function entries");
+		return;
+	}
+	lttng_ust_tracepoint_module_register(tps, nr_funcs);
+	DBG("Registered %zu patchable functions", nr_funcs);
+}
+
+/*
+ * The sites and the trampoline jumps are never freed: a thread may
+ * still be running through them.
+ */
+static
+void lttng_ust_patchable_exit(void)
+	__attribute__((destructor));
+static
+void lttng_ust_patchable_exit(void)
+{
+	size_t i;
+
+	if (!patchable_reg_probe)
+		return;
+	lttng_ust_tracepoint_module_unregister(tps);
+	for (i = 0; i < nr_funcs; i++) {
+		if (CMM_LOAD_SHARED(funcs[i].tp.state))
+			patch_func_state_notify(&funcs[i].tp, 0);
+	}
+	lttng_ust_probe_unregister(patchable_reg_probe);
+	patchable_reg_probe = NULL;
+}
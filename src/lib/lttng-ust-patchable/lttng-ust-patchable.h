@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Event class of the function entries traced through patchable
+ * function entries. Its events are created at run time, one per
+ * patchable function.
+ */
+
+#undef LTTNG_UST_TRACEPOINT_PROVIDER
+#define LTTNG_UST_TRACEPOINT_PROVIDER lttng_ust_patchable
+
+#if !defined(_TRACEPOINT_LTTNG_UST_PATCHABLE_H) || defined(LTTNG_UST_TRACEPOINT_HEADER_MULTI_READ)
+#define _TRACEPOINT_LTTNG_UST_PATCHABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <lttng/tracepoint.h>
+
+LTTNG_UST_TRACEPOINT_EVENT_CLASS(lttng_ust_patchable, func_class,
+	LTTNG_UST_TP_ARGS(void *, func_addr, void *, call_site),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer_hex(unsigned long, addr,
+			(unsigned long) func_addr)
+		lttng_ust_field_integer_hex(unsigned long, call_site,
+			(unsigned long) call_site)
+	)
+)
+
+#endif /* _TRACEPOINT_LTTNG_UST_PATCHABLE_H */
+
+#undef LTTNG_UST_TRACEPOINT_INCLUDE
+#define LTTNG_UST_TRACEPOINT_INCLUDE "./lttng-ust-patchable.h"
+
+/* This part must be outside ifdef protection */
+#include <lttng/tracepoint-event.h>
+
+#ifdef __cplusplus
+}
+#endif
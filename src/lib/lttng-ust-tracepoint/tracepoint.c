@@ -12,6 +12,8 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <dlfcn.h>
 
 #include <urcu/arch.h>
@@ -27,6 +29,8 @@
 
 #include "common/logging.h"
 #include "common/macros.h"
+#include "common/getenv.h"
+#include "common/strutils.h"
 
 #include "lib/lttng-ust-tracepoint/tracepoint.h"
 #include "common/tracepoint.h"
@@ -133,6 +137,30 @@ struct callsite_entry {
 	bool tp_entry_callsite_ref; /* Has a tp_entry took a ref on this callsite */
 };
 
+/*
+ * Call site location selector, parsed from the
+ * LTTNG_UST_TRACEPOINT_SITES environment variable or set with
+ * lttng_ust_tracepoint_select_sites(). The strings point into
+ * site_selectors_str.
+ */
+struct site_selector {
+	struct cds_list_head node;
+	const char *provider;	/* Provider name glob, NULL matches any */
+	const char *event;	/* Event name glob, NULL matches any */
+	const char *library;	/* Module base name glob, NULL matches any */
+	const char *file;	/* Source file glob */
+	uint32_t line;		/* 0 matches any line */
+};
+
+/*
+ * Modules which registered call site locations, and the selectors
+ * applied to them. Protected by tracepoint mutex.
+ */
+static CDS_LIST_HEAD(site_libs);
+static CDS_LIST_HEAD(site_selectors);
+static char *site_selectors_str;
+static int site_selectors_parsed;
+
 lttng_ust_static_assert(LTTNG_UST_TRACEPOINT_NAME_LEN_MAX == LTTNG_UST_ABI_SYM_NAME_LEN,
 		"Tracepoint name max length mismatch between UST ABI and tracepoint API",
 		Tracepoint_name_max_length_mismatch);
@@ -349,12 +377,27 @@ static void remove_tracepoint(struct tracepoint_entry *e)
 	free(e);
 }
 
+/*
+ * Notify a tracepoint which asked for it of its state change.
+ */
+static void notify_tracepoint_state(struct lttng_ust_tracepoint *elem,
+		int old_state)
+{
+	if (!lttng_ust_struct_field_present(elem, state_notify)
+			|| !elem->state_notify)
+		return;
+	if (elem->state != old_state)
+		elem->state_notify(elem, elem->state);
+}
+
 /*
  * Sets the probe callback corresponding to one tracepoint.
  */
 static void set_tracepoint(struct tracepoint_entry **entry,
 	struct lttng_ust_tracepoint *elem, int active)
 {
+	int old_state = elem->state;
+
 	WARN_ON(strcmp((*entry)->provider_name, elem->provider_name) != 0);
 	WARN_ON(strcmp((*entry)->event_name, elem->event_name) != 0);
 	/*
@@ -384,6 +427,7 @@ static void set_tracepoint(struct tracepoint_entry **entry,
 	 */
 	lttng_ust_rcu_assign_pointer(elem->probes, (*entry)->probes);
 	CMM_STORE_SHARED(elem->state, active);
+	notify_tracepoint_state(elem, old_state);
 }
 
 /*
@@ -394,8 +438,11 @@ static void set_tracepoint(struct tracepoint_entry **entry,
  */
 static void disable_tracepoint(struct lttng_ust_tracepoint *elem)
 {
+	int old_state = elem->state;
+
 	CMM_STORE_SHARED(elem->state, 0);
 	lttng_ust_rcu_assign_pointer(elem->probes, NULL);
+	notify_tracepoint_state(elem, old_state);
 }
 
 /*
@@ -1001,6 +1048,262 @@ int lttng_ust_tracepoint_module_unregister(struct lttng_ust_tracepoint * const *
 	return 0;
 }
 
+static void free_site_selectors(struct cds_list_head *selectors, char *str)
+{
+	struct site_selector *sel, *tmp;
+
+	cds_list_for_each_entry_safe(sel, tmp, selectors, node) {
+		cds_list_del(&sel->node);
+		free(sel);
+	}
+	free(str);
+}
+
+/*
+ * Parse a comma-separated list of [PROVIDER:EVENT@][LIBRARY!]FILE[:LINE]
+ * selectors into a list, whose strings point into *str, a copy of
+ * selectors_str to free along with the list. Returns 0, -EINVAL if a
+ * line number is invalid, or -ENOMEM. Leaves the list empty on error.
+ */
+static int parse_site_selectors(const char *selectors_str,
+		struct cds_list_head *selectors, char **str)
+{
+	char *saveptr = NULL, *token;
+	int ret;
+
+	*str = strdup(selectors_str);
+	if (!*str)
+		return -ENOMEM;
+	for (token = strtok_r(*str, ",", &saveptr); token;
+			token = strtok_r(NULL, ",", &saveptr)) {
+		struct site_selector *sel;
+		char *sep;
+
+		sel = zmalloc(sizeof(struct site_selector));
+		if (!sel) {
+			ret = -ENOMEM;
+			goto error;
+		}
+		cds_list_add_tail(&sel->node, selectors);
+		sep = strchr(token, '@');
+		if (sep) {
+			*sep = '\0';
+			sel->provider = token;
+			token = sep + 1;
+			sep = strchr(sel->provider, ':');
+			if (sep) {
+				*sep = '\0';
+				sel->event = sep + 1;
+			}
+		}
+		sep = strchr(token, '!');
+		if (sep) {
+			*sep = '\0';
+			sel->library = token;
+			token = sep + 1;
+		}
+		sep = strrchr(token, ':');
+		if (sep) {
+			unsigned long line;
+			char *endptr;
+
+			errno = 0;
+			line = strtoul(sep + 1, &endptr, 10);
+			if (errno || endptr == sep + 1 || *endptr != '\0'
+					|| sep[1] < '0' || sep[1] > '9'
+					|| !line || line > UINT32_MAX) {
+				ERR("Invalid line number \"%s\" in tracepoint call site selector",
+					sep + 1);
+				ret = -EINVAL;
+				goto error;
+			}
+			*sep = '\0';
+			sel->line = line;
+		}
+		sel->file = *token ? token : "*";
+		DBG("Tracepoint call site selector: event \"%s:%s\", library \"%s\", file \"%s\", line %u",
+			sel->provider ? : "*", sel->event ? : "*",
+			sel->library ? : "*", sel->file, sel->line);
+	}
+	return 0;
+
+error:
+	free_site_selectors(selectors, *str);
+	*str = NULL;
+	return ret;
+}
+
+/*
+ * Parse the selectors of the LTTNG_UST_TRACEPOINT_SITES environment
+ * variable, unless selectors were set before. Must be called with
+ * tracepoint mutex held.
+ */
+static void parse_site_selectors_env(void)
+{
+	const char *env;
+	int ret;
+
+	if (site_selectors_parsed)
+		return;
+	site_selectors_parsed = 1;
+	env = lttng_ust_getenv("LTTNG_UST_TRACEPOINT_SITES");
+	if (!env || !*env)
+		return;
+	ret = parse_site_selectors(env, &site_selectors, &site_selectors_str);
+	if (ret)
+		ERR("Ignoring LTTNG_UST_TRACEPOINT_SITES: %s", strerror(-ret));
+}
+
+/*
+ * A call site is disabled if at least one selector targets its
+ * tracepoint, and none of those selectors matches its location.
+ * Must be called with tracepoint mutex held.
+ */
+static int site_state(const char *library,
+		const struct lttng_ust_tracepoint_site *site)
+{
+	struct site_selector *sel;
+	bool targeted = false;
+
+	if (!site->tp || !site->tp->provider_name || !site->tp->event_name)
+		return 1;
+	cds_list_for_each_entry(sel, &site_selectors, node) {
+		if (sel->provider && !strutils_star_glob_match(sel->provider, SIZE_MAX,
+				site->tp->provider_name, SIZE_MAX))
+			continue;
+		if (sel->event && !strutils_star_glob_match(sel->event, SIZE_MAX,
+				site->tp->event_name, SIZE_MAX))
+			continue;
+		targeted = true;
+		if (sel->library && !strutils_star_glob_match(sel->library, SIZE_MAX,
+				library, SIZE_MAX))
+			continue;
+		if (!site->file || !strutils_star_glob_match(sel->file, SIZE_MAX,
+				site->file, SIZE_MAX))
+			continue;
+		if (sel->line && sel->line != site->line)
+			continue;
+		return 1;
+	}
+	return !targeted;
+}
+
+static void lib_update_sites(struct tracepoint_site_lib *lib)
+{
+	int i;
+
+	for (i = 0; i < lib->sites_count; i++) {
+		struct lttng_ust_tracepoint_site *site = lib->sites_start[i];
+		int state;
+
+		if (!site)
+			continue;	/* skip dummy */
+		state = site_state(lib->library, site);
+		if (!state)
+			DBG("Disabling tracepoint call site %s:%u (%s) in \"%s\"",
+				site->file, site->line, site->func, lib->library);
+		CMM_STORE_SHARED(site->state, state);
+	}
+}
+
+/*
+ * Register the call site locations of a module. Call sites are
+ * enabled by default, and disabled according to the selectors of the
+ * LTTNG_UST_TRACEPOINT_SITES environment variable.
+ */
+int lttng_ust_tracepoint_module_register_sites(struct lttng_ust_tracepoint_site * const *sites_start,
+		int sites_count);
+int lttng_ust_tracepoint_module_register_sites(struct lttng_ust_tracepoint_site * const *sites_start,
+		int sites_count)
+{
+	struct tracepoint_site_lib *lib;
+	const char *library = "";
+	Dl_info info;
+
+	lttng_ust_tp_init();
+
+	lib = zmalloc(sizeof(struct tracepoint_site_lib));
+	if (!lib) {
+		PERROR("Unable to register tracepoint call sites");
+		return -1;
+	}
+	lib->sites_start = sites_start;
+	lib->sites_count = sites_count;
+	if (dladdr(sites_start, &info) && info.dli_fname) {
+		library = strrchr(info.dli_fname, '/');
+		library = library ? library + 1 : info.dli_fname;
+	}
+	lib->library = strdup(library);
+	if (!lib->library) {
+		PERROR("Unable to register tracepoint call sites");
+		free(lib);
+		return -1;
+	}
+
+	pthread_mutex_lock(&tracepoint_mutex);
+	parse_site_selectors_env();
+	cds_list_add(&lib->list, &site_libs);
+	lib_update_sites(lib);
+	pthread_mutex_unlock(&tracepoint_mutex);
+
+	DBG("just registered %d tracepoint call sites from \"%s\"",
+		sites_count, lib->library);
+	return 0;
+}
+
+int lttng_ust_tracepoint_module_unregister_sites(struct lttng_ust_tracepoint_site * const *sites_start);
+int lttng_ust_tracepoint_module_unregister_sites(struct lttng_ust_tracepoint_site * const *sites_start)
+{
+	struct tracepoint_site_lib *lib;
+
+	pthread_mutex_lock(&tracepoint_mutex);
+	cds_list_for_each_entry(lib, &site_libs, list) {
+		if (lib->sites_start != sites_start)
+			continue;
+
+		cds_list_del(&lib->list);
+		free(lib->library);
+		free(lib);
+		break;
+	}
+	pthread_mutex_unlock(&tracepoint_mutex);
+	return 0;
+}
+
+/*
+ * Replace the call site selectors, and update the state of all the
+ * registered call sites. NULL or an empty string selects all of them.
+ * Looked up by lttng_ust_tracepoint_select_sites() of the instrumented
+ * application. The selection is unchanged on error.
+ */
+int lttng_ust_tp_select_sites(const char *selectors);
+int lttng_ust_tp_select_sites(const char *selectors)
+{
+	struct cds_list_head new_selectors = CDS_LIST_HEAD_INIT(new_selectors);
+	struct tracepoint_site_lib *lib;
+	char *str = NULL;
+	int ret;
+
+	lttng_ust_tp_init();
+
+	if (selectors && *selectors) {
+		ret = parse_site_selectors(selectors, &new_selectors, &str);
+		if (ret)
+			return ret;
+	}
+
+	pthread_mutex_lock(&tracepoint_mutex);
+	/* Takes precedence over the environment, even if read later. */
+	site_selectors_parsed = 1;
+	free_site_selectors(&site_selectors, site_selectors_str);
+	cds_list_splice(&new_selectors, &site_selectors);
+	site_selectors_str = str;
+	cds_list_for_each_entry(lib, &site_libs, list)
+		lib_update_sites(lib);
+	pthread_mutex_unlock(&tracepoint_mutex);
+	return 0;
+}
+
 /*
  * Report in debug message whether the compiler correctly supports weak
  * hidden symbols. This test checks that the address associated with two
@@ -18,6 +18,13 @@ struct tracepoint_lib {
 	struct cds_list_head callsites;
 };
 
+struct tracepoint_site_lib {
+	struct cds_list_head list;	/* list of libs with call site locations */
+	struct lttng_ust_tracepoint_site * const *sites_start;
+	int sites_count;
+	char *library;			/* module base name */
+};
+
 int tracepoint_probe_register_noupdate(const char *provider_name, const char *event_name,
 		void (*callback)(void), void *priv,
 		const char *signature)
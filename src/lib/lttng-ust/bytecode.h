@@ -189,6 +189,10 @@ enum bytecode_op {
 
 	BYTECODE_OP_RETURN_S64			= 99,
 
+	/* set membership: apply to top of stack */
+	BYTECODE_OP_IN_SET_S64			= 100,
+	BYTECODE_OP_IN_SET_STRING		= 101,
+
 	NR_BYTECODE_OPS,
 };
 
@@ -224,4 +228,19 @@ struct return_op {
 	bytecode_opcode_t op;
 } __attribute__((packed));
 
+/*
+ * The set elements immediately follow the instruction: nr_elem int64_t
+ * for BYTECODE_OP_IN_SET_S64, nr_elem null-terminated strings for
+ * BYTECODE_OP_IN_SET_STRING. Strings are compared as-is (no escape
+ * sequence nor globbing). Initially 0, table_offset is set to the
+ * offset of the set lookup table within the runtime data at link time.
+ */
+struct set_op {
+	bytecode_opcode_t op;
+	uint16_t table_offset;
+	uint16_t nr_elem;
+	uint16_t data_len;	/* Length of the set elements, in bytes. */
+	char data[0];
+} __attribute__((packed));
+
 #endif /* _BYTECODE_H */
@@ -7,8 +7,12 @@
 #ifndef _LTTNG_UST_CONTEXT_INTERNAL_H
 #define _LTTNG_UST_CONTEXT_INTERNAL_H
 
+#include <sys/types.h>
+#include <urcu/system.h>
+#include <urcu/arch.h>
 #include <lttng/ust-events.h>
 #include "lib/lttng-ust/events.h"
+#include "common/ns.h"
 #include "common/ust-context-provider.h"
 
 int lttng_context_init_all(struct lttng_ust_ctx **ctx)
@@ -36,12 +40,59 @@ int lttng_ust_context_append(struct lttng_ust_ctx **ctx_p,
 		const struct lttng_ust_ctx_field *f)
 	__attribute__((visibility("hidden")));
 
+int lttng_ust_context_prepend(struct lttng_ust_ctx **ctx_p,
+		const struct lttng_ust_ctx_field *fields, unsigned int nr_fields)
+	__attribute__((visibility("hidden")));
+
 void lttng_context_vtid_reset(void)
 	__attribute__((visibility("hidden")));
 
 void lttng_context_vpid_reset(void)
 	__attribute__((visibility("hidden")));
 
+extern int lttng_context_ns_process_cache_disabled
+	__attribute__((visibility("hidden")));
+
+void lttng_context_ns_disable_process_cache(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_context_ns_enable_process_cache(void)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Inherit the process-wide copy of a namespace context cache into the
+ * cache of the calling thread. Returns NS_INO_UNINITIALIZED if the
+ * process-wide cache is not populated, e.g. because a thread changed its
+ * namespaces independently of the process.
+ */
+static inline
+ino_t lttng_context_ns_cache_inherit(ino_t *thread_cache, ino_t *process_cache)
+{
+	ino_t ns;
+
+	ns = CMM_LOAD_SHARED(*process_cache);
+	if (caa_likely(ns != NS_INO_UNINITIALIZED))
+		CMM_STORE_SHARED(*thread_cache, ns);
+	return ns;
+}
+
+/*
+ * Publish the namespace inode number looked up by a thread for the
+ * other threads. Pairs with the barrier in
+ * lttng_context_ns_disable_process_cache(): undo the store if the
+ * process-wide cache was disabled concurrently.
+ */
+static inline
+void lttng_context_ns_cache_publish(ino_t *process_cache, ino_t ns)
+{
+	if (CMM_LOAD_SHARED(lttng_context_ns_process_cache_disabled))
+		return;
+	CMM_STORE_SHARED(*process_cache, ns);
+	cmm_smp_mb();
+	if (CMM_LOAD_SHARED(lttng_context_ns_process_cache_disabled))
+		CMM_STORE_SHARED(*process_cache, NS_INO_UNINITIALIZED);
+}
+
 void lttng_context_cgroup_ns_reset(void)
 	__attribute__((visibility("hidden")));
 
@@ -102,6 +153,12 @@ int lttng_add_ip_to_ctx(struct lttng_ust_ctx **ctx)
 int lttng_add_cpu_id_to_ctx(struct lttng_ust_ctx **ctx)
 	__attribute__((visibility("hidden")));
 
+int lttng_add_repeat_to_ctx(struct lttng_ust_ctx **ctx)
+	__attribute__((visibility("hidden")));
+
+int lttng_add_truncated_to_ctx(struct lttng_ust_ctx **ctx)
+	__attribute__((visibility("hidden")));
+
 int lttng_add_dyntest_to_ctx(struct lttng_ust_ctx **ctx)
 	__attribute__((visibility("hidden")));
 
@@ -0,0 +1,645 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Indexed dispatch of event notifiers.
+ *
+ * Each event notifier registers its own tracepoint probe, so a hit on
+ * a tracepoint with many event notifiers evaluates each of their
+ * filters in turn. When several event notifiers of a same event have a
+ * filter consisting of a single equality comparison between a same
+ * payload field and a literal, they are indexed in a hash table keyed
+ * on the literal. Only one of them keeps its probe registered, and its
+ * filter is replaced by a lookup of the field value which sends the
+ * notifications of the matching event notifiers. Other event notifiers
+ * keep their own probe.
+ *
+ * Each event notifier is notified by a single probe at a time: the
+ * holder of the index it belongs to, or its own. Its dispatcher field,
+ * read by both probes, hands it over from one to the other. The
+ * probes of the event notifiers leaving an index are registered before
+ * they are handed over, and those of the event notifiers joining an
+ * index are unregistered after.
+ */
+
+#define _LGPL_SOURCE
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <lttng/urcu/pointer.h>
+#include <lttng/urcu/urcu-ust.h>
+#include <urcu/list.h>
+#include <urcu/compiler.h>
+
+#include "common/macros.h"
+#include "common/jhash.h"
+#include "lib/lttng-ust/events.h"
+#include "lttng-bytecode.h"
+
+/* Minimum number of event notifiers sharing a dispatch index. */
+#define DISPATCH_MIN_ENTRIES	2
+
+union dispatch_value {
+	int64_t s64;
+	const char *str;
+};
+
+struct dispatch_entry {
+	struct lttng_ust_event_notifier *event_notifier;
+	union dispatch_value value;
+	uint32_t next;		/* Index + 1 of the next entry of the bucket. */
+};
+
+struct lttng_event_notifier_dispatch {
+	bytecode_opcode_t load_op;	/* Field load instruction. */
+	uint32_t offset;		/* Field offset in interpreter stack. */
+	uint32_t mask;			/* Number of buckets - 1. */
+	uint32_t nr_entries;
+	uint32_t *buckets;		/* Index + 1 of the first entry, or 0. */
+	struct lttng_event_notifier_dispatch *free_next;
+	struct dispatch_entry entries[];
+};
+
+struct dispatch_candidate {
+	struct lttng_ust_event_notifier_private *event_notifier_priv;
+	bytecode_opcode_t load_op;
+	uint32_t offset;
+	union dispatch_value value;
+
+	/* Grouping of the candidates by event and field. */
+	size_t bucket_next;	/* Index + 1 of the next group of the bucket. */
+	size_t group_next;	/* Index + 1 of the next candidate of the group. */
+	uint32_t nr_group;	/* Size of the group, on its first candidate. */
+};
+
+static
+bool load_op_is_string(bytecode_opcode_t load_op)
+{
+	return load_op == BYTECODE_OP_LOAD_FIELD_REF_STRING ||
+		load_op == BYTECODE_OP_LOAD_FIELD_STRING;
+}
+
+/*
+ * Match the field load of a specialized filter: either a field
+ * reference, or a payload field lookup. Returns the instruction length,
+ * or 0 if there is no match.
+ */
+static
+size_t match_field_load(const struct bytecode_runtime *runtime,
+		const char *pc, const char *end,
+		struct dispatch_candidate *candidate)
+{
+	const struct load_op *insn = (const struct load_op *) pc;
+	const struct bytecode_get_index_data *gid;
+	const struct get_index_u16 *index;
+
+	switch (insn->op) {
+	case BYTECODE_OP_LOAD_FIELD_REF_S64:
+	case BYTECODE_OP_LOAD_FIELD_REF_STRING:
+		if (end - pc < (ptrdiff_t) (sizeof(struct load_op) + sizeof(struct field_ref)))
+			return 0;
+		candidate->load_op = insn->op;
+		candidate->offset = ((const struct field_ref *) insn->data)->offset;
+		return sizeof(struct load_op) + sizeof(struct field_ref);
+	case BYTECODE_OP_GET_PAYLOAD_ROOT:
+		break;
+	default:
+		return 0;
+	}
+	pc += sizeof(struct load_op);
+	insn = (const struct load_op *) pc;
+	if (end - pc < (ptrdiff_t) (2 * sizeof(struct load_op) + sizeof(struct get_index_u16)) ||
+			insn->op != BYTECODE_OP_GET_INDEX_U16)
+		return 0;
+	index = (const struct get_index_u16 *) insn->data;
+	gid = (const struct bytecode_get_index_data *) &runtime->data[index->index];
+	pc += sizeof(struct load_op) + sizeof(struct get_index_u16);
+	insn = (const struct load_op *) pc;
+	switch (insn->op) {
+	case BYTECODE_OP_LOAD_FIELD_S8:
+	case BYTECODE_OP_LOAD_FIELD_S16:
+	case BYTECODE_OP_LOAD_FIELD_S32:
+	case BYTECODE_OP_LOAD_FIELD_S64:
+	case BYTECODE_OP_LOAD_FIELD_U8:
+	case BYTECODE_OP_LOAD_FIELD_U16:
+	case BYTECODE_OP_LOAD_FIELD_U32:
+	case BYTECODE_OP_LOAD_FIELD_U64:
+	case BYTECODE_OP_LOAD_FIELD_STRING:
+		break;
+	default:
+		return 0;
+	}
+	if (gid->offset > UINT32_MAX)
+		return 0;
+	candidate->load_op = insn->op;
+	candidate->offset = gid->offset;
+	return 3 * sizeof(struct load_op) + sizeof(struct get_index_u16);
+}
+
+/*
+ * Match an integer or string literal. String literals containing
+ * wildcards or escape sequences are not indexed.
+ */
+static
+size_t match_literal(const char *pc, const char *end,
+		union dispatch_value *value, bool *is_string)
+{
+	const struct load_op *insn = (const struct load_op *) pc;
+	size_t len;
+
+	switch (insn->op) {
+	case BYTECODE_OP_LOAD_STRING:
+		len = strnlen(insn->data, end - pc - sizeof(struct load_op));
+		if (len == (size_t) (end - pc - sizeof(struct load_op)) ||
+				strpbrk(insn->data, "*\\"))
+			return 0;
+		value->str = insn->data;
+		*is_string = true;
+		return sizeof(struct load_op) + len + 1;
+	case BYTECODE_OP_LOAD_S64:
+		if (end - pc < (ptrdiff_t) (sizeof(struct load_op) + sizeof(struct literal_numeric)))
+			return 0;
+		value->s64 = ((const struct literal_numeric *) insn->data)->v;
+		*is_string = false;
+		return sizeof(struct load_op) + sizeof(struct literal_numeric);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * An event notifier can be indexed if it is only accepted by a single
+ * filter of the form "field == literal", or "literal == field".
+ */
+static
+bool match_candidate(struct lttng_ust_event_notifier_private *event_notifier_priv,
+		struct dispatch_candidate *candidate)
+{
+	struct cds_list_head *head = &event_notifier_priv->parent.filter_bytecode_runtime_head;
+	struct lttng_ust_bytecode_runtime *ust_runtime;
+	struct bytecode_runtime *runtime;
+	const char *pc, *end;
+	bool is_string = false;
+	size_t len;
+
+	if (!event_notifier_priv->pub->parent->enabled ||
+			event_notifier_priv->dispatch_disabled ||
+			event_notifier_priv->parent.has_enablers_without_filter_bytecode)
+		return false;
+	if (cds_list_empty(head) || head->next != head->prev)
+		return false;
+	ust_runtime = cds_list_first_entry(head, struct lttng_ust_bytecode_runtime, node);
+	if (ust_runtime->interpreter_func != lttng_bytecode_interpret)
+		return false;
+	runtime = caa_container_of(ust_runtime, struct bytecode_runtime, p);
+	pc = runtime->code;
+	end = runtime->code + runtime->len;
+
+	len = match_field_load(runtime, pc, end, candidate);
+	if (len) {
+		pc += len;
+		len = match_literal(pc, end, &candidate->value, &is_string);
+	} else {
+		len = match_literal(pc, end, &candidate->value, &is_string);
+		if (len) {
+			pc += len;
+			len = match_field_load(runtime, pc, end, candidate);
+		}
+	}
+	if (!len || is_string != load_op_is_string(candidate->load_op))
+		return false;
+	pc += len;
+	if (end - pc != 2 * sizeof(struct binary_op))
+		return false;
+	if (*(const bytecode_opcode_t *) pc != (is_string ?
+			BYTECODE_OP_EQ_STRING : BYTECODE_OP_EQ_S64))
+		return false;
+	pc += sizeof(struct binary_op);
+	return *(const bytecode_opcode_t *) pc == BYTECODE_OP_RETURN ||
+		*(const bytecode_opcode_t *) pc == BYTECODE_OP_RETURN_S64;
+}
+
+static
+uint32_t dispatch_hash(bytecode_opcode_t load_op, const union dispatch_value *value)
+{
+	if (load_op_is_string(load_op))
+		return jhash(value->str, strlen(value->str), 0);
+	return jhash(&value->s64, sizeof(value->s64), 0);
+}
+
+static
+bool dispatch_value_equal(bytecode_opcode_t load_op,
+		const union dispatch_value *a, const union dispatch_value *b)
+{
+	if (load_op_is_string(load_op))
+		return !strcmp(a->str, b->str);
+	return a->s64 == b->s64;
+}
+
+/*
+ * Create the index of the group of candidates starting at first.
+ */
+static
+struct lttng_event_notifier_dispatch *dispatch_create(
+		const struct dispatch_candidate *candidates, size_t first)
+{
+	struct lttng_event_notifier_dispatch *dispatch;
+	const struct dispatch_candidate *key = &candidates[first];
+	uint32_t nr_buckets = 1, nr_entries = key->nr_group, i = 0;
+	size_t j;
+
+	while (nr_buckets < 2 * nr_entries)
+		nr_buckets <<= 1;
+	dispatch = zmalloc(sizeof(*dispatch) +
+		nr_entries * sizeof(struct dispatch_entry) +
+		nr_buckets * sizeof(uint32_t));
+	if (!dispatch)
+		return NULL;
+	dispatch->load_op = key->load_op;
+	dispatch->offset = key->offset;
+	dispatch->mask = nr_buckets - 1;
+	dispatch->nr_entries = nr_entries;
+	dispatch->buckets = (uint32_t *) &dispatch->entries[nr_entries];
+	for (j = first + 1; j; j = candidates[j - 1].group_next) {
+		const struct dispatch_candidate *candidate = &candidates[j - 1];
+		struct dispatch_entry *entry;
+		uint32_t bucket;
+
+		entry = &dispatch->entries[i];
+		entry->event_notifier = candidate->event_notifier_priv->pub;
+		entry->value = candidate->value;
+		bucket = dispatch_hash(dispatch->load_op, &entry->value) & dispatch->mask;
+		entry->next = dispatch->buckets[bucket];
+		dispatch->buckets[bucket] = ++i;
+	}
+	return dispatch;
+}
+
+static
+bool dispatch_equal(const struct lttng_event_notifier_dispatch *a,
+		const struct lttng_event_notifier_dispatch *b)
+{
+	uint32_t i;
+
+	if (a->load_op != b->load_op || a->offset != b->offset ||
+			a->nr_entries != b->nr_entries)
+		return false;
+	for (i = 0; i < a->nr_entries; i++) {
+		if (a->entries[i].event_notifier != b->entries[i].event_notifier ||
+				!dispatch_value_equal(a->load_op, &a->entries[i].value,
+					&b->entries[i].value))
+			return false;
+	}
+	return true;
+}
+
+static
+bool dispatch_load(const struct lttng_event_notifier_dispatch *dispatch,
+		const char *stack_data, union dispatch_value *value)
+{
+	const char *ptr = &stack_data[dispatch->offset];
+
+	/* Load the field as the filter interpreter does. */
+	switch (dispatch->load_op) {
+	case BYTECODE_OP_LOAD_FIELD_REF_S64:
+		value->s64 = ((const struct literal_numeric *) ptr)->v;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_S8:
+		value->s64 = *(const int8_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_S16:
+		value->s64 = *(const int16_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_S32:
+		value->s64 = *(const int32_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_S64:
+		value->s64 = *(const int64_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_U8:
+		value->s64 = *(const uint8_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_U16:
+		value->s64 = *(const uint16_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_U32:
+		value->s64 = *(const uint32_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_U64:
+		value->s64 = (int64_t) *(const uint64_t *) ptr;
+		break;
+	case BYTECODE_OP_LOAD_FIELD_REF_STRING:
+	case BYTECODE_OP_LOAD_FIELD_STRING:
+		value->str = *(const char * const *) ptr;
+		/* The filter fails on NULL strings. */
+		if (!value->str)
+			return false;
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Filter of the event notifier holding a dispatch index. Sends the
+ * notifications of the matching event notifiers itself, and rejects
+ * the event.
+ */
+static
+int dispatch_run_filter(const struct lttng_ust_event_common *event,
+		const char *interpreter_stack_data,
+		struct lttng_ust_probe_ctx *probe_ctx,
+		void *filter_ctx)
+{
+	struct lttng_ust_event_notifier *event_notifier = event->child;
+	struct lttng_event_notifier_dispatch *dispatch;
+	union dispatch_value value;
+	uint32_t i;
+
+	dispatch = lttng_ust_rcu_dereference(event_notifier->priv->dispatch);
+	if (caa_unlikely(!dispatch))
+		return lttng_ust_interpret_event_filter(event,
+			interpreter_stack_data, probe_ctx, filter_ctx);
+	if (!dispatch_load(dispatch, interpreter_stack_data, &value))
+		return LTTNG_UST_EVENT_FILTER_REJECT;
+	i = dispatch->buckets[dispatch_hash(dispatch->load_op, &value) & dispatch->mask];
+	for (; i; i = dispatch->entries[i - 1].next) {
+		const struct dispatch_entry *entry = &dispatch->entries[i - 1];
+		struct lttng_ust_event_notifier *match = entry->event_notifier;
+		struct lttng_ust_notification_ctx notif_ctx;
+
+		if (!dispatch_value_equal(dispatch->load_op, &entry->value, &value))
+			continue;
+		if (caa_unlikely(!CMM_ACCESS_ONCE(match->parent->enabled)))
+			continue;
+		/* Not handed over to this index yet, or anymore. */
+		if (caa_unlikely(CMM_LOAD_SHARED(match->priv->dispatcher) != event_notifier))
+			continue;
+		notif_ctx.struct_size = sizeof(struct lttng_ust_notification_ctx);
+		notif_ctx.eval_capture = CMM_ACCESS_ONCE(match->eval_capture);
+		match->notification_send(match, interpreter_stack_data,
+			probe_ctx, &notif_ctx);
+	}
+	return LTTNG_UST_EVENT_FILTER_REJECT;
+}
+
+/*
+ * Filter of an event notifier reached through the dispatch index of
+ * another one, while its own probe is still registered.
+ */
+static
+int dispatch_member_run_filter(const struct lttng_ust_event_common *event,
+		const char *interpreter_stack_data,
+		struct lttng_ust_probe_ctx *probe_ctx,
+		void *filter_ctx)
+{
+	struct lttng_ust_event_notifier *event_notifier = event->child;
+
+	if (CMM_LOAD_SHARED(event_notifier->priv->dispatcher))
+		return LTTNG_UST_EVENT_FILTER_REJECT;
+	return lttng_ust_interpret_event_filter(event,
+		interpreter_stack_data, probe_ctx, filter_ctx);
+}
+
+static
+uint32_t candidate_group_hash(const struct dispatch_candidate *candidate)
+{
+	struct {
+		const struct lttng_ust_event_desc *desc;
+		uint32_t offset;
+		bytecode_opcode_t load_op;
+	} key;
+
+	memset(&key, 0, sizeof(key));
+	key.desc = candidate->event_notifier_priv->parent.desc;
+	key.offset = candidate->offset;
+	key.load_op = candidate->load_op;
+	return jhash(&key, sizeof(key), 0);
+}
+
+static
+bool candidate_group_equal(const struct dispatch_candidate *a,
+		const struct dispatch_candidate *b)
+{
+	return a->event_notifier_priv->parent.desc ==
+			b->event_notifier_priv->parent.desc &&
+		a->load_op == b->load_op && a->offset == b->offset;
+}
+
+/*
+ * Group the candidates by event and field, in a hash table of the
+ * first candidate of each group. Returns -ENOMEM on allocation failure.
+ */
+static
+int candidates_group(struct dispatch_candidate *candidates,
+		size_t nr_candidates)
+{
+	size_t nr_buckets = 1, i, *buckets;
+
+	while (nr_buckets < 2 * nr_candidates)
+		nr_buckets <<= 1;
+	buckets = zmalloc(nr_buckets * sizeof(*buckets));
+	if (!buckets)
+		return -ENOMEM;
+	for (i = 0; i < nr_candidates; i++) {
+		struct dispatch_candidate *candidate = &candidates[i];
+		size_t *bucket = &buckets[candidate_group_hash(candidate) & (nr_buckets - 1)];
+		size_t j;
+
+		for (j = *bucket; j; j = candidates[j - 1].bucket_next) {
+			if (candidate_group_equal(&candidates[j - 1], candidate))
+				break;
+		}
+		if (j) {
+			struct dispatch_candidate *first = &candidates[j - 1];
+
+			candidate->group_next = first->group_next;
+			first->group_next = i + 1;
+			first->nr_group++;
+		} else {
+			candidate->bucket_next = *bucket;
+			candidate->nr_group = 1;
+			*bucket = i + 1;
+		}
+	}
+	free(buckets);
+	return 0;
+}
+
+void lttng_event_notifier_group_dispatch_prepare(
+		struct lttng_event_notifier_group *event_notifier_group)
+{
+	struct lttng_ust_event_notifier_private *event_notifier_priv;
+	struct dispatch_candidate *candidates;
+	size_t nr_candidates = 0, nr_event_notifiers = 0, i;
+
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node) {
+		event_notifier_priv->dispatcher_pending = NULL;
+		free(event_notifier_priv->dispatch_pending);
+		event_notifier_priv->dispatch_pending = NULL;
+		nr_event_notifiers++;
+	}
+	if (nr_event_notifiers < DISPATCH_MIN_ENTRIES)
+		return;
+	candidates = zmalloc(nr_event_notifiers * sizeof(*candidates));
+	if (!candidates) {
+		/* Each event notifier keeps its own probe. */
+		return;
+	}
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node) {
+		struct dispatch_candidate *candidate = &candidates[nr_candidates];
+
+		memset(candidate, 0, sizeof(*candidate));
+		candidate->event_notifier_priv = event_notifier_priv;
+		if (match_candidate(event_notifier_priv, candidate))
+			nr_candidates++;
+	}
+	if (candidates_group(candidates, nr_candidates))
+		goto end;
+
+	for (i = 0; i < nr_candidates; i++) {
+		struct dispatch_candidate *first = &candidates[i];
+		struct lttng_ust_event_notifier *holder = first->event_notifier_priv->pub;
+		struct lttng_event_notifier_dispatch *dispatch;
+		uint32_t j;
+
+		/* First candidates of groups only. */
+		if (first->nr_group < DISPATCH_MIN_ENTRIES)
+			continue;
+		dispatch = dispatch_create(candidates, i);
+		if (!dispatch)
+			break;
+		/* The first event notifier of the index holds it. */
+		first->event_notifier_priv->dispatch_pending = dispatch;
+		for (j = 0; j < dispatch->nr_entries; j++)
+			dispatch->entries[j].event_notifier->priv->dispatcher_pending = holder;
+	}
+end:
+	free(candidates);
+}
+
+/*
+ * Switch the probe notifying an event notifier, without window where
+ * neither or both of them notify it. An event notifier is handed over
+ * to the holder of an index once the index is published, before the
+ * previous holder of the index, if any, hands it over.
+ */
+static
+void dispatch_hand_over(struct lttng_ust_event_notifier_private *event_notifier_priv)
+{
+	struct lttng_ust_event_common *event = event_notifier_priv->parent.pub;
+	struct lttng_ust_event_notifier *self = event_notifier_priv->pub;
+	struct lttng_ust_event_notifier *prev = event_notifier_priv->dispatcher;
+	struct lttng_ust_event_notifier *next = event_notifier_priv->dispatcher_pending;
+	int (*run_filter)(const struct lttng_ust_event_common *event,
+			const char *stack_data,
+			struct lttng_ust_probe_ctx *probe_ctx,
+			void *filter_ctx);
+	bool dispatcher_first;
+
+	if (next == self) {
+		run_filter = dispatch_run_filter;
+		/* Own filter ignores the dispatcher, the member filter does not. */
+		dispatcher_first = !prev;
+	} else if (next) {
+		run_filter = dispatch_member_run_filter;
+		/* Holders skip themselves once handed over to the next one. */
+		dispatcher_first = prev == self;
+	} else {
+		run_filter = lttng_ust_interpret_event_filter;
+		/* The member filter notifies once the dispatcher is cleared. */
+		dispatcher_first = prev != self;
+	}
+	if (dispatcher_first) {
+		CMM_STORE_SHARED(event_notifier_priv->dispatcher, next);
+		cmm_smp_mb();
+		CMM_STORE_SHARED(event->run_filter, run_filter);
+	} else {
+		CMM_STORE_SHARED(event->run_filter, run_filter);
+		cmm_smp_mb();
+		CMM_STORE_SHARED(event_notifier_priv->dispatcher, next);
+	}
+}
+
+void lttng_event_notifier_group_dispatch_publish(
+		struct lttng_event_notifier_group *event_notifier_group)
+{
+	struct lttng_ust_event_notifier_private *event_notifier_priv;
+	struct lttng_event_notifier_dispatch *free_list = NULL, *dispatch;
+
+	/* Publish the new indexes, unused until event notifiers are handed over. */
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node) {
+		struct lttng_event_notifier_dispatch *old = event_notifier_priv->dispatch;
+
+		dispatch = event_notifier_priv->dispatch_pending;
+		event_notifier_priv->dispatch_pending = NULL;
+		if (!dispatch)
+			continue;
+		if (old && dispatch_equal(old, dispatch)) {
+			free(dispatch);
+			continue;
+		}
+		lttng_ust_rcu_assign_pointer(event_notifier_priv->dispatch, dispatch);
+		if (old) {
+			old->free_next = free_list;
+			free_list = old;
+		}
+	}
+
+	/*
+	 * Hand over to the new holders of an index first, then the other
+	 * event notifiers, then the previous holders, which stop notifying
+	 * the event notifiers of their index once none is left to them.
+	 */
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node) {
+		if (event_notifier_priv->dispatcher_pending == event_notifier_priv->pub &&
+				event_notifier_priv->dispatcher != event_notifier_priv->pub)
+			dispatch_hand_over(event_notifier_priv);
+	}
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node) {
+		if (event_notifier_priv->dispatcher_pending != event_notifier_priv->pub &&
+				event_notifier_priv->dispatcher != event_notifier_priv->pub &&
+				event_notifier_priv->dispatcher_pending != event_notifier_priv->dispatcher)
+			dispatch_hand_over(event_notifier_priv);
+	}
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node) {
+		if (event_notifier_priv->dispatcher == event_notifier_priv->pub &&
+				event_notifier_priv->dispatcher_pending != event_notifier_priv->pub)
+			dispatch_hand_over(event_notifier_priv);
+	}
+
+	/* Remove the indexes no longer held. */
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node) {
+		struct lttng_event_notifier_dispatch *old = event_notifier_priv->dispatch;
+
+		if (!old || event_notifier_priv->dispatcher == event_notifier_priv->pub)
+			continue;
+		lttng_ust_rcu_assign_pointer(event_notifier_priv->dispatch, NULL);
+		old->free_next = free_list;
+		free_list = old;
+	}
+	if (!free_list)
+		return;
+	lttng_ust_urcu_synchronize_rcu();
+	while (free_list) {
+		dispatch = free_list;
+		free_list = dispatch->free_next;
+		free(dispatch);
+	}
+}
+
+void lttng_event_notifier_dispatch_destroy(
+		struct lttng_ust_event_notifier *event_notifier)
+{
+	free(event_notifier->priv->dispatch);
+	free(event_notifier->priv->dispatch_pending);
+}
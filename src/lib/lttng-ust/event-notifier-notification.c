@@ -9,10 +9,13 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <string.h>
 
 #include <lttng/ust-endian.h>
 #include "common/logging.h"
+#include "common/clock.h"
 #include <urcu/rculist.h>
+#include <urcu/uatomic.h>
 
 #include "lttng-tracer-core.h"
 #include "lib/lttng-ust/events.h"
@@ -33,6 +36,7 @@
 struct lttng_event_notifier_notification {
 	int notification_fd;
 	uint64_t event_notifier_token;
+	unsigned long nr_coalesced;
 	uint8_t capture_buf[CAPTURE_BUFFER_SIZE];
 	struct lttng_msgpack_writer writer;
 	bool has_captures;
@@ -311,6 +315,7 @@ void notification_send(struct lttng_event_notifier_notification *notif,
 	assert(notif);
 
 	ust_notif.token = event_notifier->priv->parent.user_token;
+	ust_notif.nr_coalesced = notif->nr_coalesced;
 
 	/*
 	 * Prepare sending the notification from multiple buffers using an
@@ -359,6 +364,122 @@ void notification_send(struct lttng_event_notifier_notification *notif,
 	}
 }
 
+/*
+ * Only the first notification of an event notifier within its
+ * coalescing window is sent. The following ones are counted, and the
+ * count is sent with the first notification after the window, or by
+ * lttng_event_notifier_notification_flush().
+ * Returns whether the notification must be sent.
+ */
+static
+bool notification_coalesce(const struct lttng_ust_event_notifier *event_notifier,
+		unsigned long *nr_coalesced)
+{
+	struct lttng_ust_event_notifier_private *priv = event_notifier->priv;
+	unsigned long now, start;
+
+	/* Time in microseconds, which may wrap around. */
+	now = (unsigned long) (trace_clock_read64_monotonic() / 1000);
+	start = uatomic_read(&priv->coalesce_start);
+	if ((start && (long) (now - start) < (long) priv->coalesce_window_us) ||
+			uatomic_cmpxchg(&priv->coalesce_start, start, now) != start) {
+		uatomic_inc(&priv->nr_coalesced);
+		return false;
+	}
+	*nr_coalesced = uatomic_xchg(&priv->nr_coalesced, 0);
+	return true;
+}
+
+/*
+ * Update the sketch of an event notifier, keyed on the value of its
+ * first capture, or on an empty key if it has no capture. Done for each
+ * hit, coalesced or not.
+ */
+static
+void notification_sketch_update(const struct lttng_ust_event_notifier *event_notifier,
+		const struct lttng_interpreter_output *output)
+{
+	struct lttng_event_notifier_sketch *sketch =
+		&event_notifier->priv->group->sketches[event_notifier->priv->sketch];
+	struct lttng_counter *counter;
+	const void *key = "";
+	size_t key_len = 0;
+
+	counter = CMM_LOAD_SHARED(sketch->counter);
+	/*
+	 * load-acquire paired with store-release orders creation of the
+	 * sketch counter and setting its configuration before it is used.
+	 */
+	cmm_smp_mb();
+	/* The sketch counter may not be created yet. */
+	if (!counter)
+		return;
+
+	if (output) {
+		switch (output->type) {
+		case LTTNG_INTERPRETER_TYPE_S64:
+		case LTTNG_INTERPRETER_TYPE_SIGNED_ENUM:
+			key = &output->u.s;
+			key_len = sizeof(output->u.s);
+			break;
+		case LTTNG_INTERPRETER_TYPE_U64:
+		case LTTNG_INTERPRETER_TYPE_UNSIGNED_ENUM:
+			key = &output->u.u;
+			key_len = sizeof(output->u.u);
+			break;
+		case LTTNG_INTERPRETER_TYPE_DOUBLE:
+			key = &output->u.d;
+			key_len = sizeof(output->u.d);
+			break;
+		case LTTNG_INTERPRETER_TYPE_STRING:
+			key = output->u.str.str;
+			key_len = strnlen(output->u.str.str, output->u.str.len);
+			break;
+		case LTTNG_INTERPRETER_TYPE_SEQUENCE:
+		default:
+			return;
+		}
+	}
+	if (lttng_sketch_update(&sketch->config, counter->counter,
+			event_notifier->priv->sketch_index, key, key_len) == -EOVERFLOW)
+		WARN_ON_ONCE(1);
+}
+
+void lttng_event_notifier_notification_flush(
+		const struct lttng_ust_event_notifier *event_notifier,
+		bool expired)
+{
+	struct lttng_ust_event_notifier_private *priv = event_notifier->priv;
+	struct lttng_event_notifier_notification notif = {0};
+	unsigned long nr_coalesced;
+	size_t i;
+
+	if (!priv->coalesce_window_us || !uatomic_read(&priv->nr_coalesced))
+		return;
+	if (expired) {
+		unsigned long now, start;
+
+		now = (unsigned long) (trace_clock_read64_monotonic() / 1000);
+		start = uatomic_read(&priv->coalesce_start);
+		if (start && (long) (now - start) < (long) priv->coalesce_window_us)
+			return;
+	}
+	/* Races with a hit starting a new window: one of them sends the count. */
+	nr_coalesced = uatomic_xchg(&priv->nr_coalesced, 0);
+	if (!nr_coalesced)
+		return;
+
+	/*
+	 * The notification stands for the last coalesced hit, whose
+	 * captures were not evaluated.
+	 */
+	notification_init(&notif, event_notifier);
+	notif.nr_coalesced = nr_coalesced - 1;
+	for (i = 0; i < priv->num_captures; i++)
+		notification_append_empty_capture(&notif);
+	notification_send(&notif, event_notifier);
+}
+
 void lttng_event_notifier_notification_send(
 		const struct lttng_ust_event_notifier *event_notifier,
 		const char *stack_data,
@@ -370,8 +491,17 @@ void lttng_event_notifier_notification_send(
 	 * allocation in this context.
 	 */
 	struct lttng_event_notifier_notification notif = {0};
+	bool sketch = caa_unlikely(event_notifier->priv->sketch);
+	bool send = true;
 
-	notification_init(&notif, event_notifier);
+	if (caa_unlikely(event_notifier->priv->coalesce_window_us) &&
+			!notification_coalesce(event_notifier, &notif.nr_coalesced))
+		send = false;
+	if (!send && !sketch)
+		return;
+
+	if (send)
+		notification_init(&notif, event_notifier);
 
 	if (caa_unlikely(notif_ctx->eval_capture)) {
 		struct lttng_ust_bytecode_runtime *capture_bc_runtime;
@@ -380,19 +510,34 @@ void lttng_event_notifier_notification_send(
 		 * Iterate over all the capture bytecodes. If the interpreter
 		 * functions returns successfully, append the value of the
 		 * `output` parameter to the capture buffer. If the interpreter
-		 * fails, append an empty capture to the buffer.
+		 * fails, append an empty capture to the buffer. The first
+		 * capture is also the sketch key, evaluated even if the
+		 * notification is coalesced.
 		 */
 		cds_list_for_each_entry_rcu(capture_bc_runtime,
 				&event_notifier->priv->capture_bytecode_runtime_head, node) {
 			struct lttng_interpreter_output output;
-
-			if (capture_bc_runtime->interpreter_func(capture_bc_runtime,
-					stack_data, probe_ctx, &output) == LTTNG_UST_BYTECODE_INTERPRETER_OK)
+			bool captured;
+
+			captured = capture_bc_runtime->interpreter_func(capture_bc_runtime,
+					stack_data, probe_ctx, &output) == LTTNG_UST_BYTECODE_INTERPRETER_OK;
+			if (sketch) {
+				if (captured)
+					notification_sketch_update(event_notifier, &output);
+				sketch = false;
+			}
+			if (!send)
+				break;
+			if (captured)
 				notification_append_capture(&notif, &output);
 			else
 				notification_append_empty_capture(&notif);
 		}
+	} else if (sketch) {
+		notification_sketch_update(event_notifier, NULL);
 	}
+	if (!send)
+		return;
 
 	/*
 	 * Send the notification (including the capture buffer) to the
@@ -161,6 +161,35 @@ int lttng_event_notifier_enabler_attach_exclusion(
 void lttng_free_event_filter_runtime(struct lttng_ust_event_common *event)
 	__attribute__((visibility("hidden")));
 
+/*
+ * Build the dispatch indexes of the enabled event notifiers of a group,
+ * and set the pending dispatcher of the event notifiers they will
+ * notify. The indexes are only used once published.
+ */
+void lttng_event_notifier_group_dispatch_prepare(
+		struct lttng_event_notifier_group *event_notifier_group)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Publish the dispatch indexes built by
+ * lttng_event_notifier_group_dispatch_prepare(), hand each event
+ * notifier over to its pending dispatcher, and free the indexes
+ * replaced after a grace period. The probes of the event notifiers
+ * leaving an index must be registered before, and those of the event
+ * notifiers joining an index unregistered after.
+ */
+void lttng_event_notifier_group_dispatch_publish(
+		struct lttng_event_notifier_group *event_notifier_group)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Free the dispatch index of an event notifier being destroyed. Called
+ * after a grace period following the unregistration of its probe.
+ */
+void lttng_event_notifier_dispatch_destroy(
+		struct lttng_ust_event_notifier *event_notifier)
+	__attribute__((visibility("hidden")));
+
 /*
  * Connect the probe on all enablers matching this event description.
  * Called on library load.
@@ -267,6 +296,12 @@ void lttng_probe_provider_unregister_events(const struct lttng_ust_probe_desc *d
 int lttng_fix_pending_events(void)
 	__attribute__((visibility("hidden")));
 
+void lttng_ust_enabler_sync_defer(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_ust_enabler_sync_resume(void)
+	__attribute__((visibility("hidden")));
+
 struct cds_list_head *lttng_get_probe_list_head(void)
 	__attribute__((visibility("hidden")));
 
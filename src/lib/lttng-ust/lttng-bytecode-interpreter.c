@@ -166,7 +166,7 @@ int lttng_bytecode_interpret_error(
  */
 
 #define START_OP							\
-	start_pc = &bytecode->data[0];					\
+	start_pc = lttng_ust_rcu_dereference(bytecode->exec_code);	\
 	for (pc = next_pc = start_pc; pc - start_pc < bytecode->len;	\
 			pc = next_pc) {					\
 		dbg_printf("Executing op %s (%u)\n",			\
@@ -192,7 +192,7 @@ int lttng_bytecode_interpret_error(
  */
 
 #define START_OP							\
-	start_pc = &bytecode->code[0];					\
+	start_pc = lttng_ust_rcu_dereference(bytecode->exec_code);	\
 	pc = next_pc = start_pc;					\
 	if (unlikely(pc - start_pc >= bytecode->len))			\
 		goto end;						\
@@ -861,9 +861,17 @@ int lttng_bytecode_interpret(struct lttng_ust_bytecode_runtime *ust_bytecode,
 		[ BYTECODE_OP_UNARY_BIT_NOT ] = &&LABEL_BYTECODE_OP_UNARY_BIT_NOT,
 
 		[ BYTECODE_OP_RETURN_S64 ] = &&LABEL_BYTECODE_OP_RETURN_S64,
+
+		/* set membership */
+		[ BYTECODE_OP_IN_SET_S64 ] = &&LABEL_BYTECODE_OP_IN_SET_S64,
+		[ BYTECODE_OP_IN_SET_STRING ] = &&LABEL_BYTECODE_OP_IN_SET_STRING,
 	};
 #endif /* #ifndef INTERPRETER_USE_SWITCH */
 
+	if (caa_unlikely(bytecode->reorder))
+		lttng_bytecode_reorder_sample(bytecode, interpreter_stack_data,
+			probe_ctx);
+
 	START_OP
 
 		OP(BYTECODE_OP_UNKNOWN):
@@ -2457,6 +2465,7 @@ int lttng_bytecode_interpret(struct lttng_ust_bytecode_runtime *ust_bytecode,
 			estack_ax(stack, top)->u.s.literal_type =
 				ESTACK_STRING_LITERAL_TYPE_NONE;
 			estack_ax(stack, top)->type = REG_STRING;
+			estack_ax_t = REG_STRING;
 			next_pc += sizeof(struct load_op);
 			PO;
 		}
@@ -2470,6 +2479,7 @@ int lttng_bytecode_interpret(struct lttng_ust_bytecode_runtime *ust_bytecode,
 			estack_ax(stack, top)->u.s.seq_len = *(unsigned long *) ptr;
 			estack_ax(stack, top)->u.s.str = *(const char **) (ptr + sizeof(unsigned long));
 			estack_ax(stack, top)->type = REG_STRING;
+			estack_ax_t = REG_STRING;
 			if (unlikely(!estack_ax(stack, top)->u.s.str)) {
 				dbg_printf("Interpreter warning: loading a NULL sequence.\n");
 				ret = -EINVAL;
@@ -2481,6 +2491,40 @@ int lttng_bytecode_interpret(struct lttng_ust_bytecode_runtime *ust_bytecode,
 			PO;
 		}
 
+		/* set membership */
+		OP(BYTECODE_OP_IN_SET_S64):
+		{
+			struct set_op *insn = (struct set_op *) pc;
+
+			/* Dynamic typing. */
+			if (!IS_INTEGER_REGISTER(estack_ax_t)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			estack_ax_v = lttng_bytecode_set_contains_s64(bytecode,
+				insn, estack_ax_v);
+			estack_ax_t = REG_S64;
+			next_pc += sizeof(struct set_op) + insn->data_len;
+			PO;
+		}
+
+		OP(BYTECODE_OP_IN_SET_STRING):
+		{
+			struct set_op *insn = (struct set_op *) pc;
+
+			/* Dynamic typing. */
+			if (estack_ax_t != REG_STRING) {
+				ret = -EINVAL;
+				goto end;
+			}
+			estack_ax_v = lttng_bytecode_set_contains_string(bytecode,
+				insn, estack_ax(stack, top)->u.s.str,
+				estack_ax(stack, top)->u.s.seq_len);
+			estack_ax_t = REG_S64;
+			next_pc += sizeof(struct set_op) + insn->data_len;
+			PO;
+		}
+
 	END_OP
 end:
 	/* No need to prepare output if an error occurred. */
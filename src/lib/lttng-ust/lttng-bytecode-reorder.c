@@ -0,0 +1,1062 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * LTTng UST bytecode adaptive reordering of logical operands.
+ *
+ * Chains of operands of a same logical operator (a && b && c) are
+ * evaluated in the order they were written. For each linked filter,
+ * the selectivity and evaluation time of each operand are sampled at
+ * runtime, and the operands are periodically reordered so that the
+ * cheapest and most selective ones are evaluated first.
+ *
+ * Only operands which are side-effect free and evaluate to a boolean
+ * are reordered, which keeps the filter result identical:
+ *
+ * - An AND chain is true if, and only if, all its operands evaluate to
+ *   true without error, whatever their order. Since an error rejects
+ *   the event, operands which may fail can be reordered as long as the
+ *   chain is not nested within an OR chain, where an error differs from
+ *   false.
+ * - Otherwise, including for OR chains, whose first true operand hides
+ *   the errors of the following ones, operands are only reordered if
+ *   none of them can fail at runtime.
+ *
+ * Sampling is decided with a per-thread countdown, so the tracing fast
+ * path does not write shared memory. The samplers only gather
+ * statistics: the order of the operands is updated by a reorder thread,
+ * started when the first reorderable filter is linked. The reordered
+ * code is a permutation of the specialized code, with the same length,
+ * sharing the runtime data. It is emitted into whichever of the two
+ * code buffers of the runtime is not published, and published with
+ * lttng_ust_rcu_assign_pointer(). The reorder thread then waits for a
+ * grace period, after which the superseded buffer may be reused.
+ */
+
+#define _LGPL_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <urcu/list.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include <lttng/urcu/pointer.h>
+#include <lttng/urcu/urcu-ust.h>
+
+#include "lttng-bytecode.h"
+#include "lttng-tracer-core.h"
+#include "common/clock.h"
+#include "common/macros.h"
+
+/*
+ * Each thread samples one evaluation of reorderable filters out of
+ * BYTECODE_REORDER_SAMPLE_PERIOD on average. Must be a power of 2.
+ */
+#define BYTECODE_REORDER_SAMPLE_PERIOD		1024
+
+/* Reconsider the order of the operands every NR_SAMPLES samples. */
+#define BYTECODE_REORDER_NR_SAMPLES		64
+
+/* Period of the reorder thread. */
+#define BYTECODE_REORDER_UPDATE_PERIOD_MS	100
+
+/* Maximum nesting of pending logical operators while parsing. */
+#define BYTECODE_REORDER_MAX_PENDING		64
+
+enum insn_class {
+	INSN_PUSH,		/* Push 1 */
+	INSN_UNARY,		/* Pop 1, push 1 */
+	INSN_BINARY,		/* Pop 2, push 1 */
+	INSN_LOGICAL,
+	INSN_RETURN,
+};
+
+struct reorder_expr {
+	uint16_t offset;		/* Within the specialized code. */
+	uint16_t len;
+	bool is_bool;			/* Evaluates to 0 or 1. */
+	bool can_fail;			/* May cause an interpreter error. */
+	bool pure;			/* Free of side effects. */
+
+	/* Chain of operands of the same logical operator. */
+	bytecode_opcode_t logical_op;	/* 0 for leaves. */
+	bool reorderable;
+	unsigned int nr_operands;
+	struct reorder_expr **operands;	/* Current evaluation order. */
+	struct reorder_expr **sorted;	/* Candidate evaluation order. */
+
+	/* Sampling of operands of reorderable chains. */
+	struct bytecode_runtime *probe;
+	uint64_t nr_samples;
+	uint64_t nr_true;
+	uint64_t time_ns;
+
+	struct reorder_expr *next;	/* All expressions, for teardown. */
+};
+
+struct bytecode_reorder {
+	struct bytecode_runtime *runtime;
+	struct reorder_expr *root;
+	struct reorder_expr *exprs;
+	unsigned int nr_samples;
+	int busy;			/* Held while sampling or updating. */
+	int update_pending;		/* Set by samplers, cleared on update. */
+	char *buffers;			/* Two copies of the code. */
+	struct cds_list_head node;	/* Reorderable runtimes list. */
+};
+
+/*
+ * The reorder mutex protects the list of reorderable runtimes, and is
+ * held by the reorder thread while updating them.
+ */
+static pthread_mutex_t reorder_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CDS_LIST_HEAD(reorder_list);
+static pthread_t reorder_thread;
+static bool reorder_thread_started;
+static bool reorder_thread_quit;
+
+/* Per-thread sampling countdown and jitter. */
+static DEFINE_URCU_TLS(unsigned int, reorder_countdown);
+static DEFINE_URCU_TLS(uint32_t, reorder_rand);
+
+static
+int decode_insn(const char *pc, size_t max_len, size_t *len,
+		enum insn_class *class)
+{
+	bytecode_opcode_t op = *(const bytecode_opcode_t *) pc;
+
+	switch (op) {
+	case BYTECODE_OP_RETURN:
+	case BYTECODE_OP_RETURN_S64:
+		*class = INSN_RETURN;
+		*len = sizeof(struct return_op);
+		break;
+
+	case BYTECODE_OP_MUL:
+	case BYTECODE_OP_DIV:
+	case BYTECODE_OP_MOD:
+	case BYTECODE_OP_PLUS:
+	case BYTECODE_OP_MINUS:
+	case BYTECODE_OP_BIT_RSHIFT:
+	case BYTECODE_OP_BIT_LSHIFT:
+	case BYTECODE_OP_BIT_AND:
+	case BYTECODE_OP_BIT_OR:
+	case BYTECODE_OP_BIT_XOR:
+	case BYTECODE_OP_EQ:
+	case BYTECODE_OP_NE:
+	case BYTECODE_OP_GT:
+	case BYTECODE_OP_LT:
+	case BYTECODE_OP_GE:
+	case BYTECODE_OP_LE:
+	case BYTECODE_OP_EQ_STRING:
+	case BYTECODE_OP_NE_STRING:
+	case BYTECODE_OP_GT_STRING:
+	case BYTECODE_OP_LT_STRING:
+	case BYTECODE_OP_GE_STRING:
+	case BYTECODE_OP_LE_STRING:
+	case BYTECODE_OP_EQ_STAR_GLOB_STRING:
+	case BYTECODE_OP_NE_STAR_GLOB_STRING:
+	case BYTECODE_OP_EQ_S64:
+	case BYTECODE_OP_NE_S64:
+	case BYTECODE_OP_GT_S64:
+	case BYTECODE_OP_LT_S64:
+	case BYTECODE_OP_GE_S64:
+	case BYTECODE_OP_LE_S64:
+	case BYTECODE_OP_EQ_DOUBLE:
+	case BYTECODE_OP_NE_DOUBLE:
+	case BYTECODE_OP_GT_DOUBLE:
+	case BYTECODE_OP_LT_DOUBLE:
+	case BYTECODE_OP_GE_DOUBLE:
+	case BYTECODE_OP_LE_DOUBLE:
+	case BYTECODE_OP_EQ_DOUBLE_S64:
+	case BYTECODE_OP_NE_DOUBLE_S64:
+	case BYTECODE_OP_GT_DOUBLE_S64:
+	case BYTECODE_OP_LT_DOUBLE_S64:
+	case BYTECODE_OP_GE_DOUBLE_S64:
+	case BYTECODE_OP_LE_DOUBLE_S64:
+	case BYTECODE_OP_EQ_S64_DOUBLE:
+	case BYTECODE_OP_NE_S64_DOUBLE:
+	case BYTECODE_OP_GT_S64_DOUBLE:
+	case BYTECODE_OP_LT_S64_DOUBLE:
+	case BYTECODE_OP_GE_S64_DOUBLE:
+	case BYTECODE_OP_LE_S64_DOUBLE:
+		*class = INSN_BINARY;
+		*len = sizeof(struct binary_op);
+		break;
+
+	case BYTECODE_OP_UNARY_PLUS:
+	case BYTECODE_OP_UNARY_MINUS:
+	case BYTECODE_OP_UNARY_NOT:
+	case BYTECODE_OP_UNARY_PLUS_S64:
+	case BYTECODE_OP_UNARY_MINUS_S64:
+	case BYTECODE_OP_UNARY_NOT_S64:
+	case BYTECODE_OP_UNARY_PLUS_DOUBLE:
+	case BYTECODE_OP_UNARY_MINUS_DOUBLE:
+	case BYTECODE_OP_UNARY_NOT_DOUBLE:
+	case BYTECODE_OP_UNARY_BIT_NOT:
+		*class = INSN_UNARY;
+		*len = sizeof(struct unary_op);
+		break;
+
+	case BYTECODE_OP_AND:
+	case BYTECODE_OP_OR:
+		*class = INSN_LOGICAL;
+		*len = sizeof(struct logical_op);
+		break;
+
+	case BYTECODE_OP_LOAD_FIELD_REF_STRING:
+	case BYTECODE_OP_LOAD_FIELD_REF_SEQUENCE:
+	case BYTECODE_OP_LOAD_FIELD_REF_S64:
+	case BYTECODE_OP_LOAD_FIELD_REF_DOUBLE:
+	case BYTECODE_OP_GET_CONTEXT_REF:
+	case BYTECODE_OP_GET_CONTEXT_REF_STRING:
+	case BYTECODE_OP_GET_CONTEXT_REF_S64:
+	case BYTECODE_OP_GET_CONTEXT_REF_DOUBLE:
+		*class = INSN_PUSH;
+		*len = sizeof(struct load_op) + sizeof(struct field_ref);
+		break;
+
+	case BYTECODE_OP_LOAD_STRING:
+	case BYTECODE_OP_LOAD_STAR_GLOB_STRING:
+		*class = INSN_PUSH;
+		*len = sizeof(struct load_op) +
+			strnlen(pc + sizeof(struct load_op),
+				max_len - sizeof(struct load_op)) + 1;
+		break;
+
+	case BYTECODE_OP_LOAD_S64:
+		*class = INSN_PUSH;
+		*len = sizeof(struct load_op) + sizeof(struct literal_numeric);
+		break;
+
+	case BYTECODE_OP_LOAD_DOUBLE:
+		*class = INSN_PUSH;
+		*len = sizeof(struct load_op) + sizeof(struct literal_double);
+		break;
+
+	case BYTECODE_OP_CAST_TO_S64:
+	case BYTECODE_OP_CAST_DOUBLE_TO_S64:
+	case BYTECODE_OP_CAST_NOP:
+		*class = INSN_UNARY;
+		*len = sizeof(struct cast_op);
+		break;
+
+	case BYTECODE_OP_GET_CONTEXT_ROOT:
+	case BYTECODE_OP_GET_APP_CONTEXT_ROOT:
+	case BYTECODE_OP_GET_PAYLOAD_ROOT:
+		*class = INSN_PUSH;
+		*len = sizeof(struct load_op);
+		break;
+
+	case BYTECODE_OP_GET_SYMBOL:
+	case BYTECODE_OP_GET_SYMBOL_FIELD:
+		*class = INSN_UNARY;
+		*len = sizeof(struct load_op) + sizeof(struct get_symbol);
+		break;
+
+	case BYTECODE_OP_GET_INDEX_U16:
+		*class = INSN_UNARY;
+		*len = sizeof(struct load_op) + sizeof(struct get_index_u16);
+		break;
+
+	case BYTECODE_OP_GET_INDEX_U64:
+		*class = INSN_UNARY;
+		*len = sizeof(struct load_op) + sizeof(struct get_index_u64);
+		break;
+
+	case BYTECODE_OP_LOAD_FIELD:
+	case BYTECODE_OP_LOAD_FIELD_S8:
+	case BYTECODE_OP_LOAD_FIELD_S16:
+	case BYTECODE_OP_LOAD_FIELD_S32:
+	case BYTECODE_OP_LOAD_FIELD_S64:
+	case BYTECODE_OP_LOAD_FIELD_U8:
+	case BYTECODE_OP_LOAD_FIELD_U16:
+	case BYTECODE_OP_LOAD_FIELD_U32:
+	case BYTECODE_OP_LOAD_FIELD_U64:
+	case BYTECODE_OP_LOAD_FIELD_STRING:
+	case BYTECODE_OP_LOAD_FIELD_SEQUENCE:
+	case BYTECODE_OP_LOAD_FIELD_DOUBLE:
+		*class = INSN_UNARY;
+		*len = sizeof(struct load_op);
+		break;
+
+	case BYTECODE_OP_IN_SET_S64:
+	case BYTECODE_OP_IN_SET_STRING:
+		*class = INSN_UNARY;
+		*len = sizeof(struct set_op) +
+			((const struct set_op *) pc)->data_len;
+		break;
+
+	default:
+		return -EINVAL;
+	}
+	if (*len > max_len)
+		return -ERANGE;
+	return 0;
+}
+
+/*
+ * Instructions which leave 0 or 1 on top of the stack.
+ */
+static
+bool insn_is_bool(bytecode_opcode_t op)
+{
+	switch (op) {
+	case BYTECODE_OP_EQ ... BYTECODE_OP_LE_S64_DOUBLE:
+	case BYTECODE_OP_UNARY_NOT:
+	case BYTECODE_OP_UNARY_NOT_S64:
+	case BYTECODE_OP_UNARY_NOT_DOUBLE:
+	case BYTECODE_OP_EQ_STAR_GLOB_STRING:
+	case BYTECODE_OP_NE_STAR_GLOB_STRING:
+	case BYTECODE_OP_IN_SET_S64:
+	case BYTECODE_OP_IN_SET_STRING:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Specialized instructions which never cause an interpreter error.
+ * String loads are excluded since they fail on NULL strings, as are
+ * dynamically typed instructions.
+ */
+static
+bool insn_cannot_fail(bytecode_opcode_t op)
+{
+	switch (op) {
+	case BYTECODE_OP_EQ_STRING ... BYTECODE_OP_LE_S64_DOUBLE:
+	case BYTECODE_OP_EQ_STAR_GLOB_STRING:
+	case BYTECODE_OP_NE_STAR_GLOB_STRING:
+	case BYTECODE_OP_UNARY_PLUS_S64:
+	case BYTECODE_OP_UNARY_MINUS_S64:
+	case BYTECODE_OP_UNARY_NOT_S64:
+	case BYTECODE_OP_UNARY_PLUS_DOUBLE:
+	case BYTECODE_OP_UNARY_MINUS_DOUBLE:
+	case BYTECODE_OP_UNARY_NOT_DOUBLE:
+	case BYTECODE_OP_LOAD_FIELD_REF_S64:
+	case BYTECODE_OP_LOAD_FIELD_REF_DOUBLE:
+	case BYTECODE_OP_LOAD_STRING:
+	case BYTECODE_OP_LOAD_STAR_GLOB_STRING:
+	case BYTECODE_OP_LOAD_S64:
+	case BYTECODE_OP_LOAD_DOUBLE:
+	case BYTECODE_OP_CAST_DOUBLE_TO_S64:
+	case BYTECODE_OP_CAST_NOP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Application contexts call back into the application.
+ */
+static
+bool insn_is_pure(bytecode_opcode_t op)
+{
+	switch (op) {
+	case BYTECODE_OP_GET_CONTEXT_REF:
+	case BYTECODE_OP_GET_APP_CONTEXT_ROOT:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static
+struct reorder_expr *expr_create(struct bytecode_reorder *reorder,
+		uint16_t offset, uint16_t len)
+{
+	struct reorder_expr *expr;
+
+	expr = zmalloc(sizeof(*expr));
+	if (!expr)
+		return NULL;
+	expr->offset = offset;
+	expr->len = len;
+	expr->next = reorder->exprs;
+	reorder->exprs = expr;
+	return expr;
+}
+
+/*
+ * Leaf covering the expressions a (and b), followed by the instruction
+ * op, ending at offset end.
+ */
+static
+struct reorder_expr *expr_leaf(struct bytecode_reorder *reorder,
+		const struct reorder_expr *a, const struct reorder_expr *b,
+		bytecode_opcode_t op, uint16_t start, uint16_t end)
+{
+	struct reorder_expr *expr;
+
+	expr = expr_create(reorder, start, end - start);
+	if (!expr)
+		return NULL;
+	expr->is_bool = insn_is_bool(op);
+	expr->can_fail = !insn_cannot_fail(op) || (a && a->can_fail) ||
+		(b && b->can_fail);
+	expr->pure = insn_is_pure(op) && (!a || a->pure) && (!b || b->pure);
+	return expr;
+}
+
+static
+int expr_append_operands(struct reorder_expr *chain,
+		struct reorder_expr *expr)
+{
+	struct reorder_expr **operands;
+	unsigned int nr = 1, i;
+
+	if (expr->logical_op == chain->logical_op)
+		nr = expr->nr_operands;
+	operands = realloc(chain->operands,
+		(chain->nr_operands + nr) * sizeof(*operands));
+	if (!operands)
+		return -ENOMEM;
+	chain->operands = operands;
+	if (expr->logical_op == chain->logical_op) {
+		for (i = 0; i < nr; i++)
+			operands[chain->nr_operands++] = expr->operands[i];
+	} else {
+		operands[chain->nr_operands++] = expr;
+	}
+	return 0;
+}
+
+/*
+ * Combine the operands of a logical operator into a chain, flattening
+ * nested chains of the same operator.
+ */
+static
+struct reorder_expr *expr_chain(struct bytecode_reorder *reorder,
+		bytecode_opcode_t op, struct reorder_expr *a,
+		struct reorder_expr *b)
+{
+	struct reorder_expr *expr;
+	unsigned int i;
+
+	expr = expr_create(reorder, a->offset, b->offset + b->len - a->offset);
+	if (!expr)
+		return NULL;
+	expr->logical_op = op;
+	if (expr_append_operands(expr, a) || expr_append_operands(expr, b))
+		return NULL;
+	expr->is_bool = true;
+	expr->pure = true;
+	for (i = 0; i < expr->nr_operands; i++) {
+		expr->is_bool &= expr->operands[i]->is_bool;
+		expr->can_fail |= expr->operands[i]->can_fail;
+		expr->pure &= expr->operands[i]->pure;
+	}
+	return expr;
+}
+
+/*
+ * Rebuild the expression tree of the specialized code by tracking which
+ * expression produced each stack entry.
+ */
+static
+int parse_code(struct bytecode_runtime *runtime,
+		struct bytecode_reorder *reorder)
+{
+	struct reorder_expr *stack[INTERPRETER_STACK_LEN];
+	struct {
+		struct reorder_expr *left;
+		bytecode_opcode_t op;
+		uint16_t skip_offset;
+	} pending[BYTECODE_REORDER_MAX_PENDING];
+	int top = 0, nr_pending = 0;
+	uint16_t offset = 0;
+
+	while (offset < runtime->len) {
+		const char *pc = &runtime->code[offset];
+		bytecode_opcode_t op = *(const bytecode_opcode_t *) pc;
+		enum insn_class class;
+		size_t len;
+		int ret;
+
+		/* Logical operators whose right operand ends here. */
+		while (nr_pending && pending[nr_pending - 1].skip_offset == offset) {
+			nr_pending--;
+			if (top < 1)
+				return -EINVAL;
+			stack[top - 1] = expr_chain(reorder,
+				pending[nr_pending].op,
+				pending[nr_pending].left, stack[top - 1]);
+			if (!stack[top - 1])
+				return -ENOMEM;
+		}
+
+		ret = decode_insn(pc, runtime->len - offset, &len, &class);
+		if (ret)
+			return ret;
+		switch (class) {
+		case INSN_PUSH:
+			if (top >= INTERPRETER_STACK_LEN)
+				return -EINVAL;
+			stack[top] = expr_leaf(reorder, NULL, NULL, op,
+				offset, offset + len);
+			if (!stack[top++])
+				return -ENOMEM;
+			break;
+		case INSN_UNARY:
+			if (top < 1)
+				return -EINVAL;
+			stack[top - 1] = expr_leaf(reorder, stack[top - 1], NULL,
+				op, stack[top - 1]->offset, offset + len);
+			if (!stack[top - 1])
+				return -ENOMEM;
+			break;
+		case INSN_BINARY:
+			if (top < 2)
+				return -EINVAL;
+			stack[top - 2] = expr_leaf(reorder, stack[top - 2],
+				stack[top - 1], op, stack[top - 2]->offset,
+				offset + len);
+			if (!stack[top - 2])
+				return -ENOMEM;
+			top--;
+			break;
+		case INSN_LOGICAL:
+		{
+			const struct logical_op *insn = (const struct logical_op *) pc;
+
+			if (top < 1 || nr_pending >= BYTECODE_REORDER_MAX_PENDING)
+				return -EINVAL;
+			if (insn->skip_offset <= offset + len ||
+					insn->skip_offset > runtime->len)
+				return -EINVAL;
+			if (nr_pending && insn->skip_offset >
+					pending[nr_pending - 1].skip_offset)
+				return -EINVAL;
+			pending[nr_pending].left = stack[--top];
+			pending[nr_pending].op = op;
+			pending[nr_pending].skip_offset = insn->skip_offset;
+			nr_pending++;
+			break;
+		}
+		case INSN_RETURN:
+			if (top != 1 || nr_pending)
+				return -EINVAL;
+			reorder->root = stack[0];
+			return 0;
+		}
+		offset += len;
+	}
+	return -EINVAL;
+}
+
+/*
+ * Copy code from the specialized code, relocating the jump targets of
+ * logical operators.
+ */
+static
+void copy_code(const struct bytecode_runtime *runtime, char *dst,
+		uint16_t dst_offset, uint16_t offset, uint16_t len)
+{
+	uint16_t pos = 0;
+
+	memcpy(&dst[dst_offset], &runtime->code[offset], len);
+	while (pos < len) {
+		char *pc = &dst[dst_offset + pos];
+		enum insn_class class;
+		size_t insn_len;
+
+		/* The code has been successfully parsed already. */
+		(void) decode_insn(pc, len - pos, &insn_len, &class);
+		if (class == INSN_LOGICAL) {
+			struct logical_op *insn = (struct logical_op *) pc;
+
+			insn->skip_offset = insn->skip_offset - offset + dst_offset;
+		}
+		pos += insn_len;
+	}
+}
+
+static
+void emit_expr(const struct bytecode_runtime *runtime,
+		const struct reorder_expr *expr, char *dst, uint16_t dst_offset)
+{
+	unsigned int i;
+
+	if (!expr->logical_op) {
+		copy_code(runtime, dst, dst_offset, expr->offset, expr->len);
+		return;
+	}
+	for (i = 0; i < expr->nr_operands; i++) {
+		const struct reorder_expr *operand = expr->operands[i];
+
+		if (i) {
+			struct logical_op insn = {
+				.op = expr->logical_op,
+				.skip_offset = dst_offset + sizeof(insn) + operand->len,
+			};
+
+			memcpy(&dst[dst_offset], &insn, sizeof(insn));
+			dst_offset += sizeof(insn);
+		}
+		emit_expr(runtime, operand, dst, dst_offset);
+		dst_offset += operand->len;
+	}
+}
+
+/*
+ * Standalone filter evaluating a single operand, used for sampling.
+ */
+static
+int create_probe(struct bytecode_runtime *runtime, struct reorder_expr *expr)
+{
+	struct bytecode_runtime *probe;
+	struct return_op ret_insn = { .op = BYTECODE_OP_RETURN_S64 };
+
+	probe = zmalloc(sizeof(*probe) + expr->len + sizeof(ret_insn));
+	if (!probe)
+		return -ENOMEM;
+	probe->p.type = LTTNG_UST_BYTECODE_TYPE_FILTER;
+	probe->p.bc = runtime->p.bc;
+	probe->p.pctx = runtime->p.pctx;
+	/* The runtime data is shared with, and owned by, the runtime. */
+	probe->data = runtime->data;
+	probe->len = expr->len + sizeof(ret_insn);
+	copy_code(runtime, probe->code, 0, expr->offset, expr->len);
+	memcpy(&probe->code[expr->len], &ret_insn, sizeof(ret_insn));
+	probe->exec_code = probe->code;
+	expr->probe = probe;
+	return 0;
+}
+
+/*
+ * Returns the number of reorderable chains within expr. An error
+ * rejects the event: error_is_false tells whether, from where expr
+ * stands, an error cannot be told apart from expr being false.
+ */
+static
+int setup_expr(struct bytecode_runtime *runtime, struct reorder_expr *expr,
+		bool error_is_false)
+{
+	unsigned int i;
+	int ret, nr = 0;
+
+	if (!expr->logical_op)
+		return 0;
+	if (expr->logical_op != BYTECODE_OP_AND)
+		error_is_false = false;
+	expr->reorderable = expr->is_bool && expr->pure &&
+		(!expr->can_fail || error_is_false);
+	if (expr->reorderable) {
+		expr->sorted = zmalloc(expr->nr_operands * sizeof(*expr->sorted));
+		if (!expr->sorted)
+			return -ENOMEM;
+		for (i = 0; i < expr->nr_operands; i++) {
+			ret = create_probe(runtime, expr->operands[i]);
+			if (ret)
+				return ret;
+		}
+		nr++;
+	}
+	for (i = 0; i < expr->nr_operands; i++) {
+		ret = setup_expr(runtime, expr->operands[i], error_is_false);
+		if (ret < 0)
+			return ret;
+		nr += ret;
+	}
+	return nr;
+}
+
+static
+void reorder_destroy(struct bytecode_reorder *reorder)
+{
+	struct reorder_expr *expr, *next;
+
+	for (expr = reorder->exprs; expr; expr = next) {
+		next = expr->next;
+		free(expr->probe);
+		free(expr->operands);
+		free(expr->sorted);
+		free(expr);
+	}
+	free(reorder->buffers);
+	free(reorder);
+}
+
+static
+void *reorder_thread_func(void *arg);
+
+/*
+ * Called with the reorder mutex held.
+ */
+static
+int reorder_thread_start(void)
+{
+	sigset_t sig_all_blocked, orig_mask;
+	int ret, ret_mask;
+
+	if (reorder_thread_started)
+		return 0;
+	if (reorder_thread_quit)
+		return -EPERM;
+	sigfillset(&sig_all_blocked);
+	ret = pthread_sigmask(SIG_SETMASK, &sig_all_blocked, &orig_mask);
+	if (ret) {
+		ERR("pthread_sigmask: %s", strerror(ret));
+		return -ret;
+	}
+	ret = pthread_create(&reorder_thread, NULL, reorder_thread_func, NULL);
+	if (ret) {
+		ERR("pthread_create: %s", strerror(ret));
+	} else {
+		reorder_thread_started = true;
+	}
+	ret_mask = pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
+	if (ret_mask)
+		ERR("pthread_sigmask: %s", strerror(ret_mask));
+	return -ret;
+}
+
+/*
+ * Called once the bytecode is specialized. Failure to analyze the
+ * bytecode only disables the reordering.
+ */
+void lttng_bytecode_reorder_init(struct bytecode_runtime *runtime)
+{
+	struct bytecode_reorder *reorder;
+	int ret;
+
+	if (runtime->p.type != LTTNG_UST_BYTECODE_TYPE_FILTER)
+		return;
+	reorder = zmalloc(sizeof(*reorder));
+	if (!reorder)
+		return;
+	reorder->runtime = runtime;
+	ret = parse_code(runtime, reorder);
+	if (ret) {
+		dbg_printf("Bytecode not reorderable: %d\n", ret);
+		goto error;
+	}
+	ret = setup_expr(runtime, reorder->root, true);
+	if (ret <= 0)
+		goto error;
+	reorder->buffers = zmalloc(2 * runtime->len);
+	if (!reorder->buffers)
+		goto error;
+	dbg_printf("Bytecode has %d reorderable chains\n", ret);
+	pthread_mutex_lock(&reorder_mutex);
+	if (reorder_thread_start()) {
+		pthread_mutex_unlock(&reorder_mutex);
+		goto error;
+	}
+	cds_list_add(&reorder->node, &reorder_list);
+	pthread_mutex_unlock(&reorder_mutex);
+	runtime->reorder = reorder;
+	return;
+
+error:
+	reorder_destroy(reorder);
+}
+
+/*
+ * Called after a grace period following the removal of the runtime
+ * from its event, so no sampler can still use it.
+ */
+void lttng_bytecode_reorder_destroy(struct bytecode_runtime *runtime)
+{
+	struct bytecode_reorder *reorder = runtime->reorder;
+
+	if (!reorder)
+		return;
+	pthread_mutex_lock(&reorder_mutex);
+	cds_list_del(&reorder->node);
+	pthread_mutex_unlock(&reorder_mutex);
+	reorder_destroy(reorder);
+}
+
+static
+void sample_expr(struct reorder_expr *expr, const char *stack_data,
+		struct lttng_ust_probe_ctx *probe_ctx)
+{
+	unsigned int i;
+
+	if (!expr->logical_op)
+		return;
+	for (i = 0; i < expr->nr_operands; i++) {
+		struct reorder_expr *operand = expr->operands[i];
+
+		if (expr->reorderable) {
+			struct lttng_ust_bytecode_filter_ctx filter_ctx;
+			uint64_t start;
+			int ret;
+
+			start = trace_clock_read64_monotonic();
+			ret = lttng_bytecode_interpret(&operand->probe->p,
+				stack_data, probe_ctx, &filter_ctx);
+			operand->time_ns += trace_clock_read64_monotonic() - start;
+			operand->nr_samples++;
+			/* Errors make an AND chain reject the event, as false. */
+			if (ret == LTTNG_UST_BYTECODE_INTERPRETER_OK &&
+					filter_ctx.result == LTTNG_UST_BYTECODE_FILTER_ACCEPT)
+				operand->nr_true++;
+		}
+		sample_expr(operand, stack_data, probe_ctx);
+	}
+}
+
+/*
+ * Probability that evaluating the chain continues after the operand:
+ * operand true for AND, false for OR.
+ */
+static
+double operand_pass(const struct reorder_expr *chain,
+		const struct reorder_expr *operand)
+{
+	double p_true = (operand->nr_true + 1.0) / (operand->nr_samples + 2.0);
+
+	return chain->logical_op == BYTECODE_OP_AND ? p_true : 1.0 - p_true;
+}
+
+static
+double operand_cost(const struct reorder_expr *operand)
+{
+	if (!operand->nr_samples)
+		return 0;
+	return (double) operand->time_ns / operand->nr_samples;
+}
+
+/*
+ * Cheapest and most selective first: increasing cost / (1 - pass).
+ */
+static
+double operand_rank(const struct reorder_expr *chain,
+		const struct reorder_expr *operand)
+{
+	return operand_cost(operand) / (1.0 - operand_pass(chain, operand));
+}
+
+static
+double chain_cost(const struct reorder_expr *chain,
+		struct reorder_expr * const *operands)
+{
+	double cost = 0, pass = 1;
+	unsigned int i;
+
+	for (i = 0; i < chain->nr_operands; i++) {
+		cost += pass * operand_cost(operands[i]);
+		pass *= operand_pass(chain, operands[i]);
+	}
+	return cost;
+}
+
+/*
+ * Returns whether the order of the operands of expr, or of a nested
+ * chain, changed.
+ */
+static
+bool update_expr(struct reorder_expr *expr)
+{
+	bool changed = false;
+	unsigned int i, j;
+
+	if (!expr->logical_op)
+		return false;
+	if (expr->reorderable) {
+		struct reorder_expr **sorted = expr->sorted;
+
+		/* Stable insertion sort, operands are few. */
+		for (i = 0; i < expr->nr_operands; i++) {
+			struct reorder_expr *operand = expr->operands[i];
+			double rank = operand_rank(expr, operand);
+
+			for (j = i; j > 0 && operand_rank(expr, sorted[j - 1]) > rank; j--)
+				sorted[j] = sorted[j - 1];
+			sorted[j] = operand;
+		}
+		/* Require a significant gain to avoid oscillations. */
+		if (chain_cost(expr, sorted) < chain_cost(expr, expr->operands) * 0.875) {
+			memcpy(expr->operands, sorted,
+				expr->nr_operands * sizeof(*sorted));
+			changed = true;
+		}
+		/* Decay, so that the order follows workload changes. */
+		for (i = 0; i < expr->nr_operands; i++) {
+			expr->operands[i]->nr_samples >>= 1;
+			expr->operands[i]->nr_true >>= 1;
+			expr->operands[i]->time_ns >>= 1;
+		}
+	}
+	for (i = 0; i < expr->nr_operands; i++)
+		changed |= update_expr(expr->operands[i]);
+	return changed;
+}
+
+/*
+ * Emit the updated order of the operands into the code buffer which is
+ * not published, and publish it. Returns whether the code changed.
+ */
+static
+bool reorder_update(struct bytecode_reorder *reorder)
+{
+	struct bytecode_runtime *runtime = reorder->runtime;
+	char *code = reorder->buffers;
+
+	if (!update_expr(reorder->root))
+		return false;
+	/* The other buffer is unused since the last grace period. */
+	if (runtime->exec_code == code)
+		code += runtime->len;
+	memcpy(code, runtime->code, runtime->len);
+	emit_expr(runtime, reorder->root, code, reorder->root->offset);
+	lttng_ust_rcu_assign_pointer(runtime->exec_code, code);
+	dbg_printf("Bytecode reordered\n");
+	return true;
+}
+
+/*
+ * Update the runtimes whose samplers gathered enough samples. A runtime
+ * busy sampling is updated on the next period.
+ */
+static
+void reorder_update_pending(void)
+{
+	struct bytecode_reorder *reorder;
+	bool published = false;
+
+	cds_list_for_each_entry(reorder, &reorder_list, node) {
+		if (!CMM_LOAD_SHARED(reorder->update_pending))
+			continue;
+		if (uatomic_cmpxchg(&reorder->busy, 0, 1))
+			continue;
+		published |= reorder_update(reorder);
+		CMM_STORE_SHARED(reorder->update_pending, 0);
+		cmm_smp_mb();
+		uatomic_set(&reorder->busy, 0);
+	}
+	/* Superseded code buffers are reused after a grace period. */
+	if (published)
+		lttng_ust_urcu_synchronize_rcu();
+}
+
+/*
+ * Only cancelled while sleeping, outside of the reorder mutex and of
+ * grace periods.
+ */
+static
+void *reorder_thread_func(void *arg __attribute__((unused)))
+{
+	struct timespec delay = {
+		.tv_sec = BYTECODE_REORDER_UPDATE_PERIOD_MS / 1000,
+		.tv_nsec = (BYTECODE_REORDER_UPDATE_PERIOD_MS % 1000) * 1000000L,
+	};
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	for (;;) {
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		(void) nanosleep(&delay, NULL);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		pthread_mutex_lock(&reorder_mutex);
+		if (reorder_thread_quit) {
+			pthread_mutex_unlock(&reorder_mutex);
+			break;
+		}
+		reorder_update_pending();
+		pthread_mutex_unlock(&reorder_mutex);
+	}
+	return NULL;
+}
+
+/*
+ * Pseudo-random sampling countdown, averaging the sample period. The
+ * jitter avoids always sampling the same filter of a thread
+ * evaluating several filters in turn.
+ */
+static
+unsigned int reorder_next_countdown(void)
+{
+	uint32_t x = URCU_TLS(reorder_rand);
+
+	if (caa_unlikely(!x))
+		x = (uint32_t) (uintptr_t) &URCU_TLS(reorder_rand) | 1;
+	/* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	URCU_TLS(reorder_rand) = x;
+	return BYTECODE_REORDER_SAMPLE_PERIOD / 2 +
+		(x & (BYTECODE_REORDER_SAMPLE_PERIOD - 1));
+}
+
+/*
+ * Called on each evaluation of a reorderable filter.
+ */
+void lttng_bytecode_reorder_sample(struct bytecode_runtime *runtime,
+		const char *stack_data, struct lttng_ust_probe_ctx *probe_ctx)
+{
+	struct bytecode_reorder *reorder = runtime->reorder;
+
+	if (caa_likely(URCU_TLS(reorder_countdown)--))
+		return;
+	URCU_TLS(reorder_countdown) = reorder_next_countdown();
+	/* Keep the statistics until the reorder thread uses them. */
+	if (CMM_LOAD_SHARED(reorder->update_pending))
+		return;
+	/* One sampler at a time. */
+	if (uatomic_cmpxchg(&reorder->busy, 0, 1))
+		return;
+	sample_expr(reorder->root, stack_data, probe_ctx);
+	if (!(++reorder->nr_samples % BYTECODE_REORDER_NR_SAMPLES))
+		CMM_STORE_SHARED(reorder->update_pending, 1);
+	cmm_smp_mb();
+	uatomic_set(&reorder->busy, 0);
+}
+
+/*
+ * Force a read (imply TLS allocation for dlopen) of TLS variables.
+ */
+void lttng_bytecode_reorder_alloc_tls(void)
+{
+	asm volatile ("" : : "m" (URCU_TLS(reorder_countdown)));
+	asm volatile ("" : : "m" (URCU_TLS(reorder_rand)));
+}
+
+/*
+ * The reorder mutex is held across fork, and nests outside of the RCU
+ * grace period lock, as in the reorder thread.
+ */
+void lttng_bytecode_reorder_lock(void)
+{
+	pthread_mutex_lock(&reorder_mutex);
+}
+
+void lttng_bytecode_reorder_unlock(void)
+{
+	pthread_mutex_unlock(&reorder_mutex);
+}
+
+/*
+ * The reorder thread does not exist in the child: it is started again
+ * when a reorderable filter is linked.
+ */
+void lttng_bytecode_reorder_after_fork_child(void)
+{
+	reorder_thread_started = false;
+	pthread_mutex_unlock(&reorder_mutex);
+}
+
+void lttng_bytecode_reorder_exit(void)
+{
+	int ret;
+
+	pthread_mutex_lock(&reorder_mutex);
+	reorder_thread_quit = true;
+	if (reorder_thread_started) {
+		ret = pthread_cancel(reorder_thread);
+		if (ret)
+			ERR("Error cancelling bytecode reorder thread: %s",
+				strerror(ret));
+		reorder_thread_started = false;
+	}
+	pthread_mutex_unlock(&reorder_mutex);
+}
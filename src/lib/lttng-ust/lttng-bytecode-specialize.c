@@ -626,6 +626,24 @@ end:
 	return ret;
 }
 
+/*
+ * Build the set lookup table once, so evaluating the set membership
+ * does not depend on the number of elements in the set.
+ */
+static int specialize_set(struct bytecode_runtime *runtime,
+		struct set_op *insn)
+{
+	ssize_t data_offset;
+
+	data_offset = bytecode_reserve_data(runtime,
+		__alignof__(struct bytecode_set_table),
+		lttng_bytecode_set_table_len(insn));
+	if (data_offset < 0)
+		return -EINVAL;
+	insn->table_offset = data_offset;
+	return lttng_bytecode_set_table_init(runtime, insn);
+}
+
 int lttng_bytecode_specialize(const struct lttng_ust_event_desc *event_desc,
 		struct bytecode_runtime *bytecode)
 {
@@ -1466,6 +1484,51 @@ int lttng_bytecode_specialize(const struct lttng_ust_event_desc *event_desc,
 			break;
 		}
 
+		/* set membership */
+		case BYTECODE_OP_IN_SET_S64:
+		case BYTECODE_OP_IN_SET_STRING:
+		{
+			struct set_op *insn = (struct set_op *) pc;
+
+			dbg_printf("op in set, %u elements\n",
+				(unsigned int) insn->nr_elem);
+			/*
+			 * Field loads are typed by now: reject operands the
+			 * interpreter would only refuse at runtime.
+			 */
+			switch (vstack_ax(stack)->type) {
+			case REG_S64:
+			case REG_U64:
+				if (insn->op != BYTECODE_OP_IN_SET_S64) {
+					ERR("String set membership applied to an integer register\n");
+					ret = -EINVAL;
+					goto end;
+				}
+				break;
+			case REG_STRING:
+				if (insn->op != BYTECODE_OP_IN_SET_STRING) {
+					ERR("Integer set membership applied to a string register\n");
+					ret = -EINVAL;
+					goto end;
+				}
+				break;
+			case REG_UNKNOWN:
+			case REG_PTR:	/* Enumerations, loaded dynamically. */
+				break;
+			default:
+				ERR("invalid register type for set membership\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			ret = specialize_set(bytecode, insn);
+			if (ret)
+				goto end;
+			/* Pop 1, push 1 */
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct set_op) + insn->data_len;
+			break;
+		}
+
 		}
 	}
 end:
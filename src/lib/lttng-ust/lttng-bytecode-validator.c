@@ -268,6 +268,37 @@ int validate_get_symbol(struct bytecode_runtime *bytecode,
 	return 0;
 }
 
+/*
+ * The set elements must exactly fill the data_len bytes following the
+ * instruction, which have been checked to be within range.
+ */
+static
+int validate_set(const struct set_op *insn)
+{
+	const char *str = insn->data, *str_limit = insn->data + insn->data_len;
+	unsigned int i;
+
+	switch (insn->op) {
+	case BYTECODE_OP_IN_SET_S64:
+		if (insn->data_len != insn->nr_elem * sizeof(int64_t))
+			return -EINVAL;
+		return 0;
+	case BYTECODE_OP_IN_SET_STRING:
+		for (i = 0; i < insn->nr_elem; i++) {
+			size_t len_limit = str_limit - str;
+
+			if (strnlen(str, len_limit) == len_limit)
+				return -EINVAL;
+			str += strlen(str) + 1;
+		}
+		if (str != str_limit)
+			return -EINVAL;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 /*
  * Validate bytecode range overflow within the validation pass.
  * Called for each instruction encountered.
@@ -524,6 +555,26 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 			ret = -ERANGE;
 		}
 		break;
+
+	/* set membership */
+	case BYTECODE_OP_IN_SET_S64:
+	case BYTECODE_OP_IN_SET_STRING:
+	{
+		struct set_op *insn = (struct set_op *) pc;
+
+		if (unlikely(pc + sizeof(struct set_op)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+			break;
+		}
+		if (unlikely(pc + sizeof(struct set_op) + insn->data_len
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+			break;
+		}
+		ret = validate_set(insn);
+		break;
+	}
 	}
 
 	return ret;
@@ -1195,6 +1246,45 @@ int validate_instruction_context(
 		dbg_printf("Validate get index u64 index %" PRIu64 "\n", get_index->index);
 		break;
 	}
+
+	/* set membership */
+	case BYTECODE_OP_IN_SET_S64:
+	{
+		if (!vstack_ax(stack)) {
+			ERR("Empty stack\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		switch (vstack_ax(stack)->type) {
+		case REG_S64:
+		case REG_U64:
+		case REG_UNKNOWN:
+			break;
+		default:
+			ERR("Integer set membership can only be applied to integer registers\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
+	case BYTECODE_OP_IN_SET_STRING:
+	{
+		if (!vstack_ax(stack)) {
+			ERR("Empty stack\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		switch (vstack_ax(stack)->type) {
+		case REG_STRING:
+		case REG_UNKNOWN:
+			break;
+		default:
+			ERR("String set membership can only be applied to string registers\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
 	}
 end:
 	return ret;
@@ -1933,6 +2023,23 @@ int exec_insn(struct bytecode_runtime *bytecode __attribute__((unused)),
 		break;
 	}
 
+	/* set membership */
+	case BYTECODE_OP_IN_SET_S64:
+	case BYTECODE_OP_IN_SET_STRING:
+	{
+		struct set_op *insn = (struct set_op *) pc;
+
+		/* Pop 1, push 1 */
+		if (!vstack_ax(stack)) {
+			ERR("Empty stack\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct set_op) + insn->data_len;
+		break;
+	}
+
 	}
 end:
 	*_next_pc = next_pc;
@@ -15,6 +15,7 @@
 #include "context-internal.h"
 #include "lttng-bytecode.h"
 #include "lib/lttng-ust/events.h"
+#include "common/jhash.h"
 #include "common/macros.h"
 #include "common/tracer.h"
 
@@ -162,6 +163,10 @@ static const char *opnames[] = {
 	[ BYTECODE_OP_UNARY_BIT_NOT ] = "UNARY_BIT_NOT",
 
 	[ BYTECODE_OP_RETURN_S64 ] = "RETURN_S64",
+
+	/* set membership */
+	[ BYTECODE_OP_IN_SET_S64 ] = "IN_SET_S64",
+	[ BYTECODE_OP_IN_SET_STRING ] = "IN_SET_STRING",
 };
 
 const char *lttng_bytecode_print_op(enum bytecode_op op)
@@ -172,6 +177,120 @@ const char *lttng_bytecode_print_op(enum bytecode_op op)
 		return opnames[op];
 }
 
+static
+uint32_t set_nr_buckets(const struct set_op *insn)
+{
+	uint32_t nr_buckets = 1;
+
+	while (nr_buckets < 2U * insn->nr_elem)
+		nr_buckets <<= 1;
+	return nr_buckets;
+}
+
+static
+uint32_t set_hash_s64(int64_t v)
+{
+	return jhash(&v, sizeof(v), 0);
+}
+
+static
+int64_t set_elem_s64(const struct set_op *insn, uint16_t offset)
+{
+	int64_t v;
+
+	memcpy(&v, (const char *) insn + offset, sizeof(v));
+	return v;
+}
+
+/*
+ * Length of the set lookup table for this instruction, in bytes.
+ */
+size_t lttng_bytecode_set_table_len(const struct set_op *insn)
+{
+	return sizeof(struct bytecode_set_table) +
+		set_nr_buckets(insn) * sizeof(uint16_t);
+}
+
+/*
+ * Populate the set lookup table of an instruction, reserved within the
+ * runtime data at insn->table_offset. Elements are referred to by their
+ * offset from the start of the instruction, so the table remains valid
+ * if the instruction is moved within the code.
+ */
+int lttng_bytecode_set_table_init(struct bytecode_runtime *runtime,
+		const struct set_op *insn)
+{
+	struct bytecode_set_table *table =
+		(struct bytecode_set_table *) &runtime->data[insn->table_offset];
+	const char *elem = insn->data;
+	unsigned int i;
+
+	table->mask = set_nr_buckets(insn) - 1;
+	memset(table->buckets, 0, (table->mask + 1) * sizeof(uint16_t));
+	for (i = 0; i < insn->nr_elem; i++) {
+		uint16_t offset = elem - (const char *) insn;
+		uint32_t hash;
+		size_t len;
+
+		switch (insn->op) {
+		case BYTECODE_OP_IN_SET_S64:
+			len = sizeof(int64_t);
+			hash = set_hash_s64(set_elem_s64(insn, offset));
+			break;
+		case BYTECODE_OP_IN_SET_STRING:
+			len = strlen(elem) + 1;
+			hash = jhash(elem, len - 1, 0);
+			break;
+		default:
+			return -EINVAL;
+		}
+		while (table->buckets[hash & table->mask])
+			hash++;
+		table->buckets[hash & table->mask] = offset;
+		elem += len;
+	}
+	return 0;
+}
+
+int lttng_bytecode_set_contains_s64(const struct bytecode_runtime *runtime,
+		const struct set_op *insn, int64_t v)
+{
+	const struct bytecode_set_table *table =
+		(const struct bytecode_set_table *) &runtime->data[insn->table_offset];
+	uint32_t hash = set_hash_s64(v);
+	uint16_t offset;
+
+	while ((offset = table->buckets[hash & table->mask])) {
+		if (set_elem_s64(insn, offset) == v)
+			return 1;
+		hash++;
+	}
+	return 0;
+}
+
+/*
+ * The string ends at the first null character or after seq_len
+ * characters, whichever comes first.
+ */
+int lttng_bytecode_set_contains_string(const struct bytecode_runtime *runtime,
+		const struct set_op *insn, const char *str, size_t seq_len)
+{
+	const struct bytecode_set_table *table =
+		(const struct bytecode_set_table *) &runtime->data[insn->table_offset];
+	size_t len = strnlen(str, seq_len);
+	uint32_t hash = jhash(str, len, 0);
+	uint16_t offset;
+
+	while ((offset = table->buckets[hash & table->mask])) {
+		const char *elem = (const char *) insn + offset;
+
+		if (!strncmp(elem, str, len) && elem[len] == '\0')
+			return 1;
+		hash++;
+	}
+	return 0;
+}
+
 static
 int apply_field_reloc(const struct lttng_ust_event_desc *event_desc,
 		struct bytecode_runtime *runtime,
@@ -458,6 +577,7 @@ int link_bytecode(const struct lttng_ust_event_desc *event_desc,
 	runtime->len = bytecode->bc.reloc_offset;
 	/* copy original bytecode */
 	memcpy(runtime->code, bytecode->bc.data, runtime->len);
+	runtime->exec_code = runtime->code;
 	/*
 	 * apply relocs. Those are a uint16_t (offset in bytecode)
 	 * followed by a string (field name).
@@ -486,6 +606,8 @@ int link_bytecode(const struct lttng_ust_event_desc *event_desc,
 	if (ret) {
 		goto link_error;
 	}
+	/* Adaptive reordering of logical operands, if applicable. */
+	lttng_bytecode_reorder_init(runtime);
 
 	runtime->p.interpreter_func = lttng_bytecode_interpret;
 	runtime->p.link_failed = 0;
@@ -585,6 +707,7 @@ void free_filter_runtime(struct cds_list_head *bytecode_runtime_head)
 
 	cds_list_for_each_entry_safe(runtime, tmp, bytecode_runtime_head,
 			p.node) {
+		lttng_bytecode_reorder_destroy(runtime);
 		free(runtime->data);
 		free(runtime);
 	}
@@ -64,10 +64,23 @@ struct bytecode_runtime {
 	size_t data_len;
 	size_t data_alloc_len;
 	char *data;
+	char *exec_code;	/* RCU-protected code run by the interpreter. */
+	struct bytecode_reorder *reorder;	/* NULL if not reorderable. */
 	uint16_t len;
 	char code[0];
 };
 
+/*
+ * Set membership lookup table, built at link time in the runtime data.
+ * Open addressing with linear probing, kept at most half full. Each
+ * bucket holds the offset of a set element from the start of its
+ * instruction, or 0 if empty.
+ */
+struct bytecode_set_table {
+	uint32_t mask;		/* Number of buckets - 1. */
+	uint16_t buckets[];
+};
+
 enum entry_type {
 	REG_S64,
 	REG_U64,
@@ -321,6 +334,21 @@ const char *lttng_bytecode_print_op(enum bytecode_op op)
 void lttng_bytecode_sync_state(struct lttng_ust_bytecode_runtime *runtime)
 	__attribute__((visibility("hidden")));
 
+size_t lttng_bytecode_set_table_len(const struct set_op *insn)
+	__attribute__((visibility("hidden")));
+
+int lttng_bytecode_set_table_init(struct bytecode_runtime *runtime,
+		const struct set_op *insn)
+	__attribute__((visibility("hidden")));
+
+int lttng_bytecode_set_contains_s64(const struct bytecode_runtime *runtime,
+		const struct set_op *insn, int64_t v)
+	__attribute__((visibility("hidden")));
+
+int lttng_bytecode_set_contains_string(const struct bytecode_runtime *runtime,
+		const struct set_op *insn, const char *str, size_t seq_len)
+	__attribute__((visibility("hidden")));
+
 int lttng_bytecode_validate(struct bytecode_runtime *bytecode)
 	__attribute__((visibility("hidden")));
 
@@ -328,6 +356,17 @@ int lttng_bytecode_specialize(const struct lttng_ust_event_desc *event_desc,
 		struct bytecode_runtime *bytecode)
 	__attribute__((visibility("hidden")));
 
+void lttng_bytecode_reorder_init(struct bytecode_runtime *runtime)
+	__attribute__((visibility("hidden")));
+
+void lttng_bytecode_reorder_sample(struct bytecode_runtime *runtime,
+		const char *stack_data,
+		struct lttng_ust_probe_ctx *probe_ctx)
+	__attribute__((visibility("hidden")));
+
+void lttng_bytecode_reorder_destroy(struct bytecode_runtime *runtime)
+	__attribute__((visibility("hidden")));
+
 int lttng_bytecode_interpret_error(struct lttng_ust_bytecode_runtime *bytecode_runtime,
 		const char *stack_data,
 		struct lttng_ust_probe_ctx *probe_ctx,
@@ -29,6 +29,12 @@
  */
 static DEFINE_URCU_TLS_INIT(ino_t, cached_ipc_ns, NS_INO_UNINITIALIZED);
 
+/*
+ * Process-wide copy of the cache, inherited by threads on their first
+ * event so they don't each stat(2) the proc filesystem.
+ */
+static ino_t cached_ipc_ns_process = NS_INO_UNINITIALIZED;
+
 static
 ino_t get_ipc_ns(void)
 {
@@ -44,6 +50,11 @@ ino_t get_ipc_ns(void)
 	if (caa_likely(ipc_ns != NS_INO_UNINITIALIZED))
 		return ipc_ns;
 
+	ipc_ns = lttng_context_ns_cache_inherit(&URCU_TLS(cached_ipc_ns),
+			&cached_ipc_ns_process);
+	if (caa_likely(ipc_ns != NS_INO_UNINITIALIZED))
+		return ipc_ns;
+
 	/*
 	 * At this point we have to populate the cache, set the initial
 	 * value to NS_INO_UNAVAILABLE (0), if we fail to get the inode
@@ -75,6 +86,8 @@ ino_t get_ipc_ns(void)
 	 */
 	CMM_STORE_SHARED(URCU_TLS(cached_ipc_ns), ipc_ns);
 
+	lttng_context_ns_cache_publish(&cached_ipc_ns_process, ipc_ns);
+
 	return ipc_ns;
 }
 
@@ -87,6 +100,7 @@ ino_t get_ipc_ns(void)
 void lttng_context_ipc_ns_reset(void)
 {
 	CMM_STORE_SHARED(URCU_TLS(cached_ipc_ns), NS_INO_UNINITIALIZED);
+	CMM_STORE_SHARED(cached_ipc_ns_process, NS_INO_UNINITIALIZED);
 }
 
 static
@@ -29,6 +29,12 @@
  */
 static DEFINE_URCU_TLS_INIT(ino_t, cached_net_ns, NS_INO_UNINITIALIZED);
 
+/*
+ * Process-wide copy of the cache, inherited by threads on their first
+ * event so they don't each stat(2) the proc filesystem.
+ */
+static ino_t cached_net_ns_process = NS_INO_UNINITIALIZED;
+
 static
 ino_t get_net_ns(void)
 {
@@ -44,6 +50,11 @@ ino_t get_net_ns(void)
 	if (caa_likely(net_ns != NS_INO_UNINITIALIZED))
 		return net_ns;
 
+	net_ns = lttng_context_ns_cache_inherit(&URCU_TLS(cached_net_ns),
+			&cached_net_ns_process);
+	if (caa_likely(net_ns != NS_INO_UNINITIALIZED))
+		return net_ns;
+
 	/*
 	 * At this point we have to populate the cache, set the initial
 	 * value to NS_INO_UNAVAILABLE (0), if we fail to get the inode
@@ -75,6 +86,8 @@ ino_t get_net_ns(void)
 	 */
 	CMM_STORE_SHARED(URCU_TLS(cached_net_ns), net_ns);
 
+	lttng_context_ns_cache_publish(&cached_net_ns_process, net_ns);
+
 	return net_ns;
 }
 
@@ -87,6 +100,7 @@ ino_t get_net_ns(void)
 void lttng_context_net_ns_reset(void)
 {
 	CMM_STORE_SHARED(URCU_TLS(cached_net_ns), NS_INO_UNINITIALIZED);
+	CMM_STORE_SHARED(cached_net_ns_process, NS_INO_UNINITIALIZED);
 }
 
 static
@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * LTTng UST repeat context.
+ *
+ * Adding this context to a channel enables the folding of identical
+ * consecutive events: a record whose payload and contexts match the
+ * previous record of the same stream is not written, the repeat_count
+ * of the previous record is incremented and its repeat_last_timestamp
+ * set to the time of the folded event instead. The fields are recorded
+ * first in the channel context, so the compared part of the records
+ * starts at the same alignment. With per-UID buffers, a process killed
+ * while folding a record stops the folding in its stream until the
+ * stream is destroyed, see lttng_event_fold().
+ */
+
+#define _LGPL_SOURCE
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lttng/ust-events.h>
+#include <lttng/ust-tracer.h>
+#include <lttng/ust-ringbuffer-context.h>
+
+#include "common/ringbuffer/frontend_types.h"
+
+#include "context-internal.h"
+
+static
+size_t repeat_get_size(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx __attribute__((unused)),
+		size_t offset)
+{
+	size_t size = 0;
+
+	size += lttng_ust_ring_buffer_align(offset, lttng_ust_rb_alignof(uint64_t));
+	size += sizeof(uint64_t);
+	return size;
+}
+
+static
+void repeat_count_record(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx __attribute__((unused)),
+		struct lttng_ust_ring_buffer_ctx *ctx,
+		struct lttng_ust_channel_buffer *chan)
+{
+	uint64_t count = 0;
+
+	lttng_ust_ring_buffer_align_ctx(ctx, lttng_ust_rb_alignof(count));
+	/* Start of the part of the record compared by the client. */
+	ctx->priv->fold_offset = ctx->priv->buf_offset;
+	chan->ops->event_write(ctx, &count, sizeof(count), lttng_ust_rb_alignof(count));
+}
+
+static
+void repeat_last_timestamp_record(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx __attribute__((unused)),
+		struct lttng_ust_ring_buffer_ctx *ctx,
+		struct lttng_ust_channel_buffer *chan)
+{
+	uint64_t timestamp = ctx->priv->tsc;
+
+	chan->ops->event_write(ctx, &timestamp, sizeof(timestamp),
+			lttng_ust_rb_alignof(timestamp));
+}
+
+static
+void repeat_get_value(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx __attribute__((unused)),
+		struct lttng_ust_ctx_value *value)
+{
+	value->u.s64 = 0;
+}
+
+static const struct lttng_ust_ctx_field *count_field = lttng_ust_static_ctx_field(
+	lttng_ust_static_event_field("repeat_count",
+		lttng_ust_static_type_integer(sizeof(uint64_t) * CHAR_BIT,
+				lttng_ust_rb_alignof(uint64_t) * CHAR_BIT,
+				lttng_ust_is_signed_type(uint64_t),
+				LTTNG_UST_BYTE_ORDER, 10),
+		false, false),
+	repeat_get_size,
+	repeat_count_record,
+	repeat_get_value,
+	NULL, NULL);
+
+static const struct lttng_ust_ctx_field *last_timestamp_field = lttng_ust_static_ctx_field(
+	lttng_ust_static_event_field("repeat_last_timestamp",
+		lttng_ust_static_type_integer(sizeof(uint64_t) * CHAR_BIT,
+				lttng_ust_rb_alignof(uint64_t) * CHAR_BIT,
+				lttng_ust_is_signed_type(uint64_t),
+				LTTNG_UST_BYTE_ORDER, 10),
+		false, false),
+	repeat_get_size,
+	repeat_last_timestamp_record,
+	repeat_get_value,
+	NULL, NULL);
+
+int lttng_add_repeat_to_ctx(struct lttng_ust_ctx **ctx)
+{
+	struct lttng_ust_ctx_field fields[2];
+
+	if (lttng_find_context(*ctx, count_field->event_field->name))
+		return -EEXIST;
+	fields[0] = *count_field;
+	fields[1] = *last_timestamp_field;
+	return lttng_ust_context_prepend(ctx, fields, 2);
+}
@@ -29,6 +29,12 @@
  */
 static DEFINE_URCU_TLS_INIT(ino_t, cached_time_ns, NS_INO_UNINITIALIZED);
 
+/*
+ * Process-wide copy of the cache, inherited by threads on their first
+ * event so they don't each stat(2) the proc filesystem.
+ */
+static ino_t cached_time_ns_process = NS_INO_UNINITIALIZED;
+
 static
 ino_t get_time_ns(void)
 {
@@ -44,6 +50,11 @@ ino_t get_time_ns(void)
 	if (caa_likely(time_ns != NS_INO_UNINITIALIZED))
 		return time_ns;
 
+	time_ns = lttng_context_ns_cache_inherit(&URCU_TLS(cached_time_ns),
+			&cached_time_ns_process);
+	if (caa_likely(time_ns != NS_INO_UNINITIALIZED))
+		return time_ns;
+
 	/*
 	 * At this point we have to populate the cache, set the initial
 	 * value to NS_INO_UNAVAILABLE (0), if we fail to get the inode
@@ -75,6 +86,8 @@ ino_t get_time_ns(void)
 	 */
 	CMM_STORE_SHARED(URCU_TLS(cached_time_ns), time_ns);
 
+	lttng_context_ns_cache_publish(&cached_time_ns_process, time_ns);
+
 	return time_ns;
 }
 
@@ -86,6 +99,7 @@ ino_t get_time_ns(void)
 void lttng_context_time_ns_reset(void)
 {
 	CMM_STORE_SHARED(URCU_TLS(cached_time_ns), NS_INO_UNINITIALIZED);
+	CMM_STORE_SHARED(cached_time_ns_process, NS_INO_UNINITIALIZED);
 }
 
 static
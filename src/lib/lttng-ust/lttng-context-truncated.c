@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * LTTng UST truncated context.
+ *
+ * Number of string and sequence fields of the event payload which were
+ * cut to the max_payload_len of the event, saturated at 255. The fields
+ * are measured before the record is reserved, so the count is known
+ * when the context is recorded. It is always 0 for filters, which run
+ * before the payload is measured.
+ */
+
+#define _LGPL_SOURCE
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lttng/ust-events.h>
+#include <lttng/ust-tracer.h>
+#include <lttng/ust-ringbuffer-context.h>
+
+#include "common/macros.h"
+
+#include "context-internal.h"
+
+static
+uint8_t get_truncated(struct lttng_ust_probe_ctx *probe_ctx)
+{
+	/* Probes built before the payload length limit do not count. */
+	if (probe_ctx->struct_size < offsetof(struct lttng_ust_probe_ctx, nr_truncated)
+			+ sizeof(probe_ctx->nr_truncated))
+		return 0;
+	return min_t(uint32_t, probe_ctx->nr_truncated, UINT8_MAX);
+}
+
+static
+size_t truncated_get_size(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx __attribute__((unused)),
+		size_t offset)
+{
+	size_t size = 0;
+
+	size += lttng_ust_ring_buffer_align(offset, lttng_ust_rb_alignof(uint8_t));
+	size += sizeof(uint8_t);
+	return size;
+}
+
+static
+void truncated_record(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx,
+		struct lttng_ust_ring_buffer_ctx *ctx,
+		struct lttng_ust_channel_buffer *chan)
+{
+	uint8_t truncated;
+
+	truncated = get_truncated(probe_ctx);
+	chan->ops->event_write(ctx, &truncated, sizeof(truncated),
+			lttng_ust_rb_alignof(truncated));
+}
+
+static
+void truncated_get_value(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx,
+		struct lttng_ust_ctx_value *value)
+{
+	value->u.s64 = get_truncated(probe_ctx);
+}
+
+static const struct lttng_ust_ctx_field *ctx_field = lttng_ust_static_ctx_field(
+	lttng_ust_static_event_field("truncated",
+		lttng_ust_static_type_integer(sizeof(uint8_t) * CHAR_BIT,
+				lttng_ust_rb_alignof(uint8_t) * CHAR_BIT,
+				lttng_ust_is_signed_type(uint8_t),
+				LTTNG_UST_BYTE_ORDER, 10),
+		false, false),
+	truncated_get_size,
+	truncated_record,
+	truncated_get_value,
+	NULL, NULL);
+
+int lttng_add_truncated_to_ctx(struct lttng_ust_ctx **ctx)
+{
+	int ret;
+
+	if (lttng_find_context(*ctx, ctx_field->event_field->name)) {
+		ret = -EEXIST;
+		goto error_find_context;
+	}
+	ret = lttng_ust_context_append(ctx, ctx_field);
+	if (ret)
+		return ret;
+	return 0;
+
+error_find_context:
+	return ret;
+}
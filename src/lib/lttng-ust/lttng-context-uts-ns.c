@@ -30,6 +30,12 @@
  */
 static DEFINE_URCU_TLS_INIT(ino_t, cached_uts_ns, NS_INO_UNINITIALIZED);
 
+/*
+ * Process-wide copy of the cache, inherited by threads on their first
+ * event so they don't each stat(2) the proc filesystem.
+ */
+static ino_t cached_uts_ns_process = NS_INO_UNINITIALIZED;
+
 static
 ino_t get_uts_ns(void)
 {
@@ -45,6 +51,11 @@ ino_t get_uts_ns(void)
 	if (caa_likely(uts_ns != NS_INO_UNINITIALIZED))
 		return uts_ns;
 
+	uts_ns = lttng_context_ns_cache_inherit(&URCU_TLS(cached_uts_ns),
+			&cached_uts_ns_process);
+	if (caa_likely(uts_ns != NS_INO_UNINITIALIZED))
+		return uts_ns;
+
 	/*
 	 * At this point we have to populate the cache, set the initial
 	 * value to NS_INO_UNAVAILABLE (0), if we fail to get the inode
@@ -76,6 +87,8 @@ ino_t get_uts_ns(void)
 	 */
 	CMM_STORE_SHARED(URCU_TLS(cached_uts_ns), uts_ns);
 
+	lttng_context_ns_cache_publish(&cached_uts_ns_process, uts_ns);
+
 	return uts_ns;
 }
 
@@ -88,6 +101,7 @@ ino_t get_uts_ns(void)
 void lttng_context_uts_ns_reset(void)
 {
 	CMM_STORE_SHARED(URCU_TLS(cached_uts_ns), NS_INO_UNINITIALIZED);
+	CMM_STORE_SHARED(cached_uts_ns_process, NS_INO_UNINITIALIZED);
 }
 
 static
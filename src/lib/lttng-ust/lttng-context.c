@@ -226,6 +226,52 @@ int lttng_ust_context_append(struct lttng_ust_ctx **ctx_p,
 	return 0;
 }
 
+/*
+ * Insert context fields before the existing ones, for fields which need
+ * to be recorded first.
+ */
+int lttng_ust_context_prepend(struct lttng_ust_ctx **ctx_p,
+		const struct lttng_ust_ctx_field *fields, unsigned int nr_fields)
+{
+	struct lttng_ust_ctx *ctx;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < nr_fields; i++) {
+		ret = lttng_ust_context_add_field(ctx_p);
+		if (ret) {
+			if (*ctx_p)
+				(*ctx_p)->nr_fields -= i;
+			return ret;
+		}
+	}
+	ctx = *ctx_p;
+	memmove(&ctx->fields[nr_fields], &ctx->fields[0],
+		sizeof(*ctx->fields) * (ctx->nr_fields - nr_fields));
+	memcpy(&ctx->fields[0], fields, sizeof(*fields) * nr_fields);
+	lttng_context_update(ctx);
+	return 0;
+}
+
+/*
+ * Set once a thread changed its namespaces with setns(2) or unshare(2).
+ * Threads created afterwards may belong to either namespace, so the
+ * namespace contexts stop sharing a process-wide cache until the next
+ * fork.
+ */
+int lttng_context_ns_process_cache_disabled;
+
+void lttng_context_ns_disable_process_cache(void)
+{
+	CMM_STORE_SHARED(lttng_context_ns_process_cache_disabled, 1);
+	cmm_smp_mb();
+}
+
+void lttng_context_ns_enable_process_cache(void)
+{
+	CMM_STORE_SHARED(lttng_context_ns_process_cache_disabled, 0);
+}
+
 void lttng_destroy_context(struct lttng_ust_ctx *ctx)
 {
 	int i;
@@ -64,6 +64,9 @@
 static CDS_LIST_HEAD(sessions);
 static CDS_LIST_HEAD(event_notifier_groups);
 
+/* Nesting count of lttng_ust_enabler_sync_defer(). */
+static int enabler_sync_deferred;
+
 struct cds_list_head *lttng_get_sessions(void)
 {
 	return &sessions;
@@ -325,6 +328,8 @@ void lttng_session_destroy(struct lttng_ust_session *session)
 		_lttng_enum_destroy(_enum);
 	cds_list_for_each_entry_safe(chan, tmpchan, &session->priv->chan_head, node)
 		_lttng_channel_unmap(chan->pub);
+	if (session->priv->profile_counter)
+		lttng_ust_counter_destroy(session->priv->profile_counter);
 	cds_list_del(&session->priv->node);
 	lttng_destroy_context(session->priv->ctx);
 	free(session->priv);
@@ -334,7 +339,7 @@ void lttng_session_destroy(struct lttng_ust_session *session)
 void lttng_event_notifier_group_destroy(
 		struct lttng_event_notifier_group *event_notifier_group)
 {
-	int close_ret;
+	int close_ret, i;
 	struct lttng_event_notifier_enabler *notifier_enabler, *tmpnotifier_enabler;
 	struct lttng_ust_event_notifier_private *event_notifier_priv, *tmpevent_notifier_priv;
 
@@ -348,6 +353,11 @@ void lttng_event_notifier_group_destroy(
 
 	lttng_ust_urcu_synchronize_rcu();
 
+	/* No probe is left to send the coalesced hits. */
+	cds_list_for_each_entry(event_notifier_priv,
+			&event_notifier_group->event_notifiers_head, node)
+		lttng_event_notifier_notification_flush(event_notifier_priv->pub, false);
+
 	cds_list_for_each_entry_safe(notifier_enabler, tmpnotifier_enabler,
 			&event_notifier_group->enablers_head, node)
 		lttng_event_notifier_enabler_destroy(notifier_enabler);
@@ -359,6 +369,11 @@ void lttng_event_notifier_group_destroy(
 	if (event_notifier_group->error_counter)
 		lttng_ust_counter_destroy(event_notifier_group->error_counter);
 
+	for (i = 0; i < LTTNG_EVENT_NOTIFIER_SKETCH_NR; i++) {
+		if (event_notifier_group->sketches[i].counter)
+			lttng_ust_counter_destroy(event_notifier_group->sketches[i].counter);
+	}
+
 	/* Close the notification fd to the listener of event_notifiers. */
 
 	lttng_ust_lock_fd_tracker();
@@ -822,6 +837,8 @@ socket_error:
 static
 int lttng_event_notifier_create(const struct lttng_ust_event_desc *desc,
 		uint64_t token, uint64_t error_counter_index,
+		uint32_t sketch, uint64_t sketch_index,
+		unsigned long coalesce_window_us,
 		struct lttng_event_notifier_group *event_notifier_group)
 {
 	struct lttng_ust_event_notifier *event_notifier;
@@ -866,6 +883,9 @@ int lttng_event_notifier_create(const struct lttng_ust_event_desc *desc,
 	event_notifier_priv->group = event_notifier_group;
 	event_notifier_priv->parent.user_token = token;
 	event_notifier_priv->error_counter_index = error_counter_index;
+	event_notifier_priv->sketch = sketch;
+	event_notifier_priv->sketch_index = sketch_index;
+	event_notifier_priv->coalesce_window_us = coalesce_window_us;
 
 	/* Event notifier will be enabled by enabler sync. */
 	event_notifier->parent->run_filter = lttng_ust_interpret_event_filter;
@@ -1371,6 +1391,7 @@ void _lttng_event_destroy(struct lttng_ust_event_common *event)
 		/* Remove from event hash table. */
 		cds_hlist_del(&event_notifier->priv->hlist);
 
+		lttng_event_notifier_dispatch_destroy(event_notifier);
 		free(event_notifier->priv);
 		free(event_notifier->parent);
 		free(event_notifier);
@@ -1441,6 +1462,9 @@ struct lttng_event_notifier_enabler *lttng_event_notifier_enabler_create(
 
 	event_notifier_enabler->user_token = event_notifier_param->event.token;
 	event_notifier_enabler->error_counter_index = event_notifier_param->error_counter_index;
+	event_notifier_enabler->sketch = event_notifier_param->sketch;
+	event_notifier_enabler->sketch_index = event_notifier_param->sketch_index;
+	event_notifier_enabler->coalesce_window_us = event_notifier_param->coalesce_window_us;
 	event_notifier_enabler->num_captures = 0;
 
 	memcpy(&event_notifier_enabler->base.event_param.name,
@@ -1629,6 +1653,10 @@ int lttng_attach_context(struct lttng_ust_abi_context *context_param,
 		return lttng_add_pid_ns_to_ctx(ctx);
 	case LTTNG_UST_ABI_CONTEXT_TIME_NS:
 		return lttng_add_time_ns_to_ctx(ctx);
+	case LTTNG_UST_ABI_CONTEXT_REPEAT:
+		return lttng_add_repeat_to_ctx(ctx);
+	case LTTNG_UST_ABI_CONTEXT_TRUNCATED:
+		return lttng_add_truncated_to_ctx(ctx);
 	case LTTNG_UST_ABI_CONTEXT_USER_NS:
 		return lttng_add_user_ns_to_ctx(ctx);
 	case LTTNG_UST_ABI_CONTEXT_UTS_NS:
@@ -1691,7 +1719,8 @@ void lttng_session_sync_event_enablers(struct lttng_ust_session *session)
 		struct lttng_enabler_ref *enabler_ref;
 		struct lttng_ust_bytecode_runtime *runtime;
 		int enabled = 0, has_enablers_without_filter_bytecode = 0;
-		int nr_filters = 0;
+		int nr_filters = 0, has_payload_limit = 0;
+		uint32_t max_payload_len = 0;
 
 		/* Enable events */
 		cds_list_for_each_entry(enabler_ref,
@@ -1709,6 +1738,27 @@ void lttng_session_sync_event_enablers(struct lttng_ust_session *session)
 		enabled = enabled && session->priv->tstate && event_recorder_priv->pub->chan->priv->parent.tstate;
 
 		CMM_STORE_SHARED(event_recorder_priv->pub->parent->enabled, enabled);
+
+		/*
+		 * The payload length limit is the largest limit of the
+		 * enabled enablers, and there is no limit as soon as one
+		 * of them has none.
+		 */
+		cds_list_for_each_entry(enabler_ref,
+				&event_recorder_priv->parent.enablers_ref_head, node) {
+			uint32_t len = enabler_ref->ref->event_param.max_payload_len;
+
+			if (!enabler_ref->ref->enabled)
+				continue;
+			if (!len) {
+				has_payload_limit = 0;
+				break;
+			}
+			has_payload_limit = 1;
+			max_payload_len = max_t(uint32_t, max_payload_len, len);
+		}
+		CMM_STORE_SHARED(event_recorder_priv->pub->max_payload_len,
+			has_payload_limit ? max_payload_len : 0);
 		/*
 		 * Sync tracepoint registration with event enabled
 		 * state.
@@ -1804,6 +1854,9 @@ void lttng_create_event_notifier_if_missing(
 			ret = lttng_event_notifier_create(desc,
 				event_notifier_enabler->user_token,
 				event_notifier_enabler->error_counter_index,
+				event_notifier_enabler->sketch,
+				event_notifier_enabler->sketch_index,
+				event_notifier_enabler->coalesce_window_us,
 				event_notifier_group);
 			if (ret) {
 				DBG("Unable to create event_notifier \"%s:%s\", error %d\n",
@@ -1880,12 +1933,29 @@ end:
 	return 0;
 }
 
+/*
+ * An event notifier notified by the dispatch index held by another one
+ * does not need its own probe.
+ */
+static
+bool event_notifier_dispatched(struct lttng_ust_event_notifier_private *event_notifier_priv,
+		struct lttng_ust_event_notifier *dispatcher)
+{
+	return dispatcher && dispatcher != event_notifier_priv->pub;
+}
+
 static
 void lttng_event_notifier_group_sync_enablers(struct lttng_event_notifier_group *event_notifier_group)
 {
 	struct lttng_event_notifier_enabler *event_notifier_enabler;
 	struct lttng_ust_event_notifier_private *event_notifier_priv;
 
+	if (enabler_sync_deferred) {
+		event_notifier_group->sync_pending = 1;
+		return;
+	}
+	event_notifier_group->sync_pending = 0;
+
 	cds_list_for_each_entry(event_notifier_enabler, &event_notifier_group->enablers_head, node)
 		lttng_event_notifier_enabler_ref_event_notifiers(event_notifier_enabler);
 
@@ -1908,18 +1978,15 @@ void lttng_event_notifier_group_sync_enablers(struct lttng_event_notifier_group
 			}
 		}
 
-		CMM_STORE_SHARED(event_notifier_priv->pub->parent->enabled, enabled);
 		/*
-		 * Sync tracepoint registration with event_notifier enabled
-		 * state.
+		 * The probe of a dispatch index holder notifies the other
+		 * event notifiers of its index until they are handed over.
 		 */
-		if (enabled) {
-			if (!event_notifier_priv->parent.registered)
-				register_event(event_notifier_priv->parent.pub);
-		} else {
-			if (event_notifier_priv->parent.registered)
-				unregister_event(event_notifier_priv->parent.pub);
-		}
+		event_notifier_priv->dispatch_disabled = !enabled &&
+			event_notifier_priv->pub->parent->enabled &&
+			event_notifier_priv->dispatcher == event_notifier_priv->pub;
+		if (!event_notifier_priv->dispatch_disabled)
+			CMM_STORE_SHARED(event_notifier_priv->pub->parent->enabled, enabled);
 
 		/* Check if has enablers without bytecode enabled */
 		cds_list_for_each_entry(enabler_ref,
@@ -1951,6 +2018,35 @@ void lttng_event_notifier_group_sync_enablers(struct lttng_event_notifier_group
 		CMM_STORE_SHARED(event_notifier_priv->pub->eval_capture,
 				!!nr_captures);
 	}
+
+	/*
+	 * Sync tracepoint registration with event_notifier enabled
+	 * state. Enabled event_notifiers reached through the dispatch
+	 * index of another event_notifier don't need their own probe.
+	 * Probes are registered before publishing the new dispatch
+	 * indexes, and unregistered after, so each event is notified
+	 * once.
+	 */
+	lttng_event_notifier_group_dispatch_prepare(event_notifier_group);
+	cds_list_for_each_entry(event_notifier_priv, &event_notifier_group->event_notifiers_head, node) {
+		if (event_notifier_priv->pub->parent->enabled &&
+				!event_notifier_dispatched(event_notifier_priv,
+					event_notifier_priv->dispatcher_pending) &&
+				!event_notifier_priv->parent.registered)
+			register_event(event_notifier_priv->parent.pub);
+	}
+	lttng_event_notifier_group_dispatch_publish(event_notifier_group);
+	cds_list_for_each_entry(event_notifier_priv, &event_notifier_group->event_notifiers_head, node) {
+		if (event_notifier_priv->dispatch_disabled) {
+			CMM_STORE_SHARED(event_notifier_priv->pub->parent->enabled, 0);
+			event_notifier_priv->dispatch_disabled = 0;
+		}
+		if ((!event_notifier_priv->pub->parent->enabled ||
+				event_notifier_dispatched(event_notifier_priv,
+					event_notifier_priv->dispatcher)) &&
+				event_notifier_priv->parent.registered)
+			unregister_event(event_notifier_priv->parent.pub);
+	}
 	lttng_ust_tp_probe_prune_release_queue();
 }
 
@@ -1966,9 +2062,55 @@ void lttng_session_lazy_sync_event_enablers(struct lttng_ust_session *session)
 	/* We can skip if session is not active */
 	if (!session->active)
 		return;
+	if (enabler_sync_deferred) {
+		session->priv->sync_pending = 1;
+		return;
+	}
 	lttng_session_sync_event_enablers(session);
 }
 
+/*
+ * Defer the lazy enabler synchronization until the matching
+ * lttng_ust_enabler_sync_resume(), so a batch of enabler commands only
+ * walks the probes once. Called with ust lock held.
+ */
+void lttng_ust_enabler_sync_defer(void)
+{
+	enabler_sync_deferred++;
+}
+
+void lttng_ust_enabler_sync_resume(void)
+{
+	struct lttng_ust_session_private *session_priv;
+	struct lttng_event_notifier_group *event_notifier_group;
+
+	assert(enabler_sync_deferred > 0);
+	if (--enabler_sync_deferred)
+		return;
+	cds_list_for_each_entry(session_priv, &sessions, node) {
+		if (!session_priv->sync_pending)
+			continue;
+		session_priv->sync_pending = 0;
+		lttng_session_lazy_sync_event_enablers(session_priv->pub);
+	}
+	cds_list_for_each_entry(event_notifier_group, &event_notifier_groups, node) {
+		if (event_notifier_group->sync_pending)
+			lttng_event_notifier_group_sync_enablers(event_notifier_group);
+	}
+}
+
+void lttng_event_notifier_groups_flush_coalesced(void)
+{
+	struct lttng_event_notifier_group *event_notifier_group;
+	struct lttng_ust_event_notifier_private *event_notifier_priv;
+
+	cds_list_for_each_entry(event_notifier_group, &event_notifier_groups, node) {
+		cds_list_for_each_entry(event_notifier_priv,
+				&event_notifier_group->event_notifiers_head, node)
+			lttng_event_notifier_notification_flush(event_notifier_priv->pub, true);
+	}
+}
+
 /*
  * Update all sessions with the given app context.
  * Called with ust lock held.
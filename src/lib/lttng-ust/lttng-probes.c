@@ -113,6 +113,25 @@ bool check_type_provider(const struct lttng_ust_type_common *type)
 		}
 		return true;
 	}
+	case lttng_ust_type_struct_native:
+	{
+		const struct lttng_ust_type_struct_native *struct_type = caa_container_of(type, const struct lttng_ust_type_struct_native, parent);
+		const struct lttng_ust_struct_native_member * const *member;
+
+		for (member = struct_type->members; *member; member++) {
+			switch ((*member)->type->type) {
+			case lttng_ust_type_integer:
+			case lttng_ust_type_float:
+			case lttng_ust_type_array:
+				break;
+			default:
+				return false;
+			}
+			if (!check_type_provider((*member)->type))
+				return false;
+		}
+		return true;
+	}
 	default:
 		return false;
 	}
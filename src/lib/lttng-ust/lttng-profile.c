@@ -0,0 +1,109 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Per-stage cycle accounting of sampled probe hits.
+ *
+ * Each thread profiles one probe hit out of the profile period of the
+ * session. The cycles spent in each stage of a profiled hit accumulate
+ * in thread-local storage, then each stage duration is counted in the
+ * per-cpu histograms of the session profile counter, indexed by channel
+ * id, event id, stage, and base 2 logarithm of the duration.
+ */
+
+#define _LGPL_SOURCE
+#include <stdint.h>
+#include <string.h>
+
+#include <urcu/compiler.h>
+#include <urcu/tls-compat.h>
+#include <lttng/ust-events.h>
+
+#include "common/events.h"
+#include "common/macros.h"
+#include "common/profile.h"
+
+static
+struct lttng_ust_session *profile_session(struct lttng_ust_event_common *event)
+{
+	struct lttng_ust_event_recorder *event_recorder;
+
+	if (event->type != LTTNG_UST_EVENT_TYPE_RECORDER)
+		return NULL;
+	event_recorder = (struct lttng_ust_event_recorder *) event->child;
+	return event_recorder->chan->parent->session;
+}
+
+int lttng_ust_profile_begin(struct lttng_ust_event_common *event)
+{
+	struct lttng_ust_profile_state *state = &URCU_TLS(lttng_ust_profile_state);
+	struct lttng_ust_session *session;
+
+	/*
+	 * Probe hits nested in the profiled one, from a signal handler or
+	 * from a context provider, are not profiled and do not account
+	 * the stages of the tracer. The profiled hit is at nesting level
+	 * 0, and is the only one to account them.
+	 */
+	if (caa_unlikely(state->active)) {
+		state->nesting++;
+		return -1;
+	}
+	session = profile_session(event);
+	if (caa_likely(!session || !CMM_LOAD_SHARED(session->priv->profile_counter)))
+		return 0;
+	if (state->countdown > 1) {
+		state->countdown--;
+		return 0;
+	}
+	state->countdown = session->priv->profile_period;
+	state->stages = 0;
+	state->nesting = 0;
+	memset(state->cycles, 0, sizeof(state->cycles));
+	state->active = 1;
+	state->last = lttng_ust_profile_cycles();
+	return 1;
+}
+
+void lttng_ust_profile_stage(int stage)
+{
+	if (stage < 0 || stage >= NR_LTTNG_UST_ABI_PROFILE_STAGE)
+		return;
+	lttng_ust_profile_account(stage);
+}
+
+void lttng_ust_profile_end(struct lttng_ust_event_common *event)
+{
+	struct lttng_ust_profile_state *state = &URCU_TLS(lttng_ust_profile_state);
+	struct lttng_ust_event_recorder *event_recorder;
+	struct lttng_ust_session *session;
+	struct lttng_counter *counter;
+	size_t indexes[4];
+	int stage;
+
+	if (state->nesting) {
+		state->nesting--;
+		return;
+	}
+	state->active = 0;
+	session = profile_session(event);
+	if (!session)
+		return;
+	counter = CMM_LOAD_SHARED(session->priv->profile_counter);
+	if (!counter)
+		return;
+	event_recorder = (struct lttng_ust_event_recorder *) event->child;
+	indexes[0] = event_recorder->chan->priv->id;
+	indexes[1] = event_recorder->priv->id;
+	for (stage = 0; stage < NR_LTTNG_UST_ABI_PROFILE_STAGE; stage++) {
+		uint64_t cycles = state->cycles[stage];
+		size_t bucket;
+
+		if (!(state->stages & (1U << stage)))
+			continue;
+		bucket = cycles ? 64 - __builtin_clzll(cycles) : 0;
+		indexes[2] = stage;
+		indexes[3] = min_t(size_t, bucket, session->priv->profile_nr_buckets - 1);
+		/* Channels and events beyond the counter dimensions are skipped. */
+		(void) counter->ops->counter_add(counter->counter, indexes, 1);
+	}
+}
@@ -9,6 +9,7 @@
 #ifndef _LTTNG_TRACER_CORE_H
 #define _LTTNG_TRACER_CORE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <urcu/arch.h>
 #include <urcu/list.h>
@@ -58,6 +59,21 @@ void lttng_time_ns_alloc_tls(void)
 void lttng_uts_ns_alloc_tls(void)
 	__attribute__((visibility("hidden")));
 
+void lttng_bytecode_reorder_alloc_tls(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_bytecode_reorder_lock(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_bytecode_reorder_unlock(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_bytecode_reorder_after_fork_child(void)
+	__attribute__((visibility("hidden")));
+
+void lttng_bytecode_reorder_exit(void)
+	__attribute__((visibility("hidden")));
+
 const char *lttng_ust_obj_get_name(int id)
 	__attribute__((visibility("hidden")));
 
@@ -77,6 +93,33 @@ void lttng_event_notifier_notification_send(
 		struct lttng_ust_notification_ctx *notif_ctx)
 	__attribute__((visibility("hidden")));
 
+/*
+ * Request the flush of the hits coalesced by event notifiers, at least
+ * every window_us. The flush thread is started by the listener thread
+ * once the command is handled, outside of the UST lock. Called with the
+ * UST lock held.
+ */
+void lttng_ust_coalesce_flush_request(unsigned long window_us)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Send the hits coalesced by an event notifier since its last
+ * notification, if any. If expired is set, only once its coalescing
+ * window has expired. Must not run concurrently with the teardown of
+ * the event notifier.
+ */
+void lttng_event_notifier_notification_flush(
+		const struct lttng_ust_event_notifier *event_notifier,
+		bool expired)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Flush the hits coalesced by the event notifiers whose window has
+ * expired. Called with the UST lock held.
+ */
+void lttng_event_notifier_groups_flush_coalesced(void)
+	__attribute__((visibility("hidden")));
+
 #ifdef HAVE_LINUX_PERF_EVENT_H
 void lttng_ust_perf_counter_alloc_tls(void)
 	__attribute__((visibility("hidden")));
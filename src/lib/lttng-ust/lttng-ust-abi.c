@@ -24,6 +24,7 @@
 
 #define _LGPL_SOURCE
 #include <fcntl.h>
+#include <limits.h>
 #include <stdint.h>
 #include <unistd.h>
 
@@ -43,6 +44,7 @@
 #include "common/ringbuffer/frontend.h"
 #include "common/ringbuffer/shm.h"
 #include "common/counter/counter.h"
+#include "common/counter/sketch.h"
 #include "common/tracepoint.h"
 #include "common/tracer.h"
 #include "common/strutils.h"
@@ -468,6 +470,7 @@ int lttng_abi_map_channel(int session_objd,
 
 	switch (type) {
 	case LTTNG_UST_ABI_CHAN_PER_CPU:
+	case LTTNG_UST_ABI_CHAN_PER_CHANNEL:
 		break;
 	default:
 		ret = -EINVAL;
@@ -533,6 +536,27 @@ int lttng_abi_map_channel(int session_objd,
 		}
 		chan_name = "channel";
 		break;
+	case LTTNG_UST_ABI_CHAN_PER_CHANNEL:
+		if (config->output == RING_BUFFER_MMAP) {
+			if (config->mode == RING_BUFFER_OVERWRITE) {
+				if (config->wakeup == RING_BUFFER_WAKEUP_BY_WRITER) {
+					transport_name = "relay-overwrite-per-channel-mmap";
+				} else {
+					transport_name = "relay-overwrite-per-channel-rt-mmap";
+				}
+			} else {
+				if (config->wakeup == RING_BUFFER_WAKEUP_BY_WRITER) {
+					transport_name = "relay-discard-per-channel-mmap";
+				} else {
+					transport_name = "relay-discard-per-channel-rt-mmap";
+				}
+			}
+		} else {
+			ret = -EINVAL;
+			goto notransport;
+		}
+		chan_name = "channel";
+		break;
 	default:
 		ret = -EINVAL;
 		goto notransport;
@@ -599,6 +623,10 @@ invalid:
 	return ret;
 }
 
+static
+int lttng_session_create_profile_counter(int session_objd, void *owner,
+		struct lttng_ust_abi_counter_conf *profile_counter_conf);
+
 /**
  *	lttng_session_cmd - lttng session object command
  *
@@ -638,6 +666,14 @@ long lttng_session_cmd(int objd, unsigned int cmd, unsigned long arg,
 	case LTTNG_UST_ABI_SESSION_STATEDUMP:
 		return lttng_session_statedump(session);
 	case LTTNG_UST_ABI_COUNTER:
+	{
+		struct lttng_ust_abi_counter_conf *counter_conf =
+			(struct lttng_ust_abi_counter_conf *) uargs->counter.counter_data;
+
+		if (!counter_conf->profile_period)
+			return -EINVAL;
+		return lttng_session_create_profile_counter(objd, owner, counter_conf);
+	}
 	case LTTNG_UST_ABI_COUNTER_GLOBAL:
 	case LTTNG_UST_ABI_COUNTER_CPU:
 		/* Not implemented yet. */
@@ -683,6 +719,11 @@ static int lttng_ust_event_notifier_enabler_create(int event_notifier_group_obj,
 	int event_notifier_objd, ret;
 
 	event_notifier_param->event.name[LTTNG_UST_ABI_SYM_NAME_LEN - 1] = '\0';
+	if (event_notifier_param->sketch >= LTTNG_EVENT_NOTIFIER_SKETCH_NR)
+		return -EINVAL;
+	/* Compared with wrapping differences of unsigned long times. */
+	if (event_notifier_param->coalesce_window_us > LONG_MAX)
+		return -EINVAL;
 	event_notifier_objd = objd_alloc(NULL, &lttng_event_notifier_enabler_ops, owner,
 		"event_notifier enabler");
 	if (event_notifier_objd < 0) {
@@ -700,6 +741,8 @@ static int lttng_ust_event_notifier_enabler_create(int event_notifier_group_obj,
 	objd_set_private(event_notifier_objd, event_notifier_enabler);
 	/* The event_notifier holds a reference on the event_notifier group. */
 	objd_ref(event_notifier_enabler->group->objd);
+	if (event_notifier_enabler->coalesce_window_us)
+		lttng_ust_coalesce_flush_request(event_notifier_enabler->coalesce_window_us);
 
 	return event_notifier_objd;
 
@@ -889,6 +932,205 @@ objd_error:
 	return ret;
 }
 
+/* Sketch counters implement the same commands as the error counter. */
+static const struct lttng_ust_abi_objd_ops lttng_event_notifier_group_sketch_counter_ops = {
+	.release = lttng_release_event_notifier_group_error_counter,
+	.cmd = lttng_event_notifier_group_error_counter_cmd,
+};
+
+static
+int lttng_ust_event_notifier_group_create_sketch_counter(int event_notifier_group_objd, void *owner,
+		struct lttng_ust_abi_counter_conf *sketch_counter_conf)
+{
+	struct lttng_event_notifier_group *event_notifier_group =
+		objd_private(event_notifier_group_objd);
+	struct lttng_event_notifier_sketch *sketch;
+	struct lttng_counter_dimension dimensions[2];
+	struct lib_sketch_config config;
+	struct lttng_counter *counter;
+	int counter_objd, ret, i;
+
+	switch (sketch_counter_conf->sketch) {
+	case LTTNG_UST_ABI_COUNTER_SKETCH_COUNT_MIN:
+		config.type = LIB_SKETCH_COUNT_MIN;
+		break;
+	case LTTNG_UST_ABI_COUNTER_SKETCH_HYPERLOGLOG:
+		config.type = LIB_SKETCH_HYPERLOGLOG;
+		break;
+	default:
+		return -EINVAL;
+	}
+	config.depth = sketch_counter_conf->sketch_depth;
+	config.width = sketch_counter_conf->sketch_width;
+	config.top_k = sketch_counter_conf->sketch_top_k;
+	if (lttng_sketch_validate_config(&config))
+		return -EINVAL;
+
+	sketch = &event_notifier_group->sketches[sketch_counter_conf->sketch];
+	if (sketch->counter)
+		return -EBUSY;
+
+	if (sketch_counter_conf->arithmetic != LTTNG_UST_ABI_COUNTER_ARITHMETIC_MODULAR ||
+			sketch_counter_conf->bitness != LTTNG_UST_ABI_COUNTER_BITNESS_64)
+		return -EINVAL;
+
+	if (sketch_counter_conf->number_dimensions != 2 ||
+			sketch_counter_conf->dimensions[1].size != lttng_sketch_get_nr_elem(&config))
+		return -EINVAL;
+
+	counter_objd = objd_alloc(NULL, &lttng_event_notifier_group_sketch_counter_ops, owner,
+		"event_notifier group sketch counter");
+	if (counter_objd < 0) {
+		ret = counter_objd;
+		goto objd_error;
+	}
+
+	for (i = 0; i < 2; i++) {
+		dimensions[i].size = sketch_counter_conf->dimensions[i].size;
+		dimensions[i].underflow_index = 0;
+		dimensions[i].overflow_index = 0;
+		dimensions[i].has_underflow = 0;
+		dimensions[i].has_overflow = 0;
+	}
+
+	counter = lttng_ust_counter_create("counter-per-cpu-64-modular", 2, dimensions);
+	if (!counter) {
+		ret = -EINVAL;
+		goto create_error;
+	}
+
+	sketch->config = config;
+	sketch->len = dimensions[0].size;
+	/*
+	 * store-release to publish the sketch counter matches
+	 * load-acquire in notification_sketch_update.
+	 */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(sketch->counter, counter);
+
+	counter->objd = counter_objd;
+	counter->event_notifier_group = event_notifier_group;	/* owner */
+
+	objd_set_private(counter_objd, counter);
+	/* The sketch counter holds a reference on the event_notifier group. */
+	objd_ref(event_notifier_group->objd);
+
+	return counter_objd;
+
+create_error:
+	{
+		int err;
+
+		err = lttng_ust_abi_objd_unref(counter_objd, 1);
+		assert(!err);
+	}
+objd_error:
+	return ret;
+}
+
+#ifdef LTTNG_UST_HAVE_PROBE_PROFILING
+static
+int lttng_release_session_profile_counter(int objd)
+{
+	struct lttng_counter *counter = objd_private(objd);
+
+	if (counter) {
+		return lttng_ust_abi_objd_unref(counter->session->priv->objd, 0);
+	} else {
+		return -EINVAL;
+	}
+}
+
+/* Profile counters implement the same commands as the error counter. */
+static const struct lttng_ust_abi_objd_ops lttng_session_profile_counter_ops = {
+	.release = lttng_release_session_profile_counter,
+	.cmd = lttng_event_notifier_group_error_counter_cmd,
+};
+
+/*
+ * The profile counter of a session has four dimensions: channel id,
+ * event id, probe stage, and cycles histogram bucket.
+ */
+static
+int lttng_session_create_profile_counter(int session_objd, void *owner,
+		struct lttng_ust_abi_counter_conf *profile_counter_conf)
+{
+	struct lttng_ust_session *session = objd_private(session_objd);
+	struct lttng_counter_dimension dimensions[4];
+	struct lttng_counter *counter;
+	int counter_objd, ret, i;
+
+	if (session->priv->profile_counter)
+		return -EBUSY;
+
+	if (profile_counter_conf->arithmetic != LTTNG_UST_ABI_COUNTER_ARITHMETIC_MODULAR ||
+			profile_counter_conf->bitness != LTTNG_UST_ABI_COUNTER_BITNESS_64)
+		return -EINVAL;
+
+	if (profile_counter_conf->number_dimensions != 4 ||
+			profile_counter_conf->dimensions[2].size != NR_LTTNG_UST_ABI_PROFILE_STAGE ||
+			!profile_counter_conf->dimensions[3].size)
+		return -EINVAL;
+
+	counter_objd = objd_alloc(NULL, &lttng_session_profile_counter_ops, owner,
+		"session profile counter");
+	if (counter_objd < 0) {
+		ret = counter_objd;
+		goto objd_error;
+	}
+
+	for (i = 0; i < 4; i++) {
+		dimensions[i].size = profile_counter_conf->dimensions[i].size;
+		dimensions[i].underflow_index = 0;
+		dimensions[i].overflow_index = 0;
+		dimensions[i].has_underflow = 0;
+		dimensions[i].has_overflow = 0;
+	}
+
+	counter = lttng_ust_counter_create("counter-per-cpu-64-modular", 4, dimensions);
+	if (!counter) {
+		ret = -EINVAL;
+		goto create_error;
+	}
+
+	session->priv->profile_period = profile_counter_conf->profile_period;
+	session->priv->profile_nr_buckets = dimensions[3].size;
+	/*
+	 * store-release to publish the profile counter matches
+	 * load-acquire in lttng_ust_profile_begin.
+	 */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(session->priv->profile_counter, counter);
+
+	counter->objd = counter_objd;
+	counter->session = session;	/* owner */
+
+	objd_set_private(counter_objd, counter);
+	/* The profile counter holds a reference on the session. */
+	objd_ref(session_objd);
+
+	return counter_objd;
+
+create_error:
+	{
+		int err;
+
+		err = lttng_ust_abi_objd_unref(counter_objd, 1);
+		assert(!err);
+	}
+objd_error:
+	return ret;
+}
+#else
+static
+int lttng_session_create_profile_counter(int session_objd __attribute__((unused)),
+		void *owner __attribute__((unused)),
+		struct lttng_ust_abi_counter_conf *profile_counter_conf __attribute__((unused)))
+{
+	return -ENOSYS;
+}
+#endif
+
 static
 long lttng_event_notifier_group_cmd(int objd, unsigned int cmd, unsigned long arg,
 		union lttng_ust_abi_args *uargs, void *owner)
@@ -916,6 +1158,10 @@ long lttng_event_notifier_group_cmd(int objd, unsigned int cmd, unsigned long ar
 	{
 		struct lttng_ust_abi_counter_conf *counter_conf =
 			(struct lttng_ust_abi_counter_conf *) uargs->counter.counter_data;
+
+		if (counter_conf->sketch != LTTNG_UST_ABI_COUNTER_SKETCH_NONE)
+			return lttng_ust_event_notifier_group_create_sketch_counter(
+					objd, owner, counter_conf);
 		return lttng_ust_event_notifier_group_create_error_counter(
 				objd, owner, counter_conf);
 	}
@@ -8,6 +8,7 @@
 #define _LGPL_SOURCE
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/mman.h>
@@ -40,6 +41,7 @@
 #include <lttng/ust-common.h>
 #include <urcu/tls-compat.h>
 #include "lib/lttng-ust/futex.h"
+#include "lib/lttng-ust/register-admission.h"
 #include "common/ustcomm.h"
 #include "common/ust-fd.h"
 #include "common/logging.h"
@@ -255,11 +257,20 @@ struct sock_info {
 
 	char wait_shm_path[PATH_MAX];
 	char *wait_shm_mmap;
+	int wait_shm_writable;
+	/* Registration admission slot, -1 if none, see admission_enter(). */
+	int admission_slot;
 	/* Keep track of lazy state dump not performed yet. */
 	int statedump_pending;
 	int initial_statedump_done;
 	/* Keep procname for statedump */
 	char procname[LTTNG_UST_CONTEXT_PROCNAME_LEN];
+
+	/* Command batch in progress, see LTTNG_UST_ABI_BATCH_BEGIN. */
+	int batch_active;
+	struct ustcomm_ust_reply *batch_replies;
+	size_t batch_nr_replies;
+	size_t batch_alloc_replies;
 };
 
 /* Socket from app (connect) to session daemon (listen) for communication */
@@ -277,6 +288,7 @@ static struct sock_info global_apps = {
 	.notify_socket = -1,
 
 	.wait_shm_path = "/" LTTNG_UST_WAIT_FILENAME,
+	.admission_slot = -1,
 
 	.statedump_pending = 0,
 	.initial_statedump_done = 0,
@@ -295,6 +307,7 @@ static struct sock_info local_apps = {
 
 	.socket = -1,
 	.notify_socket = -1,
+	.admission_slot = -1,
 
 	.statedump_pending = 0,
 	.initial_statedump_done = 0,
@@ -314,6 +327,8 @@ static const char *cmd_name_mapping[] = {
 	[ LTTNG_UST_ABI_TRACEPOINT_FIELD_LIST ] = "Create Tracepoint Field List",
 
 	[ LTTNG_UST_ABI_EVENT_NOTIFIER_GROUP_CREATE ] = "Create event notifier group",
+	[ LTTNG_UST_ABI_BATCH_BEGIN ] = "Begin Command Batch",
+	[ LTTNG_UST_ABI_BATCH_END ] = "End Command Batch",
 
 	/* Session FD commands */
 	[ LTTNG_UST_ABI_CHANNEL ] = "Create Channel",
@@ -354,7 +369,31 @@ static const char *cmd_name_mapping[] = {
 static const char *str_timeout;
 static int got_timeout_env;
 
+/*
+ * Registration admission, within the wait shm page, after the futex
+ * word written by the session daemon. Each listener takes a slot
+ * before connecting and releases it once registration is done or has
+ * failed, so that a session daemon (re)start sees the registrations of
+ * the traced processes in bounded waves rather than all at once. See
+ * register-admission.c.
+ */
+#define LTTNG_UST_WAIT_ADMISSION_OFFSET		64
+lttng_ust_static_assert(LTTNG_UST_WAIT_ADMISSION_OFFSET +
+		sizeof(struct lttng_ust_admission) <= 4096,
+		"Admission area exceeds the smallest page size",
+		admission_area_exceeds_page);
+#define LTTNG_UST_DEFAULT_REGISTER_WAVE		32
+/* Give up waiting for admission if no slot is released for that long. */
+#define LTTNG_UST_REGISTER_ADMISSION_TIMEOUT_MS	1000
+
+/* Backoff between failed registration attempts (milliseconds). */
+#define LTTNG_UST_REGISTER_BACKOFF_MIN_MS	1000
+#define LTTNG_UST_REGISTER_BACKOFF_MAX_MS	32000
+
+static long register_wave = -1;
+
 static char *get_map_shm(struct sock_info *sock_info);
+static void admission_exit(struct sock_info *sock_info);
 
 /*
  * Returns the HOME directory path. Caller MUST NOT free(3) the returned
@@ -411,10 +450,15 @@ void lttng_ust_alloc_tls(void)
 	lttng_net_ns_alloc_tls();
 	lttng_time_ns_alloc_tls();
 	lttng_uts_ns_alloc_tls();
+	lttng_bytecode_reorder_alloc_tls();
 	lttng_ust_ring_buffer_client_discard_alloc_tls();
 	lttng_ust_ring_buffer_client_discard_rt_alloc_tls();
 	lttng_ust_ring_buffer_client_overwrite_alloc_tls();
 	lttng_ust_ring_buffer_client_overwrite_rt_alloc_tls();
+	lttng_ust_ring_buffer_client_discard_per_channel_alloc_tls();
+	lttng_ust_ring_buffer_client_discard_per_channel_rt_alloc_tls();
+	lttng_ust_ring_buffer_client_overwrite_per_channel_alloc_tls();
+	lttng_ust_ring_buffer_client_overwrite_per_channel_rt_alloc_tls();
 }
 
 /*
@@ -619,6 +663,99 @@ void get_allow_blocking(void)
 	}
 }
 
+/* Minimum period of the coalesced hits flush thread (us). */
+#define COALESCE_FLUSH_MIN_PERIOD_US	10000
+
+/*
+ * Period of the coalesced hits flush thread (us): the smallest
+ * coalescing window requested by an event notifier, 0 if none.
+ */
+static unsigned long coalesce_flush_period_us;
+
+static pthread_t coalesce_flush_thread;
+static int coalesce_flush_thread_active;
+
+void lttng_ust_coalesce_flush_request(unsigned long window_us)
+{
+	unsigned long period_us = CMM_LOAD_SHARED(coalesce_flush_period_us);
+
+	if (window_us < COALESCE_FLUSH_MIN_PERIOD_US)
+		window_us = COALESCE_FLUSH_MIN_PERIOD_US;
+	if (!period_us || window_us < period_us)
+		CMM_STORE_SHARED(coalesce_flush_period_us, window_us);
+}
+
+/*
+ * Send the hits coalesced by event notifiers once their window
+ * expires, rather than with their next hit, which may never come.
+ */
+static
+void *ust_coalesce_flush_thread(void *arg __attribute__((unused)))
+{
+	lttng_ust_alloc_tls();
+	for (;;) {
+		unsigned long period_us = CMM_LOAD_SHARED(coalesce_flush_period_us);
+		struct timespec period;
+
+		period.tv_sec = period_us / 1000000;
+		period.tv_nsec = (period_us % 1000000) * 1000;
+		/* Cancellation point, outside of the UST lock. */
+		(void) nanosleep(&period, NULL);
+		if (ust_lock()) {
+			ust_unlock();
+			break;
+		}
+		lttng_event_notifier_groups_flush_coalesced();
+		ust_unlock();
+	}
+
+	pthread_mutex_lock(&ust_exit_mutex);
+	coalesce_flush_thread_active = 0;
+	pthread_mutex_unlock(&ust_exit_mutex);
+	return NULL;
+}
+
+/*
+ * Start the coalesced hits flush thread once an event notifier requests
+ * it. Called by the listener threads, outside of the UST lock since
+ * ust_exit_mutex cannot nest within it. The thread inherits the signal
+ * mask of the listener thread, which blocks all signals.
+ */
+static
+void coalesce_flush_thread_start(void)
+{
+	pthread_attr_t thread_attr;
+	int ret;
+
+	if (!CMM_LOAD_SHARED(coalesce_flush_period_us))
+		return;
+	pthread_mutex_lock(&ust_exit_mutex);
+	if (coalesce_flush_thread_active || CMM_LOAD_SHARED(lttng_ust_comm_should_quit))
+		goto end;
+	ret = pthread_attr_init(&thread_attr);
+	if (ret) {
+		ERR("pthread_attr_init: %s", strerror(ret));
+		goto end;
+	}
+	ret = pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+	if (ret) {
+		ERR("pthread_attr_setdetachstate: %s", strerror(ret));
+	}
+	ret = pthread_create(&coalesce_flush_thread, &thread_attr,
+			ust_coalesce_flush_thread, NULL);
+	if (ret) {
+		ERR("pthread_create coalesce flush: %s", strerror(ret));
+	} else {
+		coalesce_flush_thread_active = 1;
+	}
+	ret = pthread_attr_destroy(&thread_attr);
+	if (ret) {
+		ERR("pthread_attr_destroy: %s", strerror(ret));
+	}
+end:
+	pthread_mutex_unlock(&ust_exit_mutex);
+}
+
 static
 int register_to_sessiond(int socket, enum lttng_ust_ctl_socket_type type,
 		const char *procname)
@@ -677,6 +814,7 @@ void decrement_sem_count(unsigned int count)
 static
 int handle_register_done(struct sock_info *sock_info)
 {
+	admission_exit(sock_info);
 	if (sock_info->registration_done)
 		return 0;
 	sock_info->registration_done = 1;
@@ -899,6 +1037,148 @@ void prepare_cmd_reply(struct ustcomm_ust_reply *lur, uint32_t handle, uint32_t
 	}
 }
 
+/*
+ * Stand-in for the object of a batched command referring to a failed
+ * command: the payload is still received, and the command fails.
+ */
+static
+long batch_failed_ref_cmd(int objd __attribute__((unused)),
+		unsigned int cmd __attribute__((unused)),
+		unsigned long arg __attribute__((unused)),
+		union lttng_ust_abi_args *uargs __attribute__((unused)),
+		void *owner __attribute__((unused)))
+{
+	return -ENOENT;
+}
+
+static const struct lttng_ust_abi_objd_ops batch_failed_ref_ops = {
+	.cmd = batch_failed_ref_cmd,
+};
+
+/* Stand-in for the object of a command not allowed within a batch. */
+static
+long batch_invalid_cmd(int objd __attribute__((unused)),
+		unsigned int cmd __attribute__((unused)),
+		unsigned long arg __attribute__((unused)),
+		union lttng_ust_abi_args *uargs __attribute__((unused)),
+		void *owner __attribute__((unused)))
+{
+	return -EINVAL;
+}
+
+static const struct lttng_ust_abi_objd_ops batch_invalid_cmd_ops = {
+	.cmd = batch_invalid_cmd,
+};
+
+/*
+ * Resolve a reference to the object returned by an earlier command of
+ * the batch. Returns the object handle, or -ENOENT if that command
+ * failed.
+ */
+static
+int batch_resolve_handle(struct sock_info *sock_info, uint32_t handle)
+{
+	const struct ustcomm_ust_reply *lur;
+	uint32_t tag;
+	size_t i;
+
+	if (!(handle & USTCOMM_BATCH_HANDLE_REF))
+		return handle;
+	tag = handle & ~USTCOMM_BATCH_HANDLE_REF;
+	i = min_t(size_t, tag, sock_info->batch_nr_replies);
+	/* Replies are in tag order, usually one per tag. */
+	while (i > 0) {
+		lur = &sock_info->batch_replies[--i];
+		if (lur->tag > tag)
+			continue;
+		if (lur->tag < tag || lur->ret_code != LTTNG_UST_OK)
+			return -ENOENT;
+		return lur->ret_val;
+	}
+	return -ENOENT;
+}
+
+static
+int batch_add_reply(struct sock_info *sock_info,
+		const struct ustcomm_ust_reply *lur)
+{
+	if (sock_info->batch_nr_replies == sock_info->batch_alloc_replies) {
+		struct ustcomm_ust_reply *new_replies;
+		size_t new_alloc;
+
+		new_alloc = max_t(size_t, 2 * sock_info->batch_alloc_replies, 64);
+		new_replies = realloc(sock_info->batch_replies,
+				new_alloc * sizeof(*new_replies));
+		if (!new_replies)
+			return -ENOMEM;
+		sock_info->batch_replies = new_replies;
+		sock_info->batch_alloc_replies = new_alloc;
+	}
+	sock_info->batch_replies[sock_info->batch_nr_replies++] = *lur;
+	return 0;
+}
+
+/*
+ * Leave batch mode, applying the enabler changes deferred by the
+ * batched commands. Called with ust lock held.
+ */
+static
+void batch_end(struct sock_info *sock_info)
+{
+	if (!sock_info->batch_active)
+		return;
+	sock_info->batch_active = 0;
+	lttng_ust_enabler_sync_resume();
+}
+
+/*
+ * Called with ust lock held.
+ */
+static
+int handle_batch_message(struct sock_info *sock_info,
+		int sock, struct ustcomm_ust_msg *lum)
+{
+	struct ustcomm_ust_reply lur;
+	size_t nr_replies;
+	ssize_t len;
+	int ret;
+
+	if (lum->handle != LTTNG_UST_ABI_ROOT_HANDLE)
+		return -EINVAL;
+
+	switch (lum->cmd) {
+	case LTTNG_UST_ABI_BATCH_BEGIN:
+		/* Nothing is sent back until LTTNG_UST_ABI_BATCH_END. */
+		if (sock_info->batch_active)
+			return -EINVAL;
+		sock_info->batch_active = 1;
+		sock_info->batch_nr_replies = 0;
+		lttng_ust_enabler_sync_defer();
+		return 0;
+	case LTTNG_UST_ABI_BATCH_END:
+		if (!sock_info->batch_active)
+			return -EINVAL;
+		batch_end(sock_info);
+		nr_replies = sock_info->batch_nr_replies;
+		memset(&lur, 0, sizeof(lur));
+		prepare_cmd_reply(&lur, lum->handle, lum->cmd, nr_replies);
+		ret = send_reply(sock, &lur);
+		if (ret < 0)
+			return ret;
+		if (!nr_replies)
+			return 0;
+		len = ustcomm_send_unix_sock(sock, sock_info->batch_replies,
+				nr_replies * sizeof(*sock_info->batch_replies));
+		if (len < 0)
+			return len;
+		if (len != nr_replies * sizeof(*sock_info->batch_replies))
+			return -EINVAL;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static
 int handle_message(struct sock_info *sock_info,
 		int sock, struct ustcomm_ust_msg *lum)
@@ -909,6 +1189,8 @@ int handle_message(struct sock_info *sock_info,
 	union lttng_ust_abi_args args;
 	char ctxstr[LTTNG_UST_ABI_SYM_NAME_LEN];	/* App context string. */
 	ssize_t len;
+	uint32_t batch_handle = lum->handle;
+	int batch_reply = 0;	/* Reply of a batched command to record. */
 
 	memset(&lur, 0, sizeof(lur));
 
@@ -917,7 +1199,30 @@ int handle_message(struct sock_info *sock_info,
 		goto error;
 	}
 
-	ops = lttng_ust_abi_objd_ops(lum->handle);
+	if (lum->cmd == LTTNG_UST_ABI_BATCH_BEGIN
+			|| lum->cmd == LTTNG_UST_ABI_BATCH_END) {
+		ret = handle_batch_message(sock_info, sock, lum);
+		goto error;
+	}
+
+	if (sock_info->batch_active) {
+		int handle = batch_resolve_handle(sock_info, lum->handle);
+
+		batch_reply = 1;
+		if (!ustcomm_batch_cmd_allowed(lum->cmd)) {
+			ops = &batch_invalid_cmd_ops;
+		} else if (handle < 0) {
+			ops = &batch_failed_ref_ops;
+		} else {
+			lum->handle = handle;
+			ops = lttng_ust_abi_objd_ops(lum->handle);
+			/* Fail this command only, the batch goes on. */
+			if (!ops)
+				ops = &batch_failed_ref_ops;
+		}
+	} else {
+		ops = lttng_ust_abi_objd_ops(lum->handle);
+	}
 	if (!ops) {
 		ret = -ENOENT;
 		goto error;
@@ -950,8 +1255,10 @@ int handle_message(struct sock_info *sock_info,
 	case LTTNG_UST_ABI_EVENT_NOTIFIER_GROUP_CREATE:
 		/*
 		 * Those commands expect a reply to the struct ustcomm_ust_msg
-		 * before sending additional payload.
+		 * before sending additional payload, except within a batch.
 		 */
+		if (sock_info->batch_active)
+			break;
 		prepare_cmd_reply(&lur, lum->handle, lum->cmd, 0);
 
 		ret = send_reply(sock, &lur);
@@ -1414,6 +1721,15 @@ int handle_message(struct sock_info *sock_info,
 		goto error;
 	}
 
+	if (batch_reply) {
+		/* Replied to at LTTNG_UST_ABI_BATCH_END. */
+		batch_reply = 0;
+		lur.handle = batch_handle;
+		lur.tag = lum->tag;
+		ret = batch_add_reply(sock_info, &lur);
+		goto error;
+	}
+
 	ret = send_reply(sock, &lur);
 	if (ret < 0) {
 		DBG("error sending reply");
@@ -1442,6 +1758,20 @@ int handle_message(struct sock_info *sock_info,
 	}
 
 error:
+	/*
+	 * A batched command leaving early is replied to as well, so that
+	 * the replies stay in tag order. A receive failure still closes
+	 * the connection.
+	 */
+	if (batch_reply) {
+		int reply_ret;
+
+		prepare_cmd_reply(&lur, batch_handle, lum->cmd, ret);
+		lur.tag = lum->tag;
+		reply_ret = batch_add_reply(sock_info, &lur);
+		if (!ret)
+			ret = reply_ret;
+	}
 	ust_unlock();
 
 	return ret;
@@ -1462,6 +1792,12 @@ void cleanup_sock_info(struct sock_info *sock_info, int exiting)
 	sock_info->registration_done = 0;
 	sock_info->initial_statedump_done = 0;
 
+	/* A forked child does not hold the admission slot of its parent. */
+	if (exiting)
+		admission_exit(sock_info);
+	else
+		sock_info->admission_slot = -1;
+
 	/*
 	 * wait_shm_mmap, socket and notify socket are used by listener
 	 * threads outside of the ust lock, so we cannot tear them down
@@ -1505,6 +1841,17 @@ void cleanup_sock_info(struct sock_info *sock_info, int exiting)
 	}
 }
 
+static
+int open_wait_shm(struct sock_info *sock_info)
+{
+	int wait_shm_fd;
+
+	wait_shm_fd = shm_open(sock_info->wait_shm_path, O_RDWR, 0);
+	if (wait_shm_fd >= 0 || errno != EACCES)
+		return wait_shm_fd;
+	return shm_open(sock_info->wait_shm_path, O_RDONLY, 0);
+}
+
 /*
  * Using fork to set umask in the child process (not multi-thread safe).
  * We deal with the shm_open vs ftruncate race (happening when the
@@ -1521,9 +1868,10 @@ int get_wait_shm(struct sock_info *sock_info, size_t mmap_size)
 	pid_t pid;
 
 	/*
-	 * Try to open read-only.
+	 * Try to open read-only, or read-write when allowed so the
+	 * registration admission state can be updated.
 	 */
-	wait_shm_fd = shm_open(sock_info->wait_shm_path, O_RDONLY, 0);
+	wait_shm_fd = open_wait_shm(sock_info);
 	if (wait_shm_fd >= 0) {
 		int32_t tmp_read;
 		ssize_t len;
@@ -1583,7 +1931,7 @@ open_write:
 		/*
 		 * Try to open read-only again after creation.
 		 */
-		wait_shm_fd = shm_open(sock_info->wait_shm_path, O_RDONLY, 0);
+		wait_shm_fd = open_wait_shm(sock_info);
 		if (wait_shm_fd < 0) {
 			/*
 			 * Real-only open did not work. It's a failure
@@ -1673,7 +2021,7 @@ static
 char *get_map_shm(struct sock_info *sock_info)
 {
 	long page_size;
-	int wait_shm_fd, ret;
+	int wait_shm_fd, ret, flags, prot = PROT_READ;
 	char *wait_shm_mmap;
 
 	page_size = sysconf(_SC_PAGE_SIZE);
@@ -1705,7 +2053,10 @@ char *get_map_shm(struct sock_info *sock_info)
 	wait_shm_fd = ret;
 	lttng_ust_unlock_fd_tracker();
 
-	wait_shm_mmap = mmap(NULL, page_size, PROT_READ,
+	flags = fcntl(wait_shm_fd, F_GETFL);
+	if (flags >= 0 && (flags & O_ACCMODE) == O_RDWR)
+		prot |= PROT_WRITE;
+	wait_shm_mmap = mmap(NULL, page_size, prot,
 		  MAP_SHARED, wait_shm_fd, 0);
 
 	/* close shm fd immediately after taking the mmap reference */
@@ -1722,6 +2073,7 @@ char *get_map_shm(struct sock_info *sock_info)
 		DBG("mmap error (can be caused by race with sessiond). Fallback to poll mode.");
 		goto error;
 	}
+	sock_info->wait_shm_writable = !!(prot & PROT_WRITE);
 	return wait_shm_mmap;
 
 error:
@@ -1781,6 +2133,95 @@ error:
 	return;
 }
 
+static
+long get_register_wave(void)
+{
+	const char *str;
+
+	if (register_wave >= 0)
+		return register_wave;
+	register_wave = LTTNG_UST_DEFAULT_REGISTER_WAVE;
+	str = lttng_ust_getenv("LTTNG_UST_REGISTER_WAVE");
+	if (str) {
+		char *endptr;
+		long wave;
+
+		errno = 0;
+		wave = strtol(str, &endptr, 10);
+		if (errno || *endptr != '\0' || wave < 0 || wave > INT32_MAX)
+			WARN("Invalid LTTNG_UST_REGISTER_WAVE value \"%s\"", str);
+		else
+			register_wave = wave;
+	}
+	return register_wave;
+}
+
+static
+struct lttng_ust_admission *get_admission(struct sock_info *sock_info)
+{
+	if (!sock_info->wait_shm_mmap || !sock_info->wait_shm_writable)
+		return NULL;
+	return (struct lttng_ust_admission *)
+		(sock_info->wait_shm_mmap + LTTNG_UST_WAIT_ADMISSION_OFFSET);
+}
+
+/*
+ * Wait until this listener is admitted to register. Registrations
+ * proceed regardless when the wait shm is not writable, and when no
+ * slot is released for LTTNG_UST_REGISTER_ADMISSION_TIMEOUT_MS.
+ */
+static
+void admission_enter(struct sock_info *sock_info)
+{
+	struct lttng_ust_admission *admission;
+	long wave = get_register_wave();
+
+	admission = get_admission(sock_info);
+	if (!admission || !wave || sock_info->admission_slot >= 0)
+		return;
+	sock_info->admission_slot = lttng_ust_admission_enter(admission,
+		wave, LTTNG_UST_REGISTER_ADMISSION_TIMEOUT_MS);
+	if (sock_info->admission_slot < 0)
+		DBG("Registration admission wait timed out for %s apps",
+			sock_info->name);
+}
+
+static
+void admission_exit(struct sock_info *sock_info)
+{
+	struct lttng_ust_admission *admission;
+
+	if (sock_info->admission_slot < 0)
+		return;
+	admission = get_admission(sock_info);
+	if (admission)
+		lttng_ust_admission_exit(admission, sock_info->admission_slot);
+	sock_info->admission_slot = -1;
+}
+
+/*
+ * Sleep before retrying after a sequence of failure / wait / failure,
+ * which deals with a killed or broken session daemon. The exponential
+ * backoff is jittered so that processes which failed together do not
+ * retry together.
+ */
+static
+void register_backoff(unsigned int nr_failures, unsigned int *seed)
+{
+	unsigned long delay_ms = LTTNG_UST_REGISTER_BACKOFF_MIN_MS;
+	struct timespec delay;
+
+	while (nr_failures-- > 1 && delay_ms < LTTNG_UST_REGISTER_BACKOFF_MAX_MS)
+		delay_ms *= 2;
+	delay_ms = min_t(unsigned long, delay_ms, LTTNG_UST_REGISTER_BACKOFF_MAX_MS);
+	/* Uniformly within [delay / 2, delay). */
+	delay_ms = delay_ms / 2 + (unsigned long) rand_r(seed) % (delay_ms / 2);
+	delay.tv_sec = delay_ms / 1000;
+	delay.tv_nsec = (delay_ms % 1000) * 1000000L;
+	while (nanosleep(&delay, &delay) && errno == EINTR)
+		;
+}
+
 /*
  * This thread does not allocate any resource, except within
  * handle_message, within mutex protection. This mutex protects against
@@ -1793,6 +2234,8 @@ void *ust_listener_thread(void *arg)
 {
 	struct sock_info *sock_info = arg;
 	int sock, ret, prev_connect_failed = 0, has_waited = 0, fd;
+	unsigned int nr_failures = 0, seed;
+	struct timespec now;
 	long timeout;
 
 	lttng_ust_alloc_tls();
@@ -1805,25 +2248,28 @@ void *ust_listener_thread(void *arg)
 		ERR("Unable to set UST process name");
 	}
 
+	(void) clock_gettime(CLOCK_MONOTONIC, &now);
+	seed = (unsigned int) getpid() ^ (unsigned int) now.tv_nsec;
+
 	/* Restart trying to connect to the session daemon */
 restart:
 	if (prev_connect_failed) {
+		/* Let the next wave in while we wait. */
+		admission_exit(sock_info);
+		nr_failures++;
 		/* Wait for sessiond availability with pipe */
 		wait_for_sessiond(sock_info);
 		if (has_waited) {
 			has_waited = 0;
-			/*
-			 * Sleep for 5 seconds before retrying after a
-			 * sequence of failure / wait / failure. This
-			 * deals with a killed or broken session daemon.
-			 */
-			sleep(5);
+			register_backoff(nr_failures, &seed);
 		} else {
 			has_waited = 1;
 		}
 		prev_connect_failed = 0;
 	}
 
+	admission_enter(sock_info);
+
 	if (ust_lock()) {
 		goto quit;
 	}
@@ -2022,6 +2468,7 @@ restart:
 		goto restart;
 	}
 	sock = sock_info->socket;
+	nr_failures = 0;
 
 	ust_unlock();
 
@@ -2062,6 +2509,7 @@ restart:
 				 */
 				goto end;
 			}
+			coalesce_flush_thread_start();
 			continue;
 		default:
 			if (len < 0) {
@@ -2081,6 +2529,12 @@ end:
 	if (ust_lock()) {
 		goto quit;
 	}
+	/* Drop the batch interrupted by the disconnection, if any */
+	batch_end(sock_info);
+	free(sock_info->batch_replies);
+	sock_info->batch_replies = NULL;
+	sock_info->batch_nr_replies = 0;
+	sock_info->batch_alloc_replies = 0;
 	/* Cleanup socket handles before trying to reconnect */
 	lttng_ust_abi_objd_table_owner_cleanup(sock_info);
 	ust_unlock();
@@ -2293,6 +2747,7 @@ void lttng_ust_ctor(void)
 	} else {
 		handle_register_done(&local_apps);
 	}
+
 	ret = pthread_attr_destroy(&thread_attr);
 	if (ret) {
 		ERR("pthread_attr_destroy: %s", strerror(ret));
@@ -2416,8 +2871,19 @@ void lttng_ust_exit(void)
 			local_apps.thread_active = 0;
 		}
 	}
+	if (coalesce_flush_thread_active) {
+		ret = pthread_cancel(coalesce_flush_thread);
+		if (ret) {
+			ERR("Error cancelling coalesce flush thread: %s",
+				strerror(ret));
+		} else {
+			coalesce_flush_thread_active = 0;
+		}
+	}
 	pthread_mutex_unlock(&ust_exit_mutex);
 
+	lttng_bytecode_reorder_exit();
+
 	/*
 	 * Do NOT join threads: use of sys_futex makes it impossible to
 	 * join the threads without using async-cancel, but async-cancel
@@ -2491,6 +2957,7 @@ void lttng_ust_before_fork(sigset_t *save_sigset)
 	pthread_mutex_lock(&ust_fork_mutex);
 
 	ust_lock_nocheck();
+	lttng_bytecode_reorder_lock();
 	lttng_ust_urcu_before_fork();
 	lttng_ust_lock_fd_tracker();
 	lttng_perf_lock();
@@ -2520,6 +2987,7 @@ void lttng_ust_after_fork_parent(sigset_t *restore_sigset)
 		return;
 	DBG("process %d", getpid());
 	lttng_ust_urcu_after_fork_parent();
+	lttng_bytecode_reorder_unlock();
 	/* Release mutexes and re-enable signals */
 	ust_after_fork_common(restore_sigset);
 }
@@ -2540,12 +3008,17 @@ void lttng_ust_after_fork_child(sigset_t *restore_sigset)
 	lttng_context_vpid_reset();
 	lttng_context_vtid_reset();
 	lttng_ust_context_procname_reset();
+	lttng_context_ns_enable_process_cache();
 	ust_context_ns_reset();
 	ust_context_vuids_reset();
 	ust_context_vgids_reset();
 	DBG("process %d", getpid());
 	/* Release urcu mutexes */
 	lttng_ust_urcu_after_fork_child();
+	lttng_bytecode_reorder_after_fork_child();
+	/* Only the forking thread survives, the constructor starts over. */
+	coalesce_flush_thread_active = 0;
+	coalesce_flush_period_us = 0;
 	lttng_ust_cleanup(0);
 	/* Release mutexes and re-enable signals */
 	ust_after_fork_common(restore_sigset);
@@ -2554,6 +3027,7 @@ void lttng_ust_after_fork_child(sigset_t *restore_sigset)
 
 void lttng_ust_after_setns(void)
 {
+	lttng_context_ns_disable_process_cache();
 	ust_context_ns_reset();
 	ust_context_vuids_reset();
 	ust_context_vgids_reset();
@@ -2561,6 +3035,7 @@ void lttng_ust_after_setns(void)
 
 void lttng_ust_after_unshare(void)
 {
+	lttng_context_ns_disable_process_cache();
 	ust_context_ns_reset();
 	ust_context_vuids_reset();
 	ust_context_vgids_reset();
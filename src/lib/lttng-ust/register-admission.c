@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Registration admission: bounds the number of processes registering
+ * at once to a session daemon, through slots kept in the wait shm page
+ * shared by all the processes waiting for this session daemon.
+ *
+ * A slot records the pid of its owner rather than being counted, so
+ * that the slot of a process killed, crashed or replaced by exec while
+ * registering is reclaimed by the next process looking for one, instead
+ * of shrinking the wave for good.
+ */
+
+#define _LGPL_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+
+#include "futex.h"
+#include "register-admission.h"
+
+/*
+ * Whether the owner of a slot is gone. A process of another user
+ * (EPERM) is alive. A process of another pid namespace sharing the
+ * wait shm may be mistaken for a dead one, which only lets one more
+ * process in.
+ */
+static
+bool owner_gone(int32_t owner)
+{
+	return kill((pid_t) owner, 0) < 0 && errno == ESRCH;
+}
+
+int lttng_ust_admission_enter(struct lttng_ust_admission *admission,
+		unsigned int wave, unsigned int timeout_ms)
+{
+	const struct timespec timeout = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_nsec = (timeout_ms % 1000) * 1000000L,
+	};
+	int32_t pid = (int32_t) getpid();
+	bool stale = false, timed_out = false;
+	unsigned int i, slot;
+
+	if (wave > LTTNG_UST_ADMISSION_NR_SLOTS)
+		wave = LTTNG_UST_ADMISSION_NR_SLOTS;
+	for (;;) {
+		int32_t released = uatomic_read(&admission->released);
+
+		for (slot = 0; slot < wave; slot++) {
+			int32_t owner = uatomic_read(&admission->slots[slot]);
+
+			if (owner && owner != pid && !owner_gone(owner))
+				continue;
+			if (uatomic_cmpxchg(&admission->slots[slot], owner, pid) == owner)
+				goto admitted;
+		}
+		if (timed_out)
+			return -1;
+		if (lttng_ust_futex_async(&admission->released, FUTEX_WAIT,
+				released, &timeout, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:	/* Released meanwhile. */
+			case EINTR:
+				break;
+			default:
+				/* Owners may have died meanwhile: look once more. */
+				timed_out = true;
+				break;
+			}
+		}
+	}
+
+admitted:
+	/* Other slots left by an image replaced by exec. */
+	for (i = slot + 1; i < LTTNG_UST_ADMISSION_NR_SLOTS; i++) {
+		if (uatomic_cmpxchg(&admission->slots[i], pid, 0) == pid)
+			stale = true;
+	}
+	if (stale) {
+		uatomic_inc(&admission->released);
+		(void) lttng_ust_futex_async(&admission->released, FUTEX_WAKE,
+				INT_MAX, NULL, NULL, 0);
+	}
+	return (int) slot;
+}
+
+void lttng_ust_admission_exit(struct lttng_ust_admission *admission,
+		int slot)
+{
+	int32_t pid = (int32_t) getpid();
+
+	if (slot < 0 || slot >= LTTNG_UST_ADMISSION_NR_SLOTS)
+		return;
+	/* Unless reclaimed meanwhile, by mistake, see owner_gone(). */
+	if (uatomic_cmpxchg(&admission->slots[slot], pid, 0) != pid)
+		return;
+	uatomic_inc(&admission->released);
+	(void) lttng_ust_futex_async(&admission->released, FUTEX_WAKE,
+			INT_MAX, NULL, NULL, 0);
+}
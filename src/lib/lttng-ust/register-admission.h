@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Registration admission, within the session daemon wait shm page.
+ */
+
+#ifndef _LTTNG_UST_REGISTER_ADMISSION_H
+#define _LTTNG_UST_REGISTER_ADMISSION_H
+
+#include <stdint.h>
+
+/* Maximum number of processes admitted at once. */
+#define LTTNG_UST_ADMISSION_NR_SLOTS	256
+
+/*
+ * Each admitted process holds a slot, which records its pid. The
+ * release counter is the futex the waiters sleep on.
+ */
+struct lttng_ust_admission {
+	int32_t released;			/* Slot releases (futex). */
+	int32_t slots[LTTNG_UST_ADMISSION_NR_SLOTS];	/* Owner pid, 0 if free. */
+};
+
+/*
+ * Wait for a free slot among the first "wave" ones. Slots of processes
+ * which no longer exist are reclaimed, as are slots still recorded for
+ * the calling process, which cannot hold one yet: they were left by the
+ * image it replaced with exec. Returns the slot taken, or -1 if no slot
+ * was released nor reclaimed within timeout_ms, in which case the
+ * caller proceeds without slot.
+ */
+int lttng_ust_admission_enter(struct lttng_ust_admission *admission,
+		unsigned int wave, unsigned int timeout_ms)
+	__attribute__((visibility("hidden")));
+
+/* Release a slot taken by lttng_ust_admission_enter(). */
+void lttng_ust_admission_exit(struct lttng_ust_admission *admission,
+		int slot)
+	__attribute__((visibility("hidden")));
+
+#endif /* _LTTNG_UST_REGISTER_ADMISSION_H */
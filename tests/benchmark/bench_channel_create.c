@@ -0,0 +1,83 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * LTTng Userspace Tracer (UST) - channel creation benchmark
+ *
+ * Creates and destroys a per-cpu channel the way the consumer daemon
+ * does, with one shm file per possible cpu, and reports the wall time
+ * spent in channel creation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <lttng/ust-ctl.h>
+#include <lttng/ust-sigbus.h>
+
+#include "stream-fds.h"
+
+DEFINE_LTTNG_UST_SIGBUS_STATE();
+
+static
+double now_ms(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+	struct lttng_ust_ctl_consumer_channel_attr attr;
+	struct lttng_ust_ctl_consumer_channel *chan;
+	unsigned long subbuf_size = 1024 * 1024, num_subbuf = 4;
+	int nr_fds, i, iters = 5, *fds;
+	double start, total = 0;
+
+	if (argc > 1)
+		subbuf_size = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		num_subbuf = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		iters = atoi(argv[3]);
+	if (!subbuf_size || !num_subbuf || iters <= 0) {
+		printf("Usage: %s [subbuf_size] [num_subbuf] [iterations]\n", argv[0]);
+		exit(1);
+	}
+
+	nr_fds = lttng_ust_ctl_get_nr_stream_per_channel();
+	fds = calloc(nr_fds, sizeof(*fds));
+	if (!fds)
+		exit(1);
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = LTTNG_UST_ABI_CHAN_PER_CPU;
+	attr.subbuf_size = subbuf_size;
+	attr.num_subbuf = num_subbuf;
+	attr.output = LTTNG_UST_ABI_MMAP;
+
+	for (i = 0; i < iters; i++) {
+		if (open_stream_fds(fds, nr_fds)) {
+			perror("shm_open");
+			exit(1);
+		}
+		start = now_ms();
+		chan = lttng_ust_ctl_create_channel(&attr, fds, nr_fds);
+		total += now_ms() - start;
+		if (!chan) {
+			fprintf(stderr, "Channel creation failed\n");
+			exit(1);
+		}
+		lttng_ust_ctl_destroy_channel(chan);
+		close_stream_fds(fds, nr_fds);
+	}
+
+	printf("Number of streams: %d\n", nr_fds);
+	printf("Buffer size: %lu\n", subbuf_size * num_subbuf);
+	printf("Channel creation time (ms): %.3f\n", total / iters);
+	free(fds);
+	return 0;
+}
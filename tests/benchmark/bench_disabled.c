@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * LTTng Userspace Tracer (UST) - disabled tracepoints benchmark
+ *
+ * Runs a tight loop containing 50 tracepoint call sites, without any
+ * tracing session, and reports the cycles spent per loop. The code size
+ * of bench_loop() (and of its bench_loop.cold partition) is reported and
+ * compared between the variants by the test_benchmark_disabled script.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+
+#ifdef TRACING
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#include "ust_tests_benchmark.h"
+
+#define TP(n)	lttng_ust_tracepoint(ust_tests_benchmark, tpbench, (int) (i * (n)))
+#else
+#define TP(n)	do { } while (0)
+#endif
+
+#define TP5(n)	TP(n); TP(n + 1); TP(n + 2); TP(n + 3); TP(n + 4)
+#define TP50()	TP5(0); TP5(5); TP5(10); TP5(15); TP5(20); \
+		TP5(25); TP5(30); TP5(35); TP5(40); TP5(45)
+
+static volatile unsigned long sink;
+
+static
+void bench_loop(unsigned long nr_loops)
+	__attribute__((noinline));
+static
+void bench_loop(unsigned long nr_loops)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr_loops; i++) {
+		TP50();
+		sink = i;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long nr_loops = 10000000;
+	caa_cycles_t start, end;
+
+	if (argc > 1)
+		nr_loops = strtoul(argv[1], NULL, 10);
+	if (!nr_loops) {
+		printf("Usage: %s [nr_loops]\n", argv[0]);
+		exit(1);
+	}
+
+	/* Warm up. */
+	bench_loop(nr_loops / 10 ? : 1);
+
+	start = caa_get_cycles();
+	bench_loop(nr_loops);
+	end = caa_get_cycles();
+
+	printf("Number of loops: %lu\n", nr_loops);
+	printf("Cycles per loop: %.2f\n", (double) (end - start) / nr_loops);
+	return 0;
+}
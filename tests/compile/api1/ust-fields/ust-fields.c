@@ -30,6 +30,31 @@ int main(int argc, char **argv)
 	for (i = 0; i < 10; i++) {
 		lttng_ust_tracepoint(ust_tests_ust_fields, tptest_bis, i, i % 6);
 	}
+
+	for (i = 0; i < 10; i++) {
+		struct ust_tests_ust_fields_state state = {
+			.tag = 'a' + i,
+			.counter = i,
+			.level = -i,
+			.ratio = i / 10.0,
+			.name = "test",
+			.flags = { i, i << 8, i << 16 },
+			.unlisted = i,
+			.last = i,
+		};
+
+		lttng_ust_tracepoint(ust_tests_ust_fields, tpstruct, &state);
+	}
+
+	for (i = 0; i < 64; i += 7) {
+		lttng_ust_tracepoint(ust_tests_ust_fields, tpvarint,
+			UINT64_C(1) << i, -(INT64_C(1) << i));
+	}
+
+	for (i = 0; i < 64; i++) {
+		lttng_ust_tracepoint(ust_tests_ust_fields, tpdelta,
+			UINT64_C(1000000000000) + i, -1000 + i);
+	}
 	fprintf(stderr, " done.\n");
 	return 0;
 }
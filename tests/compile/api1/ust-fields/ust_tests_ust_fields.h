@@ -7,6 +7,24 @@
 #undef LTTNG_UST_TRACEPOINT_PROVIDER
 #define LTTNG_UST_TRACEPOINT_PROVIDER ust_tests_ust_fields
 
+#ifndef _UST_TESTS_UST_FIELDS_STATE_H
+#define _UST_TESTS_UST_FIELDS_STATE_H
+
+#include <stdint.h>
+
+struct ust_tests_ust_fields_state {
+	char tag;
+	uint64_t counter;
+	short level;
+	double ratio;
+	char name[5];
+	uint32_t flags[3];
+	int unlisted;
+	uint8_t last;
+};
+
+#endif /* _UST_TESTS_UST_FIELDS_STATE_H */
+
 #if !defined(_TRACEPOINT_UST_TESTS_UST_FIELDS_H) || defined(LTTNG_UST_TRACEPOINT_HEADER_MULTI_READ)
 #define _TRACEPOINT_UST_TESTS_UST_FIELDS_H
 
@@ -58,6 +76,51 @@ LTTNG_UST_TRACEPOINT_EVENT(ust_tests_ust_fields, tptest_bis,
 	)
 )
 
+/*
+ * Structure recorded in its native layout. The "unlisted" member is
+ * omitted from the description, and recorded as padding.
+ */
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_ust_fields, tpstruct,
+	LTTNG_UST_TP_ARGS(const struct ust_tests_ust_fields_state *, state),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_struct(struct ust_tests_ust_fields_state, state, state,
+			lttng_ust_field_struct_member_integer(struct ust_tests_ust_fields_state, tag)
+			lttng_ust_field_struct_member_integer(struct ust_tests_ust_fields_state, counter)
+			lttng_ust_field_struct_member_integer(struct ust_tests_ust_fields_state, level)
+			lttng_ust_field_struct_member_float(struct ust_tests_ust_fields_state, ratio)
+			lttng_ust_field_struct_member_array_text(struct ust_tests_ust_fields_state, name)
+			lttng_ust_field_struct_member_array_hex(struct ust_tests_ust_fields_state, flags)
+			lttng_ust_field_struct_member_integer(struct ust_tests_ust_fields_state, last)
+		)
+	)
+)
+
+/*
+ * Variable-length integers, recorded with each of the possible widths
+ * over the iterations of the test.
+ */
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_ust_fields, tpvarint,
+	LTTNG_UST_TP_ARGS(uint64_t, seq, int64_t, delta),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer_varint(uint64_t, seq, seq)
+		lttng_ust_field_integer_varint(int64_t, delta, delta)
+		lttng_ust_field_integer_varint(unsigned char, low, seq)
+	)
+)
+
+/*
+ * Delta-encoded integers, recorded as deltas against the first record
+ * of each packet.
+ */
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_ust_fields, tpdelta,
+	LTTNG_UST_TP_ARGS(uint64_t, seq, int32_t, level),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer_delta(uint64_t, seq, seq)
+		lttng_ust_field_string(name, "delta")
+		lttng_ust_field_integer_delta(int32_t, level, level)
+	)
+)
+
 #endif /* _TRACEPOINT_UST_TESTS_UST_FIELDS_H */
 
 #undef LTTNG_UST_TRACEPOINT_INCLUDE
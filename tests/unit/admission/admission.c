@@ -0,0 +1,128 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Registration admission slots shared by processes: waves, timeouts,
+ * and slots reclaimed from killed processes and from a previous exec
+ * image.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib/lttng-ust/register-admission.h"
+
+#include "tap.h"
+
+#define WAVE	2
+
+static struct lttng_ust_admission *admission;
+
+/*
+ * Fork a process entering admission, which reports the slot it took on
+ * the returned pipe and, if hold is set, holds it until killed.
+ */
+static
+int spawn(unsigned int timeout_ms, bool hold, pid_t *pid)
+{
+	int fds[2];
+
+	if (pipe(fds))
+		abort();
+	*pid = fork();
+	if (*pid < 0)
+		abort();
+	if (!*pid) {
+		int ret = lttng_ust_admission_enter(admission, WAVE, timeout_ms);
+
+		if (write(fds[1], &ret, sizeof(ret)) != sizeof(ret))
+			_exit(EXIT_FAILURE);
+		while (hold)
+			pause();
+		_exit(EXIT_SUCCESS);
+	}
+	(void) close(fds[1]);
+	return fds[0];
+}
+
+/* Slot taken by a spawned process. */
+static
+int slot_of(int fd)
+{
+	int slot;
+
+	if (read(fd, &slot, sizeof(slot)) != sizeof(slot))
+		slot = -2;
+	(void) close(fd);
+	return slot;
+}
+
+static
+void reap(pid_t pid, bool kill_it)
+{
+	if (kill_it)
+		(void) kill(pid, SIGKILL);
+	(void) waitpid(pid, NULL, 0);
+}
+
+int main(void)
+{
+	const struct timespec delay = { .tv_nsec = 200000000 };
+	int slot_a, slot_b, slot_c, slot, fd;
+	pid_t pid_a, pid_b, pid_c;
+	int32_t released;
+
+	plan_tests(7);
+
+	admission = mmap(NULL, sizeof(*admission), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (admission == MAP_FAILED)
+		abort();
+	memset(admission, 0, sizeof(*admission));
+
+	slot_a = slot_of(spawn(1000, true, &pid_a));
+	slot_b = slot_of(spawn(1000, true, &pid_b));
+	ok(slot_a == 0 && slot_b == 1, "a wave of %d processes admitted", WAVE);
+
+	slot_c = slot_of(spawn(200, false, &pid_c));
+	reap(pid_c, false);
+	ok(slot_c == -1, "admission times out while the wave is full");
+
+	/*
+	 * A holder is killed, without releasing its slot, while the next
+	 * process waits: the waiter takes the slot once its wait times out.
+	 */
+	fd = spawn(1000, false, &pid_c);
+	(void) nanosleep(&delay, NULL);
+	reap(pid_a, true);
+	slot_c = slot_of(fd);
+	reap(pid_c, false);
+	ok(slot_c == slot_a, "slot of a killed holder reclaimed");
+
+	/* The waiter exited without releasing its slot either. */
+	slot = lttng_ust_admission_enter(admission, WAVE, 1000);
+	ok(slot == slot_c, "slot of an exited holder reclaimed");
+
+	released = admission->released;
+	lttng_ust_admission_exit(admission, slot);
+	ok(!admission->slots[slot] && admission->released == released + 1,
+		"slot released");
+
+	/* Slots recorded for this pid were left by a previous exec image. */
+	admission->slots[0] = (int32_t) getpid();
+	admission->slots[LTTNG_UST_ADMISSION_NR_SLOTS - 1] = (int32_t) getpid();
+	slot = lttng_ust_admission_enter(admission, WAVE, 1000);
+	ok(slot == 0, "slot of a previous exec image reused");
+	ok(!admission->slots[LTTNG_UST_ADMISSION_NR_SLOTS - 1],
+		"other slots of a previous exec image released");
+	lttng_ust_admission_exit(admission, slot);
+
+	reap(pid_b, true);
+	return exit_status();
+}
@@ -0,0 +1,782 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Link and interpret filter bytecode against a test event: set
+ * membership on typed and dynamically typed operands, adaptive
+ * reordering of logical operands, and indexed dispatch of event
+ * notifiers.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <lttng/urcu/urcu-ust.h>
+
+#include "common/events.h"
+#include "common/tracer.h"
+#include "lib/lttng-ust/context-internal.h"
+#include "lib/lttng-ust/events.h"
+#include "lib/lttng-ust/lttng-bytecode.h"
+
+#include "tap.h"
+
+#define PROG_MAX_LEN	512
+
+/* Filter bytecode under construction: code, then reloc table. */
+struct prog {
+	char code[PROG_MAX_LEN];
+	uint16_t len;
+	char relocs[PROG_MAX_LEN];
+	uint16_t relocs_len;
+};
+
+static const struct lttng_ust_event_field intfield = {
+	.struct_size = sizeof(struct lttng_ust_event_field),
+	.name = "intfield",
+	.type = lttng_ust_type_integer_define(int64_t, LTTNG_UST_BYTE_ORDER, 10),
+};
+
+static const struct lttng_ust_type_string string_type = {
+	.parent = {
+		.type = lttng_ust_type_string,
+	},
+	.struct_size = sizeof(struct lttng_ust_type_string),
+	.encoding = lttng_ust_string_encoding_UTF8,
+};
+
+static const struct lttng_ust_event_field strfield = {
+	.struct_size = sizeof(struct lttng_ust_event_field),
+	.name = "strfield",
+	.type = &string_type.parent,
+};
+
+static const struct lttng_ust_event_field otherfield = {
+	.struct_size = sizeof(struct lttng_ust_event_field),
+	.name = "otherfield",
+	.type = lttng_ust_type_integer_define(int64_t, LTTNG_UST_BYTE_ORDER, 10),
+};
+
+static const struct lttng_ust_event_field * const fields[] = {
+	&intfield,
+	&strfield,
+	&otherfield,
+};
+
+static const struct lttng_ust_tracepoint_class tp_class = {
+	.struct_size = sizeof(struct lttng_ust_tracepoint_class),
+	.fields = fields,
+	.nr_fields = 3,
+};
+
+static const struct lttng_ust_event_desc event_desc = {
+	.struct_size = sizeof(struct lttng_ust_event_desc),
+	.event_name = "test",
+	.tp_class = &tp_class,
+};
+
+/* Interpreter stack data of the test event. */
+struct event_data {
+	int64_t intfield;
+	const char *strfield;
+	int64_t otherfield;
+};
+
+/* Dynamically typed context "dyn", returning an integer or a string. */
+static struct lttng_ust_ctx_value dyn_value;
+
+static
+void dyn_get_value(void *priv __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx __attribute__((unused)),
+		struct lttng_ust_ctx_value *value)
+{
+	*value = dyn_value;
+}
+
+static const struct lttng_ust_type_common dyn_type = {
+	.type = lttng_ust_type_dynamic,
+};
+
+static const struct lttng_ust_event_field dyn_field = {
+	.struct_size = sizeof(struct lttng_ust_event_field),
+	.name = "dyn",
+	.type = &dyn_type,
+};
+
+static struct lttng_ust_ctx_field ctx_fields[] = {
+	{
+		.event_field = &dyn_field,
+		.get_value = dyn_get_value,
+	},
+};
+
+static struct lttng_ust_ctx test_ctx = {
+	.fields = ctx_fields,
+	.nr_fields = 1,
+};
+
+static struct lttng_ust_ctx *ctx = &test_ctx;
+
+int lttng_get_context_index(struct lttng_ust_ctx *_ctx, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < _ctx->nr_fields; i++) {
+		if (!strcmp(_ctx->fields[i].event_field->name, name))
+			return i;
+	}
+	return -1;
+}
+
+int lttng_context_is_app(const char *name __attribute__((unused)))
+{
+	return 0;
+}
+
+int lttng_ust_add_app_context_to_ctx_rcu(const char *name __attribute__((unused)),
+		struct lttng_ust_ctx **_ctx __attribute__((unused)))
+{
+	return -ENOENT;
+}
+
+static
+void emit(struct prog *prog, const void *insn, size_t len)
+{
+	memcpy(&prog->code[prog->len], insn, len);
+	prog->len += len;
+}
+
+static
+void emit_op(struct prog *prog, bytecode_opcode_t op)
+{
+	emit(prog, &op, sizeof(op));
+}
+
+/* Returns the offset of the name within the reloc table. */
+static
+uint16_t emit_reloc(struct prog *prog, const char *name)
+{
+	uint16_t offset = prog->len;
+	uint16_t name_offset;
+
+	memcpy(&prog->relocs[prog->relocs_len], &offset, sizeof(offset));
+	prog->relocs_len += sizeof(offset);
+	name_offset = prog->relocs_len;
+	strcpy(&prog->relocs[prog->relocs_len], name);
+	prog->relocs_len += strlen(name) + 1;
+	return name_offset;
+}
+
+/* Load a field or context by reference, resolved at link time. */
+static
+void emit_ref(struct prog *prog, bytecode_opcode_t op, const char *name)
+{
+	struct field_ref ref = { 0 };
+
+	emit_reloc(prog, name);
+	emit_op(prog, op);
+	emit(prog, &ref, sizeof(ref));
+}
+
+/* Load a payload field through the symbol lookup path. */
+static
+void emit_payload_field(struct prog *prog, const char *name)
+{
+	struct get_symbol sym;
+
+	emit_op(prog, BYTECODE_OP_GET_PAYLOAD_ROOT);
+	sym.offset = emit_reloc(prog, name);
+	emit_op(prog, BYTECODE_OP_GET_SYMBOL);
+	emit(prog, &sym, sizeof(sym));
+	emit_op(prog, BYTECODE_OP_LOAD_FIELD);
+}
+
+static
+void emit_set_s64(struct prog *prog, const int64_t *elems, uint16_t nr_elem)
+{
+	struct set_op insn = {
+		.op = BYTECODE_OP_IN_SET_S64,
+		.nr_elem = nr_elem,
+		.data_len = nr_elem * sizeof(int64_t),
+	};
+
+	emit(prog, &insn, sizeof(insn));
+	emit(prog, elems, insn.data_len);
+}
+
+static
+void emit_set_string(struct prog *prog, const char * const *elems,
+		uint16_t nr_elem)
+{
+	struct set_op insn = {
+		.op = BYTECODE_OP_IN_SET_STRING,
+		.nr_elem = nr_elem,
+	};
+	uint16_t i;
+
+	for (i = 0; i < nr_elem; i++)
+		insn.data_len += strlen(elems[i]) + 1;
+	emit(prog, &insn, sizeof(insn));
+	for (i = 0; i < nr_elem; i++)
+		emit(prog, elems[i], strlen(elems[i]) + 1);
+}
+
+static
+void emit_load_s64(struct prog *prog, int64_t v)
+{
+	struct literal_numeric literal = { .v = v };
+
+	emit_op(prog, BYTECODE_OP_LOAD_S64);
+	emit(prog, &literal, sizeof(literal));
+}
+
+static
+void emit_load_string(struct prog *prog, const char *str)
+{
+	emit_op(prog, BYTECODE_OP_LOAD_STRING);
+	emit(prog, str, strlen(str) + 1);
+}
+
+/* Returns the offset of the instruction, to patch its jump target. */
+static
+uint16_t emit_logical(struct prog *prog, bytecode_opcode_t op)
+{
+	struct logical_op insn = { .op = op };
+	uint16_t offset = prog->len;
+
+	emit(prog, &insn, sizeof(insn));
+	return offset;
+}
+
+/* Jump past the instructions emitted so far. */
+static
+void patch_logical(struct prog *prog, uint16_t offset)
+{
+	struct logical_op *insn = (struct logical_op *) &prog->code[offset];
+
+	insn->skip_offset = prog->len;
+}
+
+static
+void emit_return(struct prog *prog)
+{
+	emit_op(prog, BYTECODE_OP_RETURN);
+}
+
+/*
+ * Link the program to the test event. Returns the runtime, whose
+ * interpreter_func always fails if linking failed.
+ */
+static
+struct lttng_ust_bytecode_runtime *link_prog(const struct prog *prog,
+		struct lttng_ust_event_common_private *event)
+{
+	struct lttng_ust_bytecode_node *node;
+	struct cds_list_head enabler_head;
+
+	node = zmalloc(sizeof(*node) + prog->len + prog->relocs_len);
+	if (!node)
+		abort();
+	node->type = LTTNG_UST_BYTECODE_TYPE_FILTER;
+	node->bc.len = prog->len + prog->relocs_len;
+	node->bc.reloc_offset = prog->len;
+	memcpy(node->bc.data, prog->code, prog->len);
+	memcpy(&node->bc.data[prog->len], prog->relocs, prog->relocs_len);
+	CDS_INIT_LIST_HEAD(&enabler_head);
+	cds_list_add(&node->node, &enabler_head);
+	CDS_INIT_LIST_HEAD(&event->filter_bytecode_runtime_head);
+	lttng_enabler_link_bytecode(&event_desc, &ctx,
+		&event->filter_bytecode_runtime_head, &enabler_head);
+	return cds_list_first_entry(&event->filter_bytecode_runtime_head,
+		struct lttng_ust_bytecode_runtime, node);
+}
+
+static
+void unlink_prog(struct lttng_ust_event_common_private *event)
+{
+	struct lttng_ust_event_common pub = {
+		.struct_size = sizeof(struct lttng_ust_event_common),
+		.priv = event,
+	};
+	struct lttng_ust_bytecode_node *node;
+
+	node = cds_list_first_entry(&event->filter_bytecode_runtime_head,
+		struct lttng_ust_bytecode_runtime, node)->bc;
+	lttng_free_event_filter_runtime(&pub);
+	free(node);
+}
+
+enum filter_outcome {
+	FILTER_ACCEPT,
+	FILTER_REJECT,
+	FILTER_ERROR,
+};
+
+static
+enum filter_outcome run(struct lttng_ust_bytecode_runtime *runtime,
+		const struct event_data *data)
+{
+	struct lttng_ust_probe_ctx probe_ctx = {
+		.struct_size = sizeof(struct lttng_ust_probe_ctx),
+	};
+	struct lttng_ust_bytecode_filter_ctx filter_ctx;
+
+	if (runtime->interpreter_func(runtime, (const char *) data,
+			&probe_ctx, &filter_ctx) != LTTNG_UST_BYTECODE_INTERPRETER_OK)
+		return FILTER_ERROR;
+	if (filter_ctx.result == LTTNG_UST_BYTECODE_FILTER_ACCEPT)
+		return FILTER_ACCEPT;
+	return FILTER_REJECT;
+}
+
+static const int64_t int_set[] = { 1, -5, 42, INT64_MAX };
+static const char * const string_set[] = { "foo", "bar", "" };
+
+static
+void test_set_s64(bool payload)
+{
+	struct lttng_ust_event_common_private event;
+	struct lttng_ust_bytecode_runtime *runtime;
+	struct event_data data = { .strfield = "foo" };
+	struct prog prog = { 0 };
+	const char *path = payload ? "payload field" : "field ref";
+
+	if (payload)
+		emit_payload_field(&prog, "intfield");
+	else
+		emit_ref(&prog, BYTECODE_OP_LOAD_FIELD_REF, "intfield");
+	emit_set_s64(&prog, int_set, 4);
+	emit_return(&prog);
+	runtime = link_prog(&prog, &event);
+	ok(!runtime->link_failed, "integer set on %s links", path);
+	data.intfield = 42;
+	ok(run(runtime, &data) == FILTER_ACCEPT, "integer set on %s accepts a member", path);
+	data.intfield = INT64_MAX;
+	ok(run(runtime, &data) == FILTER_ACCEPT, "integer set on %s accepts the last member", path);
+	data.intfield = 5;
+	ok(run(runtime, &data) == FILTER_REJECT, "integer set on %s rejects a non-member", path);
+	unlink_prog(&event);
+}
+
+static
+void test_set_string(bool payload)
+{
+	struct lttng_ust_event_common_private event;
+	struct lttng_ust_bytecode_runtime *runtime;
+	struct event_data data = { .intfield = 1 };
+	struct prog prog = { 0 };
+	const char *path = payload ? "payload field" : "field ref";
+
+	if (payload)
+		emit_payload_field(&prog, "strfield");
+	else
+		emit_ref(&prog, BYTECODE_OP_LOAD_FIELD_REF, "strfield");
+	emit_set_string(&prog, string_set, 3);
+	emit_return(&prog);
+	runtime = link_prog(&prog, &event);
+	ok(!runtime->link_failed, "string set on %s links", path);
+	data.strfield = "bar";
+	ok(run(runtime, &data) == FILTER_ACCEPT, "string set on %s accepts a member", path);
+	data.strfield = "";
+	ok(run(runtime, &data) == FILTER_ACCEPT, "string set on %s accepts the empty member", path);
+	data.strfield = "fo";
+	ok(run(runtime, &data) == FILTER_REJECT, "string set on %s rejects a prefix of a member", path);
+	data.strfield = "foobar";
+	ok(run(runtime, &data) == FILTER_REJECT, "string set on %s rejects an extension of a member", path);
+	unlink_prog(&event);
+}
+
+/* Operands of the wrong type known at link time. */
+static
+void test_set_mismatch(void)
+{
+	struct lttng_ust_event_common_private event;
+	struct lttng_ust_bytecode_runtime *runtime;
+	struct event_data data = { .intfield = 1, .strfield = "foo" };
+	struct prog prog = { 0 };
+
+	emit_payload_field(&prog, "intfield");
+	emit_set_string(&prog, string_set, 3);
+	emit_return(&prog);
+	runtime = link_prog(&prog, &event);
+	ok(runtime->link_failed, "string set on an integer field fails to link");
+	ok(run(runtime, &data) == FILTER_ERROR, "string set on an integer field is an error");
+	unlink_prog(&event);
+
+	memset(&prog, 0, sizeof(prog));
+	emit_payload_field(&prog, "strfield");
+	emit_set_s64(&prog, int_set, 4);
+	emit_return(&prog);
+	runtime = link_prog(&prog, &event);
+	ok(runtime->link_failed, "integer set on a string field fails to link");
+	unlink_prog(&event);
+}
+
+/* Operands typed at runtime only. */
+static
+void test_set_dynamic(void)
+{
+	struct lttng_ust_event_common_private event;
+	struct lttng_ust_bytecode_runtime *runtime;
+	struct event_data data = { .intfield = 1, .strfield = "foo" };
+	struct prog prog = { 0 };
+
+	emit_ref(&prog, BYTECODE_OP_GET_CONTEXT_REF, "dyn");
+	emit_set_string(&prog, string_set, 3);
+	emit_return(&prog);
+	runtime = link_prog(&prog, &event);
+	ok(!runtime->link_failed, "string set on a dynamic context links");
+	dyn_value.sel = LTTNG_UST_DYNAMIC_TYPE_STRING;
+	dyn_value.u.str = "foo";
+	ok(run(runtime, &data) == FILTER_ACCEPT, "string set on a dynamic string accepts a member");
+	dyn_value.u.str = "baz";
+	ok(run(runtime, &data) == FILTER_REJECT, "string set on a dynamic string rejects a non-member");
+	dyn_value.sel = LTTNG_UST_DYNAMIC_TYPE_S64;
+	dyn_value.u.s64 = 42;
+	ok(run(runtime, &data) == FILTER_ERROR, "string set on a dynamic integer is an error");
+	unlink_prog(&event);
+
+	memset(&prog, 0, sizeof(prog));
+	emit_ref(&prog, BYTECODE_OP_GET_CONTEXT_REF, "dyn");
+	emit_set_s64(&prog, int_set, 4);
+	emit_return(&prog);
+	runtime = link_prog(&prog, &event);
+	ok(!runtime->link_failed, "integer set on a dynamic context links");
+	ok(run(runtime, &data) == FILTER_ACCEPT, "integer set on a dynamic integer accepts a member");
+	dyn_value.sel = LTTNG_UST_DYNAMIC_TYPE_STRING;
+	dyn_value.u.str = "foo";
+	ok(run(runtime, &data) == FILTER_ERROR, "integer set on a dynamic string is an error");
+	unlink_prog(&event);
+}
+
+/* Offset within the stack data of the field loaded first. */
+static
+uint16_t first_field_offset(struct lttng_ust_bytecode_runtime *runtime)
+{
+	struct bytecode_runtime *bytecode =
+		caa_container_of(runtime, struct bytecode_runtime, p);
+	const char *code = CMM_LOAD_SHARED(bytecode->exec_code);
+	struct field_ref ref;
+
+	memcpy(&ref, ((const struct load_op *) code)->data, sizeof(ref));
+	return ref.offset;
+}
+
+enum reorder_workload {
+	WORKLOAD_RARE_INT,
+	WORKLOAD_RARE_STRING,
+	WORKLOAD_RARE_OTHER,
+};
+
+/*
+ * One field out of three is rarely as expected by the filter: its
+ * comparison should be reordered first. Strings are sometimes NULL,
+ * which makes their comparison fail.
+ */
+static
+void workload_data(enum reorder_workload workload, uint32_t *seed,
+		struct event_data *data)
+{
+	static const char * const strs[] = { "foo", "bar", NULL };
+	uint32_t x = *seed = *seed * 1103515245 + 12345;
+	bool rare = !((x >> 8) % 16), hit = (x >> 16) % 16;
+
+	data->intfield = (workload == WORKLOAD_RARE_INT ? rare : hit) ? 1 : 3;
+	data->otherfield = (workload == WORKLOAD_RARE_OTHER ? rare : hit) ? 2 : 4;
+	if ((workload == WORKLOAD_RARE_STRING ? rare : hit))
+		data->strfield = "foo";
+	else
+		data->strfield = strs[1 + (x >> 24) % 2];
+}
+
+/*
+ * intfield == 1 && strfield == "foo" && otherfield == 2, whose
+ * operands are reordered as the workload changes, more times than there
+ * are code buffers in the runtime.
+ */
+static
+void test_reorder(void)
+{
+	static const enum reorder_workload workloads[] = {
+		WORKLOAD_RARE_OTHER, WORKLOAD_RARE_INT, WORKLOAD_RARE_STRING,
+		WORKLOAD_RARE_OTHER, WORKLOAD_RARE_INT, WORKLOAD_RARE_STRING,
+	};
+	static const uint16_t first_offsets[] = {
+		[WORKLOAD_RARE_INT] = offsetof(struct event_data, intfield),
+		[WORKLOAD_RARE_STRING] = offsetof(struct event_data, strfield),
+		[WORKLOAD_RARE_OTHER] = offsetof(struct event_data, otherfield),
+	};
+	const struct timespec delay = { .tv_nsec = 10000000 };
+	struct lttng_ust_event_common_private event;
+	struct lttng_ust_bytecode_runtime *runtime;
+	unsigned long nr_eval = 0, nr_mismatch = 0;
+	struct prog prog = { 0 };
+	uint16_t and1, and2;
+	uint32_t seed = 1;
+	unsigned int i;
+
+	emit_ref(&prog, BYTECODE_OP_LOAD_FIELD_REF, "intfield");
+	emit_load_s64(&prog, 1);
+	emit_op(&prog, BYTECODE_OP_EQ);
+	and1 = emit_logical(&prog, BYTECODE_OP_AND);
+	emit_ref(&prog, BYTECODE_OP_LOAD_FIELD_REF, "strfield");
+	emit_load_string(&prog, "foo");
+	emit_op(&prog, BYTECODE_OP_EQ);
+	patch_logical(&prog, and1);
+	and2 = emit_logical(&prog, BYTECODE_OP_AND);
+	emit_ref(&prog, BYTECODE_OP_LOAD_FIELD_REF, "otherfield");
+	emit_load_s64(&prog, 2);
+	emit_op(&prog, BYTECODE_OP_EQ);
+	patch_logical(&prog, and2);
+	emit_return(&prog);
+	runtime = link_prog(&prog, &event);
+	ok(!runtime->link_failed &&
+		caa_container_of(runtime, struct bytecode_runtime, p)->reorder,
+		"logical chain is reorderable");
+
+	for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+		enum reorder_workload workload = workloads[i];
+		unsigned int round;
+
+		for (round = 0; round < 500; round++) {
+			unsigned int j;
+
+			if (first_field_offset(runtime) == first_offsets[workload])
+				break;
+			for (j = 0; j < 65536; j++) {
+				struct event_data data;
+				enum filter_outcome outcome;
+				bool expected;
+
+				workload_data(workload, &seed, &data);
+				expected = data.intfield == 1 && data.strfield &&
+					!strcmp(data.strfield, "foo") &&
+					data.otherfield == 2;
+				lttng_ust_urcu_read_lock();
+				outcome = run(runtime, &data);
+				lttng_ust_urcu_read_unlock();
+				/* An error rejects the event, as false. */
+				if ((outcome == FILTER_ACCEPT) != expected)
+					nr_mismatch++;
+				nr_eval++;
+			}
+			(void) nanosleep(&delay, NULL);
+		}
+		ok(first_field_offset(runtime) == first_offsets[workload],
+			"reordered for workload %u", i);
+	}
+	ok(!nr_mismatch, "reordered filter results match (%lu mismatches out of %lu)",
+		nr_mismatch, nr_eval);
+	unlink_prog(&event);
+}
+
+#define NR_NOTIFIERS	4
+
+struct test_notifier {
+	struct lttng_ust_event_common parent;
+	struct lttng_ust_event_notifier pub;
+	struct lttng_ust_event_notifier_private priv;
+	int64_t value;			/* Filter: intfield == value. */
+	bool settled;			/* Enabled before and after the sync. */
+	unsigned int nr_notified;
+};
+
+static struct test_notifier notifiers[NR_NOTIFIERS];
+static struct lttng_event_notifier_group notifier_group;
+
+static
+void count_notification(const struct lttng_ust_event_notifier *event_notifier,
+		const char *stack_data __attribute__((unused)),
+		struct lttng_ust_probe_ctx *probe_ctx __attribute__((unused)),
+		struct lttng_ust_notification_ctx *notif_ctx __attribute__((unused)))
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_NOTIFIERS; i++) {
+		if (&notifiers[i].pub == event_notifier)
+			notifiers[i].nr_notified++;
+	}
+}
+
+static
+bool notifier_dispatched(const struct test_notifier *notifier,
+		const struct lttng_ust_event_notifier *dispatcher)
+{
+	return dispatcher && dispatcher != &notifier->pub;
+}
+
+/*
+ * Hit the test event with each value of the filters, running the
+ * probes of the registered event notifiers as the tracepoint does, and
+ * check that each enabled event notifier is notified at most once on a
+ * match, and once if settled. Event notifiers being enabled or
+ * disabled by a sync may be notified or not until it completes.
+ */
+static
+bool hit_once(bool done)
+{
+	int64_t value;
+	unsigned int i;
+
+	for (value = 0; value <= 3; value++) {
+		struct lttng_ust_probe_ctx probe_ctx = {
+			.struct_size = sizeof(struct lttng_ust_probe_ctx),
+		};
+		struct event_data data = { .intfield = value };
+
+		for (i = 0; i < NR_NOTIFIERS; i++)
+			notifiers[i].nr_notified = 0;
+		lttng_ust_urcu_read_lock();
+		for (i = 0; i < NR_NOTIFIERS; i++) {
+			struct test_notifier *notifier = &notifiers[i];
+			struct lttng_ust_notification_ctx notif_ctx = {
+				.struct_size = sizeof(struct lttng_ust_notification_ctx),
+			};
+
+			if (!notifier->priv.parent.registered || !notifier->parent.enabled)
+				continue;
+			if (notifier->parent.run_filter(&notifier->parent,
+					(const char *) &data, &probe_ctx, NULL) !=
+					LTTNG_UST_EVENT_FILTER_ACCEPT)
+				continue;
+			notifier->pub.notification_send(&notifier->pub,
+				(const char *) &data, &probe_ctx, &notif_ctx);
+		}
+		lttng_ust_urcu_read_unlock();
+		for (i = 0; i < NR_NOTIFIERS; i++) {
+			struct test_notifier *notifier = &notifiers[i];
+
+			unsigned int match = notifier->parent.enabled &&
+				notifier->value == value;
+
+			if (notifier->nr_notified > match ||
+					((done || notifier->settled) &&
+						notifier->nr_notified != match))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Sync the probes and dispatch indexes of the test event notifiers as
+ * lttng_event_notifier_group_sync_enablers() does, hitting the event
+ * between each step.
+ */
+static
+void sync_dispatch(const char *what, const bool *enable)
+{
+	unsigned int i, nr_registered = 0;
+	bool once;
+
+	for (i = 0; i < NR_NOTIFIERS; i++) {
+		struct test_notifier *notifier = &notifiers[i];
+
+		notifier->settled = notifier->parent.enabled && enable[i];
+		notifier->priv.dispatch_disabled = !enable[i] &&
+			notifier->parent.enabled &&
+			notifier->priv.dispatcher == &notifier->pub;
+		if (!notifier->priv.dispatch_disabled)
+			notifier->parent.enabled = enable[i];
+	}
+	lttng_event_notifier_group_dispatch_prepare(&notifier_group);
+	for (i = 0; i < NR_NOTIFIERS; i++) {
+		struct test_notifier *notifier = &notifiers[i];
+
+		if (notifier->parent.enabled &&
+				!notifier_dispatched(notifier, notifier->priv.dispatcher_pending))
+			notifier->priv.parent.registered = 1;
+	}
+	once = hit_once(false);
+	lttng_event_notifier_group_dispatch_publish(&notifier_group);
+	once &= hit_once(false);
+	for (i = 0; i < NR_NOTIFIERS; i++) {
+		struct test_notifier *notifier = &notifiers[i];
+
+		if (notifier->priv.dispatch_disabled) {
+			notifier->parent.enabled = 0;
+			notifier->priv.dispatch_disabled = 0;
+		}
+		if (!notifier->parent.enabled ||
+				notifier_dispatched(notifier, notifier->priv.dispatcher))
+			notifier->priv.parent.registered = 0;
+		nr_registered += notifier->priv.parent.registered;
+	}
+	once &= hit_once(true);
+	ok(once, "%s: each match notified once during the sync", what);
+	ok(nr_registered == 1, "%s: single probe registered (%u)", what,
+		nr_registered);
+}
+
+/*
+ * Event notifiers with filters intfield == 1, 2, 2 and 3 indexed
+ * together, as the holder of the index and the other event notifiers
+ * are disabled and enabled.
+ */
+static
+void test_dispatch(void)
+{
+	static const int64_t values[NR_NOTIFIERS] = { 1, 2, 2, 3 };
+	static const bool all[NR_NOTIFIERS] = { true, true, true, true };
+	static const bool but_holder[NR_NOTIFIERS] = { false, true, true, true };
+	static const bool holder_only[NR_NOTIFIERS] = { true, false, false, false };
+	unsigned int i;
+
+	CDS_INIT_LIST_HEAD(&notifier_group.event_notifiers_head);
+	for (i = 0; i < NR_NOTIFIERS; i++) {
+		struct test_notifier *notifier = &notifiers[i];
+		struct prog prog = { 0 };
+
+		notifier->value = values[i];
+		notifier->parent.struct_size = sizeof(struct lttng_ust_event_common);
+		notifier->parent.priv = &notifier->priv.parent;
+		notifier->parent.type = LTTNG_UST_EVENT_TYPE_NOTIFIER;
+		notifier->parent.child = &notifier->pub;
+		notifier->parent.eval_filter = 1;
+		notifier->parent.run_filter = lttng_ust_interpret_event_filter;
+		notifier->pub.struct_size = sizeof(struct lttng_ust_event_notifier);
+		notifier->pub.parent = &notifier->parent;
+		notifier->pub.priv = &notifier->priv;
+		notifier->pub.notification_send = count_notification;
+		notifier->priv.parent.pub = &notifier->parent;
+		notifier->priv.parent.desc = &event_desc;
+		notifier->priv.pub = &notifier->pub;
+		emit_ref(&prog, BYTECODE_OP_LOAD_FIELD_REF, "intfield");
+		emit_load_s64(&prog, values[i]);
+		emit_op(&prog, BYTECODE_OP_EQ);
+		emit_return(&prog);
+		link_prog(&prog, &notifier->priv.parent);
+		cds_list_add_tail(&notifier->priv.node,
+			&notifier_group.event_notifiers_head);
+	}
+
+	sync_dispatch("index created", all);
+	sync_dispatch("holder disabled", but_holder);
+	sync_dispatch("holder enabled", all);
+	sync_dispatch("index removed", holder_only);
+	sync_dispatch("index recreated", all);
+
+	for (i = 0; i < NR_NOTIFIERS; i++) {
+		lttng_event_notifier_dispatch_destroy(&notifiers[i].pub);
+		unlink_prog(&notifiers[i].priv.parent);
+	}
+}
+
+int main(void)
+{
+	plan_tests(46);
+
+	test_set_s64(false);
+	test_set_s64(true);
+	test_set_string(false);
+	test_set_string(true);
+	test_set_mismatch();
+	test_set_dynamic();
+	test_reorder();
+	test_dispatch();
+
+	return exit_status();
+}
@@ -0,0 +1,196 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Closing file descriptors through the fd tracker: tracked ones are
+ * kept, and a thread cancelled while blocked in close() does not keep
+ * the tracker from being locked.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/ust-fd.h"
+
+#include "tap.h"
+
+#define NUM_TESTS	5
+
+/* Time for the closing thread to block in close(). */
+#define CLOSE_BLOCK_US		100000
+#define LOCK_TIMEOUT_S		5
+
+static sem_t closing, locked;
+
+/*
+ * A connected socket whose close() blocks: its peer never reads, its
+ * send buffer is full, and it lingers.
+ */
+static
+int blocking_socket(int *peer)
+{
+	struct linger linger = { .l_onoff = 1, .l_linger = 60 };
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	int listener, fd = -1, flags, rcvbuf = 4096;
+	char buf[4096] = { 0 };
+
+	*peer = -1;
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0)
+		return -1;
+	if (setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) ||
+			bind(listener, (struct sockaddr *) &addr, sizeof(addr)) ||
+			listen(listener, 1) ||
+			getsockname(listener, (struct sockaddr *) &addr, &len))
+		goto end;
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		goto end;
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)))
+		goto error;
+	*peer = accept(listener, NULL, NULL);
+	if (*peer < 0)
+		goto error;
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK))
+		goto error;
+	while (write(fd, buf, sizeof(buf)) > 0)
+		;
+	if (errno != EAGAIN || fcntl(fd, F_SETFL, flags) ||
+			setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger)))
+		goto error;
+	goto end;
+
+error:
+	(void) close(fd);
+	fd = -1;
+end:
+	(void) close(listener);
+	return fd;
+}
+
+static
+void *close_thread(void *arg)
+{
+	int fd = *(int *) arg;
+
+	(void) sem_post(&closing);
+	(void) lttng_ust_safe_close_fd(fd, close);
+	return NULL;
+}
+
+static
+void *lock_thread(void *arg __attribute__((unused)))
+{
+	lttng_ust_lock_fd_tracker();
+	lttng_ust_unlock_fd_tracker();
+	(void) sem_post(&locked);
+	return NULL;
+}
+
+static
+bool close_untracked(void)
+{
+	int fds[2];
+	bool closed;
+
+	if (pipe(fds))
+		return false;
+	closed = !lttng_ust_safe_close_fd(fds[0], close) &&
+		fcntl(fds[0], F_GETFD) < 0;
+	(void) close(fds[1]);
+	return closed;
+}
+
+static
+void test_tracked(void)
+{
+	int fds[2], fd;
+
+	if (pipe(fds)) {
+		skip(1, "no pipe");
+		return;
+	}
+	lttng_ust_lock_fd_tracker();
+	fd = lttng_ust_add_fd_to_tracker(fds[0]);
+	lttng_ust_unlock_fd_tracker();
+	ok(fd >= 0 && lttng_ust_safe_close_fd(fd, close) == -1 &&
+		errno == EBADF && fcntl(fd, F_GETFD) >= 0,
+		"tracked fd kept");
+	if (fd >= 0) {
+		lttng_ust_lock_fd_tracker();
+		lttng_ust_delete_fd_from_tracker(fd);
+		(void) close(fd);
+		lttng_ust_unlock_fd_tracker();
+	}
+	(void) close(fds[1]);
+}
+
+static
+void test_cancel_close(void)
+{
+	pthread_t closer, locker;
+	struct timespec timeout;
+	void *result = NULL;
+	bool is_locked;
+	int fd, peer;
+
+	fd = blocking_socket(&peer);
+	if (fd < 0) {
+		skip(2, "no loopback socket");
+		return;
+	}
+	if (pthread_create(&closer, NULL, close_thread, &fd)) {
+		skip(2, "no thread");
+		goto end;
+	}
+	(void) sem_wait(&closing);
+	(void) usleep(CLOSE_BLOCK_US);
+	(void) pthread_cancel(closer);
+	ok(!pthread_join(closer, &result) && result == PTHREAD_CANCELED,
+		"thread cancelled in close()");
+
+	if (pthread_create(&locker, NULL, lock_thread, NULL)) {
+		skip(1, "no thread");
+		goto end;
+	}
+	(void) clock_gettime(CLOCK_REALTIME, &timeout);
+	timeout.tv_sec += LOCK_TIMEOUT_S;
+	is_locked = !sem_timedwait(&locked, &timeout);
+	ok(is_locked, "fd tracker locked after the cancellation");
+	if (!is_locked) {
+		/* Exiting would wait for the tracker as well. */
+		skip(1, "fd tracker deadlocked");
+		(void) fflush(stdout);
+		_exit(exit_status());
+	}
+	(void) pthread_join(locker, NULL);
+end:
+	(void) close(peer);
+}
+
+int main(void)
+{
+	plan_tests(NUM_TESTS);
+
+	(void) sem_init(&closing, 0, 0);
+	(void) sem_init(&locked, 0, 0);
+
+	ok(close_untracked(), "untracked fd closed");
+	test_tracked();
+	test_cancel_close();
+	ok(close_untracked(), "untracked fd closed after the cancellation");
+
+	return exit_status();
+}
@@ -0,0 +1,118 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Counters in private memory: not shared, and only populated where
+ * they get updated.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common/align.h"
+#include "common/counter/counter.h"
+#include "common/counter/counter-api.h"
+#include "common/macros.h"
+#include "common/smp.h"
+
+#include "tap.h"
+
+#define NUM_TESTS	7
+
+/* Dimensions of the histograms of liblttng-ust-io-wrapper. */
+#define NR_SLOTS	4097
+#define NR_ROWS		14
+#define NR_COLUMNS	26
+
+static const struct lib_counter_config private_config = {
+	.alloc = COUNTER_ALLOC_PER_CPU,
+	.sync = COUNTER_SYNC_PER_CPU,
+	.arithmetic = COUNTER_ARITHMETIC_MODULAR,
+	.counter_size = COUNTER_SIZE_64_BIT,
+	.mem = COUNTER_MEM_PRIVATE,
+};
+
+/* Resident pages of the per-cpu counters, or -1 on error. */
+static
+long resident_pages(struct lib_counter *counter)
+{
+	long page_size = sysconf(_SC_PAGESIZE), nr_pages = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct lib_counter_layout *layout = &counter->percpu_counters[cpu];
+		size_t len = LTTNG_UST_ALIGN(layout->shm_len, page_size), i;
+		unsigned char *vec;
+
+		vec = malloc(len / page_size);
+		if (!vec)
+			return -1;
+		if (mincore(layout->counters, len, vec)) {
+			free(vec);
+			return -1;
+		}
+		for (i = 0; i < len / page_size; i++)
+			nr_pages += vec[i] & 1;
+		free(vec);
+	}
+	return nr_pages;
+}
+
+int main(void)
+{
+	size_t max_nr_elem[3] = { NR_SLOTS, NR_ROWS, NR_COLUMNS };
+	size_t indexes[3] = { NR_SLOTS / 2, 3, 7 };
+	int nr_cpus = num_possible_cpus(), cpu;
+	struct lib_counter *counter;
+	bool overflow, underflow;
+	int64_t value = 0;
+	int *cpu_fds;
+
+	plan_tests(NUM_TESTS);
+
+	counter = lttng_counter_create(&private_config, 3, max_nr_elem, 0, -1,
+			-1, NULL, false);
+	ok(counter, "private counter created");
+	if (!counter) {
+		skip(NUM_TESTS - 2, "no private counter");
+		goto shm;
+	}
+	ok(resident_pages(counter) == 0, "private counter not populated");
+
+	ok(!lttng_counter_add(&private_config, counter, indexes, 42) &&
+		!lttng_counter_aggregate(&private_config, counter, indexes,
+			&value, &overflow, &underflow) && value == 42,
+		"private counter updated (%" PRId64 ")", value);
+	/*
+	 * The page of the counter and those of its overflow and underflow
+	 * bits, read by the aggregation on each cpu.
+	 */
+	ok(resident_pages(counter) <= 3 * nr_cpus,
+		"only the accessed pages are populated (%ld)",
+		resident_pages(counter));
+
+	ok(!lttng_counter_clear(&private_config, counter, indexes) &&
+		!lttng_counter_aggregate(&private_config, counter, indexes,
+			&value, &overflow, &underflow) && !value,
+		"private counter cleared");
+	ok(lttng_counter_set_cpu_shm(counter, 0, 0) == -EINVAL,
+		"private counter takes no shm");
+	lttng_counter_destroy(counter);
+
+shm:
+	cpu_fds = malloc(nr_cpus * sizeof(*cpu_fds));
+	if (!cpu_fds)
+		abort();
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		cpu_fds[cpu] = 0;
+	ok(!lttng_counter_create(&private_config, 3, max_nr_elem, 0, -1,
+			nr_cpus, cpu_fds, true),
+		"private counter created from shm refused");
+	free(cpu_fds);
+
+	return exit_status();
+}
@@ -0,0 +1,257 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Estimates of the sketch counters: count-min frequencies and heavy
+ * hitters, and HyperLogLog cardinalities.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common/counter/counter.h"
+#include "common/counter/sketch.h"
+#include "common/macros.h"
+#include "common/smp.h"
+
+#include "tap.h"
+
+#define NR_SKETCHES	2
+
+#define NR_HEAVY	5
+#define NR_LIGHT	500
+
+static const struct lib_counter_config counter_config = {
+	.alloc = COUNTER_ALLOC_PER_CPU,
+	.sync = COUNTER_SYNC_PER_CPU,
+	.arithmetic = COUNTER_ARITHMETIC_MODULAR,
+	.counter_size = COUNTER_SIZE_64_BIT,
+};
+
+/* Counter of NR_SKETCHES sketches, in per-cpu shared memory. */
+static
+struct lib_counter *create_counter(const struct lib_sketch_config *config)
+{
+	size_t max_nr_elem[2] = { NR_SKETCHES, lttng_sketch_get_nr_elem(config) };
+	int nr_cpus = num_possible_cpus(), cpu;
+	struct lib_counter *counter = NULL;
+	int *cpu_fds;
+
+	cpu_fds = zmalloc(nr_cpus * sizeof(*cpu_fds));
+	if (!cpu_fds)
+		abort();
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		cpu_fds[cpu] = -1;
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		char name[NAME_MAX];
+
+		snprintf(name, sizeof(name), "/ust-sketch-test-%d-%d",
+			(int) getpid(), cpu);
+		cpu_fds[cpu] = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (cpu_fds[cpu] < 0)
+			goto end;
+		(void) shm_unlink(name);
+	}
+	counter = lttng_counter_create(&counter_config, 2, max_nr_elem, 0, -1,
+			nr_cpus, cpu_fds, true);
+end:
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		if (cpu_fds[cpu] >= 0)
+			(void) close(cpu_fds[cpu]);
+	}
+	free(cpu_fds);
+	return counter;
+}
+
+static
+int update_str(const struct lib_sketch_config *config,
+		struct lib_counter *counter, size_t sketch_index, const char *key)
+{
+	return lttng_sketch_update(config, counter, sketch_index, key, strlen(key));
+}
+
+static
+uint64_t estimate_str(const struct lib_sketch_config *config,
+		struct lib_counter *counter, const char *key)
+{
+	uint64_t count = UINT64_MAX;
+
+	if (lttng_sketch_estimate(config, counter, 0, key, strlen(key), &count))
+		return UINT64_MAX;
+	return count;
+}
+
+static
+void test_config(void)
+{
+	const struct lib_sketch_config invalid[] = {
+		{ .type = LIB_SKETCH_COUNT_MIN, .depth = 0, .width = 64 },
+		{ .type = LIB_SKETCH_COUNT_MIN, .depth = 4, .width = 0 },
+		{ .type = LIB_SKETCH_COUNT_MIN, .depth = 4, .width = 64, .top_k = 1U << 20 },
+		{ .type = LIB_SKETCH_HYPERLOGLOG, .width = 8 },
+		{ .type = LIB_SKETCH_HYPERLOGLOG, .width = 1000 },
+	};
+	const struct lib_sketch_config valid = {
+		.type = LIB_SKETCH_HYPERLOGLOG, .width = 1024,
+	};
+	unsigned int i, nr_rejected = 0;
+
+	for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		if (lttng_sketch_validate_config(&invalid[i]) == -EINVAL)
+			nr_rejected++;
+	}
+	ok(nr_rejected == sizeof(invalid) / sizeof(invalid[0]),
+		"invalid configurations rejected");
+	ok(!lttng_sketch_validate_config(&valid), "valid configuration accepted");
+}
+
+/*
+ * A few heavy keys among many light ones, the first longer than the key
+ * prefix kept by heavy hitter slots.
+ */
+static
+void heavy_key(char *key, size_t len, unsigned int i)
+{
+	if (i)
+		snprintf(key, len, "heavy-%u", i);
+	else
+		snprintf(key, len, "heavy-%0*u", LTTNG_SKETCH_KEY_LEN + 10, i);
+}
+
+static
+void test_count_min(void)
+{
+	const struct lib_sketch_config config = {
+		.type = LIB_SKETCH_COUNT_MIN,
+		.depth = 4,
+		.width = 1024,
+		.top_k = 8,
+	};
+	struct lib_sketch_entry entries[16];
+	size_t nr_entries = sizeof(entries) / sizeof(entries[0]);
+	struct lib_counter *counter;
+	unsigned int i, j, nr_exact = 0, nr_close = 0, nr_ranked = 0;
+	uint64_t count;
+	bool updated = true;
+	char key[128];
+
+	counter = create_counter(&config);
+	ok(counter, "count-min counter created");
+	if (!counter) {
+		skip(8, "no count-min counter");
+		return;
+	}
+
+	/* Interleave the heavy and light keys. */
+	for (i = 0; i < NR_LIGHT; i++) {
+		snprintf(key, sizeof(key), "light-%u", i);
+		updated &= !update_str(&config, counter, 0, key);
+		for (j = 0; j < NR_HEAVY; j++) {
+			/* Heavy key j occurs (NR_HEAVY - j) * 2 times per round. */
+			heavy_key(key, sizeof(key), j);
+			if (i % 10 < (NR_HEAVY - j) * 2)
+				updated &= !update_str(&config, counter, 0, key);
+		}
+	}
+	ok(updated, "count-min updated");
+
+	for (j = 0; j < NR_HEAVY; j++) {
+		uint64_t expected = (uint64_t) (NR_HEAVY - j) * 2 * NR_LIGHT / 10;
+
+		heavy_key(key, sizeof(key), j);
+		count = estimate_str(&config, counter, key);
+		/* Never underestimated, error bounded by e / width of the total. */
+		if (count >= expected)
+			nr_exact++;
+		if (count != UINT64_MAX && count <= expected + 50)
+			nr_close++;
+	}
+	ok(nr_exact == NR_HEAVY, "count-min never underestimates");
+	ok(nr_close == NR_HEAVY, "count-min estimates within error bound");
+	ok(estimate_str(&config, counter, "absent") <= 50,
+		"count-min estimate of an absent key within error bound");
+
+	ok(!lttng_sketch_top_k(&config, counter, 0, entries, &nr_entries) &&
+		nr_entries == config.top_k,
+		"top-k lists %u heavy hitters (%zu)", config.top_k, nr_entries);
+	for (j = 0; j < NR_HEAVY && j < nr_entries; j++) {
+		heavy_key(key, sizeof(key), j);
+		if (entries[j].key_len == strlen(key) &&
+				!memcmp(entries[j].key, key,
+					min_t(size_t, strlen(key), LTTNG_SKETCH_KEY_LEN)))
+			nr_ranked++;
+	}
+	ok(nr_ranked == NR_HEAVY, "top-k ranks the heavy hitters first");
+
+	/* Other sketches of the counter are distinct. */
+	ok(!lttng_sketch_estimate(&config, counter, 1, "heavy-1", strlen("heavy-1"), &count) &&
+		!count, "sketches are independent");
+
+	ok(!lttng_sketch_clear(&config, counter, 0) &&
+		!estimate_str(&config, counter, "heavy-1"),
+		"count-min cleared");
+	lttng_counter_destroy(counter);
+}
+
+static
+void test_hyperloglog(void)
+{
+	const struct lib_sketch_config config = {
+		.type = LIB_SKETCH_HYPERLOGLOG,
+		.width = 1024,
+	};
+	static const unsigned int cardinalities[] = { 100, 20000 };
+	struct lib_counter *counter;
+	unsigned int i, j;
+	uint64_t count;
+	char key[32];
+
+	counter = create_counter(&config);
+	ok(counter, "HyperLogLog counter created");
+	if (!counter) {
+		skip(4, "no HyperLogLog counter");
+		return;
+	}
+	ok(update_str(&config, counter, NR_SKETCHES, "key") == -EOVERFLOW,
+		"sketch index out of range");
+
+	for (i = 0; i < sizeof(cardinalities) / sizeof(cardinalities[0]); i++) {
+		unsigned int n = cardinalities[i];
+		bool updated = true;
+		uint64_t value = 0;
+
+		(void) lttng_sketch_clear(&config, counter, 0);
+		/* Each key twice: duplicates do not count. */
+		for (j = 0; j < 2 * n; j++) {
+			snprintf(key, sizeof(key), "key-%u", j % n);
+			updated &= !update_str(&config, counter, 0, key);
+		}
+		/* Standard error of 1.04 / sqrt(width), about 3 %. */
+		ok(updated && !lttng_sketch_cardinality(&config, counter, 0, &value) &&
+			value >= n * 9 / 10 && value <= n * 11 / 10,
+			"HyperLogLog estimates %u distinct keys (%" PRIu64 ")",
+			n, value);
+	}
+	ok(lttng_sketch_estimate(&config, counter, 0, "key", 3, &count) == -EINVAL,
+		"no frequency estimate from HyperLogLog");
+	lttng_counter_destroy(counter);
+}
+
+int main(void)
+{
+	plan_tests(16);
+
+	test_config();
+	test_count_min();
+	test_hyperloglog();
+
+	return exit_status();
+}
@@ -5,8 +5,12 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/mman.h>
@@ -14,10 +18,137 @@
 
 #include "common/ringbuffer/shm.h"
 #include "common/align.h"
+#include "common/bitmap.h"
+#include "common/macros.h"
 
 #include "tap.h"
 
 #define SHM_PATH "/ust-shm-test"
+#define SHM_PACKED_PATH "/ust-shm-packed-test"
+
+#define NR_VIEWS	4
+
+/*
+ * Packed object of NR_VIEWS buffers, as allocated by the producer, then
+ * appended from its shm fd and wakeup fd by the consumer: both sides see
+ * the buffers at the same offsets within one mapping.
+ */
+static
+void test_packed(void)
+{
+	size_t view_size = LTTNG_UST_PAGE_SIZE + 1, header_size, stride;
+	struct lttng_ust_shm_handle handle, consumer_handle;
+	struct shm_object_table *table, *consumer_table;
+	struct shm_object *owner, *consumer_owner;
+	unsigned long *ready, *consumer_ready;
+	unsigned int i, nr_bits = 0;
+	bool views = true, shared = true;
+	struct shm_ref ref;
+	int shmfd, pipefd[2];
+	uint64_t packed_size;
+
+	shmfd = shm_open(SHM_PACKED_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	assert(shmfd >= 0);
+	(void) shm_unlink(SHM_PACKED_PATH);
+
+	table = shm_object_table_create(NR_VIEWS - 1);
+	assert(table);
+	ok(!shm_object_table_alloc_packed(table, view_size, NR_VIEWS, shmfd,
+			&header_size, &stride),
+		"Packed allocation needs one table entry per buffer");
+	shm_object_table_destroy(table, 1);
+
+	table = shm_object_table_create(NR_VIEWS);
+	assert(table);
+	owner = shm_object_table_alloc_packed(table, view_size, NR_VIEWS, shmfd,
+			&header_size, &stride);
+	ok(owner && owner->index == 0 && table->allocated_len == NR_VIEWS,
+		"Allocate a packed shm object");
+	assert(owner);
+	ok(header_size == LTTNG_UST_PAGE_SIZE
+		&& stride == LTTNG_UST_PAGE_ALIGN(view_size)
+		&& owner->packed_map_size == header_size + NR_VIEWS * stride,
+		"Packed buffers are page aligned after the ready bitmap");
+
+	for (i = 0; i < NR_VIEWS; i++) {
+		struct shm_object *obj = &table->objects[i];
+
+		if (obj->memory_map != owner->packed_map + header_size + i * stride
+				|| obj->memory_map_size != stride)
+			views = false;
+		if (i && (obj->type != SHM_OBJECT_VIEW || obj->owner != 0
+				|| obj->shm_fd != -1 || obj->wait_fd[1] != -1))
+			views = false;
+	}
+	ok(views, "Each buffer is a view of the owner mapping");
+
+	handle.table = table;
+	ref.index = NR_VIEWS - 1;
+	ref.offset = 0;
+	ok(shm_get_wakeup_fd(&handle, &ref) == owner->wait_fd[1]
+		&& shm_get_shm_fd(&handle, &ref) == shmfd,
+		"Views share the file descriptors of their owner");
+	ok(shm_close_wakeup_fd(&handle, &ref) == -ENOENT,
+		"Shared file descriptors are not closed through a view");
+
+	ref = zalloc_shm(&table->objects[1], stride);
+	ok(ref.index == 1 && zalloc_shm(&table->objects[1], 1).index == -1,
+		"Allocations within a view are bounded by the stride");
+
+	ready = shm_get_ready_bitmap(&handle, &ref, &nr_bits);
+	ok(ready == (unsigned long *) owner->packed_map && nr_bits == NR_VIEWS,
+		"Ready bitmap at the start of the packed mapping");
+
+	/* Consumer side: channel object, then the packed stream. */
+	consumer_table = shm_object_table_create(NR_VIEWS + 1);
+	assert(consumer_table);
+	if (pipe(pipefd))
+		abort();
+	assert(shm_object_table_append_mem(consumer_table,
+		zmalloc(LTTNG_UST_PAGE_SIZE), LTTNG_UST_PAGE_SIZE, pipefd[1]));
+
+	/* File descriptors are only taken once the layout is valid. */
+	ok(!shm_object_table_append_packed(consumer_table, shmfd, pipefd[1],
+			NR_VIEWS, header_size, stride + 1, owner->packed_map_size)
+		&& !shm_object_table_append_packed(consumer_table, shmfd,
+			pipefd[1], NR_VIEWS, 0, stride, owner->packed_map_size)
+		&& !shm_object_table_append_packed(consumer_table, shmfd,
+			pipefd[1], NR_VIEWS, header_size, stride,
+			owner->packed_map_size - stride),
+		"Append a packed object with an invalid layout");
+
+	consumer_owner = shm_object_table_append_packed(consumer_table,
+			dup(shmfd), dup(pipefd[1]), NR_VIEWS, header_size, stride,
+			owner->packed_map_size);
+	ok(consumer_owner && consumer_owner->index == 1
+		&& consumer_table->allocated_len == NR_VIEWS + 1,
+		"Append a packed object");
+	assert(consumer_owner);
+
+	consumer_handle.table = consumer_table;
+	ref.index = NR_VIEWS;
+	ok(!shm_get_packed_size(&consumer_handle, &ref, &packed_size)
+		&& packed_size == owner->packed_map_size,
+		"Size of the packed mapping found from a view");
+
+	for (i = 0; i < NR_VIEWS; i++) {
+		table->objects[i].memory_map[0] = (char) (i + 1);
+		if (consumer_table->objects[i + 1].memory_map[0] != (char) (i + 1))
+			shared = false;
+	}
+	ok(shared, "Views of both sides map the same buffers");
+
+	lttng_bitmap_set_bit(NR_VIEWS - 1, ready);
+	consumer_ready = shm_get_ready_bitmap(&consumer_handle, &ref, &nr_bits);
+	ok(consumer_ready && lttng_bitmap_test_bit(NR_VIEWS - 1, consumer_ready)
+		&& lttng_bitmap_test_and_set_bit(NR_VIEWS - 1, consumer_ready)
+		&& !lttng_bitmap_test_and_set_bit(0, consumer_ready),
+		"Ready bitmap shared by both sides");
+
+	shm_object_table_destroy(consumer_table, 1);
+	(void) close(pipefd[0]);
+	shm_object_table_destroy(table, 1);
+}
 
 int main(void)
 {
@@ -27,7 +158,7 @@ int main(void)
 	struct shm_object *shmobj;
 	struct shm_ref shm_ref;
 
-	plan_tests(5);
+	plan_tests(18);
 
 	/* Open a zero byte shm fd */
 	shmfd = shm_open(SHM_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
@@ -52,5 +183,7 @@ int main(void)
 	/* Cleanup */
 	shm_object_table_destroy(table, 1);
 
+	test_packed();
+
 	return exit_status();
 }
@@ -0,0 +1,226 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Patching of function entries by liblttng-ust-patchable: a function of
+ * this test is patched when a probe is registered to its event, runs
+ * through the tracing trampoline, and is restored when the probe is
+ * unregistered, also while another thread runs it.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <lttng/tracepoint.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+
+#include "tap.h"
+
+#if defined(__x86_64__) && defined(__NR_membarrier) && defined(__has_attribute)
+#if __has_attribute(patchable_function_entry)
+#define PATCHABLE_TEST	1
+#endif
+#endif
+
+#ifdef PATCHABLE_TEST
+
+#define NUM_TESTS	10
+
+#define PATCHABLE_PROVIDER	"lttng_ust_func"
+#define PATCHABLE_SIGNATURE	"void *, func_addr, void *, call_site"
+
+#define MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE	(1 << 5)
+
+#define NR_PATCH_LOOPS	200
+#define NR_HIT_WAITS	100000
+
+#define PATCHABLE	__attribute__((noinline, patchable_function_entry(7, 5)))
+
+int patched_func(int a, int b, int c, int d, int e, int f, double g)
+	PATCHABLE;
+int patched_func(int a, int b, int c, int d, int e, int f, double g)
+{
+	return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + (int) (7 * g);
+}
+
+#define PATCHED_RESULT	(1 + 2 * 2 + 3 * 3 + 4 * 4 + 5 * 5 + 6 * 6 + 7 * 7)
+
+static int (*volatile patched_func_ptr)(int, int, int, int, int, int, double) =
+	patched_func;
+
+static unsigned long probe_hits;
+static void *probe_func_addr, *probe_call_site, *probe_data;
+static unsigned long trap_hits;
+static volatile bool stop;
+
+static
+void probe(void *data, void *func_addr, void *call_site)
+{
+	uatomic_inc(&probe_hits);
+	probe_data = data;
+	probe_func_addr = func_addr;
+	probe_call_site = call_site;
+}
+
+static
+void trap(int sig __attribute__((unused)))
+{
+	trap_hits++;
+}
+
+static
+int register_probe(void)
+{
+	return lttng_ust_tracepoint_provider_register(PATCHABLE_PROVIDER,
+			"patched_func", (void (*)(void)) probe, &probe_hits,
+			PATCHABLE_SIGNATURE);
+}
+
+static
+int unregister_probe(void)
+{
+	return lttng_ust_tracepoint_provider_unregister(PATCHABLE_PROVIDER,
+			"patched_func", (void (*)(void)) probe, &probe_hits);
+}
+
+/* Entry NOPs of the function, past its endbr64 if any. */
+static
+const uint8_t *func_entry(void)
+{
+	static const uint8_t endbr64[] = { 0xf3, 0x0f, 0x1e, 0xfa };
+	const uint8_t *entry = (const uint8_t *) patched_func;
+
+	if (!memcmp(entry, endbr64, sizeof(endbr64)))
+		entry += sizeof(endbr64);
+	return entry;
+}
+
+static
+bool entry_disarmed(void)
+{
+	const uint8_t *entry = func_entry();
+
+	return entry[0] == 0x90 && entry[1] == 0x90;
+}
+
+static
+int call_patched_func(void)
+	__attribute__((noinline));
+static
+int call_patched_func(void)
+{
+	int ret;
+
+	ret = patched_func_ptr(1, 2, 3, 4, 5, 6, 7.0);
+	cmm_barrier();	/* Not a tail call: the call site is here. */
+	return ret;
+}
+
+static
+void *run_patched_func(void *arg)
+{
+	unsigned long *nr_errors = arg;
+
+	while (!CMM_LOAD_SHARED(stop)) {
+		if (call_patched_func() != PATCHED_RESULT)
+			(*nr_errors)++;
+	}
+	return NULL;
+}
+
+static
+void test_patch(void)
+{
+	const uint8_t *call_site;
+
+	ok(!register_probe(), "probe registered");
+	ok(func_entry()[0] == 0xeb, "function entry patched");
+	ok(call_patched_func() == PATCHED_RESULT,
+		"patched function runs with its arguments");
+	call_site = probe_call_site;
+	ok(probe_hits == 1 && probe_data == &probe_hits &&
+		probe_func_addr == (void *) patched_func &&
+		call_site > (const uint8_t *) call_patched_func &&
+		call_site < (const uint8_t *) call_patched_func + 64,
+		"probe hit with the function address and its call site");
+
+	ok(!unregister_probe() && entry_disarmed(), "function entry restored");
+	ok(call_patched_func() == PATCHED_RESULT && probe_hits == 1,
+		"unpatched function runs without hitting the probe");
+}
+
+static
+void test_patch_running(void)
+{
+	unsigned long nr_errors = 0, nr_failed = 0, hits;
+	pthread_t thread;
+	int i, j;
+
+	if (pthread_create(&thread, NULL, run_patched_func, &nr_errors)) {
+		skip(1, "no thread");
+		return;
+	}
+	hits = uatomic_read(&probe_hits);
+	for (i = 0; i < NR_PATCH_LOOPS; i++) {
+		if (register_probe())
+			nr_failed++;
+		/* Until the running thread goes through the trampoline. */
+		for (j = 0; uatomic_read(&probe_hits) == hits; j++) {
+			if (j == NR_HIT_WAITS) {
+				nr_failed++;
+				break;
+			}
+			sched_yield();
+		}
+		hits = uatomic_read(&probe_hits);
+		if (unregister_probe())
+			nr_failed++;
+	}
+	CMM_STORE_SHARED(stop, true);
+	(void) pthread_join(thread, NULL);
+	ok(!nr_failed && !nr_errors && entry_disarmed(),
+		"function patched %d times while running", NR_PATCH_LOOPS);
+}
+
+int main(void)
+{
+	struct sigaction act;
+	long cmds;
+
+	cmds = syscall(__NR_membarrier, 0, 0);
+	if (cmds < 0 || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE))
+		return plan_skip_all("membarrier SYNC_CORE is not supported");
+
+	plan_tests(NUM_TESTS);
+
+	/* Installed before the handler of the patched entries. */
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = trap;
+	sigemptyset(&act.sa_mask);
+	(void) sigaction(SIGTRAP, &act, NULL);
+
+	ok(entry_disarmed(), "function entry is patchable");
+	test_patch();
+	test_patch_running();
+
+	asm volatile ("int3");
+	ok(trap_hits == 1, "other traps reach the application handler");
+	ok(call_patched_func() == PATCHED_RESULT, "function still runs");
+
+	return exit_status();
+}
+
+#else	/* PATCHABLE_TEST */
+
+int main(void)
+{
+	return plan_skip_all("patchable function entries are not supported");
+}
+
+#endif	/* PATCHABLE_TEST */
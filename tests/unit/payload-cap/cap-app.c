@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Application traced by the payload cap test. It records an event for
+ * each line read from its standard input, then writes a line to its
+ * standard output. It exits at end of input.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#include "ust_tests_payload_cap.h"
+
+int main(void)
+{
+	static const uint16_t values[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	char line[32];
+
+	while (fgets(line, sizeof(line), stdin)) {
+		lttng_ust_tracepoint(ust_tests_payload_cap, fields,
+			"abcdefghijklmnop", "xyz", values,
+			sizeof(values) / sizeof(values[0]));
+		printf("done\n");
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * String and sequence fields cut to the max_payload_len of an event.
+ * The test emulates the session daemon and the consumer daemon of the
+ * application it starts: it records an event of the application with a
+ * payload limit in a channel with the truncated context, and decodes
+ * the record read from the channel.
+ */
+
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lttng/ust-ctl.h>
+#include <lttng/ust-ringbuffer-context.h>
+#include <lttng/ust-sigbus.h>
+#include <lttng/ust-tracer.h>
+
+#include "fake-session.h"
+#include "fake-sessiond.h"
+#include "tap.h"
+
+#define NUM_TESTS	9
+
+/* Test duration limit (s), should the application not respond. */
+#define TEST_TIMEOUT	60
+
+#define EVENT_NAME	"ust_tests_payload_cap:fields"
+#define CHAN_ID		0
+#define EVENT_ID	0
+
+#define SUBBUF_SIZE	4096
+#define NUM_SUBBUF	2
+
+/*
+ * The application records "abcdefghijklmnop", "xyz" and a sequence of
+ * the 10 uint16_t values 0 to 9.
+ */
+#define MAX_PAYLOAD_LEN		8
+#define LONG_STR_PREFIX		"abcdefg"
+#define SHORT_STR		"xyz"
+#define NR_CUT_VALUES		(MAX_PAYLOAD_LEN / sizeof(uint16_t))
+
+DEFINE_LTTNG_UST_SIGBUS_STATE();
+
+static struct fake_sessiond sessiond;
+static struct fake_session_channel channel;
+
+struct record {
+	uint8_t truncated;
+	const char *long_str;
+	const char *short_str;
+	unsigned int nr_values;
+	uint16_t values[NR_CUT_VALUES];
+	const char *end;
+};
+
+/* Have the application record its event. */
+static
+int fire(void)
+{
+	char line[32];
+
+	if (write(sessiond.app_stdin, "\n", 1) != 1)
+		return -1;
+	/* Wait for the application to be done. */
+	return read(sessiond.app_stdout, line, sizeof(line)) > 0 ? 0 : -1;
+}
+
+/*
+ * Decode the record following the context and the event header in the
+ * packet: the truncated context is the byte before the first field,
+ * which begins with the prefix of the cut string.
+ */
+static
+int decode_record(const char *packet, const char *packet_end,
+		struct record *record)
+{
+	const char *p;
+	size_t len;
+
+	p = memmem(packet, packet_end - packet, LONG_STR_PREFIX,
+		strlen(LONG_STR_PREFIX));
+	if (!p || p == packet)
+		return -1;
+	record->truncated = (uint8_t) p[-1];
+	record->long_str = p;
+	len = strnlen(p, packet_end - p);
+	if (p + len == packet_end)
+		return -1;
+	p += len + 1;
+	record->short_str = p;
+	len = strnlen(p, packet_end - p);
+	if (p + len == packet_end)
+		return -1;
+	p += len + 1;
+	p += lttng_ust_ring_buffer_align(p - packet, lttng_ust_rb_alignof(unsigned int));
+	if (p + sizeof(record->nr_values) > packet_end)
+		return -1;
+	memcpy(&record->nr_values, p, sizeof(record->nr_values));
+	p += sizeof(record->nr_values);
+	if (record->nr_values > NR_CUT_VALUES)
+		return -1;
+	p += lttng_ust_ring_buffer_align(p - packet, lttng_ust_rb_alignof(uint16_t));
+	len = record->nr_values * sizeof(uint16_t);
+	if (p + len > packet_end)
+		return -1;
+	memcpy(record->values, p, len);
+	record->end = p + len;
+	return 0;
+}
+
+/*
+ * Flush the streams of the channel, and decode the record of the
+ * stream the application recorded its event in.
+ */
+static
+int read_record(struct record *record, const char **content_end)
+{
+	int cpu, ret = -1;
+
+	for (cpu = 0; cpu < channel.nr_streams && ret; cpu++) {
+		struct lttng_ust_ctl_consumer_stream *stream = channel.streams[cpu];
+		unsigned long read_offset;
+		uint64_t content_size;
+		const char *packet;
+
+		if (!stream || lttng_ust_ctl_flush_buffer(stream, 1)
+				|| lttng_ust_ctl_get_next_subbuf(stream))
+			continue;
+		if (!lttng_ust_ctl_get_mmap_read_offset(stream, &read_offset)
+				&& !lttng_ust_ctl_get_content_size(stream, &content_size)) {
+			packet = (const char *) lttng_ust_ctl_get_mmap_base(stream)
+				+ read_offset;
+			*content_end = packet + content_size / CHAR_BIT;
+			ret = decode_record(packet, *content_end, record);
+		}
+		(void) lttng_ust_ctl_put_next_subbuf(stream);
+	}
+	return ret;
+}
+
+static
+void test_payload_cap(void)
+{
+	struct lttng_ust_abi_object_data *context_data = NULL, *event_data = NULL;
+	struct lttng_ust_context_attr ctx_attr;
+	struct lttng_ust_abi_event ev;
+	struct record record;
+	const char *content_end;
+	unsigned int i, nr_copied = 0;
+	int session_handle, ret;
+
+	session_handle = lttng_ust_ctl_create_session(sessiond.cmd_sock);
+	ret = session_handle < 0 ? session_handle :
+		fake_session_send_channel(sessiond.cmd_sock, session_handle,
+			CHAN_ID, SUBBUF_SIZE, NUM_SUBBUF, &channel);
+	memset(&ctx_attr, 0, sizeof(ctx_attr));
+	ctx_attr.ctx = LTTNG_UST_ABI_CONTEXT_TRUNCATED;
+	if (!ret)
+		ret = lttng_ust_ctl_add_context(sessiond.cmd_sock, &ctx_attr,
+				channel.data, &context_data);
+	memset(&ev, 0, sizeof(ev));
+	ev.instrumentation = LTTNG_UST_ABI_TRACEPOINT;
+	strcpy(ev.name, EVENT_NAME);
+	ev.loglevel_type = LTTNG_UST_ABI_LOGLEVEL_ALL;
+	ev.loglevel = -1;
+	ev.max_payload_len = MAX_PAYLOAD_LEN;
+	if (!ret)
+		ret = lttng_ust_ctl_create_event(sessiond.cmd_sock, &ev,
+				channel.data, &event_data);
+	if (!ret)
+		ret = lttng_ust_ctl_enable(sessiond.cmd_sock, event_data);
+	if (!ret)
+		ret = lttng_ust_ctl_start_session(sessiond.cmd_sock, session_handle);
+	if (!ret)
+		ret = fire();
+	ok(!ret, "Event with a payload limit recorded in a channel with the truncated context (ret %d)",
+		ret);
+	ret = ret ? ret : read_record(&record, &content_end);
+	ok(!ret, "Record read from the channel");
+	if (ret) {
+		skip(NUM_TESTS - 3, "No record");
+		goto end;
+	}
+
+	ok(!strcmp(record.long_str, LONG_STR_PREFIX),
+		"Cut string recorded in %d bytes, terminating '\\0' included (\"%s\")",
+		MAX_PAYLOAD_LEN, record.long_str);
+	ok(!strcmp(record.short_str, SHORT_STR),
+		"String within the limit recorded whole (\"%s\")", record.short_str);
+	ok(record.nr_values == NR_CUT_VALUES,
+		"Cut sequence records the %zu elements within the limit (%u)",
+		NR_CUT_VALUES, record.nr_values);
+	for (i = 0; i < record.nr_values; i++) {
+		if (record.values[i] == i)
+			nr_copied++;
+	}
+	ok(nr_copied == NR_CUT_VALUES, "Elements of the cut sequence copied");
+	ok(record.truncated == 2,
+		"Truncated context counts the 2 cut fields (%u)",
+		(unsigned int) record.truncated);
+	ok(record.end == content_end,
+		"Event space reserved for the capped fields (%td bytes left)",
+		content_end - record.end);
+
+end:
+	if (event_data) {
+		(void) lttng_ust_ctl_release_object(-1, event_data);
+		free(event_data);
+	}
+	if (context_data) {
+		(void) lttng_ust_ctl_release_object(-1, context_data);
+		free(context_data);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct fake_session_notify notify = {
+		.chan_id = CHAN_ID,
+		.event_id = EVENT_ID,
+	};
+	bool notify_started = false;
+	int ret;
+
+	plan_tests(NUM_TESTS);
+
+	if (argc != 2) {
+		diag("Invoke as: %s <cap-app path>", argv[0]);
+		skip(NUM_TESTS, "No application to run");
+		return exit_status();
+	}
+	alarm(TEST_TIMEOUT);
+
+	if (fake_sessiond_init(&sessiond)) {
+		skip(NUM_TESTS, "Cannot listen on the application socket");
+		goto end;
+	}
+	ret = fake_sessiond_start_app(&sessiond, argv[1]);
+	if (!ret)
+		ret = lttng_ust_ctl_register_done(sessiond.cmd_sock);
+	ok(!ret, "Application registered (ret %d)", ret);
+	if (ret) {
+		skip(NUM_TESTS - 1, "Application not registered");
+		goto end;
+	}
+	notify.sock = sessiond.notify_sock;
+	if (fake_session_start_notify(&notify)) {
+		skip(NUM_TESTS - 1, "Cannot reply to the application registrations");
+		goto end;
+	}
+	notify_started = true;
+
+	test_payload_cap();
+
+end:
+	/* The notify thread ends with the notify socket of the application. */
+	if (sessiond.app > 0) {
+		close(sessiond.app_stdin);
+		sessiond.app_stdin = -1;
+	}
+	if (notify_started)
+		fake_session_join_notify(&notify);
+	fake_sessiond_fini(&sessiond);
+	fake_session_destroy_channel(&channel);
+	return exit_status();
+}
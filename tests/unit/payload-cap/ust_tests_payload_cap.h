@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#undef LTTNG_UST_TRACEPOINT_PROVIDER
+#define LTTNG_UST_TRACEPOINT_PROVIDER ust_tests_payload_cap
+
+#if !defined(_TRACEPOINT_UST_TESTS_PAYLOAD_CAP_H) || defined(LTTNG_UST_TRACEPOINT_HEADER_MULTI_READ)
+#define _TRACEPOINT_UST_TESTS_PAYLOAD_CAP_H
+
+#include <stdint.h>
+
+#include <lttng/tracepoint.h>
+
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_payload_cap, fields,
+	LTTNG_UST_TP_ARGS(const char *, long_str, const char *, short_str,
+		const uint16_t *, values, unsigned int, nr_values),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_string(long_str, long_str)
+		lttng_ust_field_string(short_str, short_str)
+		lttng_ust_field_sequence(uint16_t, values, values, unsigned int, nr_values)
+	)
+)
+
+#endif /* _TRACEPOINT_UST_TESTS_PAYLOAD_CAP_H */
+
+#undef LTTNG_UST_TRACEPOINT_INCLUDE
+#define LTTNG_UST_TRACEPOINT_INCLUDE "./ust_tests_payload_cap.h"
+
+/* This part must be outside ifdef protection */
+#include <lttng/tracepoint-event.h>
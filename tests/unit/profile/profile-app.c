@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Application traced by the profile test. Each line read from its
+ * standard input holds a number of probe hits, which it fires before
+ * writing a line to its standard output. It exits at end of input.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#include "ust_tests_profile.h"
+
+int main(void)
+{
+	char line[32];
+
+	while (fgets(line, sizeof(line), stdin)) {
+		int i, nr_hits = atoi(line);
+
+		for (i = 0; i < nr_hits; i++)
+			lttng_ust_tracepoint(ust_tests_profile, hit, i);
+		printf("%d\n", nr_hits);
+		fflush(stdout);
+	}
+	return 0;
+}
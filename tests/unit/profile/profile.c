@@ -0,0 +1,317 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Per-stage cycle accounting of sampled probe hits. The test emulates
+ * the session daemon and the consumer daemon of the application it
+ * starts: it sends a profile counter to a session, records an event of
+ * the application in a channel of the session, and reads the per-stage
+ * histograms of the probe hits fired by the application.
+ */
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lttng/ust-ctl.h>
+#include <lttng/ust-sigbus.h>
+
+#include "fake-session.h"
+#include "fake-sessiond.h"
+#include "stream-fds.h"
+#include "tap.h"
+
+#define NUM_TESTS	10
+
+/* Test duration limit (s), should the application not respond. */
+#define TEST_TIMEOUT	60
+
+#define EVENT_NAME	"ust_tests_profile:hit"
+#define CHAN_ID		0
+#define EVENT_ID	2
+#define NR_EVENTS	4
+#define PROFILE_PERIOD	4
+
+/*
+ * Stages last more than 2^(NR_BUCKETS - 1) cycles, and are all counted
+ * in the last bucket.
+ */
+#define NR_BUCKETS	4
+
+#define SUBBUF_SIZE	4096
+#define NUM_SUBBUF	2
+
+DEFINE_LTTNG_UST_SIGBUS_STATE();
+
+static const char *stage_names[NR_LTTNG_UST_ABI_PROFILE_STAGE] = {
+	[LTTNG_UST_ABI_PROFILE_STAGE_FILTER] = "filter",
+	[LTTNG_UST_ABI_PROFILE_STAGE_CONTEXT] = "context",
+	[LTTNG_UST_ABI_PROFILE_STAGE_RESERVE] = "reserve",
+	[LTTNG_UST_ABI_PROFILE_STAGE_SERIALIZE] = "serialize",
+	[LTTNG_UST_ABI_PROFILE_STAGE_COMMIT] = "commit",
+};
+
+static struct fake_sessiond sessiond;
+static int session_handle = -1;
+
+static struct lttng_ust_ctl_daemon_counter *counter;
+static int nr_counter_cpus;
+static int *counter_fds;
+
+static struct fake_session_channel channel;
+
+/* Send a profile counter to the session. */
+static
+int send_profile_counter(struct lttng_ust_ctl_daemon_counter *profile_counter)
+{
+	struct lttng_ust_abi_object_data *counter_data = NULL;
+	int ret, cpu;
+
+	ret = lttng_ust_ctl_create_counter_data(profile_counter, &counter_data);
+	if (ret)
+		return ret;
+	ret = lttng_ust_ctl_send_counter_data_to_ust(sessiond.cmd_sock,
+			session_handle, counter_data);
+	for (cpu = 0; !ret && cpu < nr_counter_cpus; cpu++) {
+		struct lttng_ust_abi_object_data *cpu_data = NULL;
+
+		ret = lttng_ust_ctl_create_counter_cpu_data(profile_counter, cpu,
+				&cpu_data);
+		if (ret)
+			break;
+		ret = lttng_ust_ctl_send_counter_cpu_data_to_ust(sessiond.cmd_sock,
+				counter_data, cpu_data);
+		(void) lttng_ust_ctl_release_object(-1, cpu_data);
+		free(cpu_data);
+	}
+	(void) lttng_ust_ctl_release_object(-1, counter_data);
+	free(counter_data);
+	return ret;
+}
+
+/* Have the application fire nr_hits probe hits. */
+static
+int fire(int nr_hits)
+{
+	char line[32];
+	int len;
+	ssize_t ret;
+
+	len = snprintf(line, sizeof(line), "%d\n", nr_hits);
+	if (write(sessiond.app_stdin, line, len) != len)
+		return -1;
+	/* Wait for the application to be done. */
+	ret = read(sessiond.app_stdout, line, sizeof(line));
+	return ret > 0 ? 0 : -1;
+}
+
+/*
+ * Sum of the histogram of a stage of an event, and count of its last
+ * bucket.
+ */
+static
+int read_stage(size_t event_index, int stage, int64_t *total, int64_t *last)
+{
+	size_t indexes[4] = { CHAN_ID, event_index, stage, 0 };
+
+	*total = 0;
+	for (indexes[3] = 0; indexes[3] < NR_BUCKETS; indexes[3]++) {
+		bool overflow, underflow;
+		int64_t value;
+
+		if (lttng_ust_ctl_counter_aggregate(counter, indexes, &value,
+				&overflow, &underflow))
+			return -1;
+		*total += value;
+		*last = value;
+	}
+	return 0;
+}
+
+/* Check that each stage but the filter was counted nr_samples times. */
+static
+bool stages_counted(int64_t nr_samples, bool *in_last_bucket)
+{
+	bool counted = true;
+	int stage;
+
+	*in_last_bucket = true;
+	for (stage = 0; stage < NR_LTTNG_UST_ABI_PROFILE_STAGE; stage++) {
+		int64_t expected = nr_samples, total, last;
+
+		if (stage == LTTNG_UST_ABI_PROFILE_STAGE_FILTER)
+			continue;
+		if (read_stage(EVENT_ID, stage, &total, &last))
+			return false;
+		if (total != expected) {
+			diag("Stage %s counted %" PRId64 " times, expected %" PRId64,
+				stage_names[stage], total, expected);
+			counted = false;
+		}
+		if (last != total)
+			*in_last_bucket = false;
+	}
+	return counted;
+}
+
+static
+void test_profile(void)
+{
+	struct lttng_ust_abi_object_data *event_data = NULL;
+	struct lttng_ust_ctl_daemon_counter *second_counter;
+	struct lttng_ust_abi_event ev;
+	int *second_counter_fds;
+	unsigned int nr_other = 0;
+	bool in_last_bucket;
+	int64_t total, last;
+	size_t event_index;
+	int ret, stage;
+
+	session_handle = lttng_ust_ctl_create_session(sessiond.cmd_sock);
+	nr_counter_cpus = lttng_ust_ctl_get_nr_cpu_per_counter();
+	counter_fds = calloc(nr_counter_cpus, sizeof(*counter_fds));
+	if (session_handle < 0 || !counter_fds
+			|| open_stream_fds(counter_fds, nr_counter_cpus)) {
+		nr_counter_cpus = 0;
+		skip(NUM_TESTS - 1, "No session");
+		return;
+	}
+	counter = lttng_ust_ctl_create_profile_counter(1, NR_EVENTS, NR_BUCKETS,
+			PROFILE_PERIOD, nr_counter_cpus, counter_fds);
+	ret = counter ? send_profile_counter(counter) : -1;
+	ok(!ret, "Profile counter sent to the session (ret %d)", ret);
+	if (ret) {
+		skip(NUM_TESTS - 2, "No profile counter");
+		return;
+	}
+
+	second_counter_fds = calloc(nr_counter_cpus, sizeof(*second_counter_fds));
+	if (second_counter_fds && !open_stream_fds(second_counter_fds, nr_counter_cpus)) {
+		second_counter = lttng_ust_ctl_create_profile_counter(1, NR_EVENTS,
+				NR_BUCKETS, PROFILE_PERIOD, nr_counter_cpus,
+				second_counter_fds);
+		ret = second_counter ? send_profile_counter(second_counter) : 0;
+		ok(second_counter && ret < 0,
+			"Second profile counter of the session refused (ret %d)", ret);
+		if (second_counter)
+			lttng_ust_ctl_destroy_counter(second_counter);
+		close_stream_fds(second_counter_fds, nr_counter_cpus);
+	} else {
+		fail("Second profile counter not created");
+	}
+	free(second_counter_fds);
+
+	ret = fake_session_send_channel(sessiond.cmd_sock, session_handle, CHAN_ID,
+			SUBBUF_SIZE, NUM_SUBBUF, &channel);
+	memset(&ev, 0, sizeof(ev));
+	ev.instrumentation = LTTNG_UST_ABI_TRACEPOINT;
+	strcpy(ev.name, EVENT_NAME);
+	ev.loglevel_type = LTTNG_UST_ABI_LOGLEVEL_ALL;
+	ev.loglevel = -1;
+	if (!ret)
+		ret = lttng_ust_ctl_create_event(sessiond.cmd_sock, &ev,
+				channel.data, &event_data);
+	if (!ret)
+		ret = lttng_ust_ctl_enable(sessiond.cmd_sock, event_data);
+	if (!ret)
+		ret = lttng_ust_ctl_start_session(sessiond.cmd_sock, session_handle);
+	ok(!ret, "Event recorded in a channel of the started session (ret %d)", ret);
+	if (ret) {
+		skip(NUM_TESTS - 4, "Session not started");
+		goto end;
+	}
+
+	/* Hits 1, 5 and 9 are sampled. */
+	ret = fire(10);
+	ok(!ret && stages_counted(3, &in_last_bucket),
+		"One hit out of %d sampled: stages counted 3 times for 10 hits",
+		PROFILE_PERIOD);
+	ok(!read_stage(EVENT_ID, LTTNG_UST_ABI_PROFILE_STAGE_FILTER, &total, &last)
+			&& !total,
+		"Filter stage not counted without a filter (%" PRId64 ")", total);
+	for (event_index = 0; event_index < NR_EVENTS; event_index++) {
+		if (event_index == EVENT_ID)
+			continue;
+		for (stage = 0; stage < NR_LTTNG_UST_ABI_PROFILE_STAGE; stage++) {
+			if (read_stage(event_index, stage, &total, &last) || total)
+				nr_other++;
+		}
+	}
+	ok(!nr_other, "Hits counted at the index of their event id only");
+	ok(in_last_bucket,
+		"Durations beyond the histogram counted in its last bucket");
+
+	/* The countdown goes on: hit 13 is sampled. */
+	ret = fire(2);
+	ok(!ret && stages_counted(3, &in_last_bucket),
+		"No hit sampled for 2 more hits");
+	ret = fire(1);
+	ok(!ret && stages_counted(4, &in_last_bucket),
+		"Next hit of the period sampled");
+
+end:
+	if (event_data) {
+		(void) lttng_ust_ctl_release_object(-1, event_data);
+		free(event_data);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct fake_session_notify notify = {
+		.chan_id = CHAN_ID,
+		.event_id = EVENT_ID,
+	};
+	bool notify_started = false;
+	int ret;
+
+	plan_tests(NUM_TESTS);
+
+	if (argc != 2) {
+		diag("Invoke as: %s <profile-app path>", argv[0]);
+		skip(NUM_TESTS, "No application to run");
+		return exit_status();
+	}
+	alarm(TEST_TIMEOUT);
+
+	if (fake_sessiond_init(&sessiond)) {
+		skip(NUM_TESTS, "Cannot listen on the application socket");
+		goto end;
+	}
+	ret = fake_sessiond_start_app(&sessiond, argv[1]);
+	if (!ret)
+		ret = lttng_ust_ctl_register_done(sessiond.cmd_sock);
+	ok(!ret, "Application registered (ret %d)", ret);
+	if (ret) {
+		skip(NUM_TESTS - 1, "Application not registered");
+		goto end;
+	}
+	notify.sock = sessiond.notify_sock;
+	if (fake_session_start_notify(&notify)) {
+		skip(NUM_TESTS - 1, "Cannot reply to the application registrations");
+		goto end;
+	}
+	notify_started = true;
+
+	test_profile();
+
+end:
+	/* The notify thread ends with the notify socket of the application. */
+	if (sessiond.app > 0) {
+		close(sessiond.app_stdin);
+		sessiond.app_stdin = -1;
+	}
+	if (notify_started)
+		fake_session_join_notify(&notify);
+	fake_sessiond_fini(&sessiond);
+	fake_session_destroy_channel(&channel);
+	if (counter)
+		lttng_ust_ctl_destroy_counter(counter);
+	if (counter_fds)
+		close_stream_fds(counter_fds, nr_counter_cpus);
+	free(counter_fds);
+	return exit_status();
+}
@@ -0,0 +1,535 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Records written through the ring buffer clients by concurrent
+ * threads, then flushed and consumed stream by stream: per-channel
+ * buffers striped over lanes. Identical consecutive records folded
+ * into the first one, as done with the repeat context.
+ */
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lttng/ust-events.h>
+#include <lttng/ust-ringbuffer-context.h>
+#include <lttng/ust-tracer.h>
+
+#include "common/events.h"
+#include "common/tracer.h"
+#include "common/ringbuffer/backend.h"
+#include "common/ringbuffer/frontend.h"
+#include "common/ringbuffer-clients/clients.h"
+
+#include "stream-fds.h"
+#include "tap.h"
+
+#define NR_CPUS			8
+#define NR_LANES		4
+#define MIN_WRITERS		8
+#define MAX_WRITERS		64
+#define NR_RECORDS		200
+#define RECORD_MAGIC		0x73656e614c747375ULL
+
+#define NR_FOLDED		10
+#define NR_FOLD_RECORDS		7
+#define FOLD_MAGIC		0x646c6f46747375ULL
+
+#define SUBBUF_SIZE		(64 * 1024)
+#define NUM_SUBBUF		4
+
+/*
+ * Lanes are limited to the number of possible cpus: have the tracer see
+ * NR_CPUS of them, whatever the number of cpus of the host running the
+ * test.
+ */
+long sysconf(int name)
+{
+	static long (*libc_sysconf)(int);
+
+	if (name == _SC_NPROCESSORS_CONF)
+		return NR_CPUS;
+	if (!libc_sysconf) {
+		libc_sysconf = (long (*)(int)) dlsym(RTLD_NEXT, "sysconf");
+		if (!libc_sysconf)
+			abort();
+	}
+	return libc_sysconf(name);
+}
+
+struct test_record {
+	uint64_t magic;
+	uint32_t writer;
+	uint32_t seq;
+};
+
+/* Repeat context fields, then the payload. */
+struct fold_record {
+	uint64_t repeat_count;
+	uint64_t repeat_last_timestamp;
+	uint64_t magic;
+	uint32_t value;
+	uint32_t padding;
+};
+
+struct consumed_fold_record {
+	struct fold_record record;
+	unsigned int subbuf;
+};
+
+struct writer {
+	pthread_t thread;
+	unsigned int index;
+	int lane;
+	unsigned int nr_written;
+	/* Consumer side. */
+	unsigned int nr_read;
+	bool misplaced;
+};
+
+static struct lttng_ust_channel_buffer *chan;
+static struct lttng_ust_event_recorder event_recorder;
+static struct lttng_ust_event_recorder_private event_recorder_priv;
+
+static struct writer writers[MAX_WRITERS];
+static sem_t writer_ready;
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static bool started;
+
+static
+struct lttng_ust_channel_buffer *create_channel(const char *transport_name,
+		int *fds, int nr_fds)
+{
+	unsigned char uuid[LTTNG_UST_UUID_LEN] = { 0 };
+	struct lttng_ust_channel_buffer *lttng_chan;
+	struct lttng_transport *transport;
+
+	transport = lttng_ust_transport_find(transport_name);
+	if (!transport)
+		return NULL;
+	lttng_chan = transport->ops.priv->channel_create(transport_name, NULL,
+			SUBBUF_SIZE, NUM_SUBBUF, 0, 0, uuid, 0, fds, nr_fds,
+			0, 0);
+	if (!lttng_chan)
+		return NULL;
+	lttng_chan->ops = &transport->ops;
+	lttng_chan->priv->header_type = 1;	/* compact */
+	return lttng_chan;
+}
+
+static
+bool write_record(unsigned int writer, unsigned int seq)
+{
+	struct test_record record = {
+		.magic = RECORD_MAGIC,
+		.writer = writer,
+		.seq = seq,
+	};
+	struct lttng_ust_ring_buffer_ctx ctx;
+
+	lttng_ust_ring_buffer_ctx_init(&ctx, &event_recorder, sizeof(record),
+			lttng_ust_rb_alignof(uint64_t), NULL);
+	if (chan->ops->event_reserve(&ctx))
+		return false;
+	chan->ops->event_write(&ctx, &record, sizeof(record),
+			lttng_ust_rb_alignof(uint64_t));
+	chan->ops->event_commit(&ctx);
+	return true;
+}
+
+static
+void *writer_thread(void *arg)
+{
+	struct writer *writer = arg;
+	unsigned int seq;
+
+	writer->lane = lib_ring_buffer_get_lane(chan->priv->rb_chan);
+	sem_post(&writer_ready);
+
+	pthread_mutex_lock(&start_mutex);
+	while (!started)
+		pthread_cond_wait(&start_cond, &start_mutex);
+	pthread_mutex_unlock(&start_mutex);
+
+	for (seq = 0; seq < NR_RECORDS; seq++) {
+		if (write_record(writer->index, seq))
+			writer->nr_written++;
+	}
+	return NULL;
+}
+
+/*
+ * Start writers until each lane has at least one, then have them all
+ * write at once. Returns the number of writers.
+ */
+static
+unsigned int run_writers(unsigned int *lanes_used)
+{
+	unsigned int nr_writers, i;
+
+	*lanes_used = 0;
+	started = false;
+	for (nr_writers = 0; nr_writers < MAX_WRITERS; nr_writers++) {
+		struct writer *writer = &writers[nr_writers];
+
+		if (nr_writers >= MIN_WRITERS && *lanes_used == (1U << NR_LANES) - 1)
+			break;
+		memset(writer, 0, sizeof(*writer));
+		writer->index = nr_writers;
+		if (pthread_create(&writer->thread, NULL, writer_thread, writer))
+			abort();
+		sem_wait(&writer_ready);
+		*lanes_used |= 1U << writer->lane;
+	}
+
+	pthread_mutex_lock(&start_mutex);
+	started = true;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_mutex);
+	for (i = 0; i < nr_writers; i++)
+		(void) pthread_join(writers[i].thread, NULL);
+	return nr_writers;
+}
+
+/* Account the records of a sub-buffer consumed from a lane. */
+static
+void read_records(const char *data, unsigned long len, int lane,
+		unsigned int nr_writers)
+{
+	unsigned long offset;
+
+	for (offset = 0; offset + sizeof(struct test_record) <= len; offset++) {
+		struct test_record record;
+		struct writer *writer;
+
+		memcpy(&record, data + offset, sizeof(record));
+		if (record.magic != RECORD_MAGIC)
+			continue;
+		offset += sizeof(record) - 1;
+		if (record.writer >= nr_writers)
+			continue;
+		writer = &writers[record.writer];
+		/* Records of a writer are read in order from its lane. */
+		if (writer->lane != lane || record.seq != writer->nr_read)
+			writer->misplaced = true;
+		writer->nr_read++;
+	}
+}
+
+/* Consume all the sub-buffers of a stream. Returns their number. */
+static
+unsigned int consume_stream(struct lttng_ust_ring_buffer *buf, int lane,
+		unsigned int nr_writers)
+{
+	struct lttng_ust_ring_buffer_channel *rb_chan = chan->priv->rb_chan;
+	struct lttng_ust_shm_handle *handle = rb_chan->handle;
+	unsigned int nr_subbuf = 0;
+	static char data[SUBBUF_SIZE];
+
+	while (!lib_ring_buffer_get_next_subbuf(buf, handle)) {
+		unsigned long len;
+
+		len = lib_ring_buffer_get_read_data_size(&rb_chan->backend.config,
+				buf, handle);
+		if (len > sizeof(data))
+			len = sizeof(data);
+		if (lib_ring_buffer_read(&buf->backend, buf->cons_snapshot,
+				data, len, handle) == len)
+			read_records(data, len, lane, nr_writers);
+		lib_ring_buffer_put_next_subbuf(buf, handle);
+		nr_subbuf++;
+	}
+	return nr_subbuf;
+}
+
+/*
+ * Reserve and write a record, recording the repeat context fields as
+ * lttng-context-repeat.c does when folding.
+ */
+static
+bool reserve_fold_record(struct lttng_ust_ring_buffer_ctx *ctx,
+		uint32_t value, bool fold)
+{
+	struct fold_record record = {
+		.magic = FOLD_MAGIC,
+		.value = value,
+	};
+
+	lttng_ust_ring_buffer_ctx_init(ctx, &event_recorder, sizeof(record),
+			lttng_ust_rb_alignof(uint64_t), NULL);
+	if (chan->ops->event_reserve(ctx))
+		return false;
+	lttng_ust_ring_buffer_align_ctx(ctx, lttng_ust_rb_alignof(uint64_t));
+	if (fold)
+		ctx->priv->fold_offset = ctx->priv->buf_offset;
+	record.repeat_last_timestamp = ctx->priv->tsc;
+	chan->ops->event_write(ctx, &record, sizeof(record),
+			lttng_ust_rb_alignof(uint64_t));
+	return true;
+}
+
+static
+bool write_fold_record(uint32_t value)
+{
+	struct lttng_ust_ring_buffer_ctx ctx;
+
+	if (!reserve_fold_record(&ctx, value, true))
+		return false;
+	chan->ops->event_commit(&ctx);
+	return true;
+}
+
+/* Consume the records of a stream, up to NR_FOLD_RECORDS. */
+static
+unsigned int consume_fold_records(struct lttng_ust_ring_buffer *buf,
+		struct consumed_fold_record *records)
+{
+	struct lttng_ust_ring_buffer_channel *rb_chan = chan->priv->rb_chan;
+	struct lttng_ust_shm_handle *handle = rb_chan->handle;
+	unsigned int nr_records = 0, subbuf = 0;
+	static char data[SUBBUF_SIZE];
+
+	while (!lib_ring_buffer_get_next_subbuf(buf, handle)) {
+		unsigned long len, offset;
+
+		len = lib_ring_buffer_get_read_data_size(&rb_chan->backend.config,
+				buf, handle);
+		if (len > sizeof(data))
+			len = sizeof(data);
+		if (lib_ring_buffer_read(&buf->backend, buf->cons_snapshot,
+				data, len, handle) != len)
+			len = 0;
+		for (offset = 0; offset + sizeof(struct fold_record) <= len; offset++) {
+			struct fold_record record;
+
+			memcpy(&record, data + offset, sizeof(record));
+			if (record.magic != FOLD_MAGIC)
+				continue;
+			offset += sizeof(record) - 1;
+			if (nr_records == NR_FOLD_RECORDS)
+				continue;
+			records[nr_records].record = record;
+			records[nr_records].subbuf = subbuf;
+			nr_records++;
+		}
+		lib_ring_buffer_put_next_subbuf(buf, handle);
+		subbuf++;
+	}
+	return nr_records;
+}
+
+static
+bool fold_record_is(const struct consumed_fold_record *consumed,
+		uint32_t value, uint64_t repeat_count)
+{
+	return consumed->record.value == value
+		&& consumed->record.repeat_count == repeat_count;
+}
+
+static
+void test_fold(const char *transport_name)
+{
+	struct consumed_fold_record records[NR_FOLD_RECORDS];
+	struct lttng_ust_ring_buffer_channel *rb_chan;
+	struct lttng_ust_ring_buffer_ctx ctx, nested_ctx;
+	struct lttng_ust_shm_handle *handle;
+	struct lttng_ust_ring_buffer *buf;
+	int fd, shm_fd, wait_fd, wakeup_fd;
+	bool written = true;
+	uint64_t memory_map_size;
+	void *memory_map_addr;
+	unsigned int i;
+
+	if (open_stream_fds(&fd, 1))
+		abort();
+	chan = create_channel(transport_name, &fd, 1);
+	if (!chan) {
+		skip(3, "%s: no channel", transport_name);
+		close_stream_fds(&fd, 1);
+		return;
+	}
+	event_recorder.chan = chan;
+	rb_chan = chan->priv->rb_chan;
+	handle = rb_chan->handle;
+	buf = channel_get_ring_buffer(&rb_chan->backend.config, rb_chan, 0,
+			handle, &shm_fd, &wait_fd, &wakeup_fd, &memory_map_size,
+			&memory_map_addr);
+	if (!buf || lib_ring_buffer_open_read(buf, handle)) {
+		skip(3, "%s: no stream", transport_name);
+		goto end;
+	}
+
+	/* A run of identical records, then another one. */
+	for (i = 0; i < NR_FOLDED; i++)
+		written &= write_fold_record(1);
+	written &= write_fold_record(2);
+
+	/*
+	 * A record identical to the previous one, committed after another
+	 * one was reserved, as from a signal handler: it cannot be
+	 * discarded any more.
+	 */
+	written &= write_fold_record(3);
+	if (reserve_fold_record(&ctx, 3, true)) {
+		if (reserve_fold_record(&nested_ctx, 4, false))
+			chan->ops->event_commit(&nested_ctx);
+		else
+			written = false;
+		chan->ops->event_commit(&ctx);
+	} else {
+		written = false;
+	}
+
+	/* Identical records on each side of a sub-buffer switch. */
+	written &= write_fold_record(5);
+	(void) chan->ops->priv->flush_buffer(chan);
+	written &= write_fold_record(5);
+
+	(void) chan->ops->priv->flush_buffer(chan);
+	memset(records, 0, sizeof(records));
+	if (!written || consume_fold_records(buf, records) != NR_FOLD_RECORDS) {
+		skip(3, "%s: records not consumed", transport_name);
+		goto release;
+	}
+	ok(fold_record_is(&records[0], 1, NR_FOLDED - 1)
+		&& fold_record_is(&records[1], 2, 0),
+		"%s: identical records folded into the first one",
+		transport_name);
+	ok(fold_record_is(&records[2], 3, 0)
+		&& fold_record_is(&records[3], 3, 0)
+		&& records[4].record.value == 4,
+		"%s: no fold past a record reserved meanwhile",
+		transport_name);
+	ok(fold_record_is(&records[5], 5, 0)
+		&& fold_record_is(&records[6], 5, 0)
+		&& records[6].subbuf == records[5].subbuf + 1,
+		"%s: no fold across a sub-buffer switch", transport_name);
+
+release:
+	lib_ring_buffer_release_read(buf, handle);
+end:
+	chan->ops->priv->channel_destroy(chan);
+	chan = NULL;
+	close_stream_fds(&fd, 1);
+}
+
+static
+void test_lanes(const char *transport_name)
+{
+	struct lttng_ust_ring_buffer *bufs[NR_LANES] = { NULL };
+	struct lttng_ust_ring_buffer_channel *rb_chan;
+	struct lttng_ust_shm_handle *handle;
+	unsigned int nr_writers, lanes_used, i;
+	bool created = true, consumed = true, complete = true, ordered = true;
+	int fds[NR_LANES], lane;
+
+	if (open_stream_fds(fds, NR_LANES))
+		abort();
+	chan = create_channel(transport_name, fds, NR_LANES);
+	ok(chan && chan->priv->rb_chan->nr_streams == NR_LANES,
+		"%s: channel of %d lanes created", transport_name, NR_LANES);
+	if (!chan) {
+		skip(4, "%s: no channel", transport_name);
+		close_stream_fds(fds, NR_LANES);
+		return;
+	}
+	event_recorder.chan = chan;
+	rb_chan = chan->priv->rb_chan;
+	handle = rb_chan->handle;
+
+	/* Each lane is a stream of its own. */
+	for_each_channel_lane(lane, rb_chan) {
+		int shm_fd, wait_fd, wakeup_fd;
+		uint64_t memory_map_size;
+		void *memory_map_addr;
+
+		bufs[lane] = channel_get_ring_buffer(&rb_chan->backend.config,
+				rb_chan, lane, handle, &shm_fd, &wait_fd,
+				&wakeup_fd, &memory_map_size, &memory_map_addr);
+		if (!bufs[lane] || shm_fd != fds[lane]
+				|| lib_ring_buffer_open_read(bufs[lane], handle))
+			created = false;
+	}
+	ok(created, "%s: stream of each lane created", transport_name);
+
+	nr_writers = run_writers(&lanes_used);
+	ok(lanes_used == (1U << NR_LANES) - 1,
+		"%s: %u writers spread over all lanes", transport_name,
+		nr_writers);
+
+	/* Flush each stream, as done on tracing stop. */
+	(void) chan->ops->priv->flush_buffer(chan);
+	for (lane = 0; lane < NR_LANES; lane++) {
+		if (!bufs[lane] || !consume_stream(bufs[lane], lane, nr_writers))
+			consumed = false;
+	}
+	ok(consumed, "%s: each lane flushed and consumed", transport_name);
+
+	for (i = 0; i < nr_writers; i++) {
+		if (writers[i].nr_written != NR_RECORDS
+				|| writers[i].nr_read != NR_RECORDS)
+			complete = false;
+		if (writers[i].misplaced)
+			ordered = false;
+	}
+	ok(complete && ordered,
+		"%s: records of each writer consumed in order from its lane",
+		transport_name);
+
+	for (lane = 0; lane < NR_LANES; lane++) {
+		if (bufs[lane])
+			lib_ring_buffer_release_read(bufs[lane], handle);
+	}
+	chan->ops->priv->channel_destroy(chan);
+	chan = NULL;
+	close_stream_fds(fds, NR_LANES);
+}
+
+int main(void)
+{
+	static const char *transports[] = {
+		"relay-discard-per-channel-mmap",
+		"relay-overwrite-per-channel-mmap",
+		"relay-discard-per-channel-rt-mmap",
+		"relay-overwrite-per-channel-rt-mmap",
+	};
+	struct lttng_ust_event_common event_common;
+	int fds[NR_CPUS + 1];
+	unsigned int i;
+
+	plan_tests(1 + 8 * sizeof(transports) / sizeof(transports[0]));
+
+	lttng_ust_ring_buffer_clients_init();
+	sem_init(&writer_ready, 0, 0);
+
+	memset(&event_common, 0, sizeof(event_common));
+	event_common.struct_size = sizeof(event_common);
+	event_recorder.struct_size = sizeof(event_recorder);
+	event_recorder.parent = &event_common;
+	event_recorder.priv = &event_recorder_priv;
+	event_recorder_priv.pub = &event_recorder;
+	event_recorder_priv.id = 1;
+
+	if (open_stream_fds(fds, NR_CPUS + 1))
+		abort();
+	chan = create_channel(transports[0], fds, NR_CPUS + 1);
+	ok(!chan, "At most one lane per possible cpu");
+	if (chan)
+		chan->ops->priv->channel_destroy(chan);
+	close_stream_fds(fds, NR_CPUS + 1);
+
+	for (i = 0; i < sizeof(transports) / sizeof(transports[0]); i++) {
+		test_lanes(transports[i]);
+		test_fold(transports[i]);
+	}
+
+	lttng_ust_ring_buffer_clients_exit();
+	return exit_status();
+}
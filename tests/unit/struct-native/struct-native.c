@@ -0,0 +1,317 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Structures recorded in their native layout. The structure is
+ * recorded through a probe with fake channel operations, and its
+ * description is serialized as it is sent to the session daemon. The
+ * offset of each member in the described layout, where the bytes
+ * between members are described as padding, must match offsetof.
+ */
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#include "ust_tests_struct_native.h"
+
+#include <lttng/ust-ctl.h>
+
+#include "common/events.h"
+#include "common/ustcomm.h"
+
+#include "tap.h"
+
+#define NUM_TESTS	16
+
+#define PADDING_PREFIX	"_padding_"
+#define EVENT_ID	42
+
+static const struct {
+	const char *name;
+	size_t offset;
+} members[] = {
+	{ "tag", offsetof(struct ust_tests_struct_native_state, tag) },
+	{ "counter", offsetof(struct ust_tests_struct_native_state, counter) },
+	{ "level", offsetof(struct ust_tests_struct_native_state, level) },
+	{ "ratio", offsetof(struct ust_tests_struct_native_state, ratio) },
+	{ "name", offsetof(struct ust_tests_struct_native_state, name) },
+	{ "flags", offsetof(struct ust_tests_struct_native_state, flags) },
+	{ "last", offsetof(struct ust_tests_struct_native_state, last) },
+};
+
+/* Writes done by the probe. */
+static unsigned int nr_writes, nr_commits;
+static size_t write_len, write_alignment;
+static char write_data[sizeof(struct ust_tests_struct_native_state)];
+
+static
+int fake_event_reserve(struct lttng_ust_ring_buffer_ctx *ctx __attribute__((unused)))
+{
+	return 0;
+}
+
+static
+void fake_event_commit(struct lttng_ust_ring_buffer_ctx *ctx __attribute__((unused)))
+{
+	nr_commits++;
+}
+
+static
+void fake_event_write(struct lttng_ust_ring_buffer_ctx *ctx __attribute__((unused)),
+		const void *src, size_t len, size_t alignment)
+{
+	nr_writes++;
+	write_len = len;
+	write_alignment = alignment;
+	memcpy(write_data, src, len < sizeof(write_data) ? len : sizeof(write_data));
+}
+
+static struct lttng_ust_channel_buffer_ops fake_ops = {
+	.struct_size = sizeof(struct lttng_ust_channel_buffer_ops),
+	.event_reserve = fake_event_reserve,
+	.event_commit = fake_event_commit,
+	.event_write = fake_event_write,
+};
+
+/* Without a profile counter, when built with probe profiling. */
+static struct lttng_ust_session_private fake_session_priv;
+
+static struct lttng_ust_session fake_session = {
+	.struct_size = sizeof(struct lttng_ust_session),
+	.active = 1,
+	.priv = &fake_session_priv,
+};
+
+static struct lttng_ust_channel_common fake_chan_common = {
+	.struct_size = sizeof(struct lttng_ust_channel_common),
+	.type = LTTNG_UST_CHANNEL_TYPE_BUFFER,
+	.enabled = 1,
+	.session = &fake_session,
+};
+
+static struct lttng_ust_channel_buffer fake_chan = {
+	.struct_size = sizeof(struct lttng_ust_channel_buffer),
+	.parent = &fake_chan_common,
+	.ops = &fake_ops,
+};
+
+static struct lttng_ust_event_recorder fake_event_recorder;
+
+static struct lttng_ust_event_common fake_event = {
+	.struct_size = sizeof(struct lttng_ust_event_common),
+	.type = LTTNG_UST_EVENT_TYPE_RECORDER,
+	.child = &fake_event_recorder,
+	.enabled = 1,
+};
+
+static struct lttng_ust_event_recorder fake_event_recorder = {
+	.struct_size = sizeof(struct lttng_ust_event_recorder),
+	.parent = &fake_event,
+	.chan = &fake_chan,
+};
+
+static
+void test_record(void)
+{
+	struct ust_tests_struct_native_state state;
+
+	/* Fill the padding too, it is recorded with the members. */
+	memset(&state, 0x5a, sizeof(state));
+	state.tag = 't';
+	state.counter = -1234567890123LL;
+	state.level = 0xbeef;
+	state.ratio = 0.25;
+	memcpy(state.name, "abcde", sizeof(state.name));
+	state.flags[0] = 1;
+	state.flags[1] = 2;
+	state.flags[2] = 3;
+	state.unlisted = 7;
+	state.last = 0xff;
+
+	lttng_ust__event_probe__ust_tests_struct_native___state(&fake_event, &state);
+
+	ok(nr_writes == 1 && nr_commits == 1,
+		"Structure recorded in a single write (%u writes, %u commits)",
+		nr_writes, nr_commits);
+	ok(write_len == sizeof(state)
+			&& write_alignment == lttng_ust_rb_alignof(struct ust_tests_struct_native_state),
+		"Write of the structure size and alignment (%zu bytes, aligned on %zu)",
+		write_len, write_alignment);
+	ok(!memcmp(write_data, &state, sizeof(state)),
+		"Recorded bytes match the structure, padding included");
+}
+
+/* Size in bytes of the serialized type at fields[*i], advances *i. */
+static
+ssize_t serialized_size(const struct lttng_ust_ctl_field *fields, size_t *i)
+{
+	const struct lttng_ust_ctl_type *type = &fields[*i].type;
+
+	(*i)++;
+	switch (type->atype) {
+	case lttng_ust_ctl_atype_integer:
+		return type->u.integer.size / CHAR_BIT;
+	case lttng_ust_ctl_atype_float:
+		return (type->u._float.exp_dig + type->u._float.mant_dig) / CHAR_BIT;
+	case lttng_ust_ctl_atype_array_nestable:
+	{
+		uint32_t length = type->u.array_nestable.length;
+		ssize_t elem_size;
+
+		elem_size = serialized_size(fields, i);
+		if (elem_size < 0)
+			return elem_size;
+		return elem_size * length;
+	}
+	default:
+		return -1;
+	}
+}
+
+static
+int find_member(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
+		if (!strcmp(members[i].name, name))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Walk the members of the serialized structure, and check the offset
+ * of each member against offsetof, and the offset named by each
+ * padding area.
+ */
+static
+void check_layout(const struct lttng_ust_ctl_field *fields, size_t nr_fields)
+{
+	size_t i = 1, offset = 0;
+	unsigned int nr_members = 0, nr_padding = 0, bad_padding = 0, j;
+
+	ok(nr_fields > 0
+			&& fields[0].type.atype == lttng_ust_ctl_atype_struct_nestable
+			&& !strcmp(fields[0].name, "state"),
+		"Structure described as a struct field");
+	ok(fields[0].type.u.struct_nestable.alignment
+			== lttng_ust_rb_alignof(struct ust_tests_struct_native_state) * CHAR_BIT,
+		"Structure alignment described (%u bits)",
+		fields[0].type.u.struct_nestable.alignment);
+
+	for (j = 0; j < fields[0].type.u.struct_nestable.nr_fields && i < nr_fields; j++) {
+		const char *name = fields[i].name;
+		ssize_t size;
+		int member;
+
+		size = serialized_size(fields, &i);
+		if (size < 0)
+			break;
+		if (!strncmp(name, PADDING_PREFIX, strlen(PADDING_PREFIX))) {
+			if (strtoul(name + strlen(PADDING_PREFIX), NULL, 10) != offset)
+				bad_padding++;
+			nr_padding++;
+		} else {
+			member = find_member(name);
+			if (member < 0) {
+				fail("Unexpected member \"%s\"", name);
+			} else {
+				ok(offset == members[member].offset,
+					"Member \"%s\" at offset %zu, offsetof %zu",
+					name, offset, members[member].offset);
+				nr_members++;
+			}
+		}
+		offset += size;
+	}
+	ok(nr_members == sizeof(members) / sizeof(members[0]) && i == nr_fields,
+		"All members described (%u members, %zu of %zu fields)",
+		nr_members, i, nr_fields);
+	/* After tag, level and name, the unlisted member, after last. */
+	ok(nr_padding == 5 && !bad_padding,
+		"Padding areas named after their offset (%u areas, %u misnamed)",
+		nr_padding, bad_padding);
+	ok(offset == sizeof(struct ust_tests_struct_native_state),
+		"Described size %zu matches sizeof %zu",
+		offset, sizeof(struct ust_tests_struct_native_state));
+}
+
+/*
+ * Serialize the event description as sent to the session daemon. The
+ * reply is queued on the socket before the registration, which reads
+ * it once the description is sent.
+ */
+static
+void test_layout(void)
+{
+	const struct lttng_ust_event_desc *desc =
+		&lttng_ust__event_desc___ust_tests_struct_native_state;
+	struct {
+		struct ustcomm_notify_hdr header;
+		struct ustcomm_notify_event_msg m;
+	} msg;
+	struct {
+		struct ustcomm_notify_hdr header;
+		struct ustcomm_notify_event_reply r;
+	} reply;
+	struct lttng_ust_ctl_field *fields = NULL;
+	char *signature = NULL;
+	uint32_t id = 0;
+	int sv[2], ret;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		skip(13, "socketpair failed");
+		return;
+	}
+	memset(&reply, 0, sizeof(reply));
+	reply.header.notify_cmd = LTTNG_UST_CTL_NOTIFY_CMD_EVENT;
+	reply.r.event_id = EVENT_ID;
+	if (ustcomm_send_unix_sock(sv[1], &reply, sizeof(reply)) != sizeof(reply)) {
+		skip(13, "Failed to queue the reply");
+		goto end;
+	}
+
+	ret = ustcomm_register_event(sv[0], &fake_session, 0, 0,
+			desc->event_name, 0, desc->tp_class->signature,
+			desc->tp_class->nr_fields, desc->tp_class->fields,
+			NULL, &id);
+	ok(ret == 0 && id == EVENT_ID, "Event registered (ret %d, id %u)",
+		ret, id);
+
+	if (ustcomm_recv_unix_sock(sv[1], &msg, sizeof(msg)) != sizeof(msg)) {
+		skip(12, "Failed to receive the event message");
+		goto end;
+	}
+	signature = malloc(msg.m.signature_len);
+	fields = malloc(msg.m.fields_len);
+	if (!signature || !fields
+			|| ustcomm_recv_unix_sock(sv[1], signature, msg.m.signature_len) != msg.m.signature_len
+			|| ustcomm_recv_unix_sock(sv[1], fields, msg.m.fields_len) != msg.m.fields_len) {
+		skip(12, "Failed to receive the event description");
+		goto end;
+	}
+	check_layout(fields, msg.m.fields_len / sizeof(*fields));
+end:
+	free(signature);
+	free(fields);
+	close(sv[0]);
+	close(sv[1]);
+}
+
+int main(void)
+{
+	plan_tests(NUM_TESTS);
+
+	test_record();
+	test_layout();
+
+	return exit_status();
+}
@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#undef LTTNG_UST_TRACEPOINT_PROVIDER
+#define LTTNG_UST_TRACEPOINT_PROVIDER ust_tests_struct_native
+
+#ifndef _UST_TESTS_STRUCT_NATIVE_STATE_H
+#define _UST_TESTS_STRUCT_NATIVE_STATE_H
+
+#include <stdint.h>
+
+/*
+ * Padding after "tag" and "level", an omitted member and trailing
+ * padding after "last".
+ */
+struct ust_tests_struct_native_state {
+	char tag;
+	int64_t counter;
+	uint16_t level;
+	double ratio;
+	char name[5];
+	uint32_t flags[3];
+	int unlisted;
+	uint8_t last;
+};
+
+#endif /* _UST_TESTS_STRUCT_NATIVE_STATE_H */
+
+#if !defined(_TRACEPOINT_UST_TESTS_STRUCT_NATIVE_H) || defined(LTTNG_UST_TRACEPOINT_HEADER_MULTI_READ)
+#define _TRACEPOINT_UST_TESTS_STRUCT_NATIVE_H
+
+#include <lttng/tracepoint.h>
+
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_struct_native, state,
+	LTTNG_UST_TP_ARGS(const struct ust_tests_struct_native_state *, state),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_struct(struct ust_tests_struct_native_state, state, state,
+			lttng_ust_field_struct_member_integer(struct ust_tests_struct_native_state, tag)
+			lttng_ust_field_struct_member_integer(struct ust_tests_struct_native_state, counter)
+			lttng_ust_field_struct_member_integer(struct ust_tests_struct_native_state, level)
+			lttng_ust_field_struct_member_float(struct ust_tests_struct_native_state, ratio)
+			lttng_ust_field_struct_member_array_text(struct ust_tests_struct_native_state, name)
+			lttng_ust_field_struct_member_array_hex(struct ust_tests_struct_native_state, flags)
+			lttng_ust_field_struct_member_integer(struct ust_tests_struct_native_state, last)
+		)
+	)
+)
+
+#endif /* _TRACEPOINT_UST_TESTS_STRUCT_NATIVE_H */
+
+#undef LTTNG_UST_TRACEPOINT_INCLUDE
+#define LTTNG_UST_TRACEPOINT_INCLUDE "./ust_tests_struct_native.h"
+
+/* This part must be outside ifdef protection */
+#include <lttng/tracepoint-event.h>
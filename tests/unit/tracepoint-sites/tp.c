@@ -0,0 +1,6 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#include "ust_tests_sites.h"
@@ -0,0 +1,164 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Selection of tracepoint call sites with the LTTNG_UST_TRACEPOINT_SITES
+ * environment variable. The selectors are computed from the call sites
+ * registered by a first run, which then re-executes the test with them
+ * since the environment is read when the library is loaded. The
+ * selection is then changed at runtime.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#define LTTNG_UST_TRACEPOINT_SITES
+#include "ust_tests_sites.h"
+
+#include "tap.h"
+
+#define SITES_ENV	"LTTNG_UST_TRACEPOINT_SITES"
+#define NUM_TESTS	11
+
+/* Values traced through the probe, one bit per call site. */
+static unsigned int traced;
+
+static
+void probe(void *data __attribute__((unused)), int value)
+{
+	traced |= 1U << value;
+}
+
+static
+void site_selected(int value)
+{
+	lttng_ust_tracepoint(ust_tests_sites, selected, value);
+}
+
+static
+void site_not_selected(int value)
+{
+	lttng_ust_tracepoint(ust_tests_sites, selected, value);
+}
+
+static
+void site_other(int value)
+{
+	lttng_ust_tracepoint(ust_tests_sites, other, value);
+}
+
+/* Call both sites of the "selected" event, returns the values traced. */
+static
+unsigned int trace_sites(void)
+{
+	traced = 0;
+	site_selected(1);
+	site_not_selected(2);
+	return traced;
+}
+
+static
+struct lttng_ust_tracepoint_site *find_site(const char *func)
+{
+	struct lttng_ust_tracepoint_site * const *site;
+
+	for (site = __start_lttng_ust_tracepoint_sites_ptrs;
+			site < __stop_lttng_ust_tracepoint_sites_ptrs; site++) {
+		if (*site && !strcmp((*site)->func, func))
+			return *site;
+	}
+	return NULL;
+}
+
+int main(int argc __attribute__((unused)), char **argv)
+{
+	struct lttng_ust_tracepoint_site *selected, *not_selected, *other;
+	char selectors[256];
+	bool refused;
+
+	selected = find_site("site_selected");
+	not_selected = find_site("site_not_selected");
+	other = find_site("site_other");
+
+	if (!getenv(SITES_ENV)) {
+		char env[256];
+
+		if (!selected)
+			return EXIT_FAILURE;
+		/* Select the first call site of the event by its line. */
+		snprintf(env, sizeof(env),
+			"ust_tests_sites:selected@*tracepoint-sites.c:%u,nomatch:*@nofile.c",
+			selected->line);
+		if (setenv(SITES_ENV, env, 1))
+			return EXIT_FAILURE;
+		execv("/proc/self/exe", argv);
+		perror("execv");
+		return EXIT_FAILURE;
+	}
+
+	plan_tests(NUM_TESTS);
+
+	ok(selected && not_selected && other, "Call sites registered");
+	if (!selected || !not_selected || !other)
+		return exit_status();
+	ok(selected->line != not_selected->line && selected->tp == not_selected->tp,
+		"Two call sites of the same tracepoint");
+
+	ok(CMM_LOAD_SHARED(selected->state) == 1,
+		"Call site matching a selector of its event is enabled (%s)",
+		getenv(SITES_ENV));
+	ok(CMM_LOAD_SHARED(not_selected->state) == 0,
+		"Call site not matching the selectors of its event is disabled");
+	ok(CMM_LOAD_SHARED(other->state) == 1,
+		"Call site of an event without selector is enabled");
+
+	/* No session is tracing: the calls must not be recorded. */
+	site_selected(1);
+	site_not_selected(2);
+	site_other(3);
+
+	ok(lttng_ust_tracepoint_enabled(ust_tests_sites, selected) == 0,
+		"Tracepoint is disabled without a session");
+
+	if (lttng_ust_tracepoint_provider_register("ust_tests_sites", "selected",
+			(void (*)(void)) probe, NULL,
+			lttng_ust_tracepoint_ust_tests_sites___selected.signature)) {
+		skip(NUM_TESTS - 6, "Probe not registered");
+		return exit_status();
+	}
+	ok(trace_sites() == 1U << 1,
+		"Call site not selected is not traced while its event is enabled");
+
+	refused = true;
+	snprintf(selectors, sizeof(selectors),
+		"ust_tests_sites:selected@*tracepoint-sites.c:%u",
+		not_selected->line);
+	refused &= lttng_ust_tracepoint_select_sites("*tracepoint-sites.c:12x") == -EINVAL;
+	refused &= lttng_ust_tracepoint_select_sites("*tracepoint-sites.c:0") == -EINVAL;
+	refused &= lttng_ust_tracepoint_select_sites("*tracepoint-sites.c:-1") == -EINVAL;
+	refused &= lttng_ust_tracepoint_select_sites("*tracepoint-sites.c:99999999999999999999") == -EINVAL;
+	refused &= lttng_ust_tracepoint_select_sites("*tracepoint-sites.c:") == -EINVAL;
+	ok(refused && CMM_LOAD_SHARED(selected->state) == 1
+		&& CMM_LOAD_SHARED(not_selected->state) == 0,
+		"Invalid line numbers refused, selection unchanged");
+
+	ok(!lttng_ust_tracepoint_select_sites(selectors)
+		&& CMM_LOAD_SHARED(selected->state) == 0
+		&& CMM_LOAD_SHARED(not_selected->state) == 1
+		&& CMM_LOAD_SHARED(other->state) == 1,
+		"Call sites selected at runtime (%s)", selectors);
+	ok(trace_sites() == 1U << 2,
+		"Only the call site selected at runtime is traced");
+
+	ok(!lttng_ust_tracepoint_select_sites(NULL)
+		&& trace_sites() == ((1U << 1) | (1U << 2)),
+		"All call sites traced once the selectors are removed");
+
+	(void) lttng_ust_tracepoint_provider_unregister("ust_tests_sites", "selected",
+			(void (*)(void)) probe, NULL);
+	return exit_status();
+}
@@ -0,0 +1,33 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#undef LTTNG_UST_TRACEPOINT_PROVIDER
+#define LTTNG_UST_TRACEPOINT_PROVIDER ust_tests_sites
+
+#if !defined(_TRACEPOINT_UST_TESTS_SITES_H) || defined(LTTNG_UST_TRACEPOINT_HEADER_MULTI_READ)
+#define _TRACEPOINT_UST_TESTS_SITES_H
+
+#include <lttng/tracepoint.h>
+
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_sites, selected,
+	LTTNG_UST_TP_ARGS(int, value),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer(int, value, value)
+	)
+)
+
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_sites, other,
+	LTTNG_UST_TP_ARGS(int, value),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer(int, value, value)
+	)
+)
+
+#endif /* _TRACEPOINT_UST_TESTS_SITES_H */
+
+#undef LTTNG_UST_TRACEPOINT_INCLUDE
+#define LTTNG_UST_TRACEPOINT_INCLUDE "./ust_tests_sites.h"
+
+/* This part must be outside ifdef protection */
+#include <lttng/tracepoint-event.h>
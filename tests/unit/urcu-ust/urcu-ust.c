@@ -0,0 +1,148 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Concurrent reader registration and unregistration in the lock-free
+ * registry of the LTTng-UST RCU flavor, with registrations nested in
+ * signal handlers and concurrent grace periods.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <urcu/uatomic.h>
+#include <lttng/urcu/urcu-ust.h>
+#include <lttng/urcu/pointer.h>
+
+#include "tap.h"
+
+#define NR_ROUNDS		50
+#define NR_READERS		16
+#define NR_READ_LOOPS		2000
+
+#define OBJ_LIVE		0x1111
+#define OBJ_DEAD		0xdead
+
+struct obj {
+	int magic;
+};
+
+static struct obj *shared_obj;
+static int stop_updater;
+static int nr_dead_seen;
+static int nr_reads;
+static int nr_signal_reads;
+static int nr_grace_periods;
+
+static
+void check_obj(void)
+{
+	struct obj *obj;
+
+	lttng_ust_urcu_read_lock();
+	obj = lttng_ust_rcu_dereference(shared_obj);
+	if (obj->magic != OBJ_LIVE)
+		uatomic_inc(&nr_dead_seen);
+	lttng_ust_urcu_read_unlock();
+}
+
+/* Registers the interrupted thread if it is not registered yet. */
+static
+void sigusr1_handler(int signo __attribute__((unused)))
+{
+	check_obj();
+	uatomic_inc(&nr_signal_reads);
+}
+
+static
+void *reader_thread(void *arg __attribute__((unused)))
+{
+	int i;
+
+	for (i = 0; i < NR_READ_LOOPS; i++)
+		check_obj();
+	uatomic_add(&nr_reads, NR_READ_LOOPS);
+	/* Unregistered by the thread exit notifier. */
+	return NULL;
+}
+
+static
+void *updater_thread(void *arg __attribute__((unused)))
+{
+	while (!uatomic_read(&stop_updater)) {
+		struct obj *new_obj, *old_obj;
+
+		new_obj = malloc(sizeof(*new_obj));
+		if (!new_obj)
+			abort();
+		new_obj->magic = OBJ_LIVE;
+		old_obj = lttng_ust_rcu_xchg_pointer(&shared_obj, new_obj);
+		lttng_ust_urcu_synchronize_rcu();
+		old_obj->magic = OBJ_DEAD;
+		free(old_obj);
+		uatomic_inc(&nr_grace_periods);
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t updater, readers[NR_READERS];
+	struct sigaction sa;
+	bool create_ok = true;
+	int round, i;
+
+	plan_tests(5);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigusr1_handler;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGUSR1, &sa, NULL))
+		abort();
+
+	shared_obj = malloc(sizeof(*shared_obj));
+	if (!shared_obj)
+		abort();
+	shared_obj->magic = OBJ_LIVE;
+
+	if (pthread_create(&updater, NULL, updater_thread, NULL))
+		abort();
+
+	/*
+	 * Each round registers and unregisters NR_READERS threads, some
+	 * of them first registered from a signal handler.
+	 */
+	for (round = 0; round < NR_ROUNDS; round++) {
+		for (i = 0; i < NR_READERS; i++) {
+			if (pthread_create(&readers[i], NULL, reader_thread, NULL))
+				create_ok = false;
+		}
+		for (i = 0; i < NR_READERS; i += 2)
+			(void) pthread_kill(readers[i], SIGUSR1);
+		for (i = 0; i < NR_READERS; i++) {
+			if (pthread_join(readers[i], NULL))
+				create_ok = false;
+		}
+	}
+	ok(create_ok, "Register and unregister %d reader threads",
+		NR_ROUNDS * NR_READERS);
+	ok(uatomic_read(&nr_reads) == NR_ROUNDS * NR_READERS * NR_READ_LOOPS,
+		"All read-side critical sections completed");
+	ok(uatomic_read(&nr_signal_reads) > 0,
+		"Read-side critical sections in signal handlers completed (%d)",
+		uatomic_read(&nr_signal_reads));
+
+	uatomic_set(&stop_updater, 1);
+	if (pthread_join(updater, NULL))
+		abort();
+	ok(uatomic_read(&nr_grace_periods) > 0,
+		"Grace periods completed concurrently (%d)",
+		uatomic_read(&nr_grace_periods));
+	ok(uatomic_read(&nr_dead_seen) == 0,
+		"No reader observed a reclaimed object");
+
+	free(shared_obj);
+	return exit_status();
+}
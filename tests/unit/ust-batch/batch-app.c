@@ -0,0 +1,17 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Application registering to the session daemon emulated by the
+ * ust-batch test, until its standard input is closed.
+ */
+
+#include <unistd.h>
+
+int main(void)
+{
+	char c;
+
+	while (read(STDIN_FILENO, &c, 1) > 0)
+		;
+	return 0;
+}
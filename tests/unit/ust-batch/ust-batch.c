@@ -0,0 +1,171 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Command batches, as handled by the listener thread of an application.
+ * The test emulates the session daemon, and runs a batch over the
+ * command socket of the application it starts: handles resolved within
+ * the batch, a command failing alone, a command refused within a batch,
+ * and a command leaving its handler early must all be replied to, in
+ * order.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lttng/ust-abi.h>
+#include <lttng/ust-error.h>
+
+#include "common/ustcomm.h"
+
+#include "fake-sessiond.h"
+#include "tap.h"
+
+#define NUM_TESTS	12
+
+/* Test duration limit (s), should the application not respond. */
+#define TEST_TIMEOUT	60
+
+/* Handle of no object. */
+#define NO_HANDLE	12345
+
+#define REF(tag)	(USTCOMM_BATCH_HANDLE_REF | (tag))
+
+static const struct {
+	uint32_t handle;
+	uint32_t cmd;
+} batch[] = {
+	/* 1: the session. */
+	{ LTTNG_UST_ABI_ROOT_HANDLE, LTTNG_UST_ABI_SESSION },
+	/* 2, 3: resolved within the batch. */
+	{ REF(1), LTTNG_UST_ABI_ENABLE },
+	{ REF(1), LTTNG_UST_ABI_DISABLE },
+	/* 4: leaves its handler early, without names to receive. */
+	{ REF(1), LTTNG_UST_ABI_EXCLUSION },
+	/* 5: fails alone. */
+	{ NO_HANDLE, LTTNG_UST_ABI_DISABLE },
+	/* 6: refers to a failed command. */
+	{ REF(5), LTTNG_UST_ABI_ENABLE },
+	/* 7: refused within a batch. */
+	{ LTTNG_UST_ABI_ROOT_HANDLE, LTTNG_UST_ABI_TRACER_VERSION },
+	/* 8: the batch goes on. */
+	{ LTTNG_UST_ABI_ROOT_HANDLE, LTTNG_UST_ABI_SESSION },
+};
+
+#define NR_BATCH_CMDS	(sizeof(batch) / sizeof(batch[0]))
+
+static
+int send_cmd(int sock, uint32_t handle, uint32_t cmd, uint32_t tag)
+{
+	struct ustcomm_ust_msg lum;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = handle;
+	lum.cmd = cmd;
+	lum.tag = tag;
+	/* Exclusion without names: nothing follows. */
+	if (cmd == LTTNG_UST_ABI_EXCLUSION)
+		lum.u.exclusion.count = 0;
+	return ustcomm_send_app_msg(sock, &lum);
+}
+
+static
+bool reply_is(const struct ustcomm_ust_reply *replies, unsigned int tag,
+		int32_t ret_code)
+{
+	return replies[tag - 1].ret_code == ret_code;
+}
+
+static
+void test_batch(int sock)
+{
+	struct ustcomm_ust_reply lur, replies[NR_BATCH_CMDS];
+	struct pollfd pfd = { .fd = sock, .events = POLLIN };
+	unsigned int i, nr_in_order = 0;
+	bool sent = true;
+	int ret;
+
+	sent = !send_cmd(sock, LTTNG_UST_ABI_ROOT_HANDLE, LTTNG_UST_ABI_BATCH_BEGIN, 0);
+	for (i = 0; i < NR_BATCH_CMDS && sent; i++)
+		sent = !send_cmd(sock, batch[i].handle, batch[i].cmd, i + 1);
+	ok(sent && poll(&pfd, 1, 100) == 0,
+		"Batched commands sent, nothing replied before the batch end");
+
+	ret = send_cmd(sock, LTTNG_UST_ABI_ROOT_HANDLE, LTTNG_UST_ABI_BATCH_END, 0);
+	if (!ret)
+		ret = ustcomm_recv_app_reply(sock, &lur, LTTNG_UST_ABI_ROOT_HANDLE,
+				LTTNG_UST_ABI_BATCH_END);
+	ok(!ret && lur.ret_val == NR_BATCH_CMDS,
+		"Batch end replied with one reply per command (ret %d, %u replies)",
+		ret, ret ? 0 : lur.ret_val);
+	if (ret || lur.ret_val != NR_BATCH_CMDS
+			|| ustcomm_recv_unix_sock(sock, replies, sizeof(replies)) != sizeof(replies)) {
+		skip(NUM_TESTS - 3, "Batch replies not received");
+		return;
+	}
+
+	for (i = 0; i < NR_BATCH_CMDS; i++) {
+		if (replies[i].tag == i + 1 && replies[i].handle == batch[i].handle
+				&& replies[i].cmd == batch[i].cmd)
+			nr_in_order++;
+	}
+	ok(nr_in_order == NR_BATCH_CMDS, "Replies in command order (%u of %zu)",
+		nr_in_order, NR_BATCH_CMDS);
+	ok(reply_is(replies, 1, LTTNG_UST_OK), "Session created within the batch");
+	ok(reply_is(replies, 2, LTTNG_UST_OK) && reply_is(replies, 3, LTTNG_UST_OK),
+		"Handle of the session resolved within the batch");
+	ok(reply_is(replies, 4, LTTNG_UST_OK),
+		"Command leaving its handler early replied to");
+	ok(reply_is(replies, 5, -LTTNG_UST_ERR_NOENT),
+		"Command on a handle of no object fails alone (ret_code %d)",
+		replies[4].ret_code);
+	ok(reply_is(replies, 6, -LTTNG_UST_ERR_NOENT),
+		"Command referring to a failed command fails (ret_code %d)",
+		replies[5].ret_code);
+	ok(reply_is(replies, 7, -LTTNG_UST_ERR_INVAL),
+		"Command returning data refused within a batch (ret_code %d)",
+		replies[6].ret_code);
+	ok(reply_is(replies, 8, LTTNG_UST_OK) && replies[7].ret_val != replies[0].ret_val,
+		"Batch goes on after failed commands");
+
+	/* The connection is kept, out of batch mode. */
+	ret = send_cmd(sock, LTTNG_UST_ABI_ROOT_HANDLE, LTTNG_UST_ABI_TRACER_VERSION, 0);
+	if (!ret)
+		ret = ustcomm_recv_app_reply(sock, &lur, LTTNG_UST_ABI_ROOT_HANDLE,
+				LTTNG_UST_ABI_TRACER_VERSION);
+	ok(!ret, "Command replied to after the batch (ret %d)", ret);
+}
+
+int main(int argc, char **argv)
+{
+	struct fake_sessiond sessiond;
+	int ret;
+
+	plan_tests(NUM_TESTS);
+
+	if (argc != 2) {
+		diag("Invoke as: %s <batch-app path>", argv[0]);
+		skip(NUM_TESTS, "No application to run");
+		return exit_status();
+	}
+	alarm(TEST_TIMEOUT);
+
+	if (fake_sessiond_init(&sessiond)) {
+		skip(NUM_TESTS, "Cannot listen on the application socket");
+		goto end;
+	}
+	ret = fake_sessiond_start_app(&sessiond, argv[1]);
+	ok(!ret, "Application registered on its command and notify sockets");
+	if (ret) {
+		skip(NUM_TESTS - 1, "Application not registered");
+		goto end;
+	}
+
+	test_batch(sessiond.cmd_sock);
+
+end:
+	fake_sessiond_fini(&sessiond);
+	return exit_status();
+}
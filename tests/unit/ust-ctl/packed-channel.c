@@ -0,0 +1,163 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Per-cpu channels packed within a single shm object: shared wakeup fd
+ * and ready-cpu bitmap, as seen by a consumer.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <lttng/ust-ctl.h>
+#include <lttng/ust-sigbus.h>
+
+#include "tap.h"
+
+#define NR_CPUS		4
+
+DEFINE_LTTNG_UST_SIGBUS_STATE();
+
+/*
+ * Packing needs more than one possible cpu: have liblttng-ust-ctl see
+ * NR_CPUS of them, whatever the number of cpus of the host running the
+ * test. Buffers of cpus which do not exist are never written to.
+ */
+long sysconf(int name)
+{
+	static long (*libc_sysconf)(int);
+
+	if (name == _SC_NPROCESSORS_CONF)
+		return NR_CPUS;
+	if (!libc_sysconf) {
+		libc_sysconf = (long (*)(int)) dlsym(RTLD_NEXT, "sysconf");
+		if (!libc_sysconf)
+			abort();
+	}
+	return libc_sysconf(name);
+}
+
+static
+int open_stream_fd(void)
+{
+	char name[64];
+	int fd;
+
+	snprintf(name, sizeof(name), "/ust-packed-channel-test-%d", (int) getpid());
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		abort();
+	(void) shm_unlink(name);
+	return fd;
+}
+
+static
+struct lttng_ust_ctl_consumer_channel *create_channel(int nr_stream_fds,
+		int *fds)
+{
+	struct lttng_ust_ctl_consumer_channel_attr attr;
+	int i;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = LTTNG_UST_ABI_CHAN_PER_CPU;
+	attr.subbuf_size = getpagesize();
+	attr.num_subbuf = 2;
+	attr.output = LTTNG_UST_ABI_MMAP;
+	for (i = 0; i < nr_stream_fds; i++)
+		fds[i] = open_stream_fd();
+	return lttng_ust_ctl_create_channel(&attr, fds, nr_stream_fds);
+}
+
+static
+int pending_wakeups(int wait_fd)
+{
+	int len = -1;
+
+	if (ioctl(wait_fd, FIONREAD, &len) < 0)
+		return -1;
+	return len;
+}
+
+int main(void)
+{
+	struct lttng_ust_ctl_consumer_stream *streams[NR_CPUS] = { NULL };
+	struct lttng_ust_ctl_consumer_channel *chan;
+	unsigned long bitmap[2];
+	int fds[NR_CPUS], cpu, wait_fd = -1;
+	bool created = true, shared = true;
+
+	plan_tests(10);
+
+	ok(lttng_ust_ctl_get_nr_stream_per_channel() == NR_CPUS,
+		"%d possible cpus", NR_CPUS);
+
+	chan = create_channel(1, fds);
+	ok(chan, "Create a per-cpu channel packed within one shm object");
+	if (!chan) {
+		skip(8, "No packed channel");
+		return exit_status();
+	}
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		int fd;
+
+		streams[cpu] = lttng_ust_ctl_create_stream(chan, cpu);
+		if (!streams[cpu]) {
+			created = false;
+			continue;
+		}
+		fd = lttng_ust_ctl_stream_get_wait_fd(streams[cpu]);
+		if (!cpu)
+			wait_fd = fd;
+		else if (fd != wait_fd)
+			shared = false;
+	}
+	ok(created, "Create the stream of each cpu");
+	ok(created && wait_fd >= 0 && shared, "Streams share one wait fd");
+
+	ok(lttng_ust_ctl_channel_get_ready_cpus(chan, bitmap, 0) == -EINVAL,
+		"Ready-cpu bitmap does not fit");
+	ok(lttng_ust_ctl_channel_get_ready_cpus(chan, bitmap, 1) == 0,
+		"No cpu ready before any delivery");
+
+	/* Deliver sub-buffers of cpus 1, twice, and NR_CPUS - 1. */
+	if (created) {
+		(void) lttng_ust_ctl_flush_buffer(streams[1], 1);
+		(void) lttng_ust_ctl_flush_buffer(streams[1], 1);
+		(void) lttng_ust_ctl_flush_buffer(streams[NR_CPUS - 1], 1);
+	}
+	ok(pending_wakeups(wait_fd) == 2,
+		"One wakeup per ready cpu until the bitmap is fetched");
+
+	bitmap[1] = ~0UL;
+	ok(lttng_ust_ctl_channel_get_ready_cpus(chan, bitmap, 2) == 2
+		&& bitmap[0] == ((1UL << 1) | (1UL << (NR_CPUS - 1)))
+		&& !bitmap[1],
+		"Ready-cpu bitmap flags the delivering cpus");
+	ok(lttng_ust_ctl_channel_get_ready_cpus(chan, bitmap, 1) == 0,
+		"Ready-cpu bitmap cleared once fetched");
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		if (streams[cpu])
+			lttng_ust_ctl_destroy_stream(streams[cpu]);
+	}
+	lttng_ust_ctl_destroy_channel(chan);
+	(void) close(fds[0]);
+
+	chan = create_channel(NR_CPUS, fds);
+	ok(chan && lttng_ust_ctl_channel_get_ready_cpus(chan, bitmap, 1) == -ENOSYS,
+		"No ready-cpu bitmap without packing");
+	if (chan)
+		lttng_ust_ctl_destroy_channel(chan);
+	for (cpu = 0; cpu < NR_CPUS; cpu++)
+		(void) close(fds[cpu]);
+
+	return exit_status();
+}
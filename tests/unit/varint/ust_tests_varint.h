@@ -0,0 +1,30 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#undef LTTNG_UST_TRACEPOINT_PROVIDER
+#define LTTNG_UST_TRACEPOINT_PROVIDER ust_tests_varint
+
+#if !defined(_TRACEPOINT_UST_TESTS_VARINT_H) || defined(LTTNG_UST_TRACEPOINT_HEADER_MULTI_READ)
+#define _TRACEPOINT_UST_TESTS_VARINT_H
+
+#include <stdint.h>
+
+#include <lttng/tracepoint.h>
+
+LTTNG_UST_TRACEPOINT_EVENT(ust_tests_varint, fields,
+	LTTNG_UST_TP_ARGS(uint32_t, marker, uint64_t, size, uint64_t, seq),
+	LTTNG_UST_TP_FIELDS(
+		lttng_ust_field_integer(uint32_t, marker, marker)
+		lttng_ust_field_integer_varint(uint64_t, size, size)
+		lttng_ust_field_integer_delta(uint64_t, seq, seq)
+	)
+)
+
+#endif /* _TRACEPOINT_UST_TESTS_VARINT_H */
+
+#undef LTTNG_UST_TRACEPOINT_INCLUDE
+#define LTTNG_UST_TRACEPOINT_INCLUDE "./ust_tests_varint.h"
+
+/* This part must be outside ifdef protection */
+#include <lttng/tracepoint-event.h>
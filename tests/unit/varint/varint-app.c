@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Application traced by the variable-length integer test. For each line
+ * read from its standard input, it records an event for each of the
+ * sequence numbers listed on the line, then writes a line to its
+ * standard output. It exits at end of input. It runs on a single cpu,
+ * so all its events of a line are recorded in the same stream.
+ */
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LTTNG_UST_TRACEPOINT_DEFINE
+#define LTTNG_UST_TRACEPOINT_CREATE_PROBES
+#include "ust_tests_varint.h"
+
+#define MARKER	UINT32_C(0xcafef00d)
+#define SIZE	300
+
+int main(void)
+{
+	char line[256];
+	cpu_set_t cpus;
+	int cpu;
+
+	cpu = sched_getcpu();
+	if (cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		(void) sched_setaffinity(0, sizeof(cpus), &cpus);
+	}
+	while (fgets(line, sizeof(line), stdin)) {
+		char *p = line, *end;
+		uint64_t seq;
+
+		for (;;) {
+			seq = strtoull(p, &end, 0);
+			if (end == p)
+				break;
+			lttng_ust_tracepoint(ust_tests_varint, fields, MARKER,
+				SIZE, seq);
+			p = end;
+		}
+		printf("done\n");
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Variable-length and delta-encoded integer fields. The test emulates
+ * the session daemon and the consumer daemon of the application it
+ * starts: it records events of the application in a channel, and
+ * decodes the tag, the width and the kind of record of their integer
+ * fields from the packets read from the channel.
+ */
+
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lttng/ust-ctl.h>
+#include <lttng/ust-events.h>
+#include <lttng/ust-ringbuffer-context.h>
+#include <lttng/ust-sigbus.h>
+#include <lttng/ust-tracer.h>
+
+#include "fake-session.h"
+#include "fake-sessiond.h"
+#include "tap.h"
+
+#define NUM_TESTS	10
+
+/* Test duration limit (s), should the application not respond. */
+#define TEST_TIMEOUT	60
+
+#define EVENT_NAME	"ust_tests_varint:fields"
+#define CHAN_ID		0
+#define EVENT_ID	0
+
+#define SUBBUF_SIZE	4096
+#define NUM_SUBBUF	4
+
+/* Fields recorded by the application, and widths of their values. */
+#define MARKER		UINT32_C(0xcafef00d)
+#define SIZE		300
+#define SIZE_ORDER	1
+#define SEQ		UINT64_C(1000000000000)
+#define SEQ_ORDER	3
+#define FAR		(UINT64_C(1) << 40)
+
+/* Tags of the widths, entries of the dynamic type enumeration. */
+#define TAG_S8		1
+#define TAG_U8		5
+
+#define MAX_RECORDS	8
+
+DEFINE_LTTNG_UST_SIGBUS_STATE();
+
+static struct fake_sessiond sessiond;
+static struct fake_session_channel channel;
+
+struct varint {
+	unsigned int tag;
+	size_t width;
+	uint64_t value;		/* Sign-extended for signed tags. */
+};
+
+struct record {
+	const char *begin, *end;
+	struct varint size;
+	uint8_t kind;
+	struct varint seq;
+	bool contiguous;	/* Begins where the previous record ends. */
+};
+
+struct records {
+	struct record r[MAX_RECORDS];
+	unsigned int nr;
+	bool last_ends_content;
+};
+
+/* Have the application record one event per sequence number of line. */
+static
+int fire(const char *line)
+{
+	char reply[32];
+	size_t len = strlen(line);
+
+	if (write(sessiond.app_stdin, line, len) != (ssize_t) len)
+		return -1;
+	/* Wait for the application to be done. */
+	return read(sessiond.app_stdout, reply, sizeof(reply)) > 0 ? 0 : -1;
+}
+
+static
+size_t order_align(unsigned int order)
+{
+	switch (order) {
+	case 0:
+		return lttng_ust_rb_alignof(uint8_t);
+	case 1:
+		return lttng_ust_rb_alignof(uint16_t);
+	case 2:
+		return lttng_ust_rb_alignof(uint32_t);
+	default:
+		return lttng_ust_rb_alignof(uint64_t);
+	}
+}
+
+/* Decode a tag, and the value of the width it selects. */
+static
+int decode_varint(const char *packet, const char *packet_end, const char **pp,
+		struct varint *varint)
+{
+	const char *p = *pp;
+	unsigned int order;
+	bool is_signed;
+
+	if (p >= packet_end)
+		return -1;
+	varint->tag = (uint8_t) *p++;
+	if (varint->tag >= TAG_S8 && varint->tag < TAG_U8) {
+		is_signed = true;
+		order = varint->tag - TAG_S8;
+	} else if (varint->tag >= TAG_U8 && varint->tag < TAG_U8 + 4) {
+		is_signed = false;
+		order = varint->tag - TAG_U8;
+	} else {
+		return -1;
+	}
+	varint->width = 1U << order;
+	p += lttng_ust_ring_buffer_align(p - packet, order_align(order));
+	if (p + varint->width > packet_end)
+		return -1;
+	switch (order) {
+	case 0:
+	{
+		uint8_t v;
+
+		memcpy(&v, p, sizeof(v));
+		varint->value = is_signed ? (uint64_t) (int8_t) v : v;
+		break;
+	}
+	case 1:
+	{
+		uint16_t v;
+
+		memcpy(&v, p, sizeof(v));
+		varint->value = is_signed ? (uint64_t) (int16_t) v : v;
+		break;
+	}
+	case 2:
+	{
+		uint32_t v;
+
+		memcpy(&v, p, sizeof(v));
+		varint->value = is_signed ? (uint64_t) (int32_t) v : v;
+		break;
+	}
+	default:
+		memcpy(&varint->value, p, sizeof(varint->value));
+		break;
+	}
+	*pp = p + varint->width;
+	return 0;
+}
+
+/*
+ * Decode the records of a packet. Each record begins with the marker,
+ * after the compact event header of the previous one.
+ */
+static
+int decode_packet(const char *packet, const char *packet_end,
+		struct records *records)
+{
+	const char *p = packet, *prev_end = NULL;
+	uint32_t marker = MARKER;
+
+	while (records->nr < MAX_RECORDS) {
+		struct record *record = &records->r[records->nr];
+		size_t next;
+
+		p = memmem(p, packet_end - p, &marker, sizeof(marker));
+		if (!p)
+			break;
+		record->begin = p;
+		record->contiguous = false;
+		if (prev_end) {
+			next = prev_end - packet;
+			next += lttng_ust_ring_buffer_align(next, lttng_ust_rb_alignof(uint32_t));
+			next += sizeof(uint32_t);
+			next += lttng_ust_ring_buffer_align(next, lttng_ust_rb_alignof(uint64_t));
+			record->contiguous = packet + next == p;
+		}
+		p += sizeof(marker);
+		if (decode_varint(packet, packet_end, &p, &record->size))
+			return -1;
+		if (p >= packet_end)
+			return -1;
+		record->kind = (uint8_t) *p++;
+		if (decode_varint(packet, packet_end, &p, &record->seq))
+			return -1;
+		record->end = prev_end = p;
+		records->nr++;
+	}
+	records->last_ends_content = prev_end == packet_end;
+	return 0;
+}
+
+/* Flush the streams of the channel, and decode their packets. */
+static
+int read_records(struct records *records)
+{
+	int cpu, ret = 0;
+
+	records->nr = 0;
+	records->last_ends_content = false;
+	for (cpu = 0; cpu < channel.nr_streams && !ret; cpu++) {
+		struct lttng_ust_ctl_consumer_stream *stream = channel.streams[cpu];
+
+		if (!stream || lttng_ust_ctl_flush_buffer(stream, 1))
+			continue;
+		while (!ret && !lttng_ust_ctl_get_next_subbuf(stream)) {
+			unsigned long read_offset;
+			uint64_t content_size;
+			const char *packet;
+
+			if (!lttng_ust_ctl_get_mmap_read_offset(stream, &read_offset)
+					&& !lttng_ust_ctl_get_content_size(stream, &content_size)) {
+				packet = (const char *) lttng_ust_ctl_get_mmap_base(stream)
+					+ read_offset;
+				ret = decode_packet(packet, packet + content_size / CHAR_BIT,
+					records);
+			}
+			(void) lttng_ust_ctl_put_next_subbuf(stream);
+		}
+	}
+	return ret;
+}
+
+static
+bool is_varint(const struct varint *varint, unsigned int tag, uint64_t value)
+{
+	return varint->tag == tag && varint->width == 1U << (tag - (tag < TAG_U8 ? TAG_S8 : TAG_U8))
+		&& varint->value == value;
+}
+
+static
+void test_varint(void)
+{
+	struct lttng_ust_abi_object_data *event_data = NULL;
+	struct lttng_ust_abi_event ev;
+	struct records records;
+	unsigned int i, nr_ok = 0;
+	int session_handle, ret;
+	char line[128];
+	uint64_t reference;
+
+	session_handle = lttng_ust_ctl_create_session(sessiond.cmd_sock);
+	ret = session_handle < 0 ? session_handle :
+		fake_session_send_channel(sessiond.cmd_sock, session_handle,
+			CHAN_ID, SUBBUF_SIZE, NUM_SUBBUF, &channel);
+	memset(&ev, 0, sizeof(ev));
+	ev.instrumentation = LTTNG_UST_ABI_TRACEPOINT;
+	strcpy(ev.name, EVENT_NAME);
+	ev.loglevel_type = LTTNG_UST_ABI_LOGLEVEL_ALL;
+	ev.loglevel = -1;
+	if (!ret)
+		ret = lttng_ust_ctl_create_event(sessiond.cmd_sock, &ev,
+				channel.data, &event_data);
+	if (!ret)
+		ret = lttng_ust_ctl_enable(sessiond.cmd_sock, event_data);
+	if (!ret)
+		ret = lttng_ust_ctl_start_session(sessiond.cmd_sock, session_handle);
+	/* A value too far from the reference for a smaller delta. */
+	snprintf(line, sizeof(line), "%llu %llu %llu %llu %llu\n",
+		(unsigned long long) SEQ, (unsigned long long) SEQ + 1,
+		(unsigned long long) SEQ + 2, (unsigned long long) (SEQ + FAR),
+		(unsigned long long) SEQ + 3);
+	if (!ret)
+		ret = fire(line);
+	ok(!ret, "Events recorded in a packet (ret %d)", ret);
+	ret = ret ? ret : read_records(&records);
+	ok(!ret && records.nr == 5, "Records decoded from the packet (%u)",
+		ret ? 0 : records.nr);
+	if (ret || records.nr != 5) {
+		skip(NUM_TESTS - 3, "No records");
+		goto end;
+	}
+
+	for (i = 0; i < records.nr; i++) {
+		if (is_varint(&records.r[i].size, TAG_U8 + SIZE_ORDER, SIZE))
+			nr_ok++;
+	}
+	ok(nr_ok == records.nr,
+		"Variable-length integer recorded with tag %d and %d bytes (%u of %u)",
+		TAG_U8 + SIZE_ORDER, 1 << SIZE_ORDER, nr_ok, records.nr);
+	ok(records.r[0].kind == LTTNG_UST_DELTA_KIND_REFERENCE
+			&& is_varint(&records.r[0].seq, TAG_U8 + SEQ_ORDER, SEQ),
+		"First value of the packet recorded as its reference in %zu bytes (kind %u, tag %u)",
+		records.r[0].seq.width, records.r[0].kind, records.r[0].seq.tag);
+	reference = records.r[0].seq.value;
+	ok(records.r[1].kind == LTTNG_UST_DELTA_KIND_DELTA
+			&& is_varint(&records.r[1].seq, TAG_S8, 1)
+			&& records.r[2].kind == LTTNG_UST_DELTA_KIND_DELTA
+			&& is_varint(&records.r[2].seq, TAG_S8, 2)
+			&& reference + records.r[2].seq.value == SEQ + 2,
+		"Following values recorded as 1 byte deltas against the reference (kind %u, tag %u, %zu bytes)",
+		records.r[1].kind, records.r[1].seq.tag, records.r[1].seq.width);
+	ok(records.r[3].kind == LTTNG_UST_DELTA_KIND_VALUE
+			&& is_varint(&records.r[3].seq, TAG_U8 + SEQ_ORDER, SEQ + FAR),
+		"Value with a delta as wide as itself recorded as value (kind %u, tag %u)",
+		records.r[3].kind, records.r[3].seq.tag);
+	ok(records.r[4].kind == LTTNG_UST_DELTA_KIND_DELTA
+			&& is_varint(&records.r[4].seq, TAG_S8, 3),
+		"Reference kept after a value (kind %u)", records.r[4].kind);
+	nr_ok = 0;
+	for (i = 1; i < records.nr; i++) {
+		if (records.r[i].contiguous)
+			nr_ok++;
+	}
+	ok(nr_ok == records.nr - 1 && records.last_ends_content,
+		"Records end at their last byte written (%u of %u contiguous)",
+		nr_ok, records.nr - 1);
+
+	/* The flush began a new packet. */
+	snprintf(line, sizeof(line), "%llu %llu\n",
+		(unsigned long long) SEQ + 10, (unsigned long long) SEQ + 9);
+	ret = fire(line);
+	ret = ret ? ret : read_records(&records);
+	ok(!ret && records.nr == 2
+			&& records.r[0].kind == LTTNG_UST_DELTA_KIND_REFERENCE
+			&& is_varint(&records.r[0].seq, TAG_U8 + SEQ_ORDER, SEQ + 10)
+			&& records.r[1].kind == LTTNG_UST_DELTA_KIND_DELTA
+			&& is_varint(&records.r[1].seq, TAG_S8, (uint64_t) -1),
+		"Reference reset in the next packet (%u records)", ret ? 0 : records.nr);
+
+end:
+	if (event_data) {
+		(void) lttng_ust_ctl_release_object(-1, event_data);
+		free(event_data);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct fake_session_notify notify = {
+		.chan_id = CHAN_ID,
+		.event_id = EVENT_ID,
+	};
+	bool notify_started = false;
+	int ret;
+
+	plan_tests(NUM_TESTS);
+
+	if (argc != 2) {
+		diag("Invoke as: %s <varint-app path>", argv[0]);
+		skip(NUM_TESTS, "No application to run");
+		return exit_status();
+	}
+	alarm(TEST_TIMEOUT);
+
+	if (fake_sessiond_init(&sessiond)) {
+		skip(NUM_TESTS, "Cannot listen on the application socket");
+		goto end;
+	}
+	ret = fake_sessiond_start_app(&sessiond, argv[1]);
+	if (!ret)
+		ret = lttng_ust_ctl_register_done(sessiond.cmd_sock);
+	ok(!ret, "Application registered (ret %d)", ret);
+	if (ret) {
+		skip(NUM_TESTS - 1, "Application not registered");
+		goto end;
+	}
+	notify.sock = sessiond.notify_sock;
+	if (fake_session_start_notify(&notify)) {
+		skip(NUM_TESTS - 1, "Cannot reply to the application registrations");
+		goto end;
+	}
+	notify_started = true;
+
+	test_varint();
+
+end:
+	/* The notify thread ends with the notify socket of the application. */
+	if (sessiond.app > 0) {
+		close(sessiond.app_stdin);
+		sessiond.app_stdin = -1;
+	}
+	if (notify_started)
+		fake_session_join_notify(&notify);
+	fake_sessiond_fini(&sessiond);
+	fake_session_destroy_channel(&channel);
+	return exit_status();
+}
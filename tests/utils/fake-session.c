@@ -0,0 +1,175 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fake-session.h"
+#include "stream-fds.h"
+
+static
+void *notify_thread(void *arg)
+{
+	struct fake_session_notify *notify = arg;
+	int sock = notify->sock;
+
+	for (;;) {
+		enum lttng_ust_ctl_notify_cmd cmd;
+		int ret;
+
+		if (lttng_ust_ctl_recv_notify(sock, &cmd))
+			break;
+		switch (cmd) {
+		case LTTNG_UST_CTL_NOTIFY_CMD_EVENT:
+		{
+			char name[LTTNG_UST_ABI_SYM_NAME_LEN], *signature, *model_emf_uri;
+			struct lttng_ust_ctl_field *fields;
+			int session_objd, channel_objd, loglevel;
+			size_t nr_fields;
+
+			ret = lttng_ust_ctl_recv_register_event(sock, &session_objd,
+				&channel_objd, name, &loglevel, &signature,
+				&nr_fields, &fields, &model_emf_uri);
+			if (ret)
+				return NULL;
+			free(signature);
+			free(fields);
+			free(model_emf_uri);
+			ret = lttng_ust_ctl_reply_register_event(sock, notify->event_id, 0);
+			break;
+		}
+		case LTTNG_UST_CTL_NOTIFY_CMD_CHANNEL:
+		{
+			struct lttng_ust_ctl_field *fields;
+			int session_objd, channel_objd;
+			size_t nr_fields;
+
+			ret = lttng_ust_ctl_recv_register_channel(sock, &session_objd,
+				&channel_objd, &nr_fields, &fields);
+			if (ret)
+				return NULL;
+			free(fields);
+			ret = lttng_ust_ctl_reply_register_channel(sock, notify->chan_id,
+				LTTNG_UST_CTL_CHANNEL_HEADER_COMPACT, 0);
+			break;
+		}
+		case LTTNG_UST_CTL_NOTIFY_CMD_ENUM:
+		{
+			char name[LTTNG_UST_ABI_SYM_NAME_LEN];
+			struct lttng_ust_ctl_enum_entry *entries;
+			int session_objd;
+			size_t nr_entries;
+
+			ret = lttng_ust_ctl_recv_register_enum(sock, &session_objd,
+				name, &entries, &nr_entries);
+			if (ret)
+				return NULL;
+			free(entries);
+			ret = lttng_ust_ctl_reply_register_enum(sock, 0, 0);
+			break;
+		}
+		default:
+			return NULL;
+		}
+		if (ret)
+			break;
+	}
+	return NULL;
+}
+
+int fake_session_start_notify(struct fake_session_notify *notify)
+{
+	return pthread_create(&notify->tid, NULL, notify_thread, notify) ? -1 : 0;
+}
+
+void fake_session_join_notify(struct fake_session_notify *notify)
+{
+	(void) pthread_join(notify->tid, NULL);
+}
+
+int fake_session_send_channel(int cmd_sock, int session_handle,
+		uint32_t chan_id, size_t subbuf_size, size_t num_subbuf,
+		struct fake_session_channel *channel)
+{
+	struct lttng_ust_ctl_consumer_channel_attr attr;
+	int sv[2], ret, cpu;
+
+	memset(channel, 0, sizeof(*channel));
+	channel->nr_streams = lttng_ust_ctl_get_nr_stream_per_channel();
+	if (channel->nr_streams <= 0) {
+		channel->nr_streams = 0;
+		return -1;
+	}
+	channel->streams = calloc(channel->nr_streams, sizeof(*channel->streams));
+	channel->stream_fds = calloc(channel->nr_streams, sizeof(*channel->stream_fds));
+	if (!channel->streams || !channel->stream_fds)
+		return -1;
+	if (open_stream_fds(channel->stream_fds, channel->nr_streams)) {
+		free(channel->stream_fds);
+		channel->stream_fds = NULL;
+		return -1;
+	}
+	memset(&attr, 0, sizeof(attr));
+	attr.type = LTTNG_UST_ABI_CHAN_PER_CPU;
+	attr.subbuf_size = subbuf_size;
+	attr.num_subbuf = num_subbuf;
+	attr.output = LTTNG_UST_ABI_MMAP;
+	attr.chan_id = chan_id;
+	channel->chan = lttng_ust_ctl_create_channel(&attr, channel->stream_fds,
+			channel->nr_streams);
+	if (!channel->chan)
+		return -1;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+		return -1;
+	ret = lttng_ust_ctl_send_channel_to_sessiond(sv[0], channel->chan);
+	if (!ret)
+		ret = lttng_ust_ctl_recv_channel_from_consumer(sv[1], &channel->data);
+	if (!ret)
+		ret = lttng_ust_ctl_send_channel_to_ust(cmd_sock, session_handle,
+				channel->data);
+	for (cpu = 0; !ret && cpu < channel->nr_streams; cpu++) {
+		struct lttng_ust_abi_object_data *stream_data = NULL;
+
+		channel->streams[cpu] = lttng_ust_ctl_create_stream(channel->chan, cpu);
+		if (!channel->streams[cpu])
+			continue;
+		ret = lttng_ust_ctl_send_stream_to_sessiond(sv[0], channel->streams[cpu]);
+		if (!ret)
+			ret = lttng_ust_ctl_recv_stream_from_consumer(sv[1], &stream_data);
+		if (!ret)
+			ret = lttng_ust_ctl_send_stream_to_ust(cmd_sock, channel->data,
+					stream_data);
+		if (stream_data) {
+			(void) lttng_ust_ctl_release_object(-1, stream_data);
+			free(stream_data);
+		}
+	}
+	close(sv[0]);
+	close(sv[1]);
+	return ret ? -1 : 0;
+}
+
+void fake_session_destroy_channel(struct fake_session_channel *channel)
+{
+	int cpu;
+
+	if (channel->data) {
+		(void) lttng_ust_ctl_release_object(-1, channel->data);
+		free(channel->data);
+	}
+	for (cpu = 0; channel->streams && cpu < channel->nr_streams; cpu++) {
+		if (channel->streams[cpu])
+			lttng_ust_ctl_destroy_stream(channel->streams[cpu]);
+	}
+	free(channel->streams);
+	if (channel->chan)
+		lttng_ust_ctl_destroy_channel(channel->chan);
+	if (channel->stream_fds)
+		close_stream_fds(channel->stream_fds, channel->nr_streams);
+	free(channel->stream_fds);
+	memset(channel, 0, sizeof(*channel));
+}
@@ -0,0 +1,54 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Tracing session of an application registered to the emulated session
+ * daemon: replies to the registrations on its notify socket, and
+ * per-cpu channel created as the consumer daemon does.
+ */
+
+#ifndef _LTTNG_UST_TESTS_FAKE_SESSION_H
+#define _LTTNG_UST_TESTS_FAKE_SESSION_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lttng/ust-ctl.h>
+
+struct fake_session_notify {
+	int sock;
+	uint32_t chan_id;	/* Id replied to channel registrations. */
+	uint32_t event_id;	/* Id replied to event registrations. */
+	pthread_t tid;
+};
+
+struct fake_session_channel {
+	struct lttng_ust_ctl_consumer_channel *chan;
+	struct lttng_ust_ctl_consumer_stream **streams;	/* One per cpu. */
+	int *stream_fds;
+	int nr_streams;
+	struct lttng_ust_abi_object_data *data;		/* Sent to the session. */
+};
+
+/*
+ * Reply to the registrations on the notify socket from a thread, until
+ * the application closes it. Returns 0 on success, -1 on error.
+ */
+int fake_session_start_notify(struct fake_session_notify *notify);
+
+/* Wait for the application to close its notify socket. */
+void fake_session_join_notify(struct fake_session_notify *notify);
+
+/*
+ * Create a per-cpu channel as the consumer daemon does, hand it over to
+ * the session daemon through a socket pair, then send it with its
+ * streams to the session. Returns 0 on success, -1 on error: the
+ * channel is destroyed by fake_session_destroy_channel() either way.
+ */
+int fake_session_send_channel(int cmd_sock, int session_handle,
+		uint32_t chan_id, size_t subbuf_size, size_t num_subbuf,
+		struct fake_session_channel *channel);
+
+void fake_session_destroy_channel(struct fake_session_channel *channel);
+
+#endif /* _LTTNG_UST_TESTS_FAKE_SESSION_H */
@@ -0,0 +1,158 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <lttng/ust-ctl.h>
+
+#include "common/ustcomm.h"
+
+#include "fake-sessiond.h"
+
+#define FAKE_SESSIOND_HOME_TEMPLATE	"/tmp/ust-tests-XXXXXX"
+
+static
+int listen_app_sock(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if (bind(sock, (struct sockaddr *) &addr, sizeof(addr))
+			|| listen(sock, SOMAXCONN)) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/* Accept a connection of the application, and its registration. */
+static
+int accept_app(int listen_sock, enum lttng_ust_ctl_socket_type type)
+{
+	struct lttng_ust_ctl_reg_msg reg_msg;
+	int sock;
+
+	sock = accept(listen_sock, NULL, NULL);
+	if (sock < 0)
+		return -1;
+	if (recv(sock, &reg_msg, sizeof(reg_msg), MSG_WAITALL) != sizeof(reg_msg)
+			|| reg_msg.magic != LTTNG_UST_ABI_COMM_MAGIC
+			|| reg_msg.socket_type != type) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+int fake_sessiond_init(struct fake_sessiond *sessiond)
+{
+	memset(sessiond, 0, sizeof(*sessiond));
+	sessiond->listen_sock = -1;
+	sessiond->app = -1;
+	sessiond->app_stdin = -1;
+	sessiond->app_stdout = -1;
+	sessiond->cmd_sock = -1;
+	sessiond->notify_sock = -1;
+
+	strcpy(sessiond->home_dir, FAKE_SESSIOND_HOME_TEMPLATE);
+	if (!mkdtemp(sessiond->home_dir)) {
+		sessiond->home_dir[0] = '\0';
+		return -1;
+	}
+	snprintf(sessiond->rundir, sizeof(sessiond->rundir), "%s/%s",
+		sessiond->home_dir, LTTNG_DEFAULT_HOME_RUNDIR);
+	snprintf(sessiond->sock_path, sizeof(sessiond->sock_path), "%s/%s/%s",
+		sessiond->home_dir, LTTNG_DEFAULT_HOME_RUNDIR, LTTNG_UST_SOCK_FILENAME);
+	if (mkdir(sessiond->rundir, 0700))
+		return -1;
+	sessiond->listen_sock = listen_app_sock(sessiond->sock_path);
+	if (sessiond->listen_sock < 0)
+		return -1;
+	return 0;
+}
+
+int fake_sessiond_start_app(struct fake_sessiond *sessiond,
+		const char *app_path)
+{
+	int stdin_fds[2], stdout_fds[2];
+	pid_t pid;
+
+	if (pipe(stdin_fds))
+		return -1;
+	if (pipe(stdout_fds)) {
+		close(stdin_fds[0]);
+		close(stdin_fds[1]);
+		return -1;
+	}
+	pid = fork();
+	if (pid == 0) {
+		if (dup2(stdin_fds[0], STDIN_FILENO) < 0
+				|| dup2(stdout_fds[1], STDOUT_FILENO) < 0)
+			_exit(EXIT_FAILURE);
+		close(stdin_fds[0]);
+		close(stdin_fds[1]);
+		close(stdout_fds[0]);
+		close(stdout_fds[1]);
+		close(sessiond->listen_sock);
+		if (setenv("LTTNG_HOME", sessiond->home_dir, 1))
+			_exit(EXIT_FAILURE);
+		execl(app_path, app_path, (char *) NULL);
+		_exit(EXIT_FAILURE);
+	}
+	close(stdin_fds[0]);
+	close(stdout_fds[1]);
+	if (pid < 0) {
+		close(stdin_fds[1]);
+		close(stdout_fds[0]);
+		return -1;
+	}
+	sessiond->app = pid;
+	sessiond->app_stdin = stdin_fds[1];
+	sessiond->app_stdout = stdout_fds[0];
+
+	sessiond->cmd_sock = accept_app(sessiond->listen_sock,
+			LTTNG_UST_CTL_SOCKET_CMD);
+	if (sessiond->cmd_sock < 0)
+		return -1;
+	sessiond->notify_sock = accept_app(sessiond->listen_sock,
+			LTTNG_UST_CTL_SOCKET_NOTIFY);
+	if (sessiond->notify_sock < 0)
+		return -1;
+	return 0;
+}
+
+void fake_sessiond_fini(struct fake_sessiond *sessiond)
+{
+	if (sessiond->cmd_sock >= 0)
+		close(sessiond->cmd_sock);
+	if (sessiond->notify_sock >= 0)
+		close(sessiond->notify_sock);
+	if (sessiond->app > 0) {
+		close(sessiond->app_stdin);
+		close(sessiond->app_stdout);
+		(void) waitpid(sessiond->app, NULL, 0);
+	}
+	if (sessiond->listen_sock >= 0)
+		close(sessiond->listen_sock);
+	if (sessiond->home_dir[0]) {
+		(void) unlink(sessiond->sock_path);
+		(void) rmdir(sessiond->rundir);
+		(void) rmdir(sessiond->home_dir);
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Session daemon emulated on the per-user application socket of a
+ * temporary LTTNG_HOME, for tests talking to an application through
+ * its command and notify sockets.
+ */
+
+#ifndef _LTTNG_UST_TESTS_FAKE_SESSIOND_H
+#define _LTTNG_UST_TESTS_FAKE_SESSIOND_H
+
+#include <limits.h>
+#include <sys/types.h>
+
+struct fake_sessiond {
+	char home_dir[PATH_MAX];
+	char rundir[PATH_MAX];
+	char sock_path[PATH_MAX];
+	int listen_sock;
+
+	pid_t app;
+	int app_stdin;		/* Write end of the standard input of the application. */
+	int app_stdout;		/* Read end of its standard output. */
+	int cmd_sock;
+	int notify_sock;
+};
+
+/*
+ * Create LTTNG_HOME and listen on its application socket. Returns 0 on
+ * success, -1 on error.
+ */
+int fake_sessiond_init(struct fake_sessiond *sessiond);
+
+/*
+ * Start the application at app_path with its standard input and output
+ * piped to the test, and accept the registration of its command and
+ * notify sockets. Returns 0 on success, -1 on error.
+ */
+int fake_sessiond_start_app(struct fake_sessiond *sessiond,
+		const char *app_path);
+
+/*
+ * Close the sockets and the standard input of the application, wait
+ * for it to exit, and remove LTTNG_HOME.
+ */
+void fake_sessiond_fini(struct fake_sessiond *sessiond);
+
+#endif /* _LTTNG_UST_TESTS_FAKE_SESSIOND_H */
@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stream-fds.h"
+
+int open_stream_fds(int *fds, int nr)
+{
+	char name[64];
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		snprintf(name, sizeof(name), "/ust-tests-stream-%d-%d",
+			(int) getpid(), i);
+		fds[i] = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fds[i] < 0) {
+			int saved_errno = errno;
+
+			close_stream_fds(fds, i);
+			errno = saved_errno;
+			return -1;
+		}
+		(void) shm_unlink(name);
+	}
+	return 0;
+}
+
+void close_stream_fds(int *fds, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		(void) close(fds[i]);
+}
@@ -0,0 +1,19 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ * Shared memory files backing the streams of a channel, as the
+ * consumer daemon passes them to channel creation.
+ */
+
+#ifndef _LTTNG_UST_TESTS_STREAM_FDS_H
+#define _LTTNG_UST_TESTS_STREAM_FDS_H
+
+/*
+ * Open nr unlinked shm files into fds. Returns 0 on success, or -1 with
+ * errno set, none of the files left open.
+ */
+int open_stream_fds(int *fds, int nr);
+
+void close_stream_fds(int *fds, int nr);
+
+#endif /* _LTTNG_UST_TESTS_STREAM_FDS_H */